@@ -51,6 +51,21 @@ public:
     itkSetMacro(B0Threshold, double)
     itkGetMacro(B0Threshold, double)
 
+    //! Seed each voxel optimization from the previous voxel on the same line (and thread region) if it fits data better than log-linear estimate
+    itkSetMacro(UseSpatialWarmStart, bool)
+    itkGetMacro(UseSpatialWarmStart, bool)
+
+    /**
+     * Fast estimation: replaces non-linear refinement by iteratively reweighted linear least squares on log-signals,
+     * solving a fixed size normal system per voxel, voxels being processed by batches
+     */
+    itkSetMacro(UseWeightedLinearEstimation, bool)
+    itkGetMacro(UseWeightedLinearEstimation, bool)
+
+    //! Number of weighted least squares iterations in fast estimation (the first one is weighted by observed signals)
+    itkSetMacro(NumberOfWeightedLinearIterations, unsigned int)
+    itkGetMacro(NumberOfWeightedLinearIterations, unsigned int)
+
     itkGetMacro(EstimatedB0Image, OutputB0ImageType *)
     itkGetMacro(EstimatedVarianceImage, OutputB0ImageType *)
 
@@ -65,6 +80,9 @@ protected:
         m_B0Threshold = 0;
         m_EstimatedB0Image = NULL;
         m_EstimatedVarianceImage = NULL;
+        m_UseSpatialWarmStart = false;
+        m_UseWeightedLinearEstimation = false;
+        m_NumberOfWeightedLinearIterations = 3;
     }
 
     virtual ~DTIEstimationImageFilter() {}
@@ -75,6 +93,15 @@ protected:
     void BeforeThreadedGenerateData() ITK_OVERRIDE;
     void ThreadedGenerateData(const OutputImageRegionType &outputRegionForThread, itk::ThreadIdType threadId) ITK_OVERRIDE;
 
+    //! Fast estimation on a region, see SetUseWeightedLinearEstimation
+    void WeightedLinearGenerateData(const OutputImageRegionType &outputRegionForThread);
+
+    /**
+     * Iteratively reweighted linear least squares for a batch of voxels. logSignals holds one voxel per row,
+     * estimates (log B0 then tensor vector representation, one voxel per row) are initialized to log-linear estimates
+     */
+    void SolveWeightedLinearBatch(unsigned int batchSize, const vnl_matrix <double> &logSignals, vnl_matrix <double> &estimates);
+
     static double OptimizationFunction(const std::vector<double> &x, std::vector<double> &grad, void *func_data);
     double ComputeCostAtPosition(const std::vector<double> &x, const std::vector <double> &observedData,
                                  std::vector <double> &predictedValues, vnl_matrix <double> &rotationMatrix,
@@ -89,11 +116,20 @@ private:
     std::vector< vnl_vector_fixed<double,3> > m_GradientDirections;
 
     double m_B0Threshold;
+    bool m_UseSpatialWarmStart;
+    bool m_UseWeightedLinearEstimation;
+    unsigned int m_NumberOfWeightedLinearIterations;
     typename OutputB0ImageType::Pointer m_EstimatedB0Image, m_EstimatedVarianceImage;
 
     static const unsigned int m_NumberOfComponents = 6;
 
     vnl_matrix <double> m_InitialMatrixSolver;
+
+    //! Log-linear design matrix and its row-wise outer products (upper triangular part, one row per input)
+    vnl_matrix <double> m_DesignMatrix;
+    vnl_matrix <double> m_DesignOuterProducts;
+
+    static const unsigned int m_WeightedLinearBatchSize = 64;
 };
 
 } // end of namespace anima
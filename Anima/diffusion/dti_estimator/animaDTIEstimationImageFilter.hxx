@@ -4,6 +4,7 @@
 #include <itkImageRegionIterator.h>
 #include <itkImageRegionIteratorWithIndex.h>
 #include <itkImageRegionConstIterator.h>
+#include <itkImageRegionConstIteratorWithIndex.h>
 
 #include <vnl/algo/vnl_determinant.h>
 #include <vnl/algo/vnl_matrix_inverse.h>
@@ -151,6 +152,23 @@ DTIEstimationImageFilter<InputPixelScalarType, OutputPixelScalarType>
     vnl_matrix_inverse <double> inverter (initSolverSystem);
     m_InitialMatrixSolver = inverter.pinverse();
 
+    // Row-wise outer products of the design matrix: normal matrices of a batch of voxels are then a single matrix product
+    m_DesignMatrix = initSolverSystem;
+    unsigned int numUnknowns = m_NumberOfComponents + 1;
+    m_DesignOuterProducts.set_size(this->GetNumberOfIndexedInputs(),numUnknowns * (numUnknowns + 1) / 2);
+    for (unsigned int i = 0;i < this->GetNumberOfIndexedInputs();++i)
+    {
+        unsigned int pos = 0;
+        for (unsigned int j = 0;j < numUnknowns;++j)
+        {
+            for (unsigned int k = j;k < numUnknowns;++k)
+            {
+                m_DesignOuterProducts(i,pos) = initSolverSystem(i,j) * initSolverSystem(i,k);
+                ++pos;
+            }
+        }
+    }
+
     Superclass::BeforeThreadedGenerateData();
 }
 
@@ -159,6 +177,12 @@ void
 DTIEstimationImageFilter<InputPixelScalarType, OutputPixelScalarType>
 ::ThreadedGenerateData(const OutputImageRegionType &outputRegionForThread, itk::ThreadIdType threadId)
 {
+    if (m_UseWeightedLinearEstimation)
+    {
+        this->WeightedLinearGenerateData(outputRegionForThread);
+        return;
+    }
+
     typedef itk::ImageRegionConstIterator <InputImageType> ImageIteratorType;
 
     unsigned int numInputs = this->GetNumberOfIndexedInputs();
@@ -190,9 +214,22 @@ DTIEstimationImageFilter<InputPixelScalarType, OutputPixelScalarType>
     typedef itk::SymmetricEigenAnalysis < vnl_matrix <double>, vnl_diag_matrix<double>, vnl_matrix <double> > EigenAnalysisType;
     EigenAnalysisType eigen(3);
 
+    // Last estimate on the current line, used as a candidate starting point (spatial warm start). It is local to the
+    // thread region: the first voxel of each region starts cold
+    std::vector <double> neighborValue(m_NumberOfComponents, 0.0);
+    bool neighborValid = false;
+    typename OutputImageType::IndexType previousIndex;
+    previousIndex.Fill(0);
+
     while (!outIterator.IsAtEnd())
     {
         resVec.Fill(0.0);
+
+        typename OutputImageType::IndexType currentIndex = outIterator.GetIndex();
+        bool hasNeighbor = m_UseSpatialWarmStart && neighborValid && (currentIndex[0] == previousIndex[0] + 1)
+                && (currentIndex[1] == previousIndex[1]) && (currentIndex[2] == previousIndex[2]);
+        previousIndex = currentIndex;
+        neighborValid = false;
         
         if (maskIterator.Get() == 0)
         {
@@ -273,6 +310,18 @@ DTIEstimationImageFilter<InputPixelScalarType, OutputPixelScalarType>
         data.dwi = dwi;
         data.predictedValues = predictedValues;
 
+        if (hasNeighbor)
+        {
+            // Same number of parameters, comparing costs is comparing AICc: keep log-linear start if neighbor is worse
+            double initialCost = this->ComputeCostAtPosition(optimizedValue,dwi,data.predictedValues,data.rotationMatrix,
+                                                             data.workTensor,data.workEigenValues);
+            double neighborCost = this->ComputeCostAtPosition(neighborValue,dwi,data.predictedValues,data.rotationMatrix,
+                                                              data.workTensor,data.workEigenValues);
+
+            if (neighborCost < initialCost)
+                optimizedValue = neighborValue;
+        }
+
         opt.set_min_objective(OptimizationFunction, &data);
 
         try
@@ -310,6 +359,12 @@ DTIEstimationImageFilter<InputPixelScalarType, OutputPixelScalarType>
             }
         }
 
+        if (m_UseSpatialWarmStart)
+        {
+            neighborValue = optimizedValue;
+            neighborValid = true;
+        }
+
         anima::Get3DRotationExponential(optimizedValue,data.rotationMatrix);
         for (unsigned int i = 0;i < 3;++i)
             data.workEigenValues[i] = optimizedValue[3 + i];
@@ -334,6 +389,239 @@ DTIEstimationImageFilter<InputPixelScalarType, OutputPixelScalarType>
     }
 }
 
+template <class InputPixelScalarType, class OutputPixelScalarType>
+void
+DTIEstimationImageFilter<InputPixelScalarType, OutputPixelScalarType>
+::WeightedLinearGenerateData(const OutputImageRegionType &outputRegionForThread)
+{
+    typedef itk::ImageRegionConstIterator <InputImageType> ImageIteratorType;
+    typedef itk::ImageRegionConstIteratorWithIndex <MaskImageType> MaskIteratorType;
+    typedef typename OutputImageType::IndexType IndexType;
+    typedef typename OutputImageType::PixelType OutputPixelType;
+
+    unsigned int numInputs = this->GetNumberOfIndexedInputs();
+    std::vector <ImageIteratorType> inIterators;
+    for (unsigned int i = 0;i < numInputs;++i)
+        inIterators.push_back(ImageIteratorType(this->GetInput(i),outputRegionForThread));
+
+    MaskIteratorType maskIterator(this->GetComputationMask(),outputRegionForThread);
+
+    // Outputs are already filled with zeros outside of the mask
+    std::vector <IndexType> batchIndexes(m_WeightedLinearBatchSize);
+    vnl_matrix <double> dwiSignals(m_WeightedLinearBatchSize,numInputs);
+    vnl_matrix <double> logSignals(m_WeightedLinearBatchSize,numInputs);
+    vnl_matrix <double> estimates(m_WeightedLinearBatchSize,m_NumberOfComponents + 1);
+
+    OutputPixelType resVec(m_NumberOfComponents);
+    std::vector <double> dwi(numInputs,0);
+    vnl_matrix <double> workTensor(3,3), eigenVectors(3,3);
+    vnl_diag_matrix <double> eigenValues(3);
+
+    typedef itk::SymmetricEigenAnalysis < vnl_matrix <double>, vnl_diag_matrix<double>, vnl_matrix <double> > EigenAnalysisType;
+    EigenAnalysisType eigen(3);
+
+    // Same bounds as non-linear estimation
+    double minValue = 1.0e-7;
+    double maxValue = 1.0e-2;
+
+    unsigned int batchSize = 0;
+    while (!maskIterator.IsAtEnd())
+    {
+        if (maskIterator.Get() != 0)
+        {
+            batchIndexes[batchSize] = maskIterator.GetIndex();
+            for (unsigned int i = 0;i < numInputs;++i)
+            {
+                dwiSignals(batchSize,i) = inIterators[i].Get();
+                logSignals(batchSize,i) = std::log(std::max(1.0e-6,dwiSignals(batchSize,i)));
+            }
+
+            ++batchSize;
+        }
+
+        for (unsigned int i = 0;i < numInputs;++i)
+            ++inIterators[i];
+        ++maskIterator;
+
+        if ((batchSize < m_WeightedLinearBatchSize) && ((batchSize == 0) || (!maskIterator.IsAtEnd())))
+            continue;
+
+        this->SolveWeightedLinearBatch(batchSize,logSignals,estimates);
+
+        for (unsigned int j = 0;j < batchSize;++j)
+        {
+            for (unsigned int i = 0;i < m_NumberOfComponents;++i)
+                resVec[i] = estimates(j,i + 1);
+
+            anima::GetTensorFromVectorRepresentation(resVec,workTensor);
+            eigen.ComputeEigenValuesAndVectors(workTensor,eigenValues,eigenVectors);
+
+            bool outOfBounds = false;
+            for (unsigned int i = 0;i < 3;++i)
+            {
+                if ((eigenValues[i] < minValue) || (eigenValues[i] > maxValue) || (!std::isfinite(eigenValues[i])))
+                {
+                    outOfBounds = true;
+                    eigenValues[i] = std::isfinite(eigenValues[i]) ? std::min(maxValue, std::max(eigenValues[i], minValue)) : minValue;
+                }
+            }
+
+            if (outOfBounds)
+            {
+                anima::RecomposeTensor(eigenValues,eigenVectors,workTensor);
+                anima::GetVectorRepresentation(workTensor,resVec);
+            }
+
+            for (unsigned int i = 0;i < numInputs;++i)
+                dwi[i] = dwiSignals(j,i);
+
+            double outVarianceValue;
+            double outB0Value = this->ComputeB0AndVarianceFromTensorVector(workTensor,dwi,outVarianceValue);
+
+            this->GetOutput()->SetPixel(batchIndexes[j],resVec);
+            m_EstimatedB0Image->SetPixel(batchIndexes[j],outB0Value);
+            m_EstimatedVarianceImage->SetPixel(batchIndexes[j],outVarianceValue);
+        }
+
+        batchSize = 0;
+    }
+}
+
+template <class InputPixelScalarType, class OutputPixelScalarType>
+void
+DTIEstimationImageFilter<InputPixelScalarType, OutputPixelScalarType>
+::SolveWeightedLinearBatch(unsigned int batchSize, const vnl_matrix <double> &logSignals, vnl_matrix <double> &estimates)
+{
+    unsigned int numInputs = this->GetNumberOfIndexedInputs();
+    const unsigned int numUnknowns = m_NumberOfComponents + 1;
+    unsigned int numOuterProducts = m_DesignOuterProducts.cols();
+
+    // Log-linear estimates, also kept as fallback if a weighted system is singular
+    for (unsigned int j = 0;j < batchSize;++j)
+    {
+        for (unsigned int k = 0;k < numUnknowns;++k)
+        {
+            double value = 0;
+            for (unsigned int i = 0;i < numInputs;++i)
+                value += m_InitialMatrixSolver(k,i) * logSignals(j,i);
+
+            estimates(j,k) = value;
+        }
+    }
+
+    // First iteration is weighted by squared observed signals, next ones by squared predicted signals
+    vnl_matrix <double> weights(batchSize,numInputs);
+    for (unsigned int j = 0;j < batchSize;++j)
+    {
+        for (unsigned int i = 0;i < numInputs;++i)
+            weights(j,i) = std::exp(2.0 * logSignals(j,i));
+    }
+
+    vnl_matrix <double> normalMatrices(batchSize,numOuterProducts);
+    vnl_matrix <double> rightHandSides(batchSize,numUnknowns);
+    double choleskyFactor[numUnknowns][numUnknowns];
+    double solution[numUnknowns];
+
+    for (unsigned int iter = 0;iter < m_NumberOfWeightedLinearIterations;++iter)
+    {
+        // Batched normal equations: A^T W A and A^T W y for all voxels, inner loops are contiguous
+        normalMatrices.fill(0.0);
+        rightHandSides.fill(0.0);
+        for (unsigned int j = 0;j < batchSize;++j)
+        {
+            double *normalRow = normalMatrices[j];
+            double *rhsRow = rightHandSides[j];
+            for (unsigned int i = 0;i < numInputs;++i)
+            {
+                double weight = weights(j,i);
+                const double *outerRow = m_DesignOuterProducts[i];
+                for (unsigned int k = 0;k < numOuterProducts;++k)
+                    normalRow[k] += weight * outerRow[k];
+
+                double weightedSignal = weight * logSignals(j,i);
+                const double *designRow = m_DesignMatrix[i];
+                for (unsigned int k = 0;k < numUnknowns;++k)
+                    rhsRow[k] += weightedSignal * designRow[k];
+            }
+        }
+
+        for (unsigned int j = 0;j < batchSize;++j)
+        {
+            // Cholesky factorization of the fixed size normal matrix
+            bool validSystem = true;
+            unsigned int pos = 0;
+            for (unsigned int k = 0;k < numUnknowns;++k)
+            {
+                for (unsigned int l = k;l < numUnknowns;++l)
+                {
+                    choleskyFactor[l][k] = normalMatrices(j,pos);
+                    ++pos;
+                }
+            }
+
+            for (unsigned int k = 0;(k < numUnknowns) && validSystem;++k)
+            {
+                for (unsigned int l = 0;l < k;++l)
+                    choleskyFactor[k][k] -= choleskyFactor[k][l] * choleskyFactor[k][l];
+
+                if ((choleskyFactor[k][k] <= 0) || (!std::isfinite(choleskyFactor[k][k])))
+                {
+                    validSystem = false;
+                    continue;
+                }
+
+                choleskyFactor[k][k] = std::sqrt(choleskyFactor[k][k]);
+                for (unsigned int l = k + 1;l < numUnknowns;++l)
+                {
+                    for (unsigned int m = 0;m < k;++m)
+                        choleskyFactor[l][k] -= choleskyFactor[l][m] * choleskyFactor[k][m];
+
+                    choleskyFactor[l][k] /= choleskyFactor[k][k];
+                }
+            }
+
+            if (!validSystem)
+                continue;
+
+            for (unsigned int k = 0;k < numUnknowns;++k)
+            {
+                solution[k] = rightHandSides(j,k);
+                for (unsigned int l = 0;l < k;++l)
+                    solution[k] -= choleskyFactor[k][l] * solution[l];
+
+                solution[k] /= choleskyFactor[k][k];
+            }
+
+            for (int k = numUnknowns - 1;k >= 0;--k)
+            {
+                for (unsigned int l = k + 1;l < numUnknowns;++l)
+                    solution[k] -= choleskyFactor[l][k] * solution[l];
+
+                solution[k] /= choleskyFactor[k][k];
+            }
+
+            for (unsigned int k = 0;k < numUnknowns;++k)
+                estimates(j,k) = solution[k];
+        }
+
+        if (iter + 1 == m_NumberOfWeightedLinearIterations)
+            break;
+
+        for (unsigned int j = 0;j < batchSize;++j)
+        {
+            for (unsigned int i = 0;i < numInputs;++i)
+            {
+                double logPrediction = 0;
+                for (unsigned int k = 0;k < numUnknowns;++k)
+                    logPrediction += m_DesignMatrix(i,k) * estimates(j,k);
+
+                // Avoids overflow on diverging voxels
+                weights(j,i) = std::exp(2.0 * std::min(logPrediction,300.0));
+            }
+        }
+    }
+}
+
 template <class InputPixelScalarType, class OutputPixelScalarType>
 double
 DTIEstimationImageFilter<InputPixelScalarType, OutputPixelScalarType>
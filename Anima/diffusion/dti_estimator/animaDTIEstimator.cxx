@@ -30,6 +30,9 @@ int main(int argc,  char **argv)
     TCLAP::ValueArg<std::string> computationMaskArg("m","mask","Computation mask", false,"","computation mask",cmd);
 
     TCLAP::ValueArg<unsigned int> b0ThrArg("t","b0thr","bot_treshold",false,0,"B0 threshold (default : 0)",cmd);
+    TCLAP::SwitchArg warmStartArg("W","warm-start","Seed estimation from the previously estimated neighboring voxel",cmd);
+    TCLAP::SwitchArg fastEstimationArg("F","fast","Fast estimation: iteratively reweighted linear least squares instead of non-linear refinement",cmd);
+    TCLAP::ValueArg<unsigned int> wlsIterationsArg("","wls-iter","Number of weighted least squares iterations in fast estimation (default: 3)",false,3,"number of WLS iterations",cmd);
     TCLAP::ValueArg<unsigned int> nbpArg("p","numberofthreads","nb_thread",false,itk::MultiThreader::GetGlobalDefaultNumberOfThreads(),"Number of threads to run on (default: all cores)",cmd);
     TCLAP::ValueArg<std::string> reorientArg("r","reorient","dwi_reoriented",false,"","Reorient DWI given as input",cmd);
     TCLAP::ValueArg<std::string> reorientGradArg("R","reorient-G","gradient reoriented output",false,"","Reorient gradients so that they are in MrTrix format (in image coordinates)",cmd);
@@ -109,6 +112,9 @@ int main(int argc,  char **argv)
 
     mainFilter->SetB0Threshold(b0ThrArg.getValue());
     mainFilter->SetNumberOfThreads(nbpArg.getValue());
+    mainFilter->SetUseSpatialWarmStart(warmStartArg.isSet());
+    mainFilter->SetUseWeightedLinearEstimation(fastEstimationArg.isSet());
+    mainFilter->SetNumberOfWeightedLinearIterations(wlsIterationsArg.getValue());
     mainFilter->AddObserver(itk::ProgressEvent(), callback);
 
     itk::TimeProbe tmpTimer;
@@ -10,7 +10,6 @@
 #include <itkOffset.h>
 #include <itkProgressReporter.h>
 #include <itkMatrix.h>
-#include <itkSymmetricEigenAnalysis.h>
 
 #include <animaBaseTensorTools.h>
 
@@ -78,47 +77,60 @@ DTIScalarMapsImageFilter< ImageDimension >::ThreadedGenerateData(const OutputIma
     radialIterator = itk::ImageRegionIterator<OutputImageType>(radialImage, outputRegionForThread);
     radialIterator.GoToBegin();
 
-    typedef vnl_matrix<double> TensorSymMatrixType;
-    typedef itk::Vector<double, 3> EigenVectorType;
-
-    EigenVectorType eigenValue;
-    TensorSymMatrixType tensorSymMatrix(3,3);
-
-    itk::SymmetricEigenAnalysis<TensorSymMatrixType, EigenVectorType> eigenAnalysis;
-    eigenAnalysis.SetDimension(3);
+    // Tensors are processed by batches stored component-wise, eigenvalues are computed without a matrix per tensor
+    const unsigned int batchSize = 256;
+    std::vector <double> tensorComponents(6 * batchSize);
+    std::vector <double> eigenValues(3 * batchSize);
 
     while (!tensorIterator.IsAtEnd())
     {
-        TensorVectorType tensor = tensorIterator.Get();
-        double a(tensor[0]), c(tensor[2]), f(tensor[5]), ADC(0);
-        ADC = (a+c+f) / 3.0;
-
-        adcIterator.Set(ADC);
-
-        anima::GetTensorFromVectorRepresentation(tensor, tensorSymMatrix,3,false);
-
-        eigenAnalysis.ComputeEigenValues(tensorSymMatrix, eigenValue);
-
-        double l1(eigenValue[2]), l2(eigenValue[1]), l3(eigenValue[0]), fa(1);
-        double num = std::sqrt ((l1 -l2) * (l1 -l2) + (l2 -l3) * (l2 -l3) + (l3 - l1) * (l3 - l1));
-        double den = std::sqrt (l1*l1 + l2*l2 + l3*l3);
-
-        if (den == 0)
-            fa = 0;
-        else
-            fa = std::sqrt(0.5) * (num / den);
-
-        faIterator.Set(fa);
-
-        axialIterator.Set(l1);
-        radialIterator.Set((l2+l3) / 2.0);
-
-        ++tensorIterator;
-        ++adcIterator;
-        ++faIterator;
-        ++axialIterator;
-        ++radialIterator;
-        progress.CompletedPixel();
+        unsigned int numTensors = 0;
+        while ((numTensors < batchSize) && (!tensorIterator.IsAtEnd()))
+        {
+            TensorVectorType tensor = tensorIterator.Get();
+            for (unsigned int i = 0;i < 6;++i)
+                tensorComponents[i * batchSize + numTensors] = tensor[i];
+
+            ++numTensors;
+            ++tensorIterator;
+        }
+
+        // Components are laid out for a full batch, the batched solver expects them packed
+        if (numTensors < batchSize)
+        {
+            for (unsigned int i = 1;i < 6;++i)
+                std::copy(tensorComponents.begin() + i * batchSize,tensorComponents.begin() + i * batchSize + numTensors,
+                          tensorComponents.begin() + i * numTensors);
+        }
+
+        anima::ComputeSymmetric3x3EigenValues(numTensors,tensorComponents.data(),eigenValues.data());
+
+        for (unsigned int j = 0;j < numTensors;++j)
+        {
+            double l1(eigenValues[2 * numTensors + j]), l2(eigenValues[numTensors + j]), l3(eigenValues[j]), fa(1);
+            double ADC = (l1 + l2 + l3) / 3.0;
+
+            adcIterator.Set(ADC);
+
+            double num = std::sqrt ((l1 -l2) * (l1 -l2) + (l2 -l3) * (l2 -l3) + (l3 - l1) * (l3 - l1));
+            double den = std::sqrt (l1*l1 + l2*l2 + l3*l3);
+
+            if (den == 0)
+                fa = 0;
+            else
+                fa = std::sqrt(0.5) * (num / den);
+
+            faIterator.Set(fa);
+
+            axialIterator.Set(l1);
+            radialIterator.Set((l2+l3) / 2.0);
+
+            ++adcIterator;
+            ++faIterator;
+            ++axialIterator;
+            ++radialIterator;
+            progress.CompletedPixel();
+        }
     }
 }
 
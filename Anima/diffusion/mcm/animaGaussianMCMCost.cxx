@@ -21,14 +21,11 @@ GaussianMCMCost::GetValues(const ParametersType &parameters)
     m_MCMStructure->SetParametersFromVector(m_TestedParameters);
     
     m_Residuals.SetSize(nbImages);
-    m_PredictedSignals.resize(nbImages);
+    m_MCMStructure->GetPredictedSignals(this->GetGradientTable(),m_PredictedSignals);
     m_SigmaSquare = 0.0;
 
     for (unsigned int i = 0;i < nbImages;++i)
     {
-        m_PredictedSignals[i] = m_MCMStructure->GetPredictedSignal(m_SmallDelta,m_BigDelta,
-                                                                    m_GradientStrengths[i],m_Gradients[i]);
-
         m_Residuals[i] = m_ObservedSignals[i] - m_PredictedSignals[i];
         m_SigmaSquare += m_Residuals[i] * m_Residuals[i];
     }
@@ -78,17 +75,14 @@ GaussianMCMCost::GetDerivativeMatrix(const ParametersType &parameters, Derivativ
     }
 
     derivative.SetSize(nbParams, nbValues);
-    derivative.Fill(0.0);
 
-    std::vector<ListType> signalJacobians(nbValues);
+    // Jacobians are stored parameter-wise, i.e. in the same layout as the derivative matrix
+    m_MCMStructure->GetSignalJacobians(this->GetGradientTable(),m_SignalJacobians);
 
-    for (unsigned int i = 0;i < nbValues;++i)
+    for (unsigned int j = 0;j < nbParams;++j)
     {
-        signalJacobians[i] = m_MCMStructure->GetSignalJacobian(m_SmallDelta,m_BigDelta,
-                                                               m_GradientStrengths[i],m_Gradients[i]);
-
-        for (unsigned int j = 0;j < nbParams;++j)
-            derivative(j,i) = signalJacobians[i][j];
+        for (unsigned int i = 0;i < nbValues;++i)
+            derivative(j,i) = m_SignalJacobians[j * nbValues + i];
     }
 }
 
@@ -59,6 +59,7 @@ private:
     bool m_MarginalEstimation;
 
     MeasureType m_Residuals;
+    ListType m_SignalJacobians;
 };
 
 } // end namespace anima
@@ -1,7 +1,7 @@
 #include <animaGaussianMCMVariableProjectionCost.h>
 #include <cmath>
 
-#include <animaBaseTensorTools.h>
+#include <algorithm>
 #include <boost/math/special_functions/gamma.hpp>
 #include <boost/math/special_functions/fpclassify.hpp>
 
@@ -97,15 +97,15 @@ GaussianMCMVariableProjectionCost::PrepareDataForLLS()
     m_IndexesUsefulCompartments.resize(numCompartments);
 
     // Compute predicted signals and jacobian
+    const MCMGradientTable &gradientTable = this->GetGradientTable();
     m_PredictedSignalAttenuations.set_size(nbValues,numCompartments);
-    for (unsigned int i = 0;i < nbValues;++i)
+    for (unsigned int j = 0;j < numCompartments;++j)
     {
-        for (unsigned int j = 0;j < numCompartments;++j)
-        {
-            unsigned int indexComp = m_IndexesUsefulCompartments[j];
-            double predictedSignal = m_MCMStructure->GetCompartment(indexComp)->GetFourierTransformedDiffusionProfile(m_SmallDelta, m_BigDelta, m_GradientStrengths[i], m_Gradients[i]);
-            m_PredictedSignalAttenuations(i,j) = predictedSignal;
-        }
+        unsigned int indexComp = m_IndexesUsefulCompartments[j];
+        m_MCMStructure->GetCompartment(indexComp)->GetFourierTransformedDiffusionProfiles(gradientTable,m_CompartmentAttenuations);
+
+        for (unsigned int i = 0;i < nbValues;++i)
+            m_PredictedSignalAttenuations(i,j) = m_CompartmentAttenuations[i];
     }
 
     m_CholeskyMatrix.set_size(numCompartments,numCompartments);
@@ -134,7 +134,12 @@ GaussianMCMVariableProjectionCost::PrepareDataForLLS()
 
     m_CholeskySolver.SetInputMatrix(m_CholeskyMatrix);
     m_CholeskySolver.PerformDecomposition();
-    m_OptimalUsefulWeights = m_CholeskySolver.SolveLinearSystem(m_FSignals);
+
+    m_OptimalUsefulWeights.SetSize(numCompartments);
+    for (unsigned int i = 0;i < numCompartments;++i)
+        m_OptimalUsefulWeights[i] = m_FSignals[i];
+
+    m_CholeskySolver.SolveLinearSystemInPlace(m_OptimalUsefulWeights);
 
     bool nnlsNeeded = false;
 
@@ -149,7 +154,7 @@ GaussianMCMVariableProjectionCost::PrepareDataForLLS()
 
     if (nnlsNeeded)
     {
-        m_NNLSBordersOptimizer->SetDataMatrix(m_CholeskyMatrix);
+        m_NNLSBordersOptimizer->SetSharedDataMatrix(&m_CholeskyMatrix);
         m_NNLSBordersOptimizer->SetPoints(m_FSignals);
         m_NNLSBordersOptimizer->SetSquaredProblem(true);
         m_NNLSBordersOptimizer->StartOptimization();
@@ -160,19 +165,11 @@ GaussianMCMVariableProjectionCost::PrepareDataForLLS()
     if (negativeWeights)
         m_OptimalUsefulWeights *= -1;
 
-    m_OptimalUsefulWeights.set_size(numCompartments);
-
     m_CompartmentSwitches.resize(numCompartments);
     for (unsigned int i = 0;i < numCompartments;++i)
     {
         m_OptimalWeights[m_IndexesUsefulCompartments[i]] = m_OptimalUsefulWeights[i];
-        if (m_OptimalUsefulWeights[i] <= 0)
-            m_CompartmentSwitches[i] = false;
-        else
-        {
-            m_OptimalWeights[m_IndexesUsefulCompartments[i]] = m_OptimalUsefulWeights[i];
-            m_CompartmentSwitches[i] = true;
-        }
+        m_CompartmentSwitches[i] = (m_OptimalUsefulWeights[i] > 0);
     }
 
     m_Residuals.SetSize(nbValues);
@@ -183,88 +180,83 @@ GaussianMCMVariableProjectionCost::PrepareDataForDerivative()
 {
     unsigned int nbValues = m_Gradients.size();
     unsigned int numCompartments = m_IndexesUsefulCompartments.size();
+    unsigned int numModelCompartments = m_MCMStructure->GetNumberOfCompartments();
 
+    // Positions of active compartments among active ones
+    m_ActiveCompartmentPositions.resize(numCompartments);
     unsigned int numOnCompartments = 0;
-    for (unsigned int i = 0;i < numCompartments;++i)
-        numOnCompartments += m_CompartmentSwitches[i];
-
-    unsigned int nbParams = m_MCMStructure->GetNumberOfParameters();
-    // Compute jacobian parts
-    vnl_matrix<double> zeroMatrix(nbValues,numCompartments,0.0);
-    m_SignalAttenuationsJacobian.resize(nbParams);
-    std::fill(m_SignalAttenuationsJacobian.begin(),m_SignalAttenuationsJacobian.end(),zeroMatrix);
-    ListType compartmentJacobian;
-
-    m_GramMatrix.set_size(numOnCompartments,numOnCompartments);
-    m_InverseGramMatrix.set_size(numOnCompartments,numOnCompartments);
-
-    unsigned int posX = 0;
-    unsigned int posY = 0;
     for (unsigned int i = 0;i < numCompartments;++i)
     {
-        if (!m_CompartmentSwitches[i])
-            continue;
-
-        m_GramMatrix(posX,posX) = m_CholeskyMatrix(i,i);
-        posY = posX + 1;
-        for (unsigned int j = i + 1;j < numCompartments;++j)
+        m_ActiveCompartmentPositions[i] = -1;
+        if (m_CompartmentSwitches[i])
         {
-            if (!m_CompartmentSwitches[j])
-                continue;
-
-            m_GramMatrix(posX,posY) = m_CholeskyMatrix(i,j);
-            m_GramMatrix(posY,posX) = m_GramMatrix(posX,posY);
-            ++posY;
+            m_ActiveCompartmentPositions[i] = numOnCompartments;
+            ++numOnCompartments;
         }
-
-        ++posX;
     }
 
-    if (numOnCompartments > 0)
-        anima::GetTensorPower(m_GramMatrix,m_InverseGramMatrix,-1.0);
-
-    // Here gets F G^-1
-    m_FMatrixInverseG.set_size(nbValues,numOnCompartments);
-    for (unsigned int i = 0;i < nbValues;++i)
+    // Factorization of the Gram matrix restricted to active compartments:
+    // the one from LLS is reused when all compartments are active
+    m_UseLLSFactorization = (numOnCompartments == numCompartments);
+    if ((!m_UseLLSFactorization)&&(numOnCompartments > 0))
     {
-        unsigned int pos = 0;
-        for (unsigned int j = 0;j < numCompartments;++j)
+        m_GramMatrix.set_size(numOnCompartments,numOnCompartments);
+        for (unsigned int i = 0;i < numCompartments;++i)
         {
-            if (!m_CompartmentSwitches[j])
+            int posX = m_ActiveCompartmentPositions[i];
+            if (posX < 0)
                 continue;
 
-            m_FMatrixInverseG(i,pos) = 0.0;
-            unsigned int posK = 0;
-            for (unsigned int k = 0;k < numCompartments;++k)
+            for (unsigned int j = i;j < numCompartments;++j)
             {
-                if (!m_CompartmentSwitches[k])
+                int posY = m_ActiveCompartmentPositions[j];
+                if (posY < 0)
                     continue;
 
-                m_FMatrixInverseG(i,pos) += m_PredictedSignalAttenuations(i,k) * m_InverseGramMatrix(posK,pos);
-                ++posK;
+                m_GramMatrix(posX,posY) = m_CholeskyMatrix(i,j);
+                m_GramMatrix(posY,posX) = m_CholeskyMatrix(i,j);
             }
-
-            ++pos;
         }
+
+        m_GramCholeskySolver.SetInputMatrix(m_GramMatrix);
+        m_GramCholeskySolver.PerformDecomposition();
     }
 
-    for (unsigned int i = 0;i < nbValues;++i)
+    // Each parameter only acts on the signal of its own compartment: jacobians are stored as one vector per parameter
+    // [k * nbValues + i], along with the useful compartment they relate to (-1 for duplicated compartments)
+    unsigned int nbParams = m_MCMStructure->GetNumberOfParameters();
+    m_ParametersJacobians.resize(nbParams * nbValues);
+    m_ParametersCompartmentIndexes.resize(nbParams);
+    std::fill(m_ParametersCompartmentIndexes.begin(),m_ParametersCompartmentIndexes.end(),-1);
+
+    // Parameters are ordered following model compartments
+    m_CompartmentParametersOffsets.resize(numModelCompartments);
+    unsigned int pos = 0;
+    for (unsigned int i = 0;i < numModelCompartments;++i)
     {
-        unsigned int pos = 0;
+        m_CompartmentParametersOffsets[i] = pos;
+        pos += m_MCMStructure->GetCompartment(i)->GetNumberOfParameters();
+    }
 
-        for (unsigned int j = 0;j < numCompartments;++j)
-        {
-            unsigned int indexComp = m_IndexesUsefulCompartments[j];
+    const MCMGradientTable &gradientTable = this->GetGradientTable();
+    for (unsigned int j = 0;j < numCompartments;++j)
+    {
+        unsigned int indexComp = m_IndexesUsefulCompartments[j];
+        anima::BaseCompartment *compartment = m_MCMStructure->GetCompartment(indexComp);
 
-            compartmentJacobian = m_MCMStructure->GetCompartment(indexComp)->GetSignalAttenuationJacobian(m_SmallDelta, m_BigDelta,
-                                                                                                          m_GradientStrengths[i], m_Gradients[i]);
+        unsigned int compartmentSize = compartment->GetNumberOfParameters();
+        if (compartmentSize == 0)
+            continue;
 
-            unsigned int compartmentSize = compartmentJacobian.size();
-            for (unsigned int k = 0;k < compartmentSize;++k)
-                m_SignalAttenuationsJacobian[pos+k](i,j) = compartmentJacobian[k];
+        // Compartment jacobians are stored parameter-wise: [k * nbValues + i]
+        compartment->GetSignalAttenuationJacobians(gradientTable,m_CompartmentJacobians);
 
-            pos += compartmentSize;
-        }
+        unsigned int offset = m_CompartmentParametersOffsets[indexComp];
+        std::copy(m_CompartmentJacobians.begin(),m_CompartmentJacobians.begin() + compartmentSize * nbValues,
+                  m_ParametersJacobians.begin() + offset * nbValues);
+
+        for (unsigned int k = 0;k < compartmentSize;++k)
+            m_ParametersCompartmentIndexes[offset + k] = j;
     }
 }
 
@@ -278,9 +270,6 @@ GaussianMCMVariableProjectionCost::GetDerivativeMatrix(const ParametersType &par
     unsigned int nbValues = m_ObservedSignals.size();
     unsigned int numCompartments = m_IndexesUsefulCompartments.size();
 
-    this->PrepareDataForDerivative();
-    unsigned int numOnCompartments = m_GramMatrix.rows();
-
     // Assume get derivative is called with the same parameters as GetValue just before
     for (unsigned int i = 0;i < nbParams;++i)
     {
@@ -291,48 +280,77 @@ GaussianMCMVariableProjectionCost::GetDerivativeMatrix(const ParametersType &par
         }
     }
 
+    this->PrepareDataForDerivative();
+
+    unsigned int numOnCompartments = 0;
+    for (unsigned int i = 0;i < numCompartments;++i)
+        numOnCompartments += m_CompartmentSwitches[i];
+
     derivative.SetSize(nbParams, nbValues);
     derivative.Fill(0.0);
-    ListType DFw(nbValues,0.0);
 
-    ListType tmpVec(numOnCompartments,0.0);
+    m_DerivativeWorkVector.SetSize(numOnCompartments);
+    CholeskyDecomposition &gramSolver = m_UseLLSFactorization ? m_CholeskySolver : m_GramCholeskySolver;
 
     for (unsigned int k = 0;k < nbParams;++k)
     {
-        // First, compute
-        // - DFw = DF[k] w
-        std::fill(DFw.begin(),DFw.end(),0.0);
-        for (unsigned int i = 0;i < nbValues;++i)
+        // Parameters of duplicated compartments have no influence on the residuals
+        int compartmentIndex = m_ParametersCompartmentIndexes[k];
+        if (compartmentIndex < 0)
+            continue;
+
+        const double *parameterJacobian = &m_ParametersJacobians[k * nbValues];
+        double compartmentWeight = m_OptimalUsefulWeights[compartmentIndex];
+
+        // Inactive compartment: no projection part, only - DFw remains
+        int activePosition = m_ActiveCompartmentPositions[compartmentIndex];
+        if (activePosition < 0)
         {
-            DFw[i] = 0.0;
-            for (unsigned int j = 0;j < numCompartments;++j)
-                DFw[i] += m_SignalAttenuationsJacobian[k](i,j) * m_OptimalUsefulWeights[j];
+            for (unsigned int i = 0;i < nbValues;++i)
+                derivative(k,i) = - compartmentWeight * parameterJacobian[i];
+
+            continue;
         }
 
-        // Then, compute
-        // - tmpVec = F^T DF[k] w - (DF[k])^T Residuals
-        unsigned int pos = 0;
+        // DF[k] only has one non null column, so that
+        // - DFw = w_j DF[k]_j
+        // - tmpVec = F^T DFw - (DF[k])^T Residuals
         for (unsigned int j = 0;j < numCompartments;++j)
         {
-            if (!m_CompartmentSwitches[j])
+            int pos = m_ActiveCompartmentPositions[j];
+            if (pos < 0)
                 continue;
 
-            tmpVec[pos] = 0.0;
-
+            double tmpValue = 0.0;
             for (unsigned int i = 0;i < nbValues;++i)
-                tmpVec[pos] += m_PredictedSignalAttenuations(i,j) * DFw[i] - m_SignalAttenuationsJacobian[k](i,j) * m_Residuals[i];
+                tmpValue += m_PredictedSignalAttenuations(i,j) * parameterJacobian[i];
 
-            ++pos;
+            m_DerivativeWorkVector[pos] = compartmentWeight * tmpValue;
         }
 
+        double residualsProjection = 0.0;
+        for (unsigned int i = 0;i < nbValues;++i)
+            residualsProjection += parameterJacobian[i] * m_Residuals[i];
+
+        m_DerivativeWorkVector[activePosition] -= residualsProjection;
+
+        // - G^-1 tmpVec from the Gram matrix factorization
+        gramSolver.SolveLinearSystemInPlace(m_DerivativeWorkVector);
+
         // Finally, get
-        // - derivative = FMatrixInverseG tmpVec - DFw
+        // - derivative = F G^-1 tmpVec - DFw
         for (unsigned int i = 0;i < nbValues;++i)
         {
-            derivative(k,i) = - DFw[i];
+            double derivativeValue = - compartmentWeight * parameterJacobian[i];
+
+            for (unsigned int j = 0;j < numCompartments;++j)
+            {
+                int pos = m_ActiveCompartmentPositions[j];
+                if (pos >= 0)
+                    derivativeValue += m_PredictedSignalAttenuations(i,j) * m_DerivativeWorkVector[pos];
+            }
 
-            for (unsigned int j = 0;j < numOnCompartments;++j)
-                derivative(k,i) += m_FMatrixInverseG(i,j) * tmpVec[j];
+            derivative(k,i) = derivativeValue;
         }
     }
 
@@ -350,7 +368,7 @@ GaussianMCMVariableProjectionCost::GetDerivativeMatrix(const ParametersType &par
     {
         std::cerr << "Derivative: " << derivative << std::endl;
         std::cerr << "Optimal weights: " << m_OptimalUsefulWeights << std::endl;
-        std::cerr << "Gram matrix: " << m_GramMatrix << std::endl;
+        std::cerr << "Gram matrix: " << m_CholeskyMatrix << std::endl;
         std::cerr << "Residuals: " << m_Residuals << std::endl;
 
         std::cerr << "Params: " << parameters << std::endl;
@@ -15,6 +15,8 @@ namespace anima
 /**
  * @brief Class for computing variable projection costs and derivatives. Right now, it is only available for Gaussian noise.
  * By the way, this is not thread safe at all so be sure to intantiate one per thread
+ * Work matrices are kept between calls and the Gram matrix LDL factorization computed for weights estimation
+ * is reused for derivatives.
  */
 class ANIMAMCM_EXPORT GaussianMCMVariableProjectionCost : public anima::BaseMCMCost
 {
@@ -48,6 +50,7 @@ protected:
     GaussianMCMVariableProjectionCost()
     {
         m_NNLSBordersOptimizer = anima::NNLSOptimizer::New();
+        m_UseLLSFactorization = true;
     }
 
     virtual ~GaussianMCMVariableProjectionCost() ITK_OVERRIDE {}
@@ -64,19 +67,31 @@ private:
     void operator=(const Self&); //purposely not implemented
 
     // Utility variables to make ML estimation faster
-    vnl_matrix <double> m_FMatrixInverseG;
     std::vector <double> m_OptimalWeights;
     MeasureType m_Residuals;
-    vnl_matrix <double> m_GramMatrix, m_InverseGramMatrix;
+    vnl_matrix <double> m_GramMatrix;
     ParametersType m_FSignals, m_OptimalUsefulWeights;
     anima::NNLSOptimizer::Pointer m_NNLSBordersOptimizer;
     
     std::vector <unsigned int> m_IndexesUsefulCompartments;
     std::vector <bool> m_CompartmentSwitches;
     vnl_matrix <double> m_PredictedSignalAttenuations, m_CholeskyMatrix;
-    std::vector< vnl_matrix<double> > m_SignalAttenuationsJacobian;
 
-    CholeskyDecomposition m_CholeskySolver;
+    //! Work vectors holding batched compartment attenuations and jacobians
+    ListType m_CompartmentAttenuations, m_CompartmentJacobians;
+
+    //! Signal attenuation jacobians per parameter [k * nbValues + i] and the useful compartment each parameter acts on
+    ListType m_ParametersJacobians;
+    std::vector <int> m_ParametersCompartmentIndexes;
+    std::vector <unsigned int> m_CompartmentParametersOffsets;
+
+    //! Position of each useful compartment among active (positive weight) ones, -1 if inactive
+    std::vector <int> m_ActiveCompartmentPositions;
+    ParametersType m_DerivativeWorkVector;
+
+    //! LDL factorization of the full Gram matrix (LLS) and of the active compartments Gram matrix if different
+    CholeskyDecomposition m_CholeskySolver, m_GramCholeskySolver;
+    bool m_UseLLSFactorization;
 };
 
 } // end namespace anima
@@ -46,14 +46,16 @@ void NODDICompartment::UpdateSignals(double bValue, const Vector3DType &gradient
     m_IntraAxialDerivative = 0;
     double x = bValue * dpara;
     
+    unsigned int cacheIndex = this->GetCFunctionCacheIndex(x);
+    const std::vector <double> &cValues = m_CFunctionValues[cacheIndex];
+    const std::vector <double> &cDerivValues = m_CFunctionDerivatives[cacheIndex];
+
     for (unsigned int i = 0;i < m_WatsonSHCoefficients.size();++i)
     {
         double coefVal = m_WatsonSHCoefficients[i];
         double sqrtVal = std::sqrt((4.0 * i + 1.0) / (4.0 * M_PI));
         double legendreVal = boost::math::legendre_p(2 * i, innerProd);
-        double kummerVal = anima::KummerFunction(-x, i + 0.5, 2.0 * i + 1.5, false, true);
-        double xPowVal = std::pow(-x, (double)i);
-        double cVal = xPowVal * kummerVal;
+        double cVal = cValues[i];
         
         // Signal
         m_IntraAxonalSignal += coefVal * sqrtVal * legendreVal * cVal;
@@ -61,14 +63,7 @@ void NODDICompartment::UpdateSignals(double bValue, const Vector3DType &gradient
         // Derivatives
         double coefDerivVal = m_WatsonSHCoefficientDerivatives[i];
         double legendreDerivVal = boost::math::legendre_p_prime(2 * i, innerProd);
-        
-        double cDerivVal = 0.0;
-        if (m_EstimateAxialDiffusivity)
-        {
-            cDerivVal = -xPowVal * anima::KummerFunction(-x, i + 1.5, 2.0 * i + 2.5, false, true);
-            if (i > 0)
-                cDerivVal += xPowVal * i * kummerVal / x;
-        }
+        double cDerivVal = cDerivValues[i];
         
         m_IntraAngleDerivative += coefVal * sqrtVal * legendreDerivVal * cVal;
         m_IntraKappaDerivative += coefDerivVal * sqrtVal * legendreVal * cVal;
@@ -100,9 +95,92 @@ double NODDICompartment::GetFourierTransformedDiffusionProfile(double smallDelta
     return signal;
 }
     
+unsigned int NODDICompartment::GetCFunctionCacheIndex(double x)
+{
+    for (unsigned int i = 0;i < m_CFunctionXValues.size();++i)
+    {
+        if (std::abs(x - m_CFunctionXValues[i]) < 1.0e-9)
+            return i;
+    }
+
+    // Keeps cache small: values are only reused for a fixed axial diffusivity over shells
+    const unsigned int maxCacheSize = 32;
+    if (m_CFunctionXValues.size() >= maxCacheSize)
+    {
+        m_CFunctionXValues.clear();
+        m_CFunctionValues.clear();
+        m_CFunctionDerivatives.clear();
+    }
+
+    unsigned int nbCoefs = m_WatsonSHCoefficients.size();
+    std::vector <double> cValues(nbCoefs,0.0);
+    std::vector <double> cDerivValues(nbCoefs,0.0);
+
+    for (unsigned int i = 0;i < nbCoefs;++i)
+    {
+        double kummerVal = anima::KummerFunction(-x, i + 0.5, 2.0 * i + 1.5, false, true);
+        double xPowVal = std::pow(-x, (double)i);
+        cValues[i] = xPowVal * kummerVal;
+
+        if (m_EstimateAxialDiffusivity)
+        {
+            cDerivValues[i] = -xPowVal * anima::KummerFunction(-x, i + 1.5, 2.0 * i + 2.5, false, true);
+            if (i > 0)
+                cDerivValues[i] += xPowVal * i * kummerVal / x;
+        }
+    }
+
+    m_CFunctionXValues.push_back(x);
+    m_CFunctionValues.push_back(cValues);
+    m_CFunctionDerivatives.push_back(cDerivValues);
+
+    return m_CFunctionXValues.size() - 1;
+}
+
+void NODDICompartment::GetFourierTransformedDiffusionProfiles(const MCMGradientTable &gradientTable, ListType &attenuations)
+{
+    unsigned int nbValues = gradientTable.GetNumberOfGradients();
+    attenuations.resize(nbValues);
+
+    const double *bValues = gradientTable.GetBValues();
+    const std::vector <Vector3DType> &gradients = gradientTable.GetGradients();
+    double nuec = this->GetExtraAxonalFraction();
+
+    for (unsigned int i = 0;i < nbValues;++i)
+    {
+        this->UpdateSignals(bValues[i], gradients[i]);
+        attenuations[i] = (1.0 - nuec) * m_IntraAxonalSignal + nuec * m_ExtraAxonalSignal;
+    }
+}
+
+void NODDICompartment::GetSignalAttenuationJacobians(const MCMGradientTable &gradientTable, ListType &jacobians)
+{
+    unsigned int nbValues = gradientTable.GetNumberOfGradients();
+    unsigned int nbParams = this->GetNumberOfParameters();
+    jacobians.resize(nbValues * nbParams);
+
+    const double *bValues = gradientTable.GetBValues();
+    const std::vector <Vector3DType> &gradients = gradientTable.GetGradients();
+
+    for (unsigned int i = 0;i < nbValues;++i)
+    {
+        this->UpdateJacobian(bValues[i], gradients[i]);
+
+        for (unsigned int k = 0;k < nbParams;++k)
+            jacobians[k * nbValues + i] = m_JacobianVector[k];
+    }
+}
+
 NODDICompartment::ListType &NODDICompartment::GetSignalAttenuationJacobian(double smallDelta, double bigDelta, double gradientStrength, const Vector3DType &gradient)
 {
     double bValue = anima::GetBValueFromAcquisitionParameters(smallDelta, bigDelta, gradientStrength);
+    this->UpdateJacobian(bValue, gradient);
+
+    return m_JacobianVector;
+}
+
+void NODDICompartment::UpdateJacobian(double bValue, const Vector3DType &gradient)
+{
     this->UpdateSignals(bValue, gradient);
     
     m_JacobianVector.resize(this->GetNumberOfParameters());
@@ -179,8 +257,6 @@ NODDICompartment::ListType &NODDICompartment::GetSignalAttenuationJacobian(doubl
         //---------------------------
         m_JacobianVector[pos] = bValue * (nuic * m_IntraAxialDerivative - (1.0 - nuic) * m_ExtraAxonalSignal * (1.0 - nuic * tmpVal / 2.0));
     }
-    
-    return m_JacobianVector;
 }
 
 double NODDICompartment::GetLogDiffusionProfile(const Vector3DType &sample)
@@ -249,6 +325,9 @@ void NODDICompartment::SetAxialDiffusivity(double num)
     if (num != this->GetAxialDiffusivity())
     {
         m_ModifiedParameters = true;
+        m_CFunctionXValues.clear();
+        m_CFunctionValues.clear();
+        m_CFunctionDerivatives.clear();
         this->Superclass::SetAxialDiffusivity(num);
     }
 }
@@ -359,6 +438,11 @@ void NODDICompartment::SetEstimateAxialDiffusivity(bool arg)
 
     m_EstimateAxialDiffusivity = arg;
     m_ChangedConstraints = true;
+
+    // C function derivatives are only computed when estimating axial diffusivity
+    m_CFunctionXValues.clear();
+    m_CFunctionValues.clear();
+    m_CFunctionDerivatives.clear();
 }
 
 void NODDICompartment::SetEstimateExtraAxonalFraction(bool arg)
@@ -31,6 +31,9 @@ public:
     virtual ListType &GetSignalAttenuationJacobian(double smallDelta, double bigDelta, double gradientStrength, const Vector3DType &gradient) ITK_OVERRIDE;
     virtual double GetLogDiffusionProfile(const Vector3DType &sample) ITK_OVERRIDE;
 
+    virtual void GetFourierTransformedDiffusionProfiles(const MCMGradientTable &gradientTable, ListType &attenuations) ITK_OVERRIDE;
+    virtual void GetSignalAttenuationJacobians(const MCMGradientTable &gradientTable, ListType &jacobians) ITK_OVERRIDE;
+
     virtual void SetParametersFromVector(const ListType &params) ITK_OVERRIDE;
     virtual ListType &GetParametersAsVector() ITK_OVERRIDE;
 
@@ -94,6 +97,15 @@ protected:
     //! Update quantities that depend on kappa
     void UpdateKappaValues();
 
+    //! Compute jacobian for a given b-value and gradient direction into m_JacobianVector
+    void UpdateJacobian(double bValue, const Vector3DType &gradient);
+
+    /**
+     * Get index in cache of C functions (Jespersen et al. 2007) and their derivatives for x = b * d.
+     * They only depend on the b-value so they are computed once per shell and reused over gradient directions
+     */
+    unsigned int GetCFunctionCacheIndex(double x);
+
 private:
     bool m_EstimateOrientationConcentration, m_EstimateAxialDiffusivity, m_EstimateExtraAxonalFraction;
     bool m_ChangedConstraints;
@@ -109,6 +121,10 @@ private:
     
     // Internal work variables for faster processing
     std::vector <double> m_WatsonSHCoefficients, m_WatsonSHCoefficientDerivatives;
+
+    //! Cache of C function values and derivatives, indexed by x = b * d values
+    std::vector <double> m_CFunctionXValues;
+    std::vector < std::vector <double> > m_CFunctionValues, m_CFunctionDerivatives;
     double m_Tau1, m_Tau1Deriv;
     double m_ExtraAxonalSignal, m_IntraAxonalSignal;
     double m_IntraAngleDerivative, m_IntraKappaDerivative, m_IntraAxialDerivative;
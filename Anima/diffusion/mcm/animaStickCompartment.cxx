@@ -45,6 +45,23 @@ StickCompartment::ListType &StickCompartment::GetSignalAttenuationJacobian(doubl
     return m_JacobianVector;
 }
 
+void StickCompartment::GetFourierTransformedDiffusionProfiles(const MCMGradientTable &gradientTable, ListType &attenuations)
+{
+    double radialDiffusivity = this->GetRadialDiffusivity1();
+    this->ComputeCylindricallySymmetricAttenuations(gradientTable,radialDiffusivity,this->GetAxialDiffusivity() - radialDiffusivity,
+                                                    attenuations);
+}
+
+void StickCompartment::GetSignalAttenuationJacobians(const MCMGradientTable &gradientTable, ListType &jacobians)
+{
+    // Parameters: theta, phi, then if estimated axial minus radial diffusivity
+    unsigned int numDiffusivityDerivatives = (m_EstimateAxialDiffusivity) ? 1 : 0;
+
+    double radialDiffusivity = this->GetRadialDiffusivity1();
+    this->ComputeCylindricallySymmetricJacobians(gradientTable,radialDiffusivity,this->GetAxialDiffusivity() - radialDiffusivity,
+                                                 numDiffusivityDerivatives,jacobians);
+}
+
 double StickCompartment::GetLogDiffusionProfile(const Vector3DType &sample)
 {
     Vector3DType compartmentOrientation(0.0);
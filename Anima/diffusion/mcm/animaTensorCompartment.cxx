@@ -70,6 +70,88 @@ TensorCompartment::ListType &TensorCompartment::GetSignalAttenuationJacobian(dou
     return m_JacobianVector;
 }
 
+void TensorCompartment::GetFourierTransformedDiffusionProfiles(const MCMGradientTable &gradientTable, ListType &attenuations)
+{
+    this->UpdateDiffusionTensor();
+
+    unsigned int nbValues = gradientTable.GetNumberOfGradients();
+    attenuations.resize(nbValues);
+
+    // Quadratic form b g^T D g is a dot product between tensor coefficients and b-value weighted outer products
+    double tensorCoefficients[6] = {m_DiffusionTensor(0,0), m_DiffusionTensor(1,1), m_DiffusionTensor(2,2),
+                                    m_DiffusionTensor(0,1), m_DiffusionTensor(0,2), m_DiffusionTensor(1,2)};
+
+    const double *outerProducts[6];
+    for (unsigned int k = 0;k < 6;++k)
+        outerProducts[k] = gradientTable.GetBValueOuterProducts(k);
+
+    for (unsigned int i = 0;i < nbValues;++i)
+    {
+        double quadForm = tensorCoefficients[0] * outerProducts[0][i] + tensorCoefficients[1] * outerProducts[1][i]
+                + tensorCoefficients[2] * outerProducts[2][i] + tensorCoefficients[3] * outerProducts[3][i]
+                + tensorCoefficients[4] * outerProducts[4][i] + tensorCoefficients[5] * outerProducts[5][i];
+
+        attenuations[i] = std::exp(- quadForm);
+    }
+}
+
+void TensorCompartment::GetSignalAttenuationJacobians(const MCMGradientTable &gradientTable, ListType &jacobians)
+{
+    this->UpdateDiffusionTensor();
+
+    unsigned int nbValues = gradientTable.GetNumberOfGradients();
+    jacobians.resize(nbValues * this->GetNumberOfParameters());
+
+    this->GetFourierTransformedDiffusionProfiles(gradientTable,m_WorkAttenuations);
+
+    double diffAxialRadial2 = this->GetAxialDiffusivity() - this->GetRadialDiffusivity2();
+    double diffRadialDiffusivities = this->GetRadialDiffusivity1() - this->GetRadialDiffusivity2();
+
+    const double *bValues = gradientTable.GetBValues();
+    const double *gradientX = gradientTable.GetGradientComponents(0);
+    const double *gradientY = gradientTable.GetGradientComponents(1);
+    const double *gradientZ = gradientTable.GetGradientComponents(2);
+
+    for (unsigned int i = 0;i < nbValues;++i)
+    {
+        double signalAttenuation = m_WorkAttenuations[i];
+        double innerProd1 = gradientX[i] * m_EigenVector1[0] + gradientY[i] * m_EigenVector1[1] + gradientZ[i] * m_EigenVector1[2];
+        double innerProd2 = gradientX[i] * m_EigenVector2[0] + gradientY[i] * m_EigenVector2[1] + gradientZ[i] * m_EigenVector2[2];
+
+        double DgTe1DTheta = m_CosTheta * (gradientX[i] * m_CosPhi + gradientY[i] * m_SinPhi) - gradientZ[i] * m_SinTheta;
+        double DgTe1DPhi = m_SinTheta * (gradientY[i] * m_CosPhi - gradientX[i] * m_SinPhi);
+
+        double DgTe2DTheta = m_SinAlpha * innerProd1;
+        double DgTe2DPhi = gradientX[i] * (m_CosTheta * m_SinPhi * m_SinAlpha - m_CosPhi * m_CosAlpha)
+                - gradientY[i] * (m_SinPhi * m_CosAlpha + m_CosTheta * m_CosPhi * m_SinAlpha);
+        double DgTe2DAlpha = gradientX[i] * (m_SinPhi * m_SinAlpha - m_CosTheta * m_CosPhi * m_CosAlpha)
+                - gradientY[i] * (m_CosPhi * m_SinAlpha + m_CosTheta * m_SinPhi * m_CosAlpha) + gradientZ[i] * m_SinTheta * m_CosAlpha;
+
+        double baseDerivative = -2.0 * bValues[i] * signalAttenuation;
+
+        // Derivative w.r.t. theta
+        jacobians[i] = baseDerivative * (diffAxialRadial2 * innerProd1 * DgTe1DTheta + diffRadialDiffusivities * innerProd2 * DgTe2DTheta);
+
+        // Derivative w.r.t. phi
+        jacobians[nbValues + i] = baseDerivative * (diffAxialRadial2 * innerProd1 * DgTe1DPhi + diffRadialDiffusivities * innerProd2 * DgTe2DPhi);
+
+        // Derivative w.r.t. alpha
+        jacobians[2 * nbValues + i] = baseDerivative * diffRadialDiffusivities * innerProd2 * DgTe2DAlpha;
+
+        if (m_EstimateDiffusivities)
+        {
+            // Derivative w.r.t. to d1
+            jacobians[3 * nbValues + i] = - bValues[i] * innerProd1 * innerProd1 * signalAttenuation;
+
+            // Derivative w.r.t. to d2
+            jacobians[4 * nbValues + i] = - bValues[i] * (innerProd1 * innerProd1 + innerProd2 * innerProd2) * signalAttenuation;
+
+            // Derivative w.r.t. to d3
+            jacobians[5 * nbValues + i] = - bValues[i] * signalAttenuation;
+        }
+    }
+}
+
 double TensorCompartment::GetLogDiffusionProfile(const Vector3DType &sample)
 {
     this->UpdateInverseDiffusionTensor();
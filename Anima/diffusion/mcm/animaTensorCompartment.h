@@ -32,6 +32,9 @@ public:
     virtual ListType &GetSignalAttenuationJacobian(double smallDelta, double bigDelta, double gradientStrength, const Vector3DType &gradient) ITK_OVERRIDE;
     virtual double GetLogDiffusionProfile(const Vector3DType &sample) ITK_OVERRIDE;
 
+    virtual void GetFourierTransformedDiffusionProfiles(const MCMGradientTable &gradientTable, ListType &attenuations) ITK_OVERRIDE;
+    virtual void GetSignalAttenuationJacobians(const MCMGradientTable &gradientTable, ListType &jacobians) ITK_OVERRIDE;
+
     virtual void SetParametersFromVector(const ListType &params) ITK_OVERRIDE;
     virtual ListType &GetParametersAsVector() ITK_OVERRIDE;
 
@@ -116,6 +119,9 @@ private:
     Vector3DType m_EigenVector1, m_EigenVector2;
     double m_SinTheta, m_CosTheta, m_SinPhi, m_CosPhi, m_SinAlpha, m_CosAlpha;
     double m_TensorDeterminant;
+
+    //! Work vector holding signal attenuations for batched jacobian computation
+    ListType m_WorkAttenuations;
 };
 
 } //end namespace anima
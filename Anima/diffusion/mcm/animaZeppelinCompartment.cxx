@@ -50,6 +50,23 @@ ZeppelinCompartment::ListType &ZeppelinCompartment::GetSignalAttenuationJacobian
     return m_JacobianVector;
 }
 
+void ZeppelinCompartment::GetFourierTransformedDiffusionProfiles(const MCMGradientTable &gradientTable, ListType &attenuations)
+{
+    double radialDiffusivity = this->GetRadialDiffusivity1();
+    this->ComputeCylindricallySymmetricAttenuations(gradientTable,radialDiffusivity,this->GetAxialDiffusivity() - radialDiffusivity,
+                                                    attenuations);
+}
+
+void ZeppelinCompartment::GetSignalAttenuationJacobians(const MCMGradientTable &gradientTable, ListType &jacobians)
+{
+    // Parameters: theta, phi, then if estimated axial minus radial and radial diffusivities
+    unsigned int numDiffusivityDerivatives = (m_EstimateDiffusivities) ? 2 : 0;
+
+    double radialDiffusivity = this->GetRadialDiffusivity1();
+    this->ComputeCylindricallySymmetricJacobians(gradientTable,radialDiffusivity,this->GetAxialDiffusivity() - radialDiffusivity,
+                                                 numDiffusivityDerivatives,jacobians);
+}
+
 double ZeppelinCompartment::GetLogDiffusionProfile(const Vector3DType &sample)
 {
     Vector3DType compartmentOrientation(0.0);
@@ -7,6 +7,7 @@
 #include <animaGradientFileReader.h>
 #include <animaVectorOperations.h>
 #include <animaReadWriteFunctions.h>
+#include <animaMCMFileWriter.h>
 
 //Update progression of the process
 void eventCallback (itk::Object* caller, const itk::EventObject& event, void* clientData)
@@ -42,6 +43,7 @@ int main(int argc,  char **argv)
     TCLAP::ValueArg<unsigned int> nbFasciclesArg("n", "nb-fascicles", "Number of computed fascicles (default: 2)", false, 2, "number of fascicles", cmd);
     TCLAP::ValueArg<unsigned int> compartmentTypeArg("c", "comp-type", "Compartment type for fascicles: 1: stick, 2: zeppelin, 3: tensor, 4: noddi (default: 3)", false, 3, "fascicles type", cmd);
     TCLAP::SwitchArg aicSelectNbCompartmentsArg("M", "opt-nb-comp", "Activate AICC-based number of compartments selection", cmd, false);
+    TCLAP::SwitchArg incrementalSelectionArg("", "incremental-selection", "Grow models one compartment at a time during number of compartments selection, stopping when AICC increases", cmd, false);
     
     TCLAP::SwitchArg freeWaterCompartmentArg("F", "free-water", "Model with free water", cmd, false);
     TCLAP::SwitchArg stationaryWaterCompartmentArg("S", "stationary-water", "Model with stationary water", cmd, false);
@@ -75,6 +77,11 @@ int main(int argc,  char **argv)
     TCLAP::ValueArg<double> xTolArg("x", "x-tol", "Tolerance for position in optimization (default: 0 -> 1.0e-4 or 1.0e-7 for bobyqa)", false, 0, "position tolerance", cmd);
     TCLAP::ValueArg<double> gTolArg("G", "g-tol", "Tolerance for gradient in optimization (default: 0 -> function of position tolerance)", false, 0, "gradient tolerance", cmd);
     TCLAP::ValueArg<unsigned int> maxEvalArg("e", "max-eval", "Maximum evaluations (default: 0 -> function of number of unknowns)", false, 0, "max evaluations", cmd);
+    TCLAP::SwitchArg spatialWarmStartArg("", "spatial-warm-start", "Seed estimation from the previously estimated neighboring voxel", cmd, false);
+
+    // Slab streaming
+    TCLAP::ValueArg<unsigned int> slabSizeArg("", "slab-size", "Number of slices per slab for streamed, resumable estimation (default: 0, whole image at once)", false, 0, "slab size", cmd);
+    TCLAP::ValueArg<std::string> slabPrefixArg("", "slab-prefix", "Prefix of slab result files, a run with the same prefix resumes after the last completed slab (default: output name)", false, "", "slab files prefix", cmd);
 
     TCLAP::ValueArg<unsigned int> nbThreadsArg("T", "nb-threads", "Number of threads to run on (default: all cores)", false, itk::MultiThreader::GetGlobalDefaultNumberOfThreads(), "number of threads", cmd);
 
@@ -113,7 +120,12 @@ int main(int argc,  char **argv)
 
     std::cout << "Loading input DWI image..." << std::endl;
 
-    anima::setMultipleImageFilterInputsFromFileName<InputImageType,FilterType>(dwiArg.getValue(), filter);
+    // In slab streaming mode, readers are kept in the pipeline so that only the current slab is read
+    std::vector <itk::ProcessObject::Pointer> streamingSources;
+    if (slabSizeArg.getValue() != 0)
+        anima::setMultipleImageFilterInputsFromFileName<InputImageType,FilterType>(dwiArg.getValue(), filter, &streamingSources);
+    else
+        anima::setMultipleImageFilterInputsFromFileName<InputImageType,FilterType>(dwiArg.getValue(), filter);
 
     // Load gradient table and b-value list
     std::cout << "Importing gradient table and b-values..." << std::endl;
@@ -181,6 +193,7 @@ int main(int argc,  char **argv)
 
     filter->SetNumberOfCompartments(nbFasciclesArg.getValue());
     filter->SetFindOptimalNumberOfCompartments(aicSelectNbCompartmentsArg.isSet());
+    filter->SetUseIncrementalModelSelection(incrementalSelectionArg.isSet());
 
     filter->SetOptimizer(optimizerArg.getValue());
     filter->SetAbsoluteCostChange(absCostChangeArg.getValue());
@@ -191,6 +204,7 @@ int main(int argc,  char **argv)
     filter->SetXTolerance(xTolArg.getValue());
     filter->SetGTolerance(gTolArg.getValue());
     filter->SetMaxEval(maxEvalArg.getValue());
+    filter->SetUseSpatialWarmStart(spatialWarmStartArg.isSet());
 
     filter->SetUseConstrainedDiffusivity(fixDiffArg.isSet());
     filter->SetUseConstrainedFreeWaterDiffusivity(!optFWDiffArg.isSet());
@@ -206,12 +220,20 @@ int main(int argc,  char **argv)
     filter->SetNumberOfThreads(nbThreadsArg.getValue());
     filter->AddObserver(itk::ProgressEvent(), callback);
 
+    filter->SetSlabSize(slabSizeArg.getValue());
+    if (slabPrefixArg.getValue() != "")
+        filter->SetSlabFilesPrefix(slabPrefixArg.getValue());
+    else
+        filter->SetSlabFilesPrefix(outArg.getValue());
+    filter->SetSlabRunDescription("dwi: " + dwiArg.getValue() + ", mask: " + computationMaskArg.getValue() +
+                                  ", mose: " + inMoseArg.getValue());
+
     itk::TimeProbe tmpTimer;
     tmpTimer.Start();
 
     try
     {
-        filter->Update();
+        filter->UpdateBySlabs();
     }
     catch (itk::ExceptionObject &e)
     {
@@ -224,9 +246,18 @@ int main(int argc,  char **argv)
     std::cout << "\nEstimation done in " << tmpTimer.GetTotal() << " s" << std::endl;
     std::cout << "Writing MCM to: " << outArg.getValue() << std::endl;
 
+    // Outputs are detached from the pipeline, writing them must not trigger a new update
+    FilterType::OutputImagePointer mcmOutput = filter->GetOutput();
+    mcmOutput->DisconnectPipeline();
+
     try
     {
-        filter->WriteMCMOutput(outArg.getValue());
+        typedef anima::MCMFileWriter <double,InputImageType::ImageDimension> MCMFileWriterType;
+        MCMFileWriterType writer;
+
+        writer.SetInputImage(mcmOutput);
+        writer.SetFileName(outArg.getValue());
+        writer.Update();
     }
     catch (std::exception &e)
     {
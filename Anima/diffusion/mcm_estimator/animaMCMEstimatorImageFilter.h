@@ -8,6 +8,7 @@
 #include <itkSingleValuedCostFunction.h>
 
 #include <animaMultiCompartmentModelCreator.h>
+#include <animaNNLSOptimizer.h>
 #include <itkCostFunction.h>
 #include <itkNonLinearOptimizer.h>
 
@@ -86,6 +87,7 @@ public:
     typedef typename Superclass::OutputImageRegionType OutputImageRegionType;
 
     typedef vnl_vector_fixed <double,3> GradientType;
+    typedef typename InputImageType::IndexType IndexType;
 
     // Acquisition-related parameters
     void SetGradientStrengths(std::vector <double> &mb) {m_GradientStrengths = mb;}
@@ -159,6 +161,17 @@ public:
     itkSetMacro(GTolerance, double)
     itkSetMacro(MaxEval, unsigned int)
 
+    //! Number of masked voxels handed out at once to a thread
+    itkSetMacro(VoxelChunkSize, unsigned int)
+
+    //! Process voxels in raster order and seed each fit from the previously estimated neighbor (within a voxel chunk only)
+    itkSetMacro(UseSpatialWarmStart, bool)
+    itkGetMacro(UseSpatialWarmStart, bool)
+
+    //! When selecting the number of compartments, grow the previous model by one compartment instead of restarting
+    itkSetMacro(UseIncrementalModelSelection, bool)
+    itkGetMacro(UseIncrementalModelSelection, bool)
+
 protected:
     MCMEstimatorImageFilter() : Superclass()
     {
@@ -215,6 +228,11 @@ protected:
 
         m_SmallDelta = anima::DiffusionSmallDelta;
         m_BigDelta = anima::DiffusionBigDelta;
+
+        m_VoxelChunkSize = 16;
+        m_HighestProcessedVoxel = 0;
+        m_UseSpatialWarmStart = false;
+        m_UseIncrementalModelSelection = false;
     }
 
     virtual ~MCMEstimatorImageFilter()
@@ -230,6 +248,25 @@ protected:
     virtual void BeforeThreadedGenerateData() ITK_OVERRIDE;
     void ThreadedGenerateData(const OutputImageRegionType &outputRegionForThread, itk::ThreadIdType threadId) ITK_OVERRIDE;
 
+    //! Builds the compacted list of masked voxels, ordered by decreasing expected cost when known
+    void InitializeSplitParameters() ITK_OVERRIDE;
+
+    //! Dynamic scheduling: threads pull small chunks of masked voxels instead of whole slices
+    void ThreadProcessSlices(itk::ThreadIdType threadId) ITK_OVERRIDE;
+
+    //! Slab streaming: AICc, B0, sigma and (if estimated) MOSE volumes are saved and assembled along with the MCM output
+    void WriteSlab(const std::string &slabPrefix, const OutputImageRegionType &slabRegion) ITK_OVERRIDE;
+    void AllocateSlabAssembly() ITK_OVERRIDE;
+    void ReadSlab(const std::string &slabPrefix, const OutputImageRegionType &slabRegion) ITK_OVERRIDE;
+    void RemoveSlab(const std::string &slabPrefix) ITK_OVERRIDE;
+
+    //! Creates AICc, B0, sigma and (if not provided) MOSE volumes on region, with the geometry of the first input
+    void CreateSideVolumes(const OutputImageRegionType &region);
+
+    //! Estimates models and writes outputs for voxels[startIndex] to voxels[endIndex - 1]
+    void ProcessVoxels(const std::vector <IndexType> &voxels, unsigned int startIndex, unsigned int endIndex,
+                       itk::ThreadIdType threadId);
+
     //! Create a cost function following the noise type and estimation mode
     virtual CostFunctionBasePointer CreateCostFunction(std::vector<double> &observedSignals, MCMPointer &mcmModel);
 
@@ -241,10 +278,29 @@ protected:
                                 double &aiccValue, double &b0Value, double &sigmaSqValue);
 
     //! Doing estimation of non isotropic compartments (for a given number of anisotropic compartments)
+    //! If a neighbor model is provided, it is first used to seed the final model estimation
     void OptimizeNonIsotropicCompartments(MCMPointer &mcmValue, unsigned int currentNumberOfCompartments,
+                                          std::vector <double> &observedSignals, itk::ThreadIdType threadId,
+                                          double &aiccValue, double &b0Value, double &sigmaSqValue,
+                                          MCMPointer neighborModel = 0);
+
+    //! Estimates the final model directly from a neighbor voxel model (normalized weights scaled by b0Value)
+    void NeighborSeededEstimation(MCMPointer &mcmValue, MCMPointer &neighborModel, std::vector <double> &observedSignals,
+                                  itk::ThreadIdType threadId, double &aiccValue, double &b0Value, double &sigmaSqValue);
+
+    //! Estimates a model with one more compartment than previousModel (normalized weights scaled by previousB0Value),
+    //! the new compartment orientation being the stick atom best explaining the previous model residuals
+    void IncrementalCompartmentEstimation(MCMPointer &mcmValue, MCMPointer &previousModel, double previousB0Value,
                                           std::vector <double> &observedSignals, itk::ThreadIdType threadId,
                                           double &aiccValue, double &b0Value, double &sigmaSqValue);
 
+    //! Creates a model of the final compartment type with the requested number of anisotropic compartments
+    MCMPointer CreateFinalModel(unsigned int numberOfCompartments, itk::ThreadIdType threadId);
+
+    //! Single optimization of a model from its current parameters, returns profiled b0, sigma square and AICc
+    void OptimizeFromCurrentParameters(MCMPointer &mcmValue, std::vector <double> &observedSignals,
+                                       double &aiccValue, double &b0Value, double &sigmaSqValue);
+
     //! Doing estimation only of multiple orientations
     void InitialOrientationsEstimation(MCMPointer &mcmValue, bool authorizedNegativeB0Value, unsigned int currentNumberOfCompartments,
                                        std::vector <double> &observedSignals, itk::ThreadIdType threadId,
@@ -309,6 +365,9 @@ private:
 
     //! Sparse dictionary for pre-, rough estimation of directions in sticks
     vnl_matrix <double> m_SparseSticksDictionary;
+    //! Dictionary Gram matrix, shared by per-thread warm started NNLS optimizers
+    vnl_matrix <double> m_SparseSticksGramMatrix;
+    std::vector <anima::NNLSOptimizer::Pointer> m_SparseSticksOptimizers;
     unsigned int m_NumberOfDictionaryEntries;
     std::vector < std::vector <double> > m_DictionaryDirections;
 
@@ -353,6 +412,15 @@ private:
     
     //! Coarse grid values for complex model initialization
     std::vector < std::vector <double> > m_ValuesCoarseGrid;
+
+    //! Compacted list of masked voxels and dynamic scheduling state
+    std::vector <IndexType> m_VoxelsToProcess;
+    unsigned int m_VoxelChunkSize;
+    unsigned int m_HighestProcessedVoxel;
+    itk::SimpleFastMutexLock m_LockHighestProcessedVoxel;
+
+    bool m_UseSpatialWarmStart;
+    bool m_UseIncrementalModelSelection;
 };
 
 } // end namespace anima
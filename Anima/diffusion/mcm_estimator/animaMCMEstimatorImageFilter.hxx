@@ -4,6 +4,7 @@
 
 #include <itkImageRegionIterator.h>
 #include <itkImageRegionConstIterator.h>
+#include <itkImageRegionConstIteratorWithIndex.h>
 #include <itkSymmetricEigenAnalysis.h>
 
 #include <animaNLOPTOptimizers.h>
@@ -23,6 +24,7 @@
 #include <animaMCMFileWriter.h>
 
 #include <limits>
+#include <algorithm>
 
 namespace anima
 {
@@ -109,12 +111,13 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
         bValueFirstB0Index = anima::GetBValueFromAcquisitionParameters(m_SmallDelta, m_BigDelta, m_GradientStrengths[firstB0Index]);
     }
 
-    B0IteratorType b0Itr(this->GetInput(firstB0Index),this->GetOutput()->GetLargestPossibleRegion());
+    // Only the requested region (current slab in slab streaming mode) of the B0 image is available
+    B0IteratorType b0Itr(this->GetInput(firstB0Index),this->GetOutput()->GetRequestedRegion());
 
     if (!this->GetComputationMask())
         this->Superclass::CheckComputationMask();
 
-    MaskIteratorType maskItr(this->GetComputationMask(),this->GetOutput()->GetLargestPossibleRegion());
+    MaskIteratorType maskItr(this->GetComputationMask(),this->GetOutput()->GetRequestedRegion());
 
     while (!b0Itr.IsAtEnd())
     {
@@ -145,7 +148,7 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
     if (m_GradientStrengths.size() != m_NumberOfImages)
         itkExceptionMacro("There should be the same number of input images and input b-values...");
 
-    itk::ImageRegionIterator <OutputImageType> fillOut(this->GetOutput(),this->GetOutput()->GetLargestPossibleRegion());
+    itk::ImageRegionIterator <OutputImageType> fillOut(this->GetOutput(),this->GetOutput()->GetRequestedRegion());
     unsigned int outSize = this->GetOutput()->GetNumberOfComponentsPerPixel();
     typename OutputImageType::PixelType emptyModelVec(outSize);
     emptyModelVec.Fill(0);
@@ -156,48 +159,7 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
         ++fillOut;
     }
 
-    // Create AICc volume
-    m_AICcVolume = OutputScalarImageType::New();
-    m_AICcVolume->Initialize();
-    m_AICcVolume->SetRegions(this->GetInput(0)->GetLargestPossibleRegion());
-    m_AICcVolume->SetSpacing (this->GetInput(0)->GetSpacing());
-    m_AICcVolume->SetOrigin (this->GetInput(0)->GetOrigin());
-    m_AICcVolume->SetDirection (this->GetInput(0)->GetDirection());
-    m_AICcVolume->Allocate();
-    m_AICcVolume->FillBuffer(0);
-
-    // Create B0 volume
-    m_B0Volume = OutputScalarImageType::New();
-    m_B0Volume->Initialize();
-    m_B0Volume->SetRegions(this->GetInput(0)->GetLargestPossibleRegion());
-    m_B0Volume->SetSpacing (this->GetInput(0)->GetSpacing());
-    m_B0Volume->SetOrigin (this->GetInput(0)->GetOrigin());
-    m_B0Volume->SetDirection (this->GetInput(0)->GetDirection());
-    m_B0Volume->Allocate();
-    m_B0Volume->FillBuffer(0);
-
-    // Create sigma volume
-    m_SigmaSquareVolume = OutputScalarImageType::New();
-    m_SigmaSquareVolume->Initialize();
-    m_SigmaSquareVolume->SetRegions(this->GetInput(0)->GetLargestPossibleRegion());
-    m_SigmaSquareVolume->SetSpacing (this->GetInput(0)->GetSpacing());
-    m_SigmaSquareVolume->SetOrigin (this->GetInput(0)->GetOrigin());
-    m_SigmaSquareVolume->SetDirection (this->GetInput(0)->GetDirection());
-    m_SigmaSquareVolume->Allocate();
-    m_SigmaSquareVolume->FillBuffer(0);
-
-    // Create mose volume
-    if (!m_MoseVolume)
-    {
-        m_MoseVolume = MoseImageType::New();
-        m_MoseVolume->Initialize();
-        m_MoseVolume->SetRegions(this->GetInput(0)->GetLargestPossibleRegion());
-        m_MoseVolume->SetSpacing (this->GetInput(0)->GetSpacing());
-        m_MoseVolume->SetOrigin (this->GetInput(0)->GetOrigin());
-        m_MoseVolume->SetDirection (this->GetInput(0)->GetDirection());
-        m_MoseVolume->Allocate();
-        m_MoseVolume->FillBuffer(0);
-    }
+    this->CreateSideVolumes(this->GetOutput()->GetRequestedRegion());
 
     if (m_ExternalMoseVolume)
         m_FindOptimalNumberOfCompartments = false;
@@ -363,6 +325,30 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
         for (unsigned int j = 0;j < m_NumberOfImages;++j)
             m_SparseSticksDictionary(j,countIsoComps + i) = mcm->GetPredictedSignal(m_SmallDelta, m_BigDelta, m_GradientStrengths[j], m_GradientDirections[j]);
     }
+
+    // Gram matrix of the dictionary, computed once and shared read-only by all threads NNLS
+    unsigned int dictionarySize = m_SparseSticksDictionary.cols();
+    m_SparseSticksGramMatrix.set_size(dictionarySize,dictionarySize);
+    for (unsigned int i = 0;i < dictionarySize;++i)
+    {
+        for (unsigned int j = i;j < dictionarySize;++j)
+        {
+            double gramValue = 0.0;
+            for (unsigned int k = 0;k < m_NumberOfImages;++k)
+                gramValue += m_SparseSticksDictionary(k,i) * m_SparseSticksDictionary(k,j);
+
+            m_SparseSticksGramMatrix(i,j) = gramValue;
+            m_SparseSticksGramMatrix(j,i) = gramValue;
+        }
+    }
+
+    m_SparseSticksOptimizers.resize(this->GetNumberOfThreads());
+    for (unsigned int i = 0;i < this->GetNumberOfThreads();++i)
+    {
+        m_SparseSticksOptimizers[i] = anima::NNLSOptimizer::New();
+        m_SparseSticksOptimizers[i]->SetSharedDataMatrix(&m_SparseSticksGramMatrix);
+        m_SparseSticksOptimizers[i]->SetSquaredProblem(true);
+    }
 }
 
 template <class InputPixelType, class OutputPixelType>
@@ -418,29 +404,230 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
 template <class InputPixelType, class OutputPixelType>
 void
 MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
-::ThreadedGenerateData(const OutputImageRegionType &outputRegionForThread, itk::ThreadIdType threadId)
+::CreateSideVolumes(const OutputImageRegionType &region)
 {
-    typedef itk::ImageRegionConstIterator <InputImageType> ConstImageIteratorType;
+    // Create AICc volume
+    m_AICcVolume = OutputScalarImageType::New();
+    m_AICcVolume->Initialize();
+    m_AICcVolume->SetRegions(region);
+    m_AICcVolume->SetSpacing (this->GetInput(0)->GetSpacing());
+    m_AICcVolume->SetOrigin (this->GetInput(0)->GetOrigin());
+    m_AICcVolume->SetDirection (this->GetInput(0)->GetDirection());
+    m_AICcVolume->Allocate();
+    m_AICcVolume->FillBuffer(0);
 
-    std::vector <ConstImageIteratorType> inIterators(m_NumberOfImages);
-    for (unsigned int i = 0;i < m_NumberOfImages;++i)
-        inIterators[i] = ConstImageIteratorType(this->GetInput(i),outputRegionForThread);
+    // Create B0 volume
+    m_B0Volume = OutputScalarImageType::New();
+    m_B0Volume->Initialize();
+    m_B0Volume->SetRegions(region);
+    m_B0Volume->SetSpacing (this->GetInput(0)->GetSpacing());
+    m_B0Volume->SetOrigin (this->GetInput(0)->GetOrigin());
+    m_B0Volume->SetDirection (this->GetInput(0)->GetDirection());
+    m_B0Volume->Allocate();
+    m_B0Volume->FillBuffer(0);
 
-    typedef itk::ImageRegionIterator <OutputImageType> OutImageIteratorType;
-    typedef itk::ImageRegionConstIterator <VectorImageType> VectorImageIteratorType;
-    OutImageIteratorType outIterator(this->GetOutput(),outputRegionForThread);
+    // Create sigma volume
+    m_SigmaSquareVolume = OutputScalarImageType::New();
+    m_SigmaSquareVolume->Initialize();
+    m_SigmaSquareVolume->SetRegions(region);
+    m_SigmaSquareVolume->SetSpacing (this->GetInput(0)->GetSpacing());
+    m_SigmaSquareVolume->SetOrigin (this->GetInput(0)->GetOrigin());
+    m_SigmaSquareVolume->SetDirection (this->GetInput(0)->GetDirection());
+    m_SigmaSquareVolume->Allocate();
+    m_SigmaSquareVolume->FillBuffer(0);
 
-    typedef itk::ImageRegionIterator <MaskImageType> MaskIteratorType;
+    // Create mose volume
+    if (!m_ExternalMoseVolume)
+    {
+        m_MoseVolume = MoseImageType::New();
+        m_MoseVolume->Initialize();
+        m_MoseVolume->SetRegions(region);
+        m_MoseVolume->SetSpacing (this->GetInput(0)->GetSpacing());
+        m_MoseVolume->SetOrigin (this->GetInput(0)->GetOrigin());
+        m_MoseVolume->SetDirection (this->GetInput(0)->GetDirection());
+        m_MoseVolume->Allocate();
+        m_MoseVolume->FillBuffer(0);
+    }
+}
+
+template <class InputPixelType, class OutputPixelType>
+void
+MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
+::WriteSlab(const std::string &slabPrefix, const OutputImageRegionType &slabRegion)
+{
+    this->Superclass::WriteSlab(slabPrefix,slabRegion);
+
+    // Side volumes only span the slab region
+    anima::writeImage <OutputScalarImageType> (slabPrefix + "_aicc.nrrd",m_AICcVolume);
+    anima::writeImage <OutputScalarImageType> (slabPrefix + "_b0.nrrd",m_B0Volume);
+    anima::writeImage <OutputScalarImageType> (slabPrefix + "_sigma.nrrd",m_SigmaSquareVolume);
+
+    if (!m_ExternalMoseVolume)
+        anima::writeImage <MoseImageType> (slabPrefix + "_mose.nrrd",m_MoseVolume);
+}
+
+template <class InputPixelType, class OutputPixelType>
+void
+MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
+::AllocateSlabAssembly()
+{
+    this->Superclass::AllocateSlabAssembly();
+
+    // Side volumes are recreated: they do not exist yet if all slabs were computed by a previous run
+    this->CreateSideVolumes(this->GetOutput()->GetLargestPossibleRegion());
+}
+
+template <class InputPixelType, class OutputPixelType>
+void
+MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
+::ReadSlab(const std::string &slabPrefix, const OutputImageRegionType &slabRegion)
+{
+    this->Superclass::ReadSlab(slabPrefix,slabRegion);
+
+    OutputScalarImagePointer slabImage = anima::readImage <OutputScalarImageType> (slabPrefix + "_aicc.nrrd");
+    this->PasteSlabImage(slabImage.GetPointer(),m_AICcVolume.GetPointer(),slabRegion);
+    slabImage = anima::readImage <OutputScalarImageType> (slabPrefix + "_b0.nrrd");
+    this->PasteSlabImage(slabImage.GetPointer(),m_B0Volume.GetPointer(),slabRegion);
+    slabImage = anima::readImage <OutputScalarImageType> (slabPrefix + "_sigma.nrrd");
+    this->PasteSlabImage(slabImage.GetPointer(),m_SigmaSquareVolume.GetPointer(),slabRegion);
+
+    if (!m_ExternalMoseVolume)
+    {
+        MoseImagePointer slabMoseImage = anima::readImage <MoseImageType> (slabPrefix + "_mose.nrrd");
+        this->PasteSlabImage(slabMoseImage.GetPointer(),m_MoseVolume.GetPointer(),slabRegion);
+    }
+}
+
+template <class InputPixelType, class OutputPixelType>
+void
+MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
+::RemoveSlab(const std::string &slabPrefix)
+{
+    this->Superclass::RemoveSlab(slabPrefix);
+
+    std::remove((slabPrefix + "_aicc.nrrd").c_str());
+    std::remove((slabPrefix + "_b0.nrrd").c_str());
+    std::remove((slabPrefix + "_sigma.nrrd").c_str());
+
+    if (!m_ExternalMoseVolume)
+        std::remove((slabPrefix + "_mose.nrrd").c_str());
+}
+
+template <class InputPixelType, class OutputPixelType>
+void
+MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
+::InitializeSplitParameters()
+{
+    // Compact masked voxels into a list, handed out to threads in small chunks
+    typedef itk::ImageRegionConstIteratorWithIndex <MaskImageType> MaskIteratorType;
+    MaskIteratorType maskItr(this->GetComputationMask(),this->GetOutput()->GetRequestedRegion());
+
+    m_VoxelsToProcess.clear();
+    std::vector <unsigned int> expectedCosts;
+
+    // Spatial warm start needs raster order so that chunks are made of neighboring voxels
+    bool sortByExpectedCost = m_ExternalMoseVolume && !m_UseSpatialWarmStart;
+
+    while (!maskItr.IsAtEnd())
+    {
+        if (maskItr.Get() != 0)
+        {
+            m_VoxelsToProcess.push_back(maskItr.GetIndex());
+
+            // Expected cost: number of anisotropic compartments to estimate, only known in advance from an external MOSE volume
+            if (sortByExpectedCost)
+                expectedCosts.push_back(std::max(0,(int)m_MoseVolume->GetPixel(maskItr.GetIndex())));
+        }
+
+        ++maskItr;
+    }
+
+    if (sortByExpectedCost)
+    {
+        // Most expensive voxels first so that cheap ones fill the gaps at the end
+        // Costs are small integers, voxels are bucketed by cost keeping raster order inside buckets
+        unsigned int maxCost = 0;
+        for (unsigned int i = 0;i < expectedCosts.size();++i)
+            maxCost = std::max(maxCost,expectedCosts[i]);
+
+        std::vector <IndexType> sortedVoxels;
+        sortedVoxels.reserve(m_VoxelsToProcess.size());
+        for (int cost = maxCost;cost >= 0;--cost)
+        {
+            for (unsigned int i = 0;i < m_VoxelsToProcess.size();++i)
+            {
+                if (expectedCosts[i] == (unsigned int)cost)
+                    sortedVoxels.push_back(m_VoxelsToProcess[i]);
+            }
+        }
+
+        m_VoxelsToProcess.swap(sortedVoxels);
+    }
+
+    m_HighestProcessedVoxel = 0;
+
+    unsigned int chunkSize = std::max(m_VoxelChunkSize,(unsigned int)1);
+    unsigned int numChunks = (m_VoxelsToProcess.size() + chunkSize - 1) / chunkSize;
+    this->InitializeProgressReporter(numChunks);
+}
+
+template <class InputPixelType, class OutputPixelType>
+void
+MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
+::ThreadProcessSlices(itk::ThreadIdType threadId)
+{
+    unsigned int chunkSize = std::max(m_VoxelChunkSize,(unsigned int)1);
+    unsigned int numVoxels = m_VoxelsToProcess.size();
+    bool continueLoop = true;
+
+    while (continueLoop)
+    {
+        m_LockHighestProcessedVoxel.Lock();
+
+        if (m_HighestProcessedVoxel >= numVoxels)
+        {
+            m_LockHighestProcessedVoxel.Unlock();
+            continueLoop = false;
+            continue;
+        }
+
+        unsigned int startVoxel = m_HighestProcessedVoxel;
+        unsigned int endVoxel = std::min(startVoxel + chunkSize,numVoxels);
+        m_HighestProcessedVoxel = endVoxel;
+
+        m_LockHighestProcessedVoxel.Unlock();
+
+        this->ProcessVoxels(m_VoxelsToProcess,startVoxel,endVoxel,threadId);
+        this->ReportCompletedWorkUnit();
+    }
+}
+
+template <class InputPixelType, class OutputPixelType>
+void
+MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
+::ThreadedGenerateData(const OutputImageRegionType &outputRegionForThread, itk::ThreadIdType threadId)
+{
+    typedef itk::ImageRegionConstIteratorWithIndex <MaskImageType> MaskIteratorType;
     MaskIteratorType maskItr(this->GetComputationMask(),outputRegionForThread);
 
-    typedef itk::ImageRegionIterator <OutputScalarImageType> ImageIteratorType;
-    ImageIteratorType aiccIterator(m_AICcVolume, outputRegionForThread);
-    ImageIteratorType b0Iterator(m_B0Volume, outputRegionForThread);
-    ImageIteratorType sigmaIterator(m_SigmaSquareVolume, outputRegionForThread);
+    std::vector <IndexType> regionVoxels;
+    while (!maskItr.IsAtEnd())
+    {
+        if (maskItr.Get() != 0)
+            regionVoxels.push_back(maskItr.GetIndex());
 
-    typedef itk::ImageRegionIterator <MoseImageType> MoseIteratorType;
-    MoseIteratorType moseIterator(m_MoseVolume, outputRegionForThread);
+        ++maskItr;
+    }
 
+    this->ProcessVoxels(regionVoxels,0,regionVoxels.size(),threadId);
+}
+
+template <class InputPixelType, class OutputPixelType>
+void
+MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
+::ProcessVoxels(const std::vector <IndexType> &voxels, unsigned int startIndex, unsigned int endIndex,
+                itk::ThreadIdType threadId)
+{
     std::vector <double> observedSignals(m_NumberOfImages,0);
 
     typename OutputImageType::PixelType resVec(this->GetOutput()->GetNumberOfComponentsPerPixel());
@@ -451,43 +638,44 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
 
     double aiccValue, b0Value, sigmaSqValue;
 
-    while (!outIterator.IsAtEnd())
-    {
-        resVec.Fill(0.0);
+    // Models estimated at the previous voxel, indexed by number of anisotropic compartments (spatial warm start)
+    std::vector <MCMPointer> neighborModels(m_NumberOfCompartments + 1);
+    std::vector <MCMPointer> currentModels(m_NumberOfCompartments + 1);
+    IndexType previousIndex;
+    previousIndex.Fill(0);
 
-        //if ((maskItr.Get() == 0)||(maskItr.GetIndex()[0] != 61)||(maskItr.GetIndex()[1] != 102)||(maskItr.GetIndex()[2] != 53))
-        if (maskItr.Get() == 0)
-        {
-            outIterator.Set(resVec);
+    for (unsigned int voxelIndex = startIndex;voxelIndex < endIndex;++voxelIndex)
+    {
+        const IndexType &index = voxels[voxelIndex];
 
-            for (unsigned int i = 0;i < m_NumberOfImages;++i)
-                ++inIterators[i];
+        // Previous voxel is used as a seed only if it is the preceding one on the same line. Warm start never crosses
+        // chunk boundaries: the first voxel of each chunk starts cold, so that results do not depend on which thread
+        // got which chunk (larger VoxelChunkSize values make longer warm started runs)
+        bool hasNeighbor = m_UseSpatialWarmStart && (voxelIndex > startIndex) && (index[0] == previousIndex[0] + 1)
+                && (index[1] == previousIndex[1]) && (index[2] == previousIndex[2]);
 
-            ++outIterator;
-            ++maskItr;
-            ++aiccIterator;
-            ++b0Iterator;
-            ++sigmaIterator;
-            ++moseIterator;
+        if (!hasNeighbor)
+            std::fill(neighborModels.begin(),neighborModels.end(),MCMPointer(0));
 
-            continue;
-        }
+        std::fill(currentModels.begin(),currentModels.end(),MCMPointer(0));
+        previousIndex = index;
 
         // Load DWI
         for (unsigned int i = 0;i < m_NumberOfImages;++i)
-            observedSignals[i] = inIterators[i].Get();
+            observedSignals[i] = this->GetInput(i)->GetPixel(index);
 
         int moseValue = -1;
         bool estimateNonIsoCompartments = false;
         if (m_ExternalMoseVolume)
         {
-            moseValue = moseIterator.Get();
+            moseValue = m_MoseVolume->GetPixel(index);
             if (moseValue > 0)
                 estimateNonIsoCompartments = true;
         }
         else if (m_NumberOfCompartments > 0)
             estimateNonIsoCompartments = true;
 
+        aiccValue = std::numeric_limits <double>::max();
         bool hasIsoCompartment = m_ModelWithFreeWaterComponent || m_ModelWithRestrictedWaterComponent || m_ModelWithStationaryWaterComponent || m_ModelWithStaniszComponent;
         if (estimateNonIsoCompartments)
         {
@@ -509,6 +697,12 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
                 maximalNumberOfCompartments = numMoseCompartments;
             }
 
+            // Incremental selection: model with i compartments is grown from the one with i - 1
+            bool incrementalSelection = m_FindOptimalNumberOfCompartments && m_UseIncrementalModelSelection;
+            MCMPointer previousModel;
+            double previousB0Value = 0;
+            double previousAiccValue = std::numeric_limits <double>::max();
+
             for (unsigned int i = minimalNumberOfCompartments;i <= maximalNumberOfCompartments;++i)
             {
                 double tmpB0Value = 0;
@@ -516,7 +710,16 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
                 double tmpAiccValue = 0;
                 MCMPointer mcmValue;
 
-                this->OptimizeNonIsotropicCompartments(mcmValue,i,observedSignals,threadId,tmpAiccValue,tmpB0Value,tmpSigmaSqValue);
+                if (previousModel)
+                    this->IncrementalCompartmentEstimation(mcmValue,previousModel,previousB0Value,observedSignals,threadId,
+                                                           tmpAiccValue,tmpB0Value,tmpSigmaSqValue);
+
+                if (!previousModel || (tmpB0Value == 0.0))
+                    this->OptimizeNonIsotropicCompartments(mcmValue,i,observedSignals,threadId,tmpAiccValue,tmpB0Value,
+                                                           tmpSigmaSqValue,neighborModels[i]);
+
+                if (tmpB0Value != 0.0)
+                    currentModels[i] = mcmValue;
 
                 if ((tmpAiccValue < aiccValue)||(!m_FindOptimalNumberOfCompartments))
                 {
@@ -527,6 +730,17 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
                     sigmaSqValue = tmpSigmaSqValue;
                     mcmData = mcmValue;
                 }
+
+                if (incrementalSelection)
+                {
+                    // Stop as soon as AICc starts increasing with the number of compartments
+                    if ((tmpB0Value == 0.0)||(tmpAiccValue >= previousAiccValue))
+                        break;
+
+                    previousModel = mcmValue;
+                    previousB0Value = tmpB0Value;
+                    previousAiccValue = tmpAiccValue;
+                }
             }
         }
         else if (hasIsoCompartment)
@@ -550,21 +764,14 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
         else
             resVec = mcmData->GetModelVector();
 
-        outIterator.Set(resVec);
-        aiccIterator.Set(aiccValue);
-        b0Iterator.Set(b0Value);
-        sigmaIterator.Set(sigmaSqValue);
-        moseIterator.Set(mcmData->GetNumberOfCompartments() - mcmData->GetNumberOfIsotropicCompartments());
+        this->GetOutput()->SetPixel(index,resVec);
+        m_AICcVolume->SetPixel(index,aiccValue);
+        m_B0Volume->SetPixel(index,b0Value);
+        m_SigmaSquareVolume->SetPixel(index,sigmaSqValue);
+        m_MoseVolume->SetPixel(index,mcmData->GetNumberOfCompartments() - mcmData->GetNumberOfIsotropicCompartments());
 
-        for (unsigned int i = 0;i < m_NumberOfImages;++i)
-            ++inIterators[i];
-
-        ++outIterator;
-        ++maskItr;
-        ++aiccIterator;
-        ++b0Iterator;
-        ++sigmaIterator;
-        ++moseIterator;
+        if (m_UseSpatialWarmStart)
+            neighborModels.swap(currentModels);
     }
 }
 
@@ -573,7 +780,8 @@ void
 MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
 ::OptimizeNonIsotropicCompartments(MCMPointer &mcmValue, unsigned int currentNumberOfCompartments,
                                    std::vector <double> &observedSignals, itk::ThreadIdType threadId,
-                                   double &aiccValue, double &b0Value, double &sigmaSqValue)
+                                   double &aiccValue, double &b0Value, double &sigmaSqValue,
+                                   MCMPointer neighborModel)
 {
     b0Value = 0;
     sigmaSqValue = 1;
@@ -582,7 +790,45 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
     this->InitialOrientationsEstimation(mcmValue,false,currentNumberOfCompartments,observedSignals,threadId,
                                         aiccValue,b0Value,sigmaSqValue);
 
-    this->ModelEstimation(mcmValue,false,observedSignals,threadId,aiccValue,b0Value,sigmaSqValue);
+    // Constrained sticks are fully estimated by the initialization, nothing to seed
+    bool useNeighborModel = neighborModel && (b0Value != 0.0) && !((m_CompartmentType == Stick)&&(m_UseConstrainedDiffusivity));
+
+    MCMPointer seededValue;
+    double seededAiccValue = 0;
+    double seededB0Value = 0;
+    double seededSigmaSqValue = 1;
+
+    if (useNeighborModel)
+    {
+        seededB0Value = b0Value;
+        this->NeighborSeededEstimation(seededValue,neighborModel,observedSignals,threadId,
+                                       seededAiccValue,seededB0Value,seededSigmaSqValue);
+
+        // Ball and stick model is the reference: the seeded fit is kept if it explains data at least as well,
+        // otherwise it is likely stuck in the neighbor basin and full initialization is performed
+        if ((seededB0Value != 0.0)&&(seededAiccValue <= aiccValue))
+        {
+            mcmValue = seededValue;
+            aiccValue = seededAiccValue;
+            b0Value = seededB0Value;
+            sigmaSqValue = seededSigmaSqValue;
+        }
+        else
+            useNeighborModel = false;
+    }
+
+    if (!useNeighborModel)
+    {
+        this->ModelEstimation(mcmValue,false,observedSignals,threadId,aiccValue,b0Value,sigmaSqValue);
+
+        if ((seededValue)&&(seededB0Value != 0.0)&&((b0Value == 0.0)||(seededAiccValue < aiccValue)))
+        {
+            mcmValue = seededValue;
+            aiccValue = seededAiccValue;
+            b0Value = seededB0Value;
+            sigmaSqValue = seededSigmaSqValue;
+        }
+    }
 
     if (b0Value == 0.0)
     {
@@ -603,6 +849,183 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
     }
 }
 
+template <class InputPixelType, class OutputPixelType>
+void
+MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
+::NeighborSeededEstimation(MCMPointer &mcmValue, MCMPointer &neighborModel, std::vector <double> &observedSignals,
+                           itk::ThreadIdType threadId, double &aiccValue, double &b0Value, double &sigmaSqValue)
+{
+    unsigned int numberOfCompartments = neighborModel->GetNumberOfCompartments() - neighborModel->GetNumberOfIsotropicCompartments();
+    MCMPointer mcmUpdateValue = this->CreateFinalModel(numberOfCompartments,threadId);
+
+    // - Copy neighbor model, its weights are normalized: bring them back to the current b0 scale
+    this->InitializeModelFromSimplifiedOne(neighborModel,mcmUpdateValue);
+
+    MCMType::ListType seedWeights = mcmUpdateValue->GetCompartmentWeights();
+    for (unsigned int i = 0;i < seedWeights.size();++i)
+        seedWeights[i] *= b0Value;
+
+    mcmUpdateValue->SetCompartmentWeights(seedWeights);
+
+    this->OptimizeFromCurrentParameters(mcmUpdateValue,observedSignals,aiccValue,b0Value,sigmaSqValue);
+    mcmValue = mcmUpdateValue;
+}
+
+template <class InputPixelType, class OutputPixelType>
+void
+MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
+::IncrementalCompartmentEstimation(MCMPointer &mcmValue, MCMPointer &previousModel, double previousB0Value,
+                                   std::vector <double> &observedSignals, itk::ThreadIdType threadId,
+                                   double &aiccValue, double &b0Value, double &sigmaSqValue)
+{
+    b0Value = 0;
+    sigmaSqValue = 1;
+    aiccValue = -1;
+
+    // Residual of the previous model, its weights are normalized
+    unsigned int numIsotropicComponents = previousModel->GetNumberOfIsotropicCompartments();
+    unsigned int previousNumberOfCompartments = previousModel->GetNumberOfCompartments();
+    std::vector <double> residuals(m_NumberOfImages,0.0);
+    for (unsigned int i = 0;i < m_NumberOfImages;++i)
+        residuals[i] = observedSignals[i] - previousB0Value * previousModel->GetPredictedSignal(m_SmallDelta,m_BigDelta,
+                                                                                               m_GradientStrengths[i],m_GradientDirections[i]);
+
+    // Greedy sparse step: stick atom best correlated with the residual
+    unsigned int dictionaryIsotropicSize = m_SparseSticksDictionary.cols() - m_NumberOfDictionaryEntries;
+    unsigned int bestAtomIndex = 0;
+    double bestCorrelation = 0.0;
+    double bestAtomWeight = 0.0;
+    for (unsigned int j = dictionaryIsotropicSize;j < m_SparseSticksDictionary.cols();++j)
+    {
+        double dotProduct = 0.0;
+        double atomNorm = 0.0;
+        for (unsigned int i = 0;i < m_NumberOfImages;++i)
+        {
+            dotProduct += residuals[i] * m_SparseSticksDictionary(i,j);
+            atomNorm += m_SparseSticksDictionary(i,j) * m_SparseSticksDictionary(i,j);
+        }
+
+        if (atomNorm <= 0.0)
+            continue;
+
+        double correlation = dotProduct / std::sqrt(atomNorm);
+        if (correlation > bestCorrelation)
+        {
+            bestCorrelation = correlation;
+            bestAtomIndex = j;
+            bestAtomWeight = dotProduct / atomNorm;
+        }
+    }
+
+    // Nothing left to explain along a new direction
+    if (bestCorrelation <= 0.0)
+        return;
+
+    unsigned int numberOfCompartments = previousNumberOfCompartments - numIsotropicComponents + 1;
+    MCMPointer mcmUpdateValue = this->CreateFinalModel(numberOfCompartments,threadId);
+
+    // - Keep previous compartments, new one gets default parameters and the selected atom orientation
+    MCMType::ListType initialWeights(mcmUpdateValue->GetNumberOfCompartments(),0.0);
+    for (unsigned int i = 0;i < previousNumberOfCompartments;++i)
+    {
+        mcmUpdateValue->GetCompartment(i)->CopyFromOther(previousModel->GetCompartment(i));
+        initialWeights[i] = previousB0Value * previousModel->GetCompartmentWeight(i);
+    }
+
+    std::vector <double> newDirection(3,0.0);
+    anima::TransformCartesianToSphericalCoordinates(m_DictionaryDirections[bestAtomIndex],newDirection);
+
+    anima::BaseCompartment *newCompartment = mcmUpdateValue->GetCompartment(previousNumberOfCompartments);
+    newCompartment->SetOrientationTheta(newDirection[0]);
+    newCompartment->SetOrientationPhi(newDirection[1]);
+    initialWeights[previousNumberOfCompartments] = bestAtomWeight;
+
+    mcmUpdateValue->SetCompartmentWeights(initialWeights);
+
+    this->OptimizeFromCurrentParameters(mcmUpdateValue,observedSignals,aiccValue,b0Value,sigmaSqValue);
+    mcmValue = mcmUpdateValue;
+
+    if (b0Value != 0.0)
+    {
+        MCMType::ListType outputWeights = mcmValue->GetCompartmentWeights();
+
+        for (unsigned int i = 0;i < outputWeights.size();++i)
+            outputWeights[i] /= b0Value;
+
+        mcmValue->SetCompartmentWeights(outputWeights);
+    }
+}
+
+template <class InputPixelType, class OutputPixelType>
+typename MCMEstimatorImageFilter<InputPixelType, OutputPixelType>::MCMPointer
+MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
+::CreateFinalModel(unsigned int numberOfCompartments, itk::ThreadIdType threadId)
+{
+    MCMCreatorType *mcmCreator = m_MCMCreators[threadId];
+    mcmCreator->SetModelWithFreeWaterComponent(m_ModelWithFreeWaterComponent);
+    mcmCreator->SetModelWithStationaryWaterComponent(m_ModelWithStationaryWaterComponent);
+    mcmCreator->SetModelWithRestrictedWaterComponent(m_ModelWithRestrictedWaterComponent);
+    mcmCreator->SetModelWithStaniszComponent(m_ModelWithStaniszComponent);
+    mcmCreator->SetVariableProjectionEstimationMode(m_MLEstimationStrategy == VariableProjection);
+    mcmCreator->SetUseConstrainedFreeWaterDiffusivity(m_UseConstrainedFreeWaterDiffusivity);
+    mcmCreator->SetUseConstrainedIRWDiffusivity(m_UseConstrainedIRWDiffusivity);
+    mcmCreator->SetUseConstrainedStaniszDiffusivity(m_UseConstrainedStaniszDiffusivity);
+    mcmCreator->SetUseConstrainedStaniszRadius(m_UseConstrainedStaniszRadius);
+    mcmCreator->SetUseCommonDiffusivities(m_UseCommonDiffusivities);
+
+    mcmCreator->SetCompartmentType(m_CompartmentType);
+    mcmCreator->SetNumberOfCompartments(numberOfCompartments);
+    mcmCreator->SetUseConstrainedDiffusivity(m_UseConstrainedDiffusivity);
+    mcmCreator->SetUseConstrainedExtraAxonalFraction(m_UseConstrainedExtraAxonalFraction);
+    mcmCreator->SetUseConstrainedOrientationConcentration(m_UseConstrainedOrientationConcentration);
+    mcmCreator->SetUseCommonConcentrations(m_UseCommonConcentrations);
+    mcmCreator->SetUseCommonExtraAxonalFractions(m_UseCommonExtraAxonalFractions);
+
+    MCMPointer mcmValue = mcmCreator->GetNewMultiCompartmentModel();
+    mcmValue->SetNegativeWeightBounds(false);
+
+    return mcmValue;
+}
+
+template <class InputPixelType, class OutputPixelType>
+void
+MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
+::OptimizeFromCurrentParameters(MCMPointer &mcmValue, std::vector <double> &observedSignals,
+                                double &aiccValue, double &b0Value, double &sigmaSqValue)
+{
+    b0Value = 0;
+    sigmaSqValue = 1;
+
+    CostFunctionBasePointer cost = this->CreateCostFunction(observedSignals,mcmValue);
+
+    unsigned int dimension = mcmValue->GetNumberOfParameters();
+    ParametersType p(dimension);
+    MCMType::ListType workVec(dimension);
+    itk::Array<double> lowerBounds(dimension), upperBounds(dimension);
+
+    workVec = mcmValue->GetParameterLowerBounds();
+    for (unsigned int i = 0;i < dimension;++i)
+        lowerBounds[i] = workVec[i];
+
+    workVec = mcmValue->GetParameterUpperBounds();
+    for (unsigned int i = 0;i < dimension;++i)
+        upperBounds[i] = workVec[i];
+
+    // Initial parameters may come from another voxel or model, project them inside bounds
+    workVec = mcmValue->GetParametersAsVector();
+    for (unsigned int i = 0;i < dimension;++i)
+        p[i] = std::min(upperBounds[i],std::max(lowerBounds[i],workVec[i]));
+
+    double costValue = this->PerformSingleOptimization(p,cost,lowerBounds,upperBounds);
+    this->GetProfiledInformation(cost,mcmValue,b0Value,sigmaSqValue);
+
+    for (unsigned int i = 0;i < dimension;++i)
+        workVec[i] = p[i];
+
+    mcmValue->SetParametersFromVector(workVec);
+    aiccValue = this->ComputeAICcValue(mcmValue,costValue);
+}
+
 template <class InputPixelType, class OutputPixelType>
 void
 MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
@@ -1323,21 +1746,30 @@ MCMEstimatorImageFilter<InputPixelType, OutputPixelType>
     unsigned int numNonIsotropicComponents = complexModel->GetNumberOfCompartments() - numIsotropicComponents;
     unsigned int numCompartments = complexModel->GetNumberOfCompartments();
 
-    //First compute sparse solution as NNLS optmization
-    anima::NNLSOptimizer::Pointer sparseOptimizer = anima::NNLSOptimizer::New();
-    sparseOptimizer->SetDataMatrix(m_SparseSticksDictionary);
+    //First compute sparse solution as NNLS optmization, on the shared Gram matrix (DtD)
+    anima::NNLSOptimizer *sparseOptimizer = m_SparseSticksOptimizers[threadId];
 
     unsigned int dictionarySize = m_SparseSticksDictionary.cols();
     unsigned int numSignals = observedSignals.size();
-    ParametersType rightHandValues(numSignals);
-    for (unsigned int i = 0;i < numSignals;++i)
-        rightHandValues[i] = observedSignals[i];
+    double signalsSign = authorizeNegativeB0Value ? -1.0 : 1.0;
+    ParametersType rightHandValues(dictionarySize);
+    for (unsigned int j = 0;j < dictionarySize;++j)
+    {
+        rightHandValues[j] = 0.0;
+        for (unsigned int i = 0;i < numSignals;++i)
+            rightHandValues[j] += m_SparseSticksDictionary(i,j) * observedSignals[i];
 
-    if (authorizeNegativeB0Value)
-        rightHandValues *= -1;
+        rightHandValues[j] *= signalsSign;
+    }
+
+    double signalsSquaredNorm = 0.0;
+    for (unsigned int i = 0;i < numSignals;++i)
+        signalsSquaredNorm += observedSignals[i] * observedSignals[i];
 
+    // Each voxel starts from zero: the dictionary is underdetermined, warm starts from the previous voxel of the thread
+    // would make the selected sticks depend on thread scheduling
     sparseOptimizer->SetPoints(rightHandValues);
-    sparseOptimizer->SetSquaredProblem(false);
+    sparseOptimizer->SetPointsSquaredNorm(signalsSquaredNorm);
     sparseOptimizer->StartOptimization();
 
     // Get atom weights and determine the number of non null weighted components, first quartile of their weights
@@ -14,6 +14,7 @@ int main(int argc, char **argv)
     TCLAP::ValueArg<std::string> inFileArg("i","input","list of MCM images (one per line)",true,"","MCM images",cmd);
     TCLAP::ValueArg<std::string> resArg("o","output", "Average MCM volume",true,"","result MCM volume",cmd);
     TCLAP::ValueArg<int> outputFascicleArg("n", "nb-of-output-fascicle", "number of output fascicles", true, 0, "number of output fascicles",cmd);
+    TCLAP::SwitchArg pairingArg("P","pairing","Group fascicles by greedy and Hungarian pairing instead of spectral clustering (faster for many inputs)",cmd,false);
     TCLAP::ValueArg<unsigned int> nbpArg("p","numberofthreads","Number of threads to run on (default: all cores)",false,itk::MultiThreader::GetGlobalDefaultNumberOfThreads(),"number of threads",cmd);
 
     try
@@ -100,6 +101,8 @@ int main(int argc, char **argv)
     anima::MultiCompartmentModel::Pointer outputReferenceModel = mcmCreator.GetNewMultiCompartmentModel();
 
     mainFilter->SetReferenceOutputModel(outputReferenceModel);
+    if (pairingArg.isSet())
+        mainFilter->SetCompartmentGrouping(anima::MCMWeightedAverager::GreedyHungarianPairing);
     mainFilter->SetNumberOfThreads(nbpArg.getValue());
     mainFilter->Update();
 
@@ -42,13 +42,19 @@ public:
 
     typedef anima::MCMWeightedAverager MCMAveragerType;
     typedef typename MCMAveragerType::Pointer MCMAveragerPointer;
+    typedef typename MCMAveragerType::CompartmentGroupingType CompartmentGroupingType;
 
     void SetReferenceOutputModel(MCModelPointer &model);
     MCModelType *GetReferenceOutputModel() {return m_ReferenceOutputModel;}
 
+    //! Method used to group fascicles of input models (default: spectral clustering)
+    itkSetMacro(CompartmentGrouping, CompartmentGroupingType)
+    itkGetConstMacro(CompartmentGrouping, CompartmentGroupingType)
+
 protected:
     MCMAverageImagesImageFilter ()
     {
+        m_CompartmentGrouping = MCMAveragerType::SpectralClustering;
     }
 
     virtual ~MCMAverageImagesImageFilter () {}
@@ -73,6 +79,7 @@ private:
 
     std::vector <MCModelPointer> m_ReferenceInputModels;
     MCModelPointer m_ReferenceOutputModel;
+    CompartmentGroupingType m_CompartmentGrouping;
 };
 
 } // end namespace anima
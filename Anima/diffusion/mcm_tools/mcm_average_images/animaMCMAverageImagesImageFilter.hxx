@@ -59,6 +59,7 @@ MCMAverageImagesImageFilter <TPixelType>
 {
     MCMAveragerPointer mcmAverager = anima::MCMWeightedAverager::New();
     mcmAverager->SetOutputModel(m_ReferenceOutputModel);
+    mcmAverager->SetCompartmentGrouping(m_CompartmentGrouping);
 
     return mcmAverager;
 }
@@ -0,0 +1,68 @@
+#include <tclap/CmdLine.h>
+
+#include <animaMCMFileReader.h>
+#include <animaMCMFileWriter.h>
+
+#include <itkTimeProbe.h>
+
+template <class PixelType>
+void convertMCM(std::string inputFileName, std::string outputFileName)
+{
+    typedef anima::MCMFileReader <PixelType,3> MCMReaderType;
+    typedef anima::MCMFileWriter <PixelType,3> MCMWriterType;
+
+    itk::TimeProbe tmpTime;
+    tmpTime.Start();
+
+    MCMReaderType mcmReader;
+    mcmReader.SetFileName(inputFileName);
+    mcmReader.Update();
+
+    tmpTime.Stop();
+    std::cout << "Reading time: " << tmpTime.GetTotal() << "s" << std::endl;
+
+    tmpTime.Reset();
+    tmpTime.Start();
+
+    MCMWriterType mcmWriter;
+    mcmWriter.SetInputImage(mcmReader.GetModelVectorImage());
+    mcmWriter.SetFileName(outputFileName);
+    mcmWriter.Update();
+
+    tmpTime.Stop();
+    std::cout << "Writing time: " << tmpTime.GetTotal() << "s" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    TCLAP::CmdLine cmd("Converts MCM images between the XML header + images format (.mcm) and the single file binary format (.mcmb). Output format is chosen from the output extension.\nINRIA / IRISA - VisAGeS Team",' ',ANIMA_VERSION);
+
+    TCLAP::ValueArg<std::string> inArg("i","input","Input MCM file (.mcm or .mcmb)",true,"","input MCM",cmd);
+    TCLAP::ValueArg<std::string> outArg("o","output","Output MCM file (.mcm or .mcmb)",true,"","output MCM",cmd);
+
+    try
+    {
+        cmd.parse(argc,argv);
+    }
+    catch (TCLAP::ArgException& e)
+    {
+        std::cerr << "Error: " << e.error() << "for argument " << e.argId() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        // Keep input component type so that conversion is lossless
+        if (anima::GetMCMComponentType(inArg.getValue()) == itk::ImageIOBase::FLOAT)
+            convertMCM <float> (inArg.getValue(),outArg.getValue());
+        else
+            convertMCM <double> (inArg.getValue(),outArg.getValue());
+    }
+    catch (itk::ExceptionObject &e)
+    {
+        std::cerr << e << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -34,6 +34,13 @@ public:
     /** Superclass typedefs. */
     typedef typename Superclass::OutputImageRegionType OutputImageRegionType;
 
+    /**
+     * Computes generalized FA of a block of ODFs stored as contiguous rows of SH coefficients (numODFs x numCoefficients).
+     * Null ODFs get a zero GFA
+     */
+    static void ComputeGeneralizedFAValues(unsigned int numODFs, unsigned int numCoefficients,
+                                           const double *coefficients, double *gfaValues);
+
 protected:
     GeneralizedFAImageFilter()
     {
@@ -43,23 +50,11 @@ protected:
 
     void ThreadedGenerateData(const OutputImageRegionType &outputRegionForThread, itk::ThreadIdType threadId) ITK_OVERRIDE;
 
-    bool isZero(InputImagePixel &testVal)
-    {
-        bool resVal = true;
-        for (unsigned int i = 0;i < testVal.GetSize();++i)
-        {
-            if (testVal[i] != 0)
-            {
-                resVal = false;
-                break;
-            }
-        }
-
-        return resVal;
-    }
-
 private:
     ITK_DISALLOW_COPY_AND_ASSIGN(GeneralizedFAImageFilter);
+
+    //! Number of voxels gathered before computing their GFA at once
+    static const unsigned int m_BlockSize = 256;
 };
 	
 } // end of namespace anima
@@ -2,17 +2,39 @@
 
 #include "animaGeneralizedFAImageFilter.h"
 #include <itkImageRegionConstIterator.h>
-#include <itkImageRegionConstIteratorWithIndex.h>
 #include <itkImageRegionIterator.h>
+#include <vnl/vnl_matrix.h>
+
+#include <cmath>
+#include <algorithm>
 
 namespace anima
 {
+template <typename TInputPixelType>
+void
+GeneralizedFAImageFilter<TInputPixelType>
+::ComputeGeneralizedFAValues(unsigned int numODFs, unsigned int numCoefficients, const double *coefficients, double *gfaValues)
+{
+    for (unsigned int j = 0;j < numODFs;++j)
+    {
+        const double *odfCoefficients = coefficients + j * numCoefficients;
+
+        double sumSquares = 0;
+        for (unsigned int i = 0;i < numCoefficients;++i)
+            sumSquares += odfCoefficients[i] * odfCoefficients[i];
+
+        gfaValues[j] = 0;
+        if (sumSquares > 0)
+            gfaValues[j] = std::sqrt(std::max(0.0, 1.0 - odfCoefficients[0] * odfCoefficients[0] / sumSquares));
+    }
+}
+
 template <typename TInputPixelType>
 void
 GeneralizedFAImageFilter<TInputPixelType>
 ::ThreadedGenerateData(const OutputImageRegionType &outputRegionForThread, itk::ThreadIdType threadId)
 {
-    typedef itk::ImageRegionConstIteratorWithIndex <TInputImage> InputIteratorType;
+    typedef itk::ImageRegionConstIterator <TInputImage> InputIteratorType;
     typedef itk::ImageRegionIterator <TOutputImage> OutputIteratorType;
 
     InputIteratorType inputIt(this->GetInput(),outputRegionForThread);
@@ -21,25 +43,29 @@ GeneralizedFAImageFilter<TInputPixelType>
     unsigned int vdim = this->GetInput()->GetNumberOfComponentsPerPixel();
     InputImagePixel tmpCoefs;
 
-    while(!inputIt.IsAtEnd())
-    {
-        tmpCoefs = inputIt.Get();
+    vnl_matrix <double> coefficientsBlock(m_BlockSize,vdim);
+    std::vector <double> gfaBlock(m_BlockSize,0);
 
-        if (isZero(tmpCoefs))
+    while (!inputIt.IsAtEnd())
+    {
+        unsigned int blockSize = 0;
+        while ((blockSize < m_BlockSize) && (!inputIt.IsAtEnd()))
         {
+            tmpCoefs = inputIt.Get();
+            for (unsigned int i = 0;i < vdim;++i)
+                coefficientsBlock(blockSize,i) = tmpCoefs[i];
+
+            ++blockSize;
             ++inputIt;
-            outIt.Set(0);
-            ++outIt;
-            continue;
         }
 
-        double sumSquares = 0;
-        for (unsigned int i = 0;i < vdim;++i)
-            sumSquares += tmpCoefs[i]*tmpCoefs[i];
+        ComputeGeneralizedFAValues(blockSize,vdim,coefficientsBlock.data_block(),gfaBlock.data());
 
-        outIt.Set(sqrt(1 - tmpCoefs[0]*tmpCoefs[0]/sumSquares));
-        ++inputIt;
-        ++outIt;
+        for (unsigned int j = 0;j < blockSize;++j)
+        {
+            outIt.Set(gfaBlock[j]);
+            ++outIt;
+        }
     }
 }
 	
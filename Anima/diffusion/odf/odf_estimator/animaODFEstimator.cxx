@@ -25,6 +25,9 @@ int main(int argc, char **argv)
 	TCLAP::SwitchArg radialArg("R","radialestimation","Use radial estimation (see Aganj et al) ? (default: no)",cmd,false);
 	TCLAP::ValueArg<double> aganjRegFactorArg("d","adr","Delta threshold for signal regularization, only use if R option activated (see Aganj et al, default : 0.001)",false,0.001,"delta signal regularization",cmd);
 	
+    TCLAP::ValueArg<unsigned int> slabSizeArg("","slab-size","Number of slices per slab for streamed, resumable estimation (default: 0, whole image at once)",false,0,"slab size",cmd);
+    TCLAP::ValueArg<std::string> slabPrefixArg("","slab-prefix","Prefix of slab result files, a run with the same prefix resumes after the last completed slab (default: output name)",false,"","slab files prefix",cmd);
+
     TCLAP::ValueArg<unsigned int> nbpArg("p","numberofthreads","Number of threads to run on (default: all cores)",false,itk::MultiThreader::GetGlobalDefaultNumberOfThreads(),"number of threads",cmd);
     
     try
@@ -58,7 +61,13 @@ int main(int argc, char **argv)
     if (normalizeArg.isSet())
         mainFilter->SetFileNameSphereTesselation(normSphereArg.getValue());
     
-    anima::setMultipleImageFilterInputsFromFileName<InputImageType,MainFilterType>(inArg.getValue(), mainFilter);
+    // In slab streaming mode, readers are kept in the pipeline so that only the current slab is read
+    std::vector <itk::ProcessObject::Pointer> streamingSources;
+    std::vector <itk::ProcessObject::Pointer> *streamingSourcesPointer = 0;
+    if (slabSizeArg.getValue() != 0)
+        streamingSourcesPointer = &streamingSources;
+
+    anima::setMultipleImageFilterInputsFromFileName<InputImageType,MainFilterType>(inArg.getValue(), mainFilter, streamingSourcesPointer);
     
     typedef anima::GradientFileReader < std::vector < double >, double > GFReaderType;
     GFReaderType gfReader;
@@ -76,13 +85,23 @@ int main(int argc, char **argv)
 	tmpTime.Start();
 	
 	mainFilter->SetNumberOfThreads(nbpArg.getValue());
-	mainFilter->Update();
+    mainFilter->SetSlabSize(slabSizeArg.getValue());
+    if (slabPrefixArg.getValue() != "")
+        mainFilter->SetSlabFilesPrefix(slabPrefixArg.getValue());
+    else
+        mainFilter->SetSlabFilesPrefix(resArg.getValue());
+    mainFilter->SetSlabRunDescription("input: " + inArg.getValue() + ", gradients: " + gradArg.getValue());
+
+    mainFilter->UpdateBySlabs();
 	
 	tmpTime.Stop();
 	
 	std::cout << "Execution Time: " << tmpTime.GetTotal() << std::endl;
 	
-    anima::writeImage <MainFilterType::TOutputImage> (resArg.getValue(),mainFilter->GetOutput());
+    MainFilterType::OutputImagePointer outputImage = mainFilter->GetOutput();
+    outputImage->DisconnectPipeline();
+
+    anima::writeImage <MainFilterType::TOutputImage> (resArg.getValue(),outputImage);
 	
 	return EXIT_SUCCESS;
 }
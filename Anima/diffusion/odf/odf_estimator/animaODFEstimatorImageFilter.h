@@ -1,7 +1,7 @@
 #pragma once
 
 #include <iostream>
-#include <itkImageToImageFilter.h>
+#include <animaMaskedImageToImageFilter.h>
 #include <itkVectorImage.h>
 #include <itkImage.h>
 #include <vector>
@@ -11,7 +11,7 @@ namespace anima
 
 template <typename TInputPixelType, typename TOutputPixelType>
 class ODFEstimatorImageFilter :
-        public itk::ImageToImageFilter< itk::Image<TInputPixelType, 3> , itk::VectorImage <TOutputPixelType, 3> >
+        public anima::MaskedImageToImageFilter< itk::Image<TInputPixelType, 3> , itk::VectorImage <TOutputPixelType, 3> >
 {
 public:
     /** Standard class typedefs. */
@@ -19,7 +19,7 @@ public:
     typedef itk::Image <TInputPixelType, 3> TInputImage;
     typedef itk::Image<TInputPixelType,4> Image4DType;
     typedef itk::VectorImage <TOutputPixelType, 3> TOutputImage;
-    typedef itk::ImageToImageFilter< TInputImage, TOutputImage > Superclass;
+    typedef anima::MaskedImageToImageFilter< TInputImage, TOutputImage > Superclass;
     typedef itk::SmartPointer<Self> Pointer;
     typedef itk::SmartPointer<const Self>  ConstPointer;
 
@@ -27,13 +27,14 @@ public:
     itkNewMacro(Self);
 
     /** Run-time type information (and related methods) */
-    itkTypeMacro(ODFEstimatorImageFilter, ImageToImageFilter);
+    itkTypeMacro(ODFEstimatorImageFilter, MaskedImageToImageFilter);
 
     typedef typename TInputImage::Pointer InputImagePointer;
     typedef typename TOutputImage::Pointer OutputImagePointer;
 
     /** Superclass typedefs. */
     typedef typename Superclass::OutputImageRegionType OutputImageRegionType;
+    typedef typename Superclass::MaskImageType MaskImageType;
 
     void AddGradientDirection(unsigned int i, std::vector <double> &grad);
 
@@ -64,7 +65,7 @@ protected:
         m_SharpnessRatio = 0.255;
 
         m_Normalize = false;
-        m_SphereSHSampling.clear();
+        m_SphereSHIntegral.clear();
 
         m_UseAganjEstimation = false;
     }
@@ -102,7 +103,8 @@ private:
 
     bool m_Normalize;
     std::string m_FileNameSphereTesselation;
-    std::vector < std::vector <double> > m_SphereSHSampling;
+    //! Sum over the normalization sphere of each SH basis function, ODF integral is its dot product with coefficients
+    std::vector <double> m_SphereSHIntegral;
 
     double m_Lambda;
     double m_SharpnessRatio; // See Descoteaux et al. TMI 2009, article plus appendix
@@ -110,6 +112,9 @@ private:
     bool m_UseAganjEstimation;
     double m_DeltaAganjRegularization;
     unsigned int m_LOrder;
+
+    //! Number of masked voxels reconstructed at once by a single matrix-matrix product
+    static const unsigned int m_ReconstructionBlockSize = 256;
 };
 
 } // end of namespace anima
@@ -5,10 +5,13 @@
 #include <animaODFSphericalHarmonicBasis.h>
 #include <itkImageRegionConstIterator.h>
 #include <itkImageRegionIterator.h>
+#include <itkImageRegionConstIteratorWithIndex.h>
 #include <boost/math/special_functions/legendre.hpp>
 #include <fstream>
+#include <algorithm>
 
 #include <animaVectorOperations.h>
+#include <animaMatrixOperations.h>
 
 namespace anima
 {
@@ -66,20 +69,10 @@ ODFEstimatorImageFilter<TInputPixelType,TOutputPixelType>
     // Compute TMatrix as expressed in Descoteaux MRM 2007
 
     unsigned int posValue = 0;
-    vnl_matrix <double> BMatrix(numGrads,vectorLength);
+    vnl_matrix <double> BMatrix;
 
     anima::ODFSphericalHarmonicBasis tmpBasis(m_LOrder);
-
-    for (unsigned int i = 0;i < numGrads;++i)
-    {
-        posValue = 0;
-        for (int k = 0;k <= (int)m_LOrder;k += 2)
-            for (int m = -k;m <= k;++m)
-            {
-                BMatrix(i,posValue) = tmpBasis.getNthSHValueAtPosition(k,m,m_GradientDirections[i][0],m_GradientDirections[i][1]);
-                ++posValue;
-            }
-    }
+    tmpBasis.ComputeBasisMatrix(m_GradientDirections,BMatrix);
 
     std::vector <double> LVector(vectorLength,0);
     m_PVector.resize(vectorLength);
@@ -165,11 +158,9 @@ ODFEstimatorImageFilter<TInputPixelType,TOutputPixelType>
     {
         std::ifstream sphereIn(m_FileNameSphereTesselation.c_str());
 
-        m_SphereSHSampling.clear();
-
         std::vector <double> dirTmp(3,0);
         std::vector <double> sphericalCoords;
-        std::vector <double> shData;
+        std::vector < std::vector <double> > sphereDirections;
 
         while (!sphereIn.eof())
         {
@@ -181,18 +172,25 @@ ODFEstimatorImageFilter<TInputPixelType,TOutputPixelType>
 
             sscanf(tmpStr,"%lf %lf %lf",&dirTmp[0],&dirTmp[1],&dirTmp[2]);
             anima::TransformCartesianToSphericalCoordinates(dirTmp,sphericalCoords);
-            shData.clear();
+            sphereDirections.push_back(sphericalCoords);
+        }
+        sphereIn.close();
 
-            for (int k = 0;k <= (int)m_LOrder;k += 2)
-                for (int m = -k;m <= k;++m)
-                    shData.push_back(tmpBasis.getNthSHValueAtPosition(k,m,sphericalCoords[0],sphericalCoords[1]));
+        vnl_matrix <double> sphereBasisMatrix;
+        tmpBasis.ComputeBasisMatrix(sphereDirections,sphereBasisMatrix);
 
-            m_SphereSHSampling.push_back(shData);
+        m_SphereSHIntegral.resize(vectorLength);
+        std::fill(m_SphereSHIntegral.begin(),m_SphereSHIntegral.end(),0.0);
+        for (unsigned int i = 0;i < sphereBasisMatrix.rows();++i)
+        {
+            for (unsigned int j = 0;j < vectorLength;++j)
+                m_SphereSHIntegral[j] += sphereBasisMatrix(i,j);
         }
-        sphereIn.close();
     }
     else
         m_Normalize = false;
+
+    this->Superclass::BeforeThreadedGenerateData();
 }
 
 template <typename TInputPixelType, typename TOutputPixelType>
@@ -201,97 +199,110 @@ ODFEstimatorImageFilter<TInputPixelType,TOutputPixelType>
 ::ThreadedGenerateData(const OutputImageRegionType &outputRegionForThread, itk::ThreadIdType threadId)
 {
     typedef itk::ImageRegionConstIterator <TInputImage> InputIteratorType;
-    typedef itk::ImageRegionIterator <TOutputImage> OutputIteratorType;
+    typedef itk::ImageRegionConstIteratorWithIndex <MaskImageType> MaskIteratorType;
+    typedef typename TOutputImage::IndexType IndexType;
 
     unsigned int vectorLength = (m_LOrder + 1)*(m_LOrder + 2)/2;
     unsigned int numGrads = m_GradientIndexes.size();
     unsigned int numB0 = m_B0Indexes.size();
+    unsigned int numInputs = this->GetNumberOfIndexedInputs();
 
-    OutputIteratorType resIt(this->GetOutput(),outputRegionForThread);
-    InputIteratorType b0It(this->GetInput(0),outputRegionForThread);
-
-    std::vector<InputIteratorType> diffusionIt(this->GetNumberOfIndexedInputs());
-    for (unsigned int i = 0;i < this->GetNumberOfIndexedInputs();++i)
+    MaskIteratorType maskIt(this->GetComputationMask(),outputRegionForThread);
+    std::vector<InputIteratorType> diffusionIt(numInputs);
+    for (unsigned int i = 0;i < numInputs;++i)
         diffusionIt[i] = InputIteratorType(this->GetInput(i),outputRegionForThread);
 
+    // Voxels are gathered by blocks and reconstructed at once, outputs are already filled with zeros elsewhere
+    std::vector <IndexType> blockIndexes(m_ReconstructionBlockSize);
+    std::vector <double> blockB0Values(m_ReconstructionBlockSize,0);
+    vnl_matrix <double> signalBlock(m_ReconstructionBlockSize,numGrads);
+    vnl_matrix <double> coefficientsBlock(m_ReconstructionBlockSize,vectorLength);
+
     itk::VariableLengthVector <TOutputPixelType> outputData(vectorLength);
     std::vector <double> tmpData(numGrads,0);
-    while (!diffusionIt[0].IsAtEnd())
+    unsigned int blockSize = 0;
+    while (!maskIt.IsAtEnd())
     {
-        double b0Value = 0;
-        for (unsigned int i = 0;i < numB0;++i)
-        {
-            b0Value += diffusionIt[m_B0Indexes[i]].Get();
-            ++diffusionIt[m_B0Indexes[i]];
-        }
-
-        b0Value /= numB0;
-
-        for (unsigned int i = 0;i < numGrads;++i)
+        if (maskIt.Get() != 0)
         {
-            tmpData[i] = diffusionIt[m_GradientIndexes[i]].Get();
-            ++diffusionIt[m_GradientIndexes[i]];
-        }
+            double b0Value = 0;
+            for (unsigned int i = 0;i < numB0;++i)
+                b0Value += diffusionIt[m_B0Indexes[i]].Get();
 
-        for (unsigned int i = 0;i < vectorLength;++i)
-            outputData[i] = 0;
+            b0Value /= numB0;
 
-        if ((isZero(tmpData))||(b0Value <= 0))
-        {
-            resIt.Set(outputData);
-            ++resIt;
-            continue;
-        }
-
-        if (m_UseAganjEstimation)
-        {
             for (unsigned int i = 0;i < numGrads;++i)
+                tmpData[i] = diffusionIt[m_GradientIndexes[i]].Get();
+
+            if ((!isZero(tmpData))&&(b0Value > 0))
             {
-                double e = tmpData[i] / b0Value;
-
-                if (e < 0)
-                    tmpData[i] = m_DeltaAganjRegularization / 2.0;
-                else if (e < m_DeltaAganjRegularization)
-                    tmpData[i] = m_DeltaAganjRegularization / 2.0 + e * e / (2.0 * m_DeltaAganjRegularization);
-                else if (e < 1.0 - m_DeltaAganjRegularization)
-                    tmpData[i] = e;
-                else if (e < 1)
-                    tmpData[i] = 1.0 - m_DeltaAganjRegularization / 2.0 - (1.0 - e) * (1.0 - e) / (2.0 * m_DeltaAganjRegularization);
-                else
-                    tmpData[i] = 1.0 - m_DeltaAganjRegularization / 2.0;
+                if (m_UseAganjEstimation)
+                {
+                    for (unsigned int i = 0;i < numGrads;++i)
+                    {
+                        double e = tmpData[i] / b0Value;
+
+                        if (e < 0)
+                            tmpData[i] = m_DeltaAganjRegularization / 2.0;
+                        else if (e < m_DeltaAganjRegularization)
+                            tmpData[i] = m_DeltaAganjRegularization / 2.0 + e * e / (2.0 * m_DeltaAganjRegularization);
+                        else if (e < 1.0 - m_DeltaAganjRegularization)
+                            tmpData[i] = e;
+                        else if (e < 1)
+                            tmpData[i] = 1.0 - m_DeltaAganjRegularization / 2.0 - (1.0 - e) * (1.0 - e) / (2.0 * m_DeltaAganjRegularization);
+                        else
+                            tmpData[i] = 1.0 - m_DeltaAganjRegularization / 2.0;
+
+                        tmpData[i] = std::log(-std::log(tmpData[i]));
+                    }
+                }
+
+                for (unsigned int i = 0;i < numGrads;++i)
+                    signalBlock(blockSize,i) = tmpData[i];
 
-                tmpData[i] = std::log(-std::log(tmpData[i]));
+                blockIndexes[blockSize] = maskIt.GetIndex();
+                blockB0Values[blockSize] = b0Value;
+                ++blockSize;
             }
         }
 
-        if (b0Value > 0)
+        for (unsigned int i = 0;i < numInputs;++i)
+            ++diffusionIt[i];
+        ++maskIt;
+
+        if ((blockSize < m_ReconstructionBlockSize) && ((blockSize == 0) || (!maskIt.IsAtEnd())))
+            continue;
+
+        anima::ComputeBlockedMatrixTransposeProduct(blockSize,numGrads,vectorLength,signalBlock.data_block(),
+                                                    m_TMatrix.data_block(),coefficientsBlock.data_block());
+
+        for (unsigned int j = 0;j < blockSize;++j)
         {
             for (unsigned int i = 0;i < vectorLength;++i)
-                for (unsigned int j = 0;j < numGrads;++j)
-                    outputData[i] += m_TMatrix(i,j)*tmpData[j];
+                outputData[i] = coefficientsBlock(j,i);
 
             if (!m_UseAganjEstimation)
             {
                 for (unsigned int i = 0;i < vectorLength;++i)
-                    outputData[i] /= b0Value;
+                    outputData[i] /= blockB0Values[j];
             }
             else
                 outputData[0] = 1/(2*sqrt(M_PI));
-        }
 
-        if (m_Normalize)
-        {
-            long double integralODF = 0;
-            for (unsigned int i = 0;i < m_SphereSHSampling.size();++i)
-                for (unsigned int j = 0;j < vectorLength;++j)
-                    integralODF += m_SphereSHSampling[i][j]*outputData[j];
+            if (m_Normalize)
+            {
+                long double integralODF = 0;
+                for (unsigned int i = 0;i < vectorLength;++i)
+                    integralODF += m_SphereSHIntegral[i]*outputData[i];
 
-            for (unsigned int i = 0;i < vectorLength;++i)
-                outputData[i] /= integralODF;
+                for (unsigned int i = 0;i < vectorLength;++i)
+                    outputData[i] /= integralODF;
+            }
+
+            this->GetOutput()->SetPixel(blockIndexes[j],outputData);
         }
 
-        resIt.Set(outputData);
-        ++resIt;
+        blockSize = 0;
     }
 }
     
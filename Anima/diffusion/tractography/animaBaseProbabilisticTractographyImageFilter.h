@@ -8,11 +8,16 @@
 #include <itkProcessObject.h>
 #include <itkLinearInterpolateImageFunction.h>
 #include <itkFastMutexLock.h>
+#include <itkBarrier.h>
 #include <itkProgressReporter.h>
 
 #include <vector>
 #include <random>
 
+#include <animaStreamingFibersWriter.h>
+#include <animaPhiloxRandomGenerator.h>
+#include <animaWatsonDistribution.h>
+
 namespace anima
 {
 
@@ -66,10 +71,13 @@ public:
     typedef std::vector <FiberType> FiberProcessVectorType;
     typedef std::vector <unsigned int> MembershipType;
 
+    //! Counter-based generator, reset to a stream keyed by the seed index before tracking each seed
+    typedef anima::PhiloxRandomGenerator RandomGeneratorType;
+
     typedef struct {
         BaseProbabilisticTractographyImageFilter *trackerPtr;
-        std::vector <FiberProcessVectorType> resultFibersFromThreads;
-        std::vector <ListType> resultWeightsFromThreads;
+        std::vector <FiberProcessVectorType> resultFibersFromChunks;
+        std::vector <ListType> resultWeightsFromChunks;
     } trackerArguments;
 
     struct pair_comparator
@@ -109,9 +117,25 @@ public:
         Weight
     };
 
+    /**
+     * Particles are stored as a shared-prefix tree: all points live in a common pool, each pointing to its parent
+     * (the root points to itself) and each particle only knows the pool index of its last point (tip). Resampling
+     * then only copies tips, particles sharing their history share the corresponding points.
+     */
     struct FiberWorkType
     {
-        FiberProcessVectorType fiberParticles;
+        FiberType pointPool;
+        MembershipType pointParents;
+        MembershipType pointDepths;
+        MembershipType particleTips;
+        //! Pool size after last compaction, used to decide when to remove points no particle refers to anymore
+        unsigned int compactedPoolSize;
+
+        //! Work buffers for merges, pool sized, weights and flags are reset at the end of each merge
+        ListType pointWeights;
+        std::vector <bool> visitedPointFlags;
+        MembershipType visitedPoints;
+
         MembershipType classMemberships;
         std::vector <MembershipType> reverseClassMemberships;
         MembershipType classSizes;
@@ -120,6 +144,60 @@ public:
         std::vector <bool> stoppedParticles;
     };
 
+    //! Outcome of a propagation step for a particle, applied by the team leader
+    enum ParticleStepStatusType
+    {
+        ParticleInactive = 0,
+        ParticleStopped,
+        ParticleMoved
+    };
+
+    /**
+     * Particle set of a seed, shared by the threads of a team. Propagation is done by fixed size blocks of particles and
+     * resampling class by class, each with its own random substream: results do not depend on the number of threads.
+     * Team threads only write per particle entries, changes to the point pool and stop flags are applied by the leader.
+     */
+    struct ParticleSetWorkType
+    {
+        FiberWorkType fiberData;
+        DirectionVectorType previousDirections;
+        ListType logWeightVals;
+        ListType oldFiberWeights;
+
+        unsigned int seedIndex;
+        unsigned int iteration;
+        bool is2d;
+
+        //! Per particle step outputs
+        std::vector <VectorType> modelValues;
+        std::vector <ContinuousIndexType> tipIndexes;
+        FiberType newTipPoints;
+        std::vector <unsigned char> particleStatus;
+
+        //! Classes to resample at the current iteration
+        MembershipType resampledClasses;
+    };
+
+    //! Work handed by a team leader to its team
+    enum ParticleTeamTaskType
+    {
+        PropagateParticles = 0,
+        ResampleClasses,
+        TerminateTeam
+    };
+
+    //! Threads of the filter tracking a seed together: the leader runs ComputeFiber, others wait for its tasks
+    struct ParticleTeamType
+    {
+        itk::Barrier::Pointer barrier;
+        ParticleTeamTaskType task;
+        ParticleSetWorkType *workData;
+
+        //! Errors raised while executing a task, thrown again by the leader
+        itk::FastMutexLock::Pointer errorLock;
+        std::string errorDescription;
+    };
+
     void SetInitialColinearityDirection(const ColinearityDirectionType &colDir) {m_InitialColinearityDirection = colDir;}
     void SetInitialDirectionMode(const InitialDirectionModeType &dir) {m_InitialDirectionMode = dir;}
     itkGetMacro(InitialDirectionMode,InitialDirectionModeType)
@@ -158,6 +236,26 @@ public:
     itkSetMacro(ComputeLocalColors,bool)
     itkSetMacro(MAPMergeFibers,bool)
 
+    //! If true, seed voxels are processed along a Morton curve instead of raster order (default) for cache locality
+    itkSetMacro(MortonSeedOrdering,bool)
+
+    //! Key of the random streams (defaults to current time). Each seed draws from its own stream, results do not depend on threading
+    itkSetMacro(RandomSeed,unsigned int)
+    itkGetMacro(RandomSeed,unsigned int)
+
+    //! Restricts tracking to seeds [FirstSeedIndex, FirstSeedIndex + NumberOfSeedsToProcess) of the ordered seed list (0: all remaining)
+    itkSetMacro(FirstSeedIndex,unsigned int)
+    itkSetMacro(NumberOfSeedsToProcess,unsigned int)
+
+    /**
+     * Number of threads tracking the particles of a same seed (0, default: as many as possible when there are less seeds
+     * than threads, 1 otherwise). Remaining threads split seeds among them
+     */
+    itkSetMacro(NumberOfThreadsPerSeed,unsigned int)
+
+    //! If set, accepted fibers and their weights are pushed to this opened writer while tracking, output polydata stays empty
+    void SetStreamingWriter(anima::StreamingFibersWriter *writer) {m_StreamingWriter = writer;}
+
     itkSetMacro(MinimalNumberOfParticlesPerClass,unsigned int)
 
     itkSetMacro(ModelDimension, unsigned int)
@@ -175,43 +273,103 @@ protected:
     //! Multithread util function
     static ITK_THREAD_RETURN_TYPE ThreadTracker(void *arg);
 
-    //! Doing the thread work dispatch
-    void ThreadTrack(unsigned int numThread, FiberProcessVectorType &resultFibers, ListType &resultWeights);
+    //! Doing the thread work dispatch, results are stored per seed chunk so that their output order does not depend on threading
+    void ThreadTrack(unsigned int numThread, std::vector <FiberProcessVectorType> &resultFibers,
+                     std::vector <ListType> &resultWeights);
 
     //! Doing the real tracking by calling ComputeFiber and merging its results
     void ThreadedTrackComputer(unsigned int numThread, FiberProcessVectorType &resultFibers,
                                ListType &resultWeights, unsigned int startSeedIndex,
                                unsigned int endSeedIndex);
 
-    //! This little guy is the one handling probabilistic tracking
+    //! This little guy is the one handling probabilistic tracking, seedIndex keys its random substreams
     FiberProcessVectorType ComputeFiber(FiberType &fiber, InterpolatorPointer &modelInterpolator,
-                                        unsigned int numThread, ListType &resultWeights);
+                                        unsigned int numThread, unsigned int seedIndex, ListType &resultWeights);
+
+    //! Loop of non leader team threads: executes tasks of the team leader until it terminates the team
+    void ParticleTeamWorker(unsigned int numThread);
+
+    //! Runs a task on all threads of the team led by numThread, the leader taking its share. Returns when all are done
+    void RunParticleTeamTask(unsigned int numThread, ParticleTeamTaskType task, ParticleSetWorkType &workData,
+                             InterpolatorPointer &modelInterpolator);
+
+    //! Executes the share of a team task of the thread of given rank in its team
+    void ExecuteParticleTeamTask(ParticleTeamType &team, unsigned int rank, unsigned int numThread,
+                                 InterpolatorPointer &modelInterpolator);
+
+    //! Propagates one block of particles by one step: model at tips, stopping criteria, proposal, move and weight update
+    void PropagateParticleBlock(ParticleSetWorkType &workData, unsigned int blockIndex,
+                                InterpolatorPointer &modelInterpolator, unsigned int numThread);
+
+    //! Resamples the particles of a class from their weights
+    void ResampleParticleClass(ParticleSetWorkType &workData, unsigned int classIndex);
+
+    //! Random substream of a particle block or a resampled class at an iteration, substream 0 is left to serial draws of the seed
+    unsigned int GetParticleRandomSubstream(unsigned int iteration, unsigned int index, bool resampling)
+    {
+        return 1 + 2 * (iteration * m_NumberOfParticles + index) + (resampling ? 1 : 0);
+    }
+
+    //! Number of seeds handed at once to a team
+    unsigned int GetSeedChunkSize();
 
     //! Generate seed points (can be re-implemented but this one has to be called)
     virtual void PrepareTractography();
 
     //! This ugly guy is the heart of multi-modal probabilistic tractography, making decisions on split and merges of particles
-    unsigned int UpdateClassesMemberships(FiberWorkType &fiberData, DirectionVectorType &directions, std::mt19937 &random_generator);
+    unsigned int UpdateClassesMemberships(FiberWorkType &fiberData, DirectionVectorType &directions, RandomGeneratorType &random_generator);
 
     //! This guy takes the result of computefiber and merges the classes, each one becomes one fiber
     // Returns in outputMerged several fibers, as of now if there are active particles it returns only the merge of those, and returns true.
     // Otherwise, returns false and a merge per stopped fiber lengths
     bool MergeParticleClassFibers(FiberWorkType &fiberData, FiberProcessVectorType &outputMerged, unsigned int classNumber);
 
+    //! Adds a point at the tip of a particle in the shared point pool
+    void AppendParticlePoint(FiberWorkType &fiberData, unsigned int particleIndex, const PointType &point);
+
+    //! Rebuilds the full fiber of a particle from the shared point pool
+    void GetParticleFiber(const FiberWorkType &fiberData, unsigned int particleIndex, FiberType &fiber);
+
+    /**
+     * Weighted sum of particle fibers, point by point from the seed, particles with non positive weights ignored.
+     * Shared prefixes are visited once: tip weights are accumulated on parents, in decreasing pool index order
+     * (a parent is always stored before its children).
+     */
+    void ComputeParticlesWeightedSum(FiberWorkType &fiberData, const MembershipType &particleIndexes,
+                                     const ListType &weights, FiberType &sumFiber);
+
+    //! Removes from the point pool all points that are not on the path of a particle anymore
+    void CompactParticlePointPool(FiberWorkType &fiberData);
+
     //! Filter output fibers by ROIs and compute local colors
     FiberProcessVectorType FilterOutputFibers(FiberProcessVectorType &fibers, ListType &weights);
 
     //! Propose new direction for a particle, given the old direction, and a model (model dependent, not implemented here)
     virtual Vector3DType ProposeNewDirection(Vector3DType &oldDirection, VectorType &modelValue,
                                              Vector3DType &sampling_direction, double &log_prior, double &log_proposal,
-                                             std::mt19937 &random_generator, unsigned int threadId) = 0;
+                                             RandomGeneratorType &random_generator, unsigned int threadId) = 0;
+
+    /**
+     * Proposes new directions for the active particles of a block at once (outputs indexed as activeParticles), returning prior and
+     * proposal log-densities. Tip indexes, old directions and model values are indexed by particle. Calls ProposeNewDirection
+     * for each particle: models may re-implement it with batched samplers, and have to if ProposeNewDirection relies on
+     * thread state set by ComputeModelValue (it is then the one of the last active particle)
+     */
+    virtual void ProposeNewDirections(const MembershipType &activeParticles, std::vector <ContinuousIndexType> &tipIndexes,
+                                      DirectionVectorType &oldDirections, std::vector <VectorType> &modelValues,
+                                      DirectionVectorType &samplingDirections, ListType &logPriors, ListType &logProposals,
+                                      DirectionVectorType &newDirections, RandomGeneratorType &random_generator, unsigned int threadId);
+
+    //! Watson log-normalizers cache of a thread, for batched samplers
+    anima::WatsonLogNormalizerCache &GetWatsonNormalizerCache(unsigned int threadId) {return m_WatsonNormalizerCaches[threadId];}
 
     //! Update particle weight based on an underlying model and the chosen direction (model dependent, not implemented here)
     virtual double ComputeLogWeightUpdate(double b0Value, double noiseValue, Vector3DType &newDirection, VectorType &modelValue,
                                           double &log_prior, double &log_proposal, unsigned int threadId) = 0;
 
     //! Estimate model from raw diffusion data (model dependent, not implemented here)
-    virtual void ComputeModelValue(InterpolatorPointer &modelInterpolator, ContinuousIndexType &index, VectorType &modelValue) = 0;
+    virtual void ComputeModelValue(InterpolatorPointer &modelInterpolator, ContinuousIndexType &index, VectorType &modelValue,
+                                   unsigned int threadId) = 0;
 
     //! Initialize first direction from user input (model dependent, not implemented here)
     virtual Vector3DType InitializeFirstIterationFromModel(Vector3DType &colinearDir, VectorType &modelValue, unsigned int threadId) = 0;
@@ -253,7 +411,16 @@ private:
     ScalarImagePointer m_B0Image, m_NoiseImage;
     ScalarInterpolatorPointer m_B0Interpolator, m_NoiseInterpolator;
 
-    std::vector <std::mt19937> m_Generators;
+    std::vector <RandomGeneratorType> m_Generators;
+    std::vector <anima::WatsonLogNormalizerCache> m_WatsonNormalizerCaches;
+    unsigned int m_RandomSeed;
+    unsigned int m_FirstSeedIndex, m_NumberOfSeedsToProcess;
+
+    //! Particles are propagated by blocks of this size, independent of the number of threads for reproducibility
+    unsigned int m_ParticleBlockSize;
+    unsigned int m_NumberOfThreadsPerSeed;
+    unsigned int m_ParticleTeamSize;
+    std::vector <ParticleTeamType> m_ParticleTeams;
 
     ColinearityDirectionType m_InitialColinearityDirection;
     InitialDirectionModeType m_InitialDirectionMode;
@@ -270,8 +437,10 @@ private:
 
     bool m_MAPMergeFibers;
     bool m_ComputeLocalColors;
+    bool m_MortonSeedOrdering;
 
     vtkSmartPointer<vtkPolyData> m_Output;
+    anima::StreamingFibersWriter *m_StreamingWriter;
 
     itk::SimpleFastMutexLock m_LockHighestProcessedSeed;
     int m_HighestProcessedSeed;
@@ -7,10 +7,12 @@
 #include <itkImageRegionConstIterator.h>
 #include <itkExtractImageFilter.h>
 #include <itkMultiThreader.h>
+#include <itkMutexLockHolder.h>
 #include <itkImageMomentsCalculator.h>
 
 #include <animaVectorOperations.h>
 #include <animaLogarithmFunctions.h>
+#include <animaSeedOrdering.h>
 
 #include <vnl/algo/vnl_matrix_inverse.h>
 
@@ -21,6 +23,8 @@
 #include <animaKMeansFilter.h>
 
 #include <ctime>
+#include <algorithm>
+#include <functional>
 
 namespace anima
 {
@@ -50,12 +54,21 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
     m_ClusterDistance = 1;
 
     m_ComputeLocalColors = true;
+    m_MortonSeedOrdering = false;
     m_MAPMergeFibers = true;
+    m_StreamingWriter = 0;
 
     m_InitialColinearityDirection = Center;
     m_InitialDirectionMode = Weight;
 
     m_Generators.clear();
+    m_RandomSeed = time(0);
+    m_FirstSeedIndex = 0;
+    m_NumberOfSeedsToProcess = 0;
+
+    m_ParticleBlockSize = 64;
+    m_NumberOfThreadsPerSeed = 0;
+    m_ParticleTeamSize = 1;
 
     m_HighestProcessedSeed = 0;
     m_ProgressReport = 0;
@@ -74,15 +87,46 @@ void
 BaseProbabilisticTractographyImageFilter <TInputModelImageType>
 ::Update()
 {
+    // The multi-threader may run less threads than asked: teams, barriers and per thread data are built for its count
+    this->GetMultiThreader()->SetNumberOfThreads(this->GetNumberOfThreads());
+    this->SetNumberOfThreads(this->GetMultiThreader()->GetNumberOfThreads());
+
     this->PrepareTractography();
     m_Output = vtkPolyData::New();
 
     if (m_ProgressReport)
         delete m_ProgressReport;
 
-    unsigned int stepData = std::min((int)m_PointsToProcess.size(),100);
-    if (stepData == 0)
-        stepData = 1;
+    // Threads are grouped in teams tracking the particles of a seed together, so that all work when seeds are few
+    unsigned int numThreads = this->GetMultiThreader()->GetNumberOfThreads();
+    m_ParticleTeamSize = m_NumberOfThreadsPerSeed;
+    if (m_ParticleTeamSize == 0)
+    {
+        m_ParticleTeamSize = 1;
+        if ((m_PointsToProcess.size() > 0) && (m_PointsToProcess.size() < numThreads))
+            m_ParticleTeamSize = numThreads / m_PointsToProcess.size();
+    }
+
+    // Threads beyond the number of particle blocks would have nothing to do
+    unsigned int numParticleBlocks = (m_NumberOfParticles + m_ParticleBlockSize - 1) / m_ParticleBlockSize;
+    m_ParticleTeamSize = std::min(m_ParticleTeamSize,std::min(numParticleBlocks,numThreads));
+    if (m_ParticleTeamSize == 0)
+        m_ParticleTeamSize = 1;
+
+    m_ParticleTeams = std::vector <ParticleTeamType> (numThreads / m_ParticleTeamSize);
+    for (unsigned int i = 0;i < m_ParticleTeams.size();++i)
+    {
+        m_ParticleTeams[i].barrier = itk::Barrier::New();
+        m_ParticleTeams[i].barrier->Initialize(m_ParticleTeamSize);
+        m_ParticleTeams[i].task = TerminateTeam;
+        m_ParticleTeams[i].workData = 0;
+        m_ParticleTeams[i].errorLock = itk::FastMutexLock::New();
+    }
+
+    if (m_ParticleTeamSize > 1)
+        std::cout << "Tracking with " << m_ParticleTeams.size() << " teams of " << m_ParticleTeamSize << " threads per seed" << std::endl;
+
+    unsigned int stepData = this->GetSeedChunkSize();
 
     unsigned int numSteps = std::floor(m_PointsToProcess.size() / (float)stepData);
     if (m_PointsToProcess.size() % stepData != 0)
@@ -95,23 +139,23 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
 
     trackerArguments tmpStr;
     tmpStr.trackerPtr = this;
-    tmpStr.resultFibersFromThreads.resize(this->GetNumberOfThreads());
-    tmpStr.resultWeightsFromThreads.resize(this->GetNumberOfThreads());
+    tmpStr.resultFibersFromChunks.resize(numSteps);
+    tmpStr.resultWeightsFromChunks.resize(numSteps);
 
-    for (unsigned int i = 0;i < this->GetNumberOfThreads();++i)
-    {
-        tmpStr.resultFibersFromThreads[i] = resultFibers;
-        tmpStr.resultWeightsFromThreads[i] = resultWeights;
-    }
-
-    this->GetMultiThreader()->SetNumberOfThreads(this->GetNumberOfThreads());
     this->GetMultiThreader()->SetSingleMethod(this->ThreadTracker,&tmpStr);
     this->GetMultiThreader()->SingleMethodExecute();
 
-    for (unsigned int j = 0;j < this->GetNumberOfThreads();++j)
+    // Fibers were filtered and handed to the writer by tracking threads, they are counted once the writer is closed
+    if (m_StreamingWriter)
+    {
+        std::cout << std::endl;
+        return;
+    }
+
+    for (unsigned int j = 0;j < numSteps;++j)
     {
-        resultFibers.insert(resultFibers.end(),tmpStr.resultFibersFromThreads[j].begin(),tmpStr.resultFibersFromThreads[j].end());
-        resultWeights.insert(resultWeights.end(),tmpStr.resultWeightsFromThreads[j].begin(),tmpStr.resultWeightsFromThreads[j].end());
+        resultFibers.insert(resultFibers.end(),tmpStr.resultFibersFromChunks[j].begin(),tmpStr.resultFibersFromChunks[j].end());
+        resultWeights.insert(resultWeights.end(),tmpStr.resultWeightsFromChunks[j].begin(),tmpStr.resultWeightsFromChunks[j].end());
     }
 
     std::cout << "\nKept " << resultFibers.size() << " fibers after filtering" << std::endl;
@@ -135,13 +179,10 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
     m_NoiseInterpolator = ScalarInterpolatorType::New();
     m_NoiseInterpolator->SetInputImage(m_NoiseImage);
 
-    // Initialize random generator
+    // One generator per thread, switched to the stream of each seed before tracking it
     m_Generators.resize(this->GetNumberOfThreads());
-
-    std::mt19937 motherGenerator(time(0));
-
-    for (unsigned int i = 0;i < this->GetNumberOfThreads();++i)
-        m_Generators[i] = std::mt19937(motherGenerator());
+    m_WatsonNormalizerCaches.resize(this->GetNumberOfThreads());
+    std::cout << "Random seed: " << m_RandomSeed << std::endl;
 
     bool is2d = m_InputModelImage->GetLargestPossibleRegion().GetSize()[2] == 1;
     if (is2d && (m_InitialColinearityDirection == Top))
@@ -200,15 +241,22 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
         }
     }
 
+    std::vector <IndexType> seedIndexes;
     while (!maskItr.IsAtEnd())
     {
-        if (maskItr.Get() == 0)
-        {
-            ++maskItr;
-            continue;
-        }
+        if (maskItr.Get() != 0)
+            seedIndexes.push_back(maskItr.GetIndex());
 
-        tmpIndex = maskItr.GetIndex();
+        ++maskItr;
+    }
+
+    // Seeds of a voxel stay consecutive, so that thread chunks are compact bricks along the curve
+    if (m_MortonSeedOrdering)
+        anima::SortIndexesAlongMortonCurve(seedIndexes);
+
+    for (unsigned int s = 0;s < seedIndexes.size();++s)
+    {
+        tmpIndex = seedIndexes[s];
 
         if (is2d)
         {
@@ -244,11 +292,23 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
                 }
             }
         }
-
-        ++maskItr;
     }
 
     std::cout << "Generated " << m_PointsToProcess.size() << " seed points from ROI mask" << std::endl;
+
+    if ((m_FirstSeedIndex == 0)&&(m_NumberOfSeedsToProcess == 0))
+        return;
+
+    unsigned int totalNumberOfSeeds = m_PointsToProcess.size();
+    unsigned int firstSeed = std::min(m_FirstSeedIndex,totalNumberOfSeeds);
+    unsigned int endSeed = totalNumberOfSeeds;
+    if ((m_NumberOfSeedsToProcess != 0)&&(m_NumberOfSeedsToProcess < endSeed - firstSeed))
+        endSeed = firstSeed + m_NumberOfSeedsToProcess;
+
+    m_PointsToProcess.erase(m_PointsToProcess.begin() + endSeed,m_PointsToProcess.end());
+    m_PointsToProcess.erase(m_PointsToProcess.begin(),m_PointsToProcess.begin() + firstSeed);
+
+    std::cout << "Tracking seeds " << firstSeed << " to " << endSeed << " out of " << totalNumberOfSeeds << std::endl;
 }
 
 template <class TInputModelImageType>
@@ -273,7 +333,7 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
     unsigned int nbThread = threadArgs->ThreadID;
 
     trackerArguments *tmpArg = (trackerArguments *)threadArgs->UserData;
-    tmpArg->trackerPtr->ThreadTrack(nbThread,tmpArg->resultFibersFromThreads[nbThread],tmpArg->resultWeightsFromThreads[nbThread]);
+    tmpArg->trackerPtr->ThreadTrack(nbThread,tmpArg->resultFibersFromChunks,tmpArg->resultWeightsFromChunks);
 
     return NULL;
 }
@@ -281,15 +341,25 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
 template <class TInputModelImageType>
 void
 BaseProbabilisticTractographyImageFilter <TInputModelImageType>
-::ThreadTrack(unsigned int numThread, FiberProcessVectorType &resultFibers,
-              ListType &resultWeights)
+::ThreadTrack(unsigned int numThread, std::vector <FiberProcessVectorType> &resultFibers,
+              std::vector <ListType> &resultWeights)
 {
+    // Threads left out of teams have nothing to do, team members other than leaders wait for particle tasks
+    unsigned int teamIndex = numThread / m_ParticleTeamSize;
+    if (teamIndex >= m_ParticleTeams.size())
+        return;
+
+    if (numThread % m_ParticleTeamSize != 0)
+    {
+        this->ParticleTeamWorker(numThread);
+        return;
+    }
+
     bool continueLoop = true;
     unsigned int highestToleratedSeedIndex = m_PointsToProcess.size();
+    unsigned int stepData = this->GetSeedChunkSize();
 
-    unsigned int stepData = std::min((int)m_PointsToProcess.size(),100);
-    if (stepData == 0)
-        stepData = 1;
+    std::string trackingError = "";
 
     while (continueLoop)
     {
@@ -311,12 +381,42 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
 
         m_LockHighestProcessedSeed.Unlock();
 
-        this->ThreadedTrackComputer(numThread,resultFibers,resultWeights,startPoint,endPoint);
+        unsigned int chunkIndex = startPoint / stepData;
 
-        m_LockHighestProcessedSeed.Lock();
-        m_ProgressReport->CompletedPixel();
-        m_LockHighestProcessedSeed.Unlock();
+        // Any error (including an abort from the progress reporter) stops the leader, its team is released below
+        try
+        {
+            this->ThreadedTrackComputer(numThread,resultFibers[chunkIndex],resultWeights[chunkIndex],startPoint,endPoint);
+
+            // Progress may throw on abort, the holder releases the lock in that case
+            itk::MutexLockHolder <itk::SimpleFastMutexLock> progressHolder(m_LockHighestProcessedSeed);
+            m_ProgressReport->CompletedPixel();
+        }
+        catch (itk::ExceptionObject &e)
+        {
+            trackingError = e.GetDescription();
+        }
+        catch (std::exception &e)
+        {
+            trackingError = e.what();
+        }
+        catch (...)
+        {
+            trackingError = "Unknown error while tracking";
+        }
+
+        if (trackingError != "")
+            break;
     }
+
+    // Release team members, even on error, before returning
+    ParticleTeamType &team = m_ParticleTeams[teamIndex];
+    team.task = TerminateTeam;
+    if (m_ParticleTeamSize > 1)
+        team.barrier->Wait();
+
+    if (trackingError != "")
+        itkExceptionMacro(<< trackingError);
 }
 
 template <class TInputModelImageType>
@@ -335,13 +435,20 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
     {
         m_SeedMask->TransformPhysicalPointToContinuousIndex(m_PointsToProcess[i][0],startIndex);
 
-        tmpFibers = this->ComputeFiber(m_PointsToProcess[i], modelInterpolator, numThread, tmpWeights);
+        // Seed indexes are global (before any range restriction) so that split runs reproduce a full one
+        m_Generators[numThread].SetStream(m_RandomSeed,m_FirstSeedIndex + i);
+        tmpFibers = this->ComputeFiber(m_PointsToProcess[i], modelInterpolator, numThread, m_FirstSeedIndex + i, tmpWeights);
 
         tmpFibers = this->FilterOutputFibers(tmpFibers, tmpWeights);
 
         for (unsigned int j = 0;j < tmpFibers.size();++j)
         {
-            if (tmpFibers[j].size() > m_MinLengthFiber / m_StepProgression)
+            if (tmpFibers[j].size() <= m_MinLengthFiber / m_StepProgression)
+                continue;
+
+            if (m_StreamingWriter)
+                m_StreamingWriter->AddFiber(tmpFibers[j],tmpWeights[j]);
+            else
             {
                 resultFibers.push_back(tmpFibers[j]);
                 resultWeights.push_back(tmpWeights[j]);
@@ -350,6 +457,116 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
     }
 }
 
+template <class TInputModelImageType>
+unsigned int
+BaseProbabilisticTractographyImageFilter <TInputModelImageType>
+::GetSeedChunkSize()
+{
+    // Chunks are small enough for every team to get one
+    unsigned int numTeams = std::max((int)m_ParticleTeams.size(),1);
+    unsigned int stepData = std::min((int)((m_PointsToProcess.size() + numTeams - 1) / numTeams),100);
+    if (stepData == 0)
+        stepData = 1;
+
+    return stepData;
+}
+
+template <class TInputModelImageType>
+void
+BaseProbabilisticTractographyImageFilter <TInputModelImageType>
+::ParticleTeamWorker(unsigned int numThread)
+{
+    ParticleTeamType &team = m_ParticleTeams[numThread / m_ParticleTeamSize];
+    unsigned int rank = numThread % m_ParticleTeamSize;
+    InterpolatorPointer modelInterpolator = this->GetModelInterpolator();
+
+    while (true)
+    {
+        // Wait for the leader to publish a task
+        team.barrier->Wait();
+        if (team.task == TerminateTeam)
+            break;
+
+        this->ExecuteParticleTeamTask(team,rank,numThread,modelInterpolator);
+        team.barrier->Wait();
+    }
+}
+
+template <class TInputModelImageType>
+void
+BaseProbabilisticTractographyImageFilter <TInputModelImageType>
+::RunParticleTeamTask(unsigned int numThread, ParticleTeamTaskType task, ParticleSetWorkType &workData,
+                      InterpolatorPointer &modelInterpolator)
+{
+    ParticleTeamType &team = m_ParticleTeams[numThread / m_ParticleTeamSize];
+    team.task = task;
+    team.workData = &workData;
+    team.errorDescription = "";
+
+    if (m_ParticleTeamSize > 1)
+        team.barrier->Wait();
+
+    this->ExecuteParticleTeamTask(team,0,numThread,modelInterpolator);
+
+    if (m_ParticleTeamSize > 1)
+        team.barrier->Wait();
+
+    if (team.errorDescription != "")
+        itkExceptionMacro(<< team.errorDescription);
+}
+
+template <class TInputModelImageType>
+void
+BaseProbabilisticTractographyImageFilter <TInputModelImageType>
+::ExecuteParticleTeamTask(ParticleTeamType &team, unsigned int rank, unsigned int numThread,
+                          InterpolatorPointer &modelInterpolator)
+{
+    ParticleSetWorkType &workData = *team.workData;
+
+    // Errors are kept for the leader, a thread leaving now would block the team on its barrier
+    try
+    {
+        switch (team.task)
+        {
+            case PropagateParticles:
+            {
+                // Blocks are interleaved between threads, balancing regions where many particles stop
+                unsigned int numBlocks = (m_NumberOfParticles + m_ParticleBlockSize - 1) / m_ParticleBlockSize;
+                for (unsigned int b = rank;b < numBlocks;b += m_ParticleTeamSize)
+                    this->PropagateParticleBlock(workData,b,modelInterpolator,numThread);
+                break;
+            }
+
+            case ResampleClasses:
+                for (unsigned int c = rank;c < workData.resampledClasses.size();c += m_ParticleTeamSize)
+                    this->ResampleParticleClass(workData,workData.resampledClasses[c]);
+                break;
+
+            case TerminateTeam:
+            default:
+                break;
+        }
+    }
+    catch (itk::ExceptionObject &e)
+    {
+        team.errorLock->Lock();
+        team.errorDescription = e.GetDescription();
+        team.errorLock->Unlock();
+    }
+    catch (std::exception &e)
+    {
+        team.errorLock->Lock();
+        team.errorDescription = e.what();
+        team.errorLock->Unlock();
+    }
+    catch (...)
+    {
+        team.errorLock->Lock();
+        team.errorDescription = "Unknown error in particle team task";
+        team.errorLock->Unlock();
+    }
+}
+
 template <class TInputModelImageType>
 typename BaseProbabilisticTractographyImageFilter <TInputModelImageType>::FiberProcessVectorType
 BaseProbabilisticTractographyImageFilter <TInputModelImageType>
@@ -521,14 +738,27 @@ template <class TInputModelImageType>
 typename BaseProbabilisticTractographyImageFilter <TInputModelImageType>::FiberProcessVectorType
 BaseProbabilisticTractographyImageFilter <TInputModelImageType>
 ::ComputeFiber(FiberType &fiber, InterpolatorPointer &modelInterpolator,
-               unsigned int numThread, ListType &resultWeights)
+               unsigned int numThread, unsigned int seedIndex, ListType &resultWeights)
 {
     unsigned int numberOfClasses = 1;
 
-    FiberWorkType fiberComputationData;
-    fiberComputationData.fiberParticles.resize(m_NumberOfParticles);
-    for (unsigned int i = 0;i < m_NumberOfParticles;++i)
-        fiberComputationData.fiberParticles[i] = fiber;
+    // Particle set shared with the threads of the team
+    ParticleSetWorkType particleSetData;
+    FiberWorkType &fiberComputationData = particleSetData.fiberData;
+    DirectionVectorType &previousDirections = particleSetData.previousDirections;
+    ListType &logWeightVals = particleSetData.logWeightVals;
+    ListType &oldFiberWeights = particleSetData.oldFiberWeights;
+
+    // All particles start from the seed fiber, stored once in the point pool
+    for (unsigned int i = 0;i < fiber.size();++i)
+    {
+        fiberComputationData.pointPool.push_back(fiber[i]);
+        fiberComputationData.pointParents.push_back((i > 0) ? i - 1 : 0);
+        fiberComputationData.pointDepths.push_back(i);
+    }
+
+    fiberComputationData.particleTips = MembershipType(m_NumberOfParticles,fiber.size() - 1);
+    fiberComputationData.compactedPoolSize = fiber.size();
 
     fiberComputationData.particleWeights = ListType(m_NumberOfParticles, 1.0 / m_NumberOfParticles);
     fiberComputationData.stoppedParticles = std::vector <bool> (m_NumberOfParticles,false);
@@ -542,38 +772,32 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
         tmpVec[j] = j;
     fiberComputationData.reverseClassMemberships[0] = tmpVec;
 
-    ListType logWeightVals(m_NumberOfParticles, 1.0 / m_NumberOfParticles);
-    ListType oldFiberWeights(m_NumberOfParticles, 1.0 / m_NumberOfParticles);
+    logWeightVals = ListType(m_NumberOfParticles, 1.0 / m_NumberOfParticles);
+    oldFiberWeights = ListType(m_NumberOfParticles, 1.0 / m_NumberOfParticles);
     std::vector <bool> emptyClasses;
     ListType tmpVector(m_NumberOfParticles,0);
 
     ListType logWeightSums(numberOfClasses,0);
     ListType effectiveNumberOfParticles(numberOfClasses,0);
 
-    DirectionVectorType previousDirections(m_NumberOfParticles);
-
-    // Data structures for resampling
-    FiberProcessVectorType fiberParticlesCopy;
-    DirectionVectorType previousDirectionsCopy;
-    ListType weightSpecificClassValues;
-    FiberProcessVectorType fiberTrash;
-    std::vector <bool> usedFibers;
+    previousDirections.resize(m_NumberOfParticles);
 
     // Here to constrain directions to 2D plane if needed
-    bool is2d = m_InputModelImage->GetLargestPossibleRegion().GetSize()[2] == 1;
+    particleSetData.is2d = m_InputModelImage->GetLargestPossibleRegion().GetSize()[2] == 1;
+    particleSetData.seedIndex = seedIndex;
 
     VectorType modelValue(m_ModelDimension);
-
-    Vector3DType sampling_direction(0.0), newDirection;
-    PointType currentPoint;
-    ContinuousIndexType currentIndex, newIndex;
-    IndexType closestIndex;
+    particleSetData.modelValues = std::vector <VectorType> (m_NumberOfParticles,modelValue);
+    particleSetData.tipIndexes.resize(m_NumberOfParticles);
+    particleSetData.newTipPoints.resize(m_NumberOfParticles);
+    particleSetData.particleStatus.resize(m_NumberOfParticles);
 
     unsigned int numIter = 0;
     bool stopLoop = false;
     while (!stopLoop)
     {
         ++numIter;
+        particleSetData.iteration = numIter;
 
         // Store previous weights for the resampling step
         if (numIter > 1)
@@ -581,128 +805,19 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
 
         logWeightSums.resize(numberOfClasses);
         std::fill(logWeightSums.begin(),logWeightSums.end(),0.0);
-        for (unsigned int i = 0;i < m_NumberOfParticles;++i)
-        {
-            // Do not compute trashed fibers
-            if (fiberComputationData.stoppedParticles[i])
-                continue;
-
-            currentPoint = fiberComputationData.fiberParticles[i].back();
-
-            m_SeedMask->TransformPhysicalPointToContinuousIndex(currentPoint,currentIndex);
-
-            // Trash fiber if it goes outside of the brain
-            if (!modelInterpolator->IsInsideBuffer(currentIndex))
-            {
-                fiberComputationData.stoppedParticles[i] = true;
-                fiberComputationData.particleWeights[i] = 0;
-                continue;
-            }
-
-            // Trash fiber if it goes through the cut mask
-            m_SeedMask->TransformPhysicalPointToIndex(currentPoint,closestIndex);
-
-            if (m_CutMask)
-            {
-                if (m_CutMask->GetPixel(closestIndex) != 0)
-                {
-                    fiberComputationData.stoppedParticles[i] = true;
-                    fiberComputationData.particleWeights[i] = 0;
-                    continue;
-                }
-            }
-
-            // Computes diffusion information at current position
-            modelValue.Fill(0.0);
-            double estimatedNoiseValue = 20.0;
-            this->ComputeModelValue(modelInterpolator, currentIndex, modelValue);
-            double estimatedB0Value = m_B0Interpolator->EvaluateAtContinuousIndex(currentIndex);
-            estimatedNoiseValue = m_NoiseInterpolator->EvaluateAtContinuousIndex(currentIndex);
-
-            if (!this->CheckModelProperties(estimatedB0Value,estimatedNoiseValue,modelValue,numThread))
-            {
-                fiberComputationData.stoppedParticles[i] = true;
-                fiberComputationData.particleWeights[i] = 0;
-                continue;
-            }
 
-            // Set initial direction to the principal eigenvector of the tensor
-            if (numIter == 1)
-            {
-                Vector3DType initDir(0.0);
-                switch (m_InitialColinearityDirection)
-                {
-                    case Top:
-                        initDir[2] = 1;
-                        break;
-                    case Bottom:
-                        initDir[2] = -1;
-                        break;
-                    case Left:
-                        initDir[0] = -1;
-                        break;
-                    case Right:
-                        initDir[0] = 1;
-                        break;
-                    case Front:
-                        initDir[1] = -1;
-                        break;
-                    case Back:
-                        initDir[1] = 1;
-                        break;
-                    case Outward:
-                        for (unsigned int j = 0;j < InputModelImageType::ImageDimension;++j)
-                            initDir[j] = currentPoint[j] - m_DWIGravityCenter[j];
-                        break;
-                    case Center:
-                    default:
-                        for (unsigned int j = 0;j < InputModelImageType::ImageDimension;++j)
-                            initDir[j] = m_DWIGravityCenter[j] - currentPoint[j];
-                        break;
-                }
-
-                if (is2d)
-                    initDir[2] = 0;
-                initDir.Normalize();
-
-                previousDirections[i] = this->InitializeFirstIterationFromModel(initDir,modelValue,numThread);
-            }
-
-            // Propose a new direction based on the previous one and the diffusion information at current position
-            double log_prior = 0, log_proposal = 0;
-            newDirection = this->ProposeNewDirection(previousDirections[i], modelValue, sampling_direction, log_prior,
-                                                     log_proposal, m_Generators[numThread], numThread);
+        // Particle blocks are moved by the team, the point pool and stop flags are then updated in particle order
+        this->RunParticleTeamTask(numThread,PropagateParticles,particleSetData,modelInterpolator);
 
-            // Update the position of the particle
-            for (unsigned int j = 0;j < InputModelImageType::ImageDimension;++j)
-                currentPoint[j] += m_StepProgression * newDirection[j];
-
-            // Log-weight update must be done at new position (except for prior and proposal)
-            m_SeedMask->TransformPhysicalPointToContinuousIndex(currentPoint,newIndex);
-
-            // Set the new proposed direction as the current direction
-            previousDirections[i] = newDirection;
-
-            modelValue.Fill(0.0);
-
-            if (!modelInterpolator->IsInsideBuffer(newIndex))
+        for (unsigned int i = 0;i < m_NumberOfParticles;++i)
+        {
+            if (particleSetData.particleStatus[i] == ParticleStopped)
             {
                 fiberComputationData.stoppedParticles[i] = true;
                 fiberComputationData.particleWeights[i] = 0;
-                continue;
             }
-
-            fiberComputationData.fiberParticles[i].push_back(currentPoint);
-
-            this->ComputeModelValue(modelInterpolator, newIndex, modelValue);
-            estimatedB0Value = m_B0Interpolator->EvaluateAtContinuousIndex(newIndex);
-            estimatedNoiseValue = m_NoiseInterpolator->EvaluateAtContinuousIndex(newIndex);
-
-            // Update the weight of the particle
-            double updateWeightLogVal = this->ComputeLogWeightUpdate(estimatedB0Value, estimatedNoiseValue, newDirection,
-                                                                     modelValue, log_prior, log_proposal, numThread);
-
-            logWeightVals[i] = updateWeightLogVal + anima::safe_log(oldFiberWeights[i]);
+            else if (particleSetData.particleStatus[i] == ParticleMoved)
+                this->AppendParticlePoint(fiberComputationData,i,particleSetData.newTipPoints[i]);
         }
 
         // Continue only if some particles are still moving
@@ -794,6 +909,7 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
             effectiveNumberOfParticles[fiberComputationData.classMemberships[i]] += weight * weight;
         }
 
+        particleSetData.resampledClasses.clear();
         for (unsigned int m = 0;m < numberOfClasses;++m)
         {
             if (effectiveNumberOfParticles[m] != 0)
@@ -801,60 +917,23 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
             else
                 continue; // Q: shouldn't we be treating this case as an empty cluster that shouldn't even exist? (same as previous Q)
 
-            // Actual class resampling
             if (effectiveNumberOfParticles[m] < m_ResamplingThreshold * fiberComputationData.classSizes[m])
-            {
-                weightSpecificClassValues.resize(fiberComputationData.classSizes[m]);
-                previousDirectionsCopy.resize(fiberComputationData.classSizes[m]);
-                fiberParticlesCopy.resize(fiberComputationData.classSizes[m]);
-
-                for (unsigned int i = 0;i < fiberComputationData.classSizes[m];++i)
-                {
-                    unsigned int posIndex = fiberComputationData.reverseClassMemberships[m][i];
-                    weightSpecificClassValues[i] = fiberComputationData.particleWeights[posIndex];
-                    previousDirectionsCopy[i] = previousDirections[posIndex];
-                    fiberParticlesCopy[i] = fiberComputationData.fiberParticles[posIndex];
-                }
-
-                std::discrete_distribution<> dist(weightSpecificClassValues.begin(),weightSpecificClassValues.end());
-                usedFibers.resize(fiberComputationData.classSizes[m]);
-                std::fill(usedFibers.begin(),usedFibers.end(),false);
-
-                for (unsigned int i = 0;i < fiberComputationData.classSizes[m];++i)
-                {
-                    unsigned int z = dist(m_Generators[numThread]);
-                    unsigned int iReal = fiberComputationData.reverseClassMemberships[m][i];
-                    previousDirections[iReal] = previousDirectionsCopy[z];
-                    fiberComputationData.fiberParticles[iReal] = fiberParticlesCopy[z];
-                    // In all of this, we suppose that stopped particles have zero weights and will therefore
-                    // be lost when resampling
-                    fiberComputationData.stoppedParticles[iReal] = false;
-                    usedFibers[z] = true;
-                }
-
-                for (unsigned int i = 0;i < fiberComputationData.classSizes[m];++i)
-                {
-                    unsigned int iReal = fiberComputationData.reverseClassMemberships[m][i];
-
-                    if (!usedFibers[i])
-                    {
-                        if (oldFiberWeights[iReal] > m_FiberTrashThreshold / m_NumberOfParticles)
-                        {
-                            if (fiberComputationData.particleWeights[iReal] != 0)
-                                fiberParticlesCopy[i].pop_back();
+                particleSetData.resampledClasses.push_back(m);
+        }
 
-                            // The fiber trash used to contain fibers that were lost with a sufficient weight
-                            // However, using way too much memory so removed for now
-                            //if (fiberParticlesCopy[i].size() > m_MinLengthFiber / m_StepProgression)
-                            //    fiberTrash.push_back(fiberParticlesCopy[i]);
-                        }
-                    }
-                }
+        // Actual class resampling, classes are independent and shared among the team
+        if (particleSetData.resampledClasses.size() != 0)
+        {
+            this->RunParticleTeamTask(numThread,ResampleClasses,particleSetData,modelInterpolator);
 
-                // Update only weightVals, oldWeightVals will get updated when starting back the loop
-                // Same here for stopped fibers, they get rejected when resampling
+            // In all of this, we suppose that stopped particles have zero weights and will therefore
+            // be lost when resampling. The fiber trash used to contain fibers that were lost with a sufficient
+            // weight. However, using way too much memory so removed for now
+            for (unsigned int c = 0;c < particleSetData.resampledClasses.size();++c)
+            {
+                unsigned int m = particleSetData.resampledClasses[c];
                 for (unsigned int i = 0;i < fiberComputationData.classSizes[m];++i)
-                    fiberComputationData.particleWeights[fiberComputationData.reverseClassMemberships[m][i]] = 1.0 / fiberComputationData.classSizes[m];
+                    fiberComputationData.stoppedParticles[fiberComputationData.reverseClassMemberships[m][i]] = false;
             }
         }
 
@@ -864,6 +943,10 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
         if (numIter > m_MaxLengthFiber / m_StepProgression)
             stopLoop = true;
 
+        // Branches of particles lost when resampling are garbage, remove them once they are as large as the live tree
+        if (fiberComputationData.pointPool.size() > 2 * fiberComputationData.compactedPoolSize)
+            this->CompactParticlePointPool(fiberComputationData);
+
         numberOfClasses = this->UpdateClassesMemberships(fiberComputationData,previousDirections,m_Generators[numThread]);
 
         for (unsigned int i = 0;i < fiberComputationData.particleWeights.size();++i)
@@ -874,30 +957,254 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
     }
 
     // Now that we're done, if we don't keep individual particles, merge them cluster by cluster
+    FiberProcessVectorType outputFibers;
     if (m_MAPMergeFibers)
     {
-        FiberProcessVectorType mergedOutput,classMergedOutput;
+        FiberProcessVectorType classMergedOutput;
         for (unsigned int i = 0;i < numberOfClasses;++i)
         {
             this->MergeParticleClassFibers(fiberComputationData,classMergedOutput,i);
-            mergedOutput.insert(mergedOutput.end(),classMergedOutput.begin(),classMergedOutput.end());
+            outputFibers.insert(outputFibers.end(),classMergedOutput.begin(),classMergedOutput.end());
         }
 
-        fiberComputationData.fiberParticles = mergedOutput;
-    }
-
-    if (m_MAPMergeFibers)
         resultWeights = fiberComputationData.classWeights;
+    }
     else
+    {
+        outputFibers.resize(m_NumberOfParticles);
+        for (unsigned int i = 0;i < m_NumberOfParticles;++i)
+            this->GetParticleFiber(fiberComputationData,i,outputFibers[i]);
+
         resultWeights = fiberComputationData.particleWeights;
+    }
+
+    return outputFibers;
+}
+
+template <class TInputModelImageType>
+void
+BaseProbabilisticTractographyImageFilter <TInputModelImageType>
+::PropagateParticleBlock(ParticleSetWorkType &workData, unsigned int blockIndex,
+                         InterpolatorPointer &modelInterpolator, unsigned int numThread)
+{
+    FiberWorkType &fiberComputationData = workData.fiberData;
+    DirectionVectorType &previousDirections = workData.previousDirections;
+
+    unsigned int startParticle = blockIndex * m_ParticleBlockSize;
+    unsigned int endParticle = std::min(startParticle + m_ParticleBlockSize,m_NumberOfParticles);
+
+    VectorType modelValue(m_ModelDimension);
+    PointType currentPoint;
+    ContinuousIndexType currentIndex, newIndex;
+    IndexType closestIndex;
+
+    // First pass: model at particle tips, stopping criteria and initial directions
+    MembershipType activeParticles;
+    for (unsigned int i = startParticle;i < endParticle;++i)
+    {
+        workData.particleStatus[i] = ParticleInactive;
+
+        // Do not compute trashed fibers
+        if (fiberComputationData.stoppedParticles[i])
+            continue;
+
+        currentPoint = fiberComputationData.pointPool[fiberComputationData.particleTips[i]];
+
+        m_SeedMask->TransformPhysicalPointToContinuousIndex(currentPoint,currentIndex);
+
+        // Trash fiber if it goes outside of the brain
+        if (!modelInterpolator->IsInsideBuffer(currentIndex))
+        {
+            workData.particleStatus[i] = ParticleStopped;
+            continue;
+        }
+
+        // Trash fiber if it goes through the cut mask
+        m_SeedMask->TransformPhysicalPointToIndex(currentPoint,closestIndex);
+
+        if (m_CutMask)
+        {
+            if (m_CutMask->GetPixel(closestIndex) != 0)
+            {
+                workData.particleStatus[i] = ParticleStopped;
+                continue;
+            }
+        }
+
+        // Computes diffusion information at current position
+        modelValue.Fill(0.0);
+        double estimatedNoiseValue = 20.0;
+        this->ComputeModelValue(modelInterpolator, currentIndex, modelValue, numThread);
+        double estimatedB0Value = m_B0Interpolator->EvaluateAtContinuousIndex(currentIndex);
+        estimatedNoiseValue = m_NoiseInterpolator->EvaluateAtContinuousIndex(currentIndex);
+
+        if (!this->CheckModelProperties(estimatedB0Value,estimatedNoiseValue,modelValue,numThread))
+        {
+            workData.particleStatus[i] = ParticleStopped;
+            continue;
+        }
+
+        // Set initial direction to the principal eigenvector of the tensor
+        if (workData.iteration == 1)
+        {
+            Vector3DType initDir(0.0);
+            switch (m_InitialColinearityDirection)
+            {
+                case Top:
+                    initDir[2] = 1;
+                    break;
+                case Bottom:
+                    initDir[2] = -1;
+                    break;
+                case Left:
+                    initDir[0] = -1;
+                    break;
+                case Right:
+                    initDir[0] = 1;
+                    break;
+                case Front:
+                    initDir[1] = -1;
+                    break;
+                case Back:
+                    initDir[1] = 1;
+                    break;
+                case Outward:
+                    for (unsigned int j = 0;j < InputModelImageType::ImageDimension;++j)
+                        initDir[j] = currentPoint[j] - m_DWIGravityCenter[j];
+                    break;
+                case Center:
+                default:
+                    for (unsigned int j = 0;j < InputModelImageType::ImageDimension;++j)
+                        initDir[j] = m_DWIGravityCenter[j] - currentPoint[j];
+                    break;
+            }
+
+            if (workData.is2d)
+                initDir[2] = 0;
+            initDir.Normalize();
+
+            previousDirections[i] = this->InitializeFirstIterationFromModel(initDir,modelValue,numThread);
+        }
 
-    return fiberComputationData.fiberParticles;
+        workData.modelValues[i] = modelValue;
+        workData.tipIndexes[i] = currentIndex;
+        activeParticles.push_back(i);
+    }
+
+    // Propose new directions based on the previous ones and the diffusion information at current positions
+    DirectionVectorType samplingDirections, newDirections;
+    ListType logPriors, logProposals;
+    RandomGeneratorType blockGenerator(m_RandomSeed,workData.seedIndex,
+                                       this->GetParticleRandomSubstream(workData.iteration,blockIndex,false));
+
+    this->ProposeNewDirections(activeParticles, workData.tipIndexes, previousDirections, workData.modelValues, samplingDirections,
+                               logPriors, logProposals, newDirections, blockGenerator, numThread);
+
+    // Second pass: move particles and update their weights at their new positions
+    for (unsigned int k = 0;k < activeParticles.size();++k)
+    {
+        unsigned int i = activeParticles[k];
+        Vector3DType &newDirection = newDirections[k];
+        currentPoint = fiberComputationData.pointPool[fiberComputationData.particleTips[i]];
+
+        // Update the position of the particle
+        for (unsigned int j = 0;j < InputModelImageType::ImageDimension;++j)
+            currentPoint[j] += m_StepProgression * newDirection[j];
+
+        // Log-weight update must be done at new position (except for prior and proposal)
+        m_SeedMask->TransformPhysicalPointToContinuousIndex(currentPoint,newIndex);
+
+        // Set the new proposed direction as the current direction
+        previousDirections[i] = newDirection;
+
+        modelValue.Fill(0.0);
+
+        if (!modelInterpolator->IsInsideBuffer(newIndex))
+        {
+            workData.particleStatus[i] = ParticleStopped;
+            continue;
+        }
+
+        workData.newTipPoints[i] = currentPoint;
+        workData.particleStatus[i] = ParticleMoved;
+
+        this->ComputeModelValue(modelInterpolator, newIndex, modelValue, numThread);
+        double estimatedB0Value = m_B0Interpolator->EvaluateAtContinuousIndex(newIndex);
+        double estimatedNoiseValue = m_NoiseInterpolator->EvaluateAtContinuousIndex(newIndex);
+
+        // Update the weight of the particle
+        double updateWeightLogVal = this->ComputeLogWeightUpdate(estimatedB0Value, estimatedNoiseValue, newDirection,
+                                                                 modelValue, logPriors[k], logProposals[k], numThread);
+
+        workData.logWeightVals[i] = updateWeightLogVal + anima::safe_log(workData.oldFiberWeights[i]);
+    }
+}
+
+template <class TInputModelImageType>
+void
+BaseProbabilisticTractographyImageFilter <TInputModelImageType>
+::ResampleParticleClass(ParticleSetWorkType &workData, unsigned int classIndex)
+{
+    FiberWorkType &fiberComputationData = workData.fiberData;
+    unsigned int classSize = fiberComputationData.classSizes[classIndex];
+
+    ListType weightSpecificClassValues(classSize);
+    DirectionVectorType previousDirectionsCopy(classSize);
+    MembershipType particleTipsCopy(classSize);
+
+    for (unsigned int i = 0;i < classSize;++i)
+    {
+        unsigned int posIndex = fiberComputationData.reverseClassMemberships[classIndex][i];
+        weightSpecificClassValues[i] = fiberComputationData.particleWeights[posIndex];
+        previousDirectionsCopy[i] = workData.previousDirections[posIndex];
+        particleTipsCopy[i] = fiberComputationData.particleTips[posIndex];
+    }
+
+    // Resampled particles only share the history of their ancestor: copying its tip is enough
+    std::discrete_distribution<> dist(weightSpecificClassValues.begin(),weightSpecificClassValues.end());
+    RandomGeneratorType classGenerator(m_RandomSeed,workData.seedIndex,
+                                       this->GetParticleRandomSubstream(workData.iteration,classIndex,true));
+
+    for (unsigned int i = 0;i < classSize;++i)
+    {
+        unsigned int z = dist(classGenerator);
+        unsigned int iReal = fiberComputationData.reverseClassMemberships[classIndex][i];
+        workData.previousDirections[iReal] = previousDirectionsCopy[z];
+        fiberComputationData.particleTips[iReal] = particleTipsCopy[z];
+    }
+
+    // Update only weightVals, oldWeightVals will get updated when starting back the loop
+    // Same here for stopped fibers, they get rejected when resampling
+    for (unsigned int i = 0;i < classSize;++i)
+        fiberComputationData.particleWeights[fiberComputationData.reverseClassMemberships[classIndex][i]] = 1.0 / classSize;
+}
+
+template <class TInputModelImageType>
+void
+BaseProbabilisticTractographyImageFilter <TInputModelImageType>
+::ProposeNewDirections(const MembershipType &activeParticles, std::vector <ContinuousIndexType> &tipIndexes,
+                       DirectionVectorType &oldDirections, std::vector <VectorType> &modelValues,
+                       DirectionVectorType &samplingDirections, ListType &logPriors, ListType &logProposals,
+                       DirectionVectorType &newDirections, RandomGeneratorType &random_generator, unsigned int threadId)
+{
+    unsigned int numParticles = activeParticles.size();
+    samplingDirections.resize(numParticles);
+    newDirections.resize(numParticles);
+    logPriors.assign(numParticles,0.0);
+    logProposals.assign(numParticles,0.0);
+
+    for (unsigned int k = 0;k < numParticles;++k)
+    {
+        unsigned int i = activeParticles[k];
+        newDirections[k] = this->ProposeNewDirection(oldDirections[i], modelValues[i], samplingDirections[k], logPriors[k],
+                                                     logProposals[k], random_generator, threadId);
+    }
 }
 
 template <class TInputModelImageType>
 unsigned int
 BaseProbabilisticTractographyImageFilter <TInputModelImageType>
-::UpdateClassesMemberships(FiberWorkType &fiberData, DirectionVectorType &directions, std::mt19937 &random_generator)
+::UpdateClassesMemberships(FiberWorkType &fiberData, DirectionVectorType &directions, RandomGeneratorType &random_generator)
 {
     const unsigned int p = PointType::PointDimension;
     typedef anima::KMeansFilter <PointType,p> KMeansFilterType;
@@ -1167,7 +1474,7 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
             {
                 unsigned int classIndex = fusedClassesIndexes[i][j];
                 for (unsigned int k = 0;k < fiberData.reverseClassMemberships[classIndex].size();++k)
-                    vectorToCluster.push_back(fiberData.fiberParticles[fiberData.reverseClassMemberships[classIndex][k]].back());
+                    vectorToCluster.push_back(fiberData.pointPool[fiberData.particleTips[fiberData.reverseClassMemberships[classIndex][k]]]);
             }
 
             clustering.resize(vectorToCluster.size());
@@ -1285,45 +1592,22 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
     }
 
     FiberType classFiber;
-    FiberType tmpFiber;
-    unsigned int sizeMerged = 0;
     unsigned int p = PointType::GetPointDimension();
 
     double sumWeights = 0;
+    ListType classWeights(runningIndexes.size());
     for (unsigned int j = 0;j < runningIndexes.size();++j)
-        sumWeights += fiberData.particleWeights[runningIndexes[j]];
+    {
+        classWeights[j] = fiberData.particleWeights[runningIndexes[j]];
+        sumWeights += classWeights[j];
+    }
 
     if (runningIndexes.size() != 0)
     {
         // Use weights provided
-        for (unsigned int j = 0;j < runningIndexes.size();++j)
-        {
-            double tmpWeight = fiberData.particleWeights[runningIndexes[j]];
-            if (tmpWeight <= 0)
-                continue;
+        this->ComputeParticlesWeightedSum(fiberData,runningIndexes,classWeights,classFiber);
 
-            tmpFiber = fiberData.fiberParticles[runningIndexes[j]];
-            for (unsigned int k = 0;k < tmpFiber.size();++k)
-            {
-                if (k < sizeMerged)
-                {
-                    for (unsigned int l = 0;l < p;++l)
-                        classFiber[k][l] += tmpWeight * tmpFiber[k][l];
-                }
-                else
-                {
-                    if (tmpWeight != 0)
-                    {
-                        sizeMerged++;
-                        classFiber.push_back(tmpFiber[k]);
-                        for (unsigned int l = 0;l < p;++l)
-                            classFiber[k][l] *= tmpWeight;
-                    }
-                }
-            }
-        }
-
-        for (unsigned int j = 0;j < sizeMerged;++j)
+        for (unsigned int j = 0;j < classFiber.size();++j)
         {
             for (unsigned int k = 0;k < p;++k)
                 classFiber[j][k] /= sumWeights;
@@ -1338,7 +1622,7 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
     std::vector <unsigned int> particleSizes;
     for (unsigned int i = 0;i < stoppedIndexes.size();++i)
     {
-        unsigned int particleSize = fiberData.fiberParticles[stoppedIndexes[i]].size();
+        unsigned int particleSize = fiberData.pointDepths[fiberData.particleTips[stoppedIndexes[i]]] + 1;
         bool sizeFound = false;
         for (unsigned int j = 0;j < particleSizes.size();++j)
         {
@@ -1362,28 +1646,10 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
     outputMerged.resize(particleGroups.size());
     for (unsigned int i = 0;i < particleGroups.size();++i)
     {
-        classFiber.clear();
-        sizeMerged = 0;
+        ListType groupWeights(particleGroups[i].size(),1.0);
+        this->ComputeParticlesWeightedSum(fiberData,particleGroups[i],groupWeights,classFiber);
 
-        for (unsigned int j = 0;j < particleGroups[i].size();++j)
-        {
-            tmpFiber = fiberData.fiberParticles[particleGroups[i][j]];
-            for (unsigned int k = 0;k < tmpFiber.size();++k)
-            {
-                if (k < sizeMerged)
-                {
-                    for (unsigned int l = 0;l < p;++l)
-                        classFiber[k][l] += tmpFiber[k][l];
-                }
-                else
-                {
-                    sizeMerged++;
-                    classFiber.push_back(tmpFiber[k]);
-                }
-            }
-        }
-
-        for (unsigned int j = 0;j < sizeMerged;++j)
+        for (unsigned int j = 0;j < classFiber.size();++j)
         {
             for (unsigned int k = 0;k < p;++k)
                 classFiber[j][k] /= particleGroups[i].size();
@@ -1395,4 +1661,141 @@ BaseProbabilisticTractographyImageFilter <TInputModelImageType>
     return false;
 }
 
+template <class TInputModelImageType>
+void
+BaseProbabilisticTractographyImageFilter <TInputModelImageType>
+::AppendParticlePoint(FiberWorkType &fiberData, unsigned int particleIndex, const PointType &point)
+{
+    unsigned int parentIndex = fiberData.particleTips[particleIndex];
+
+    fiberData.particleTips[particleIndex] = fiberData.pointPool.size();
+    fiberData.pointPool.push_back(point);
+    fiberData.pointParents.push_back(parentIndex);
+    fiberData.pointDepths.push_back(fiberData.pointDepths[parentIndex] + 1);
+}
+
+template <class TInputModelImageType>
+void
+BaseProbabilisticTractographyImageFilter <TInputModelImageType>
+::GetParticleFiber(const FiberWorkType &fiberData, unsigned int particleIndex, FiberType &fiber)
+{
+    unsigned int pointIndex = fiberData.particleTips[particleIndex];
+    unsigned int fiberSize = fiberData.pointDepths[pointIndex] + 1;
+    fiber.resize(fiberSize);
+
+    for (unsigned int i = fiberSize;i > 0;--i)
+    {
+        fiber[i - 1] = fiberData.pointPool[pointIndex];
+        pointIndex = fiberData.pointParents[pointIndex];
+    }
+}
+
+template <class TInputModelImageType>
+void
+BaseProbabilisticTractographyImageFilter <TInputModelImageType>
+::ComputeParticlesWeightedSum(FiberWorkType &fiberData, const MembershipType &particleIndexes,
+                              const ListType &weights, FiberType &sumFiber)
+{
+    unsigned int p = PointType::GetPointDimension();
+    if (fiberData.pointWeights.size() < fiberData.pointPool.size())
+    {
+        fiberData.pointWeights.resize(fiberData.pointPool.size(),0.0);
+        fiberData.visitedPointFlags.resize(fiberData.pointPool.size(),false);
+    }
+
+    // Mark points on the path of at least one particle, stopping when reaching an already visited prefix
+    fiberData.visitedPoints.clear();
+    unsigned int sizeMerged = 0;
+    for (unsigned int i = 0;i < particleIndexes.size();++i)
+    {
+        if (weights[i] <= 0)
+            continue;
+
+        unsigned int pointIndex = fiberData.particleTips[particleIndexes[i]];
+        sizeMerged = std::max(sizeMerged,fiberData.pointDepths[pointIndex] + 1);
+        fiberData.pointWeights[pointIndex] += weights[i];
+
+        while (!fiberData.visitedPointFlags[pointIndex])
+        {
+            fiberData.visitedPointFlags[pointIndex] = true;
+            fiberData.visitedPoints.push_back(pointIndex);
+            if (fiberData.pointDepths[pointIndex] == 0)
+                break;
+
+            pointIndex = fiberData.pointParents[pointIndex];
+        }
+    }
+
+    // Accumulate weights from children to parents, children have larger pool indexes
+    std::sort(fiberData.visitedPoints.begin(),fiberData.visitedPoints.end(),std::greater <unsigned int> ());
+    PointType zeroPoint;
+    zeroPoint.Fill(0.0);
+    sumFiber.resize(sizeMerged);
+    std::fill(sumFiber.begin(),sumFiber.end(),zeroPoint);
+
+    for (unsigned int i = 0;i < fiberData.visitedPoints.size();++i)
+    {
+        unsigned int pointIndex = fiberData.visitedPoints[i];
+        double pointWeight = fiberData.pointWeights[pointIndex];
+        unsigned int depth = fiberData.pointDepths[pointIndex];
+
+        for (unsigned int j = 0;j < p;++j)
+            sumFiber[depth][j] += pointWeight * fiberData.pointPool[pointIndex][j];
+
+        if (depth > 0)
+            fiberData.pointWeights[fiberData.pointParents[pointIndex]] += pointWeight;
+
+        fiberData.pointWeights[pointIndex] = 0;
+        fiberData.visitedPointFlags[pointIndex] = false;
+    }
+}
+
+template <class TInputModelImageType>
+void
+BaseProbabilisticTractographyImageFilter <TInputModelImageType>
+::CompactParticlePointPool(FiberWorkType &fiberData)
+{
+    unsigned int poolSize = fiberData.pointPool.size();
+    MembershipType newIndexes(poolSize,0);
+    std::vector <bool> usedPoints(poolSize,false);
+
+    for (unsigned int i = 0;i < fiberData.particleTips.size();++i)
+    {
+        unsigned int pointIndex = fiberData.particleTips[i];
+        while (!usedPoints[pointIndex])
+        {
+            usedPoints[pointIndex] = true;
+            if (fiberData.pointDepths[pointIndex] == 0)
+                break;
+
+            pointIndex = fiberData.pointParents[pointIndex];
+        }
+    }
+
+    // Moving points in increasing index order keeps parents before their children
+    unsigned int newPoolSize = 0;
+    for (unsigned int i = 0;i < poolSize;++i)
+    {
+        if (!usedPoints[i])
+            continue;
+
+        newIndexes[i] = newPoolSize;
+        fiberData.pointPool[newPoolSize] = fiberData.pointPool[i];
+        fiberData.pointParents[newPoolSize] = newIndexes[fiberData.pointParents[i]];
+        fiberData.pointDepths[newPoolSize] = fiberData.pointDepths[i];
+        ++newPoolSize;
+    }
+
+    fiberData.pointPool.resize(newPoolSize);
+    fiberData.pointParents.resize(newPoolSize);
+    fiberData.pointDepths.resize(newPoolSize);
+    fiberData.pointWeights.clear();
+    fiberData.visitedPointFlags.clear();
+
+    for (unsigned int i = 0;i < fiberData.particleTips.size();++i)
+        fiberData.particleTips[i] = newIndexes[fiberData.particleTips[i]];
+
+    fiberData.compactedPoolSize = newPoolSize;
+}
+
 } // end of namespace anima
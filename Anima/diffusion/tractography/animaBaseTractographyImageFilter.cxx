@@ -5,6 +5,7 @@
 #include <itkProgressReporter.h>
 
 #include <animaVectorOperations.h>
+#include <animaSeedOrdering.h>
 
 #include <vtkPointData.h>
 #include <vtkCellData.h>
@@ -23,6 +24,8 @@ BaseTractographyImageFilter::BaseTractographyImageFilter()
     m_MinimalModelWeight = 0.25;
 
     m_ComputeLocalColors = true;
+    m_MortonSeedOrdering = false;
+    m_StreamingWriter = 0;
     m_HighestProcessedSeed = 0;
     m_ProgressReport = 0;
 }
@@ -61,7 +64,14 @@ void BaseTractographyImageFilter::Update()
     this->GetMultiThreader()->SetNumberOfThreads(this->GetNumberOfThreads());
     this->GetMultiThreader()->SetSingleMethod(this->ThreadTracker,&tmpStr);
     this->GetMultiThreader()->SingleMethodExecute();
-    
+
+    // Fibers were filtered and handed to the writer by tracking threads, they are counted once the writer is closed
+    if (m_StreamingWriter)
+    {
+        std::cout << std::endl;
+        return;
+    }
+
     for (unsigned int j = 0;j < this->GetNumberOfThreads();++j)
     {
         resultFibers.insert(resultFibers.end(),tmpStr.resultFibersFromThreads[j].begin(),
@@ -91,16 +101,23 @@ void BaseTractographyImageFilter::PrepareTractography()
     
     bool is2d = (m_InputImage->GetLargestPossibleRegion().GetSize()[2] <= 1);
     FiberType tmpFiber(1);
-    
+
+    std::vector <IndexType> seedIndexes;
     while (!seedItr.IsAtEnd())
     {
-        if (seedItr.Get() == 0)
-        {
-            ++seedItr;
-            continue;
-        }
-        
-        tmpIndex = seedItr.GetIndex();
+        if (seedItr.Get() != 0)
+            seedIndexes.push_back(seedItr.GetIndex());
+
+        ++seedItr;
+    }
+
+    // Seeds of a voxel stay consecutive, so that thread chunks are compact bricks along the curve
+    if (m_MortonSeedOrdering)
+        anima::SortIndexesAlongMortonCurve(seedIndexes);
+    
+    for (unsigned int s = 0;s < seedIndexes.size();++s)
+    {
+        tmpIndex = seedIndexes[s];
         
         if (is2d)
         {
@@ -135,8 +152,6 @@ void BaseTractographyImageFilter::PrepareTractography()
                 }
             }
         }
-        
-        ++seedItr;
     }
 
     if (m_FilteringImage.IsNotNull())
@@ -223,13 +238,27 @@ void BaseTractographyImageFilter::ThreadedTrackComputer(unsigned int numThread,
                                                         unsigned int startSeedIndex, unsigned int endSeedIndex)
 {    
     FiberType tmpFiber;
+    std::vector <FiberType> streamedFibers;
     for (unsigned int i = startSeedIndex;i < endSeedIndex;++i)
     {
         tmpFiber = m_PointsToProcess[i].second;
         this->ComputeFiber(tmpFiber,m_PointsToProcess[i].first,numThread);
         
-        if (tmpFiber.size() > m_MinLengthFiber / m_StepProgression)
+        if (tmpFiber.size() <= m_MinLengthFiber / m_StepProgression)
+            continue;
+
+        if (!m_StreamingWriter)
+        {
             resultFibers.push_back(tmpFiber);
+            continue;
+        }
+
+        // Streaming: filtering is done fiber by fiber before handing it to the writer
+        streamedFibers.resize(1);
+        streamedFibers[0] = tmpFiber;
+        streamedFibers = this->FilterOutputFibers(streamedFibers);
+        for (unsigned int j = 0;j < streamedFibers.size();++j)
+            m_StreamingWriter->AddFiber(streamedFibers[j]);
     }
 }
 
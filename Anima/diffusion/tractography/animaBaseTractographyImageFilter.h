@@ -10,6 +10,8 @@
 #include <itkFastMutexLock.h>
 #include <itkProgressReporter.h>
 
+#include <animaStreamingFibersWriter.h>
+
 #include "AnimaTractographyExport.h"
 
 #include <vector>
@@ -76,6 +78,12 @@ public:
     void Update() ITK_OVERRIDE;
     
     void SetComputeLocalColors(bool flag) {m_ComputeLocalColors = flag;}
+
+    //! If true, seed voxels are processed along a Morton curve instead of raster order (default) for cache locality
+    void SetMortonSeedOrdering(bool flag) {m_MortonSeedOrdering = flag;}
+
+    //! If set, accepted fibers are pushed to this opened writer while tracking and the output polydata stays empty
+    void SetStreamingWriter(anima::StreamingFibersWriter *writer) {m_StreamingWriter = writer;}
     void createVTKOutput(std::vector < std::vector <PointType> > &filteredFibers);
     vtkPolyData *GetOutput() {return m_Output;}
     
@@ -128,7 +136,9 @@ private:
     std::vector <unsigned int> m_FilteringValues;
     
     bool m_ComputeLocalColors;
+    bool m_MortonSeedOrdering;
     vtkSmartPointer<vtkPolyData> m_Output;
+    anima::StreamingFibersWriter *m_StreamingWriter;
 
     itk::SimpleFastMutexLock m_LockHighestProcessedSeed;
     int m_HighestProcessedSeed;
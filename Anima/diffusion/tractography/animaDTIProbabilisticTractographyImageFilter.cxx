@@ -32,7 +32,7 @@ DTIProbabilisticTractographyImageFilter::~DTIProbabilisticTractographyImageFilte
 DTIProbabilisticTractographyImageFilter::Vector3DType
 DTIProbabilisticTractographyImageFilter::ProposeNewDirection(Vector3DType &oldDirection, VectorType &modelValue,
                                                              Vector3DType &sampling_direction, double &log_prior,
-                                                             double &log_proposal, std::mt19937 &random_generator,
+                                                             double &log_proposal, RandomGeneratorType &random_generator,
                                                              unsigned int threadId)
 {
     Vector3DType resVec(0.0);
@@ -87,6 +87,73 @@ DTIProbabilisticTractographyImageFilter::ProposeNewDirection(Vector3DType &oldDi
     return resVec;
 }
 
+void
+DTIProbabilisticTractographyImageFilter::ProposeNewDirections(const MembershipType &activeParticles, std::vector <ContinuousIndexType> &tipIndexes,
+                                                              DirectionVectorType &oldDirections, std::vector <VectorType> &modelValues,
+                                                              DirectionVectorType &samplingDirections, ListType &logPriors,
+                                                              ListType &logProposals, DirectionVectorType &newDirections,
+                                                              RandomGeneratorType &random_generator, unsigned int threadId)
+{
+    unsigned int numParticles = activeParticles.size();
+    bool is2d = this->GetInputModelImage()->GetLargestPossibleRegion().GetSize()[2] <= 1;
+    double priorKappa = this->GetKappaOfPriorDistribution();
+
+    samplingDirections.resize(numParticles);
+    DirectionVectorType previousDirections(numParticles);
+    ListType kappaValues(numParticles,priorKappa);
+    std::vector <bool> prolateTensors(numParticles,false);
+
+    for (unsigned int k = 0;k < numParticles;++k)
+    {
+        unsigned int i = activeParticles[k];
+        previousDirections[k] = oldDirections[i];
+
+        if (this->GetLinearCoefficient(modelValues[i]) > m_ThresholdForProlateTensor)
+        {
+            prolateTensors[k] = true;
+            this->GetDTIPrincipalDirection(modelValues[i], samplingDirections[k], is2d);
+
+            if (anima::ComputeScalarProduct(previousDirections[k], samplingDirections[k]) < 0)
+                samplingDirections[k] *= -1;
+
+            kappaValues[k] = this->GetKappaFromFA(this->GetFractionalAnisotropy(modelValues[i]));
+        }
+        else
+            samplingDirections[k] = previousDirections[k];
+    }
+
+    anima::WatsonLogNormalizerCache &normalizerCache = this->GetWatsonNormalizerCache(threadId);
+    anima::SampleFromWatsonDistributions(kappaValues, samplingDirections, newDirections, logProposals, normalizerCache, random_generator);
+
+    if (is2d)
+    {
+        for (unsigned int k = 0;k < numParticles;++k)
+        {
+            newDirections[k][InputModelImageType::ImageDimension - 1] = 0;
+            newDirections[k].Normalize();
+        }
+
+        // Projected samples moved, their proposal densities are evaluated again
+        anima::EvaluateWatsonLogPDFs(newDirections, samplingDirections, kappaValues, logProposals, normalizerCache);
+    }
+
+    ListType priorKappas(numParticles,priorKappa);
+    anima::EvaluateWatsonLogPDFs(newDirections, previousDirections, priorKappas, logPriors, normalizerCache);
+
+    for (unsigned int k = 0;k < numParticles;++k)
+    {
+        // As in ProposeNewDirection, prior and proposal are only accounted for on prolate tensors
+        if (!prolateTensors[k])
+        {
+            logPriors[k] = 0;
+            logProposals[k] = 0;
+        }
+
+        if (anima::ComputeScalarProduct(previousDirections[k], newDirections[k]) < 0)
+            newDirections[k] *= -1;
+    }
+}
+
 DTIProbabilisticTractographyImageFilter::Vector3DType
 DTIProbabilisticTractographyImageFilter::
 InitializeFirstIterationFromModel(Vector3DType &colinearDir, VectorType &modelValue, unsigned int threadId)
@@ -289,7 +356,7 @@ void DTIProbabilisticTractographyImageFilter::GetDTIMinorDirection(VectorType &m
 }
 
 void DTIProbabilisticTractographyImageFilter::ComputeModelValue(InterpolatorPointer &modelInterpolator, ContinuousIndexType &index,
-                                                                VectorType &modelValue)
+                                                                VectorType &modelValue, unsigned int threadId)
 {
     modelValue.SetSize(this->GetModelDimension());
     modelValue.Fill(0.0);
@@ -434,7 +501,7 @@ void DTIProbabilisticTractographyImageFilter::ComputeAdditionalScalarMaps()
         this->GetInputModelImage()->TransformPhysicalPointToContinuousIndex(tmpPoint,tmpIndex);
         tensorValue.Fill(0.0);
         if (modelInterpolator->IsInsideBuffer(tmpIndex))
-            this->ComputeModelValue(modelInterpolator,tmpIndex,tensorValue);
+            this->ComputeModelValue(modelInterpolator,tmpIndex,tensorValue,0);
 
         anima::GetTensorFromVectorRepresentation(tensorValue,tmpMat,3,false);
 
@@ -37,13 +37,21 @@ protected:
 
     virtual Vector3DType ProposeNewDirection(Vector3DType &oldDirection, VectorType &modelValue,
                                              Vector3DType &sampling_direction, double &log_prior,
-                                             double &log_proposal, std::mt19937 &random_generator,
+                                             double &log_proposal, RandomGeneratorType &random_generator,
                                              unsigned int threadId) ITK_OVERRIDE;
 
+    //! Batched proposal for the whole particle set, Watson samples and log-densities computed with cached normalizers
+    virtual void ProposeNewDirections(const MembershipType &activeParticles, std::vector <ContinuousIndexType> &tipIndexes,
+                                      DirectionVectorType &oldDirections, std::vector <VectorType> &modelValues,
+                                      DirectionVectorType &samplingDirections, ListType &logPriors, ListType &logProposals,
+                                      DirectionVectorType &newDirections, RandomGeneratorType &random_generator,
+                                      unsigned int threadId) ITK_OVERRIDE;
+
     virtual double ComputeLogWeightUpdate(double b0Value, double noiseValue, Vector3DType &newDirection, VectorType &modelValue,
                                           double &log_prior, double &log_proposal, unsigned int threadId) ITK_OVERRIDE;
 
-    virtual void ComputeModelValue(InterpolatorPointer &modelInterpolator, ContinuousIndexType &index, VectorType &modelValue) ITK_OVERRIDE;
+    virtual void ComputeModelValue(InterpolatorPointer &modelInterpolator, ContinuousIndexType &index, VectorType &modelValue,
+                                   unsigned int threadId) ITK_OVERRIDE;
 
     virtual Vector3DType InitializeFirstIterationFromModel(Vector3DType &colinearDir,
                                                            VectorType &modelValue, unsigned int threadId) ITK_OVERRIDE;
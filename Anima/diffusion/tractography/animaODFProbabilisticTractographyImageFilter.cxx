@@ -11,6 +11,10 @@
 #include <animaVMFDistribution.h>
 #include <animaWatsonDistribution.h>
 
+#include <itkMultiThreader.h>
+#include <itkImageRegionConstIteratorWithIndex.h>
+#include <itkImageRegionIterator.h>
+
 namespace anima
 {
 
@@ -25,6 +29,9 @@ ODFProbabilisticTractographyImageFilter::ODFProbabilisticTractographyImageFilter
 
     m_ODFSHBasis = NULL;
 
+    m_UsePrecomputedPeaks = false;
+    m_PeakODFDistanceThreshold = 0.1;
+
     this->SetModelDimension(15);
 }
 
@@ -47,26 +54,192 @@ void ODFProbabilisticTractographyImageFilter::PrepareTractography()
         delete m_ODFSHBasis;
 
     m_ODFSHBasis = new anima::ODFSphericalHarmonicBasis(m_ODFSHOrder);
+
+    m_ThreadSHWorkTables.resize(this->GetNumberOfThreads());
+    m_ThreadPeakIndexes.resize(this->GetNumberOfThreads());
+    m_ThreadPeaksUsable.assign(this->GetNumberOfThreads(),0);
+
+    if (m_UsePrecomputedPeaks)
+        this->ComputePeakImage();
+}
+
+ITK_THREAD_RETURN_TYPE ODFProbabilisticTractographyImageFilter::ThreadPeakExtractor(void *arg)
+{
+    itk::MultiThreader::ThreadInfoStruct *threadArgs = (itk::MultiThreader::ThreadInfoStruct *)arg;
+    ODFProbabilisticTractographyImageFilter *tracker = (ODFProbabilisticTractographyImageFilter *)threadArgs->UserData;
+
+    tracker->ExtractPeaksOfSlices(threadArgs->ThreadID,threadArgs->NumberOfThreads);
+
+    return NULL;
+}
+
+void ODFProbabilisticTractographyImageFilter::ComputePeakImage()
+{
+    InputModelImageType *modelImage = this->GetInputModelImage();
+
+    m_PeakImage = PeakImageType::New();
+    m_PeakImage->Initialize();
+    m_PeakImage->SetRegions(modelImage->GetLargestPossibleRegion());
+    m_PeakImage->SetSpacing(modelImage->GetSpacing());
+    m_PeakImage->SetOrigin(modelImage->GetOrigin());
+    m_PeakImage->SetDirection(modelImage->GetDirection());
+    m_PeakImage->SetVectorLength(1 + 5 * m_MaximalNumberOfPeaks);
+    m_PeakImage->Allocate();
+
+    PeakImageType::PixelType zeroPeaks(m_PeakImage->GetVectorLength());
+    zeroPeaks.Fill(0.0);
+    m_PeakImage->FillBuffer(zeroPeaks);
+
+    this->GetMultiThreader()->SetNumberOfThreads(this->GetNumberOfThreads());
+    this->GetMultiThreader()->SetSingleMethod(this->ThreadPeakExtractor,this);
+    this->GetMultiThreader()->SingleMethodExecute();
+
+    std::cout << "Extracted ODF peaks of all voxels" << std::endl;
+}
+
+void ODFProbabilisticTractographyImageFilter::ExtractPeaksOfSlices(unsigned int threadId, unsigned int numThreads)
+{
+    typedef itk::ImageRegionConstIteratorWithIndex <InputModelImageType> ModelIteratorType;
+    typedef itk::ImageRegionIterator <PeakImageType> PeakIteratorType;
+
+    InputModelImageType *modelImage = this->GetInputModelImage();
+    bool is2d = (modelImage->GetLargestPossibleRegion().GetSize()[2] == 1);
+
+    // Slices are interleaved between threads to balance the work between white matter and background slices
+    InputModelImageType::RegionType sliceRegion = modelImage->GetLargestPossibleRegion();
+    unsigned int numSlices = sliceRegion.GetSize()[2];
+    unsigned int firstSlice = sliceRegion.GetIndex()[2];
+    sliceRegion.SetSize(2,1);
+
+    VectorType modelValue(this->GetModelDimension());
+    PeakImageType::PixelType peakValue(m_PeakImage->GetVectorLength());
+    DirectionVectorType maximaODF;
+    Vector3DType sphDirection;
+
+    for (unsigned int slice = threadId;slice < numSlices;slice += numThreads)
+    {
+        sliceRegion.SetIndex(2,firstSlice + slice);
+        ModelIteratorType modelItr(modelImage,sliceRegion);
+        PeakIteratorType peakItr(m_PeakImage,sliceRegion);
+
+        while (!modelItr.IsAtEnd())
+        {
+            for (unsigned int i = 0;i < this->GetModelDimension();++i)
+                modelValue[i] = modelItr.Get()[i];
+
+            double sumSquares = 0;
+            for (unsigned int i = 0;i < this->GetModelDimension();++i)
+                sumSquares += modelValue[i] * modelValue[i];
+
+            // Voxels without peaks are left to the usual maxima search
+            if ((sumSquares == 0) || (this->GetGeneralizedFractionalAnisotropy(modelValue) < m_GFAThreshold))
+            {
+                ++modelItr;
+                ++peakItr;
+                continue;
+            }
+
+            unsigned int numDirs = this->FindODFMaxima(modelValue,maximaODF,m_MinimalDiffusionProbability,is2d);
+            if (numDirs > m_MaximalNumberOfPeaks)
+                numDirs = m_MaximalNumberOfPeaks;
+
+            peakValue.Fill(0.0);
+            peakValue[0] = numDirs;
+            for (unsigned int i = 0;i < numDirs;++i)
+            {
+                anima::TransformCartesianToSphericalCoordinates(maximaODF[i],sphDirection);
+
+                for (unsigned int j = 0;j < 3;++j)
+                    peakValue[1 + 5 * i + j] = maximaODF[i][j];
+
+                peakValue[1 + 5 * i + 3] = m_ODFSHBasis->getValueAtPosition(modelValue,sphDirection[0],sphDirection[1],
+                                                                            m_ThreadSHWorkTables[threadId]);
+
+                // 0.5 is for Watson kappa
+                peakValue[1 + 5 * i + 4] = 0.5 * m_CurvatureScale * m_ODFSHBasis->getCurvatureAtPosition(modelValue,sphDirection[0],sphDirection[1],
+                                                                                                          m_ThreadSHWorkTables[threadId]);
+            }
+
+            peakItr.Set(peakValue);
+
+            ++modelItr;
+            ++peakItr;
+        }
+    }
+}
+
+unsigned int ODFProbabilisticTractographyImageFilter::GetCurrentODFMaxima(const VectorType &modelValue, DirectionVectorType &maxima,
+                                                                          ListType *odfValues, ListType *kappaValues,
+                                                                          bool is2d, unsigned int threadId)
+{
+    if (m_UsePrecomputedPeaks && (m_ThreadPeaksUsable[threadId] != 0))
+    {
+        PeakImageType::PixelType peakValue = m_PeakImage->GetPixel(m_ThreadPeakIndexes[threadId]);
+        unsigned int numDirs = peakValue[0];
+
+        maxima.resize(numDirs);
+        if (odfValues)
+            odfValues->resize(numDirs);
+        if (kappaValues)
+            kappaValues->resize(numDirs);
+
+        for (unsigned int i = 0;i < numDirs;++i)
+        {
+            for (unsigned int j = 0;j < 3;++j)
+                maxima[i][j] = peakValue[1 + 5 * i + j];
+
+            if (odfValues)
+                (*odfValues)[i] = peakValue[1 + 5 * i + 3];
+            if (kappaValues)
+                (*kappaValues)[i] = peakValue[1 + 5 * i + 4];
+        }
+
+        return numDirs;
+    }
+
+    unsigned int numDirs = this->FindODFMaxima(modelValue,maxima,m_MinimalDiffusionProbability,is2d);
+    if (!odfValues && !kappaValues)
+        return numDirs;
+
+    Vector3DType sphDirection;
+    if (odfValues)
+        odfValues->resize(numDirs);
+    if (kappaValues)
+        kappaValues->resize(numDirs);
+
+    for (unsigned int i = 0;i < numDirs;++i)
+    {
+        anima::TransformCartesianToSphericalCoordinates(maxima[i],sphDirection);
+
+        if (odfValues)
+            (*odfValues)[i] = m_ODFSHBasis->getValueAtPosition(modelValue,sphDirection[0],sphDirection[1],
+                                                               m_ThreadSHWorkTables[threadId]);
+
+        // 0.5 is for Watson kappa
+        if (kappaValues)
+            (*kappaValues)[i] = 0.5 * m_CurvatureScale * m_ODFSHBasis->getCurvatureAtPosition(modelValue,sphDirection[0],sphDirection[1],
+                                                                                               m_ThreadSHWorkTables[threadId]);
+    }
+
+    return numDirs;
 }
 
 ODFProbabilisticTractographyImageFilter::Vector3DType
 ODFProbabilisticTractographyImageFilter::ProposeNewDirection(Vector3DType &oldDirection, VectorType &modelValue,
                                                              Vector3DType &sampling_direction, double &log_prior,
-                                                             double &log_proposal, std::mt19937 &random_generator,
+                                                             double &log_proposal, RandomGeneratorType &random_generator,
                                                              unsigned int threadId)
 {
     Vector3DType resVec(0.0);
     bool is2d = (this->GetInputModelImage()->GetLargestPossibleRegion().GetSize()[2] == 1);
 
+    // ODF values and curvatures are the same at antipodal points, they can be computed before flipping maxima
     DirectionVectorType maximaODF;
-    unsigned int numDirs = this->FindODFMaxima(modelValue,maximaODF,m_MinimalDiffusionProbability,is2d);
-    ListType mixtureWeights(numDirs,0);
-    ListType kappaValues(numDirs,0);
+    ListType mixtureWeights, kappaValues;
+    unsigned int numDirs = this->GetCurrentODFMaxima(modelValue,maximaODF,&mixtureWeights,&kappaValues,is2d,threadId);
 
     double chosenKappa = 0;
 
-    Vector3DType sphDirection;
-
     double sumWeights = 0;
 
     for (unsigned int i = 0;i < numDirs;++i)
@@ -74,12 +247,6 @@ ODFProbabilisticTractographyImageFilter::ProposeNewDirection(Vector3DType &oldDi
         if (anima::ComputeScalarProduct(oldDirection, maximaODF[i]) < 0)
             maximaODF[i] *= -1;
 
-        anima::TransformCartesianToSphericalCoordinates(maximaODF[i],sphDirection);
-        mixtureWeights[i] = m_ODFSHBasis->getValueAtPosition(modelValue,sphDirection[0],sphDirection[1]);
-
-        // 0.5 is for Watson kappa
-        kappaValues[i] = 0.5 * m_CurvatureScale * m_ODFSHBasis->getCurvatureAtPosition(modelValue,sphDirection[0],sphDirection[1]);
-
         if ((std::isnan(kappaValues[i]))||(kappaValues[i] <= 0)||(kappaValues[i] >= 1000))
             mixtureWeights[i] = 0;
 
@@ -138,6 +305,128 @@ ODFProbabilisticTractographyImageFilter::ProposeNewDirection(Vector3DType &oldDi
     return resVec;
 }
 
+void
+ODFProbabilisticTractographyImageFilter::ProposeNewDirections(const MembershipType &activeParticles, std::vector <ContinuousIndexType> &tipIndexes,
+                                                              DirectionVectorType &oldDirections, std::vector <VectorType> &modelValues,
+                                                              DirectionVectorType &samplingDirections, ListType &logPriors,
+                                                              ListType &logProposals, DirectionVectorType &newDirections,
+                                                              RandomGeneratorType &random_generator, unsigned int threadId)
+{
+    unsigned int numParticles = activeParticles.size();
+    bool is2d = (this->GetInputModelImage()->GetLargestPossibleRegion().GetSize()[2] == 1);
+    double priorKappa = this->GetKappaOfPriorDistribution();
+
+    samplingDirections.resize(numParticles);
+    DirectionVectorType previousDirections(numParticles);
+    ListType kappaValues(numParticles,priorKappa);
+
+    // Proposal mixtures, stored contiguously: particle k owns components mixtureStarts[k] to mixtureStarts[k+1] (none if no usable maxima)
+    MembershipType mixtureStarts(numParticles + 1,0);
+    DirectionVectorType mixtureAxes;
+    ListType mixtureWeights, mixtureKappas;
+
+    DirectionVectorType maximaODF;
+    ListType odfValues, maximaKappas;
+    for (unsigned int k = 0;k < numParticles;++k)
+    {
+        unsigned int i = activeParticles[k];
+        previousDirections[k] = oldDirections[i];
+        mixtureStarts[k] = mixtureAxes.size();
+
+        // Peaks usability is thread state left by the last ComputeModelValue call, set it back for this particle
+        if (m_UsePrecomputedPeaks)
+            this->UpdateThreadPeaksUsability(tipIndexes[i],modelValues[i],threadId);
+
+        unsigned int numDirs = this->GetCurrentODFMaxima(modelValues[i],maximaODF,&odfValues,&maximaKappas,is2d,threadId);
+
+        double sumWeights = 0;
+        for (unsigned int j = 0;j < numDirs;++j)
+        {
+            if (anima::ComputeScalarProduct(previousDirections[k], maximaODF[j]) < 0)
+                maximaODF[j] *= -1;
+
+            if ((std::isnan(maximaKappas[j]))||(maximaKappas[j] <= 0)||(maximaKappas[j] >= 1000))
+                odfValues[j] = 0;
+
+            sumWeights += odfValues[j];
+        }
+
+        if (sumWeights == 0)
+        {
+            samplingDirections[k] = previousDirections[k];
+            continue;
+        }
+
+        for (unsigned int j = 0;j < numDirs;++j)
+            odfValues[j] /= sumWeights;
+
+        std::discrete_distribution<> dist(odfValues.begin(),odfValues.end());
+        unsigned int chosenDirection = dist(random_generator);
+
+        samplingDirections[k] = maximaODF[chosenDirection];
+        kappaValues[k] = maximaKappas[chosenDirection];
+
+        // Null weight components do not contribute to the proposal density
+        for (unsigned int j = 0;j < numDirs;++j)
+        {
+            if (odfValues[j] <= 0)
+                continue;
+
+            mixtureAxes.push_back(maximaODF[j]);
+            mixtureWeights.push_back(odfValues[j]);
+            mixtureKappas.push_back(maximaKappas[j]);
+        }
+    }
+
+    mixtureStarts[numParticles] = mixtureAxes.size();
+
+    anima::WatsonLogNormalizerCache &normalizerCache = this->GetWatsonNormalizerCache(threadId);
+    ListType sampleLogPdfs;
+    anima::SampleFromWatsonDistributions(kappaValues, samplingDirections, newDirections, sampleLogPdfs, normalizerCache, random_generator);
+
+    if (is2d)
+    {
+        for (unsigned int k = 0;k < numParticles;++k)
+        {
+            newDirections[k][InputModelImageType::ImageDimension - 1] = 0;
+            newDirections[k].Normalize();
+        }
+    }
+
+    ListType priorKappas(numParticles,priorKappa);
+    anima::EvaluateWatsonLogPDFs(newDirections, previousDirections, priorKappas, logPriors, normalizerCache);
+
+    // All mixture components of all particles are evaluated in one batch
+    DirectionVectorType componentSamples(mixtureAxes.size());
+    for (unsigned int k = 0;k < numParticles;++k)
+    {
+        for (unsigned int j = mixtureStarts[k];j < mixtureStarts[k + 1];++j)
+            componentSamples[j] = newDirections[k];
+    }
+
+    ListType componentLogPdfs;
+    anima::EvaluateWatsonLogPDFs(componentSamples, mixtureAxes, mixtureKappas, componentLogPdfs, normalizerCache);
+
+    logProposals.assign(numParticles,0.0);
+    ListType weightedLogPdfs;
+    for (unsigned int k = 0;k < numParticles;++k)
+    {
+        if (mixtureStarts[k] == mixtureStarts[k + 1])
+            logPriors[k] = 0;
+        else
+        {
+            weightedLogPdfs.clear();
+            for (unsigned int j = mixtureStarts[k];j < mixtureStarts[k + 1];++j)
+                weightedLogPdfs.push_back(std::log(mixtureWeights[j]) + componentLogPdfs[j]);
+
+            logProposals[k] = anima::ExponentialSum(weightedLogPdfs);
+        }
+
+        if (anima::ComputeScalarProduct(previousDirections[k], newDirections[k]) < 0)
+            newDirections[k] *= -1;
+    }
+}
+
 ODFProbabilisticTractographyImageFilter::Vector3DType ODFProbabilisticTractographyImageFilter::InitializeFirstIterationFromModel(Vector3DType &colinearDir, VectorType &modelValue,
                                                                                                                                  unsigned int threadId)
 {
@@ -145,7 +434,7 @@ ODFProbabilisticTractographyImageFilter::Vector3DType ODFProbabilisticTractograp
     bool is2d = (this->GetInputModelImage()->GetLargestPossibleRegion().GetSize()[2] == 1);
 
     DirectionVectorType maximaODF;
-    unsigned int numDirs = this->FindODFMaxima(modelValue,maximaODF,m_MinimalDiffusionProbability,is2d);
+    unsigned int numDirs = this->GetCurrentODFMaxima(modelValue,maximaODF,0,0,is2d,threadId);
     if (numDirs == 0)
         return colinearDir;
 
@@ -229,7 +518,7 @@ double ODFProbabilisticTractographyImageFilter::ComputeLogWeightUpdate(double b0
     bool is2d = (this->GetInputModelImage()->GetLargestPossibleRegion().GetSize()[2] == 1);
 
     DirectionVectorType maximaODF;
-    unsigned int numDirs = this->FindODFMaxima(modelValue,maximaODF,m_MinimalDiffusionProbability,is2d);
+    unsigned int numDirs = this->GetCurrentODFMaxima(modelValue,maximaODF,0,0,is2d,threadId);
 
     double concentrationParameter = b0Value / std::sqrt(noiseValue);
 
@@ -308,16 +597,17 @@ unsigned int ODFProbabilisticTractographyImageFilter::FindODFMaxima(const Vector
     opt->SetLowerBoundParameters(lowerBounds);
     opt->SetUpperBoundParameters(upperBounds);
 
+    // One cost function (hence one SH basis) for all starting directions
+    CostFunctionType::Pointer cost = CostFunctionType::New();
+    cost->SetODFSHOrder(m_ODFSHOrder);
+    cost->SetBasisParameters(modelValueList);
+
     for (unsigned int i = 0; i < initDirs.size();++i)
     {
         anima::TransformCartesianToSphericalCoordinates(initDirs[i],angle);
         tmpValue[0] = angle[0];
         tmpValue[1] = angle[1];
 
-        CostFunctionType::Pointer cost = CostFunctionType::New();
-        cost->SetODFSHOrder(m_ODFSHOrder);
-        cost->SetBasisParameters(modelValueList);
-
         opt->SetCostFunction(cost);
         opt->SetMaximize(true);
 
@@ -398,13 +688,56 @@ unsigned int ODFProbabilisticTractographyImageFilter::FindODFMaxima(const Vector
 }
 
 void ODFProbabilisticTractographyImageFilter::ComputeModelValue(InterpolatorPointer &modelInterpolator, ContinuousIndexType &index,
-                                                                VectorType &modelValue)
+                                                                VectorType &modelValue, unsigned int threadId)
 {
     modelValue.SetSize(this->GetModelDimension());
     modelValue.Fill(0.0);
 
-    if (modelInterpolator->IsInsideBuffer(index))
-        modelValue = modelInterpolator->EvaluateAtContinuousIndex(index);
+    if (!modelInterpolator->IsInsideBuffer(index))
+    {
+        if (m_UsePrecomputedPeaks)
+            m_ThreadPeaksUsable[threadId] = 0;
+
+        return;
+    }
+
+    modelValue = modelInterpolator->EvaluateAtContinuousIndex(index);
+
+    if (!m_UsePrecomputedPeaks)
+        return;
+
+    this->UpdateThreadPeaksUsability(index,modelValue,threadId);
+}
+
+void ODFProbabilisticTractographyImageFilter::UpdateThreadPeaksUsability(const ContinuousIndexType &index, const VectorType &modelValue,
+                                                                         unsigned int threadId)
+{
+    // Closest voxel peaks are used if the interpolated ODF is close to the voxel ODF
+    m_ThreadPeaksUsable[threadId] = 0;
+    IndexType closestIndex;
+    for (unsigned int i = 0;i < InputModelImageType::ImageDimension;++i)
+        closestIndex[i] = std::floor(index[i] + 0.5);
+
+    if (!m_PeakImage->GetLargestPossibleRegion().IsInside(closestIndex))
+        return;
+
+    if (m_PeakImage->GetPixel(closestIndex)[0] == 0)
+        return;
+
+    InputModelImageType::PixelType voxelValue = this->GetInputModelImage()->GetPixel(closestIndex);
+    double voxelNorm = 0;
+    double distance = 0;
+    for (unsigned int i = 0;i < this->GetModelDimension();++i)
+    {
+        voxelNorm += voxelValue[i] * voxelValue[i];
+        distance += (voxelValue[i] - modelValue[i]) * (voxelValue[i] - modelValue[i]);
+    }
+
+    if (distance <= m_PeakODFDistanceThreshold * m_PeakODFDistanceThreshold * voxelNorm)
+    {
+        m_ThreadPeakIndexes[threadId] = closestIndex;
+        m_ThreadPeaksUsable[threadId] = 1;
+    }
 }
 
 double ODFProbabilisticTractographyImageFilter::GetGeneralizedFractionalAnisotropy(VectorType &modelValue)
@@ -33,6 +33,19 @@ public:
     itkSetMacro(CurvatureScale,double)
     itkSetMacro(MinimalDiffusionProbability,double)
 
+    //! Extract peaks of all voxel ODFs once before tracking, instead of searching maxima at each particle step
+    itkSetMacro(UsePrecomputedPeaks,bool)
+
+    //! Maximal distance between particle and closest voxel ODFs, relative to the voxel ODF norm, to use voxel peaks
+    itkSetMacro(PeakODFDistanceThreshold,double)
+
+    /**
+     * Peak image: for each voxel, number of peaks followed, for each peak, by its direction, ODF value and Watson kappa.
+     * Only available after tracking with precomputed peaks
+     */
+    typedef itk::VectorImage <float, 3> PeakImageType;
+    PeakImageType *GetPeakImage() {return m_PeakImage;}
+
 protected:
     ODFProbabilisticTractographyImageFilter();
     virtual ~ODFProbabilisticTractographyImageFilter();
@@ -42,12 +55,20 @@ protected:
 
     virtual Vector3DType ProposeNewDirection(Vector3DType &oldDirection, VectorType &modelValue,
                                           Vector3DType &sampling_direction, double &log_prior,
-                                          double &log_proposal, std::mt19937 &random_generator, unsigned int threadId) ITK_OVERRIDE;
+                                          double &log_proposal, RandomGeneratorType &random_generator, unsigned int threadId) ITK_OVERRIDE;
+
+    //! Batched proposal for the whole particle set, Watson samples and log-densities computed with cached normalizers
+    virtual void ProposeNewDirections(const MembershipType &activeParticles, std::vector <ContinuousIndexType> &tipIndexes,
+                                      DirectionVectorType &oldDirections, std::vector <VectorType> &modelValues,
+                                      DirectionVectorType &samplingDirections, ListType &logPriors, ListType &logProposals,
+                                      DirectionVectorType &newDirections, RandomGeneratorType &random_generator,
+                                      unsigned int threadId) ITK_OVERRIDE;
 
     virtual double ComputeLogWeightUpdate(double b0Value, double noiseValue, Vector3DType &newDirection, VectorType &modelValue,
                                           double &log_prior, double &log_proposal, unsigned int threadId) ITK_OVERRIDE;
 
-    virtual void ComputeModelValue(InterpolatorPointer &modelInterpolator, ContinuousIndexType &index, VectorType &modelValue) ITK_OVERRIDE;
+    virtual void ComputeModelValue(InterpolatorPointer &modelInterpolator, ContinuousIndexType &index, VectorType &modelValue,
+                                   unsigned int threadId) ITK_OVERRIDE;
 
     virtual Vector3DType InitializeFirstIterationFromModel(Vector3DType &colinearDir, VectorType &modelValue,
                                                            unsigned int threadId) ITK_OVERRIDE;
@@ -55,6 +76,21 @@ protected:
                                       VectorType &modelValue, unsigned int threadId) ITK_OVERRIDE;
 
     unsigned int FindODFMaxima(const VectorType &modelValue, DirectionVectorType &maxima, double minVal, bool is2d);
+
+    //! Sets whether precomputed peaks of the voxel closest to index can be used for modelValue (thread state read by GetCurrentODFMaxima)
+    void UpdateThreadPeaksUsability(const ContinuousIndexType &index, const VectorType &modelValue, unsigned int threadId);
+
+    /**
+     * ODF maxima at the current particle position of a thread, with their ODF values and kappas if required (non null
+     * lists). Read from the peak image if the particle ODF is close enough to its voxel ODF, searched for otherwise
+     */
+    unsigned int GetCurrentODFMaxima(const VectorType &modelValue, DirectionVectorType &maxima, ListType *odfValues,
+                                     ListType *kappaValues, bool is2d, unsigned int threadId);
+
+    //! Computes the peak image, voxel slices are processed by several threads
+    void ComputePeakImage();
+    static ITK_THREAD_RETURN_TYPE ThreadPeakExtractor(void *arg);
+    void ExtractPeaksOfSlices(unsigned int threadId, unsigned int numThreads);
     double GetGeneralizedFractionalAnisotropy(VectorType &modelValue);
 
 private:
@@ -70,6 +106,20 @@ private:
 
     unsigned int m_ODFSHOrder;
     anima::ODFSphericalHarmonicBasis *m_ODFSHBasis;
+
+    //! Basis tables of each thread, the basis being shared
+    std::vector <anima::ODFSphericalHarmonicBasis::WorkTables> m_ThreadSHWorkTables;
+
+    bool m_UsePrecomputedPeaks;
+    double m_PeakODFDistanceThreshold;
+    PeakImageType::Pointer m_PeakImage;
+
+    //! Maximal number of peaks stored per voxel, highest ODF values are kept
+    static const unsigned int m_MaximalNumberOfPeaks = 5;
+
+    //! For each thread, voxel whose peaks are used for the current particle (if usable flag is non zero)
+    std::vector <IndexType> m_ThreadPeakIndexes;
+    std::vector <unsigned char> m_ThreadPeaksUsable;
 };
 
 } // end of namespace anima
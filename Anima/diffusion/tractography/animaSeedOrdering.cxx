@@ -0,0 +1,60 @@
+#include "animaSeedOrdering.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace anima
+{
+
+//! Spreads the lowest 21 bits of value so that two zero bits separate each of them
+static itk::uint64_t SpreadMortonBits(itk::uint64_t value)
+{
+    value &= 0x1fffff;
+    value = (value | (value << 32)) & 0x1f00000000ffffULL;
+    value = (value | (value << 16)) & 0x1f0000ff0000ffULL;
+    value = (value | (value << 8)) & 0x100f00f00f00f00fULL;
+    value = (value | (value << 4)) & 0x10c30c30c30c30c3ULL;
+    value = (value | (value << 2)) & 0x1249249249249249ULL;
+
+    return value;
+}
+
+itk::uint64_t ComputeMortonCode(const itk::Index <3> &index)
+{
+    return SpreadMortonBits(index[0]) | (SpreadMortonBits(index[1]) << 1) | (SpreadMortonBits(index[2]) << 2);
+}
+
+void SortIndexesAlongMortonCurve(std::vector < itk::Index <3> > &indexes)
+{
+    if (indexes.size() < 2)
+        return;
+
+    itk::Index <3> minIndex = indexes[0];
+    for (unsigned int i = 1;i < indexes.size();++i)
+    {
+        for (unsigned int j = 0;j < 3;++j)
+            minIndex[j] = std::min(minIndex[j],indexes[i][j]);
+    }
+
+    typedef std::pair <itk::uint64_t, unsigned int> CodePairType;
+    std::vector <CodePairType> mortonCodes(indexes.size());
+    itk::Index <3> relativeIndex;
+    for (unsigned int i = 0;i < indexes.size();++i)
+    {
+        for (unsigned int j = 0;j < 3;++j)
+            relativeIndex[j] = indexes[i][j] - minIndex[j];
+
+        mortonCodes[i] = CodePairType(ComputeMortonCode(relativeIndex),i);
+    }
+
+    // Ties cannot happen for distinct indexes, the pair comparison keeps the sort deterministic anyway
+    std::sort(mortonCodes.begin(),mortonCodes.end());
+
+    std::vector < itk::Index <3> > sortedIndexes(indexes.size());
+    for (unsigned int i = 0;i < mortonCodes.size();++i)
+        sortedIndexes[i] = indexes[mortonCodes[i].second];
+
+    indexes.swap(sortedIndexes);
+}
+
+} // end namespace anima
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <itkIndex.h>
+#include <itkIntTypes.h>
+
+#include "AnimaTractographyExport.h"
+
+#include <vector>
+
+namespace anima
+{
+
+//! Morton (Z-order) code of a non negative 3D index, interleaving the lowest 21 bits of each coordinate
+ANIMATRACTOGRAPHY_EXPORT itk::uint64_t ComputeMortonCode(const itk::Index <3> &index);
+
+/**
+ * Sorts voxel indexes along a Morton curve (relative to their lowest coordinates). Voxels consecutive in the
+ * resulting vector are spatially close, so that seed chunks handed to tracking threads cover compact bricks
+ * and reuse the same model image neighborhoods instead of sweeping whole image rows.
+ */
+ANIMATRACTOGRAPHY_EXPORT void SortIndexesAlongMortonCurve(std::vector < itk::Index <3> > &indexes);
+
+} // end namespace anima
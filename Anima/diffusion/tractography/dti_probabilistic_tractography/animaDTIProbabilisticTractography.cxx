@@ -9,6 +9,7 @@
 #include <itkCommand.h>
 
 #include <animaShapesWriter.h>
+#include <animaStreamingFibersWriter.h>
 
 void ComputeKappaPolynomialCoefficients(std::vector <double> &resVal)
 {
@@ -71,6 +72,14 @@ int main(int argc,  char*  argv[])
     
     TCLAP::SwitchArg averageClustersArg("M","average-clusters","Output only cluster mean",cmd,false);
     
+    TCLAP::SwitchArg streamArg("","stream","Write fibers to disk while tracking, memory does not grow with the number of fibers (vtk or fibb output only, no local colors)",cmd,false);
+    TCLAP::SwitchArg mortonSeedsArg("","morton-seeds","Process seeds along a Morton curve instead of raster order, for cache locality",cmd,false);
+
+    TCLAP::ValueArg<unsigned int> randomSeedArg("","random-seed","Key of the per seed random streams, fixing it makes runs reproducible (default: current time)",false,0,"random seed",cmd);
+    TCLAP::ValueArg<unsigned int> firstSeedArg("","first-seed","Index of the first seed to track, to split a run across processes (default: 0)",false,0,"first seed index",cmd);
+    TCLAP::ValueArg<unsigned int> nbSeedsArg("","nb-seeds","Number of seeds to track from the first one (default: 0, all remaining)",false,0,"number of seeds",cmd);
+    TCLAP::ValueArg<unsigned int> threadsPerSeedArg("","threads-per-seed","Number of threads sharing the particles of a seed (default: 0, automatic when there are less seeds than threads)",false,0,"threads per seed",cmd);
+
     TCLAP::ValueArg<unsigned int> nbThreadsArg("T","nb-threads","Number of threads to run on (default: all available)",false,itk::MultiThreader::GetGlobalDefaultNumberOfThreads(),"number of threads",cmd);
     
     try
@@ -146,6 +155,12 @@ int main(int argc,  char*  argv[])
     dtiTracker->SetClusterDistance(clusterDistArg.getValue());
     
     dtiTracker->SetComputeLocalColors(fibersArg.getValue().find(".fds") != std::string::npos);
+    dtiTracker->SetMortonSeedOrdering(mortonSeedsArg.getValue());
+    if (randomSeedArg.isSet())
+        dtiTracker->SetRandomSeed(randomSeedArg.getValue());
+    dtiTracker->SetFirstSeedIndex(firstSeedArg.getValue());
+    dtiTracker->SetNumberOfSeedsToProcess(nbSeedsArg.getValue());
+    dtiTracker->SetNumberOfThreadsPerSeed(threadsPerSeedArg.getValue());
     dtiTracker->SetMAPMergeFibers(averageClustersArg.isSet());
     dtiTracker->SetNumberOfThreads(nbThreadsArg.getValue());
 
@@ -153,6 +168,16 @@ int main(int argc,  char*  argv[])
     callback->SetCallback(eventCallback);
     dtiTracker->AddObserver(itk::ProgressEvent(), callback);
 
+    anima::StreamingFibersWriter streamingWriter;
+    if (streamArg.isSet())
+    {
+        dtiTracker->SetComputeLocalColors(false);
+        streamingWriter.SetFileName(fibersArg.getValue());
+        streamingWriter.SetWriteWeights(true);
+        streamingWriter.Open();
+        dtiTracker->SetStreamingWriter(&streamingWriter);
+    }
+
     itk::TimeProbe tmpTime;
     tmpTime.Start();
     
@@ -162,6 +187,22 @@ int main(int argc,  char*  argv[])
     tmpTime.Stop();
     std::cout << "Tracking time: " << tmpTime.GetTotal() << "s" << std::endl;
     
+    if (streamArg.isSet())
+    {
+        try
+        {
+            streamingWriter.Close();
+        }
+        catch (itk::ExceptionObject &e)
+        {
+            std::cerr << e << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::cout << "Kept " << streamingWriter.GetNumberOfFibers() << " fibers after filtering" << std::endl;
+        return EXIT_SUCCESS;
+    }
+
     anima::ShapesWriter writer;
     writer.SetInputData(dtiTracker->GetOutput());
     writer.SetFileName(fibersArg.getValue());
@@ -9,6 +9,7 @@
 #include <tclap/CmdLine.h>
 
 #include <animaShapesWriter.h>
+#include <animaStreamingFibersWriter.h>
 
 //Update progression of the process
 void eventCallback (itk::Object* caller, const itk::EventObject& event, void* clientData)
@@ -40,6 +41,9 @@ int main(int argc,  char*  argv[])
     TCLAP::ValueArg<double> minLengthArg("","min-length","Minimum length for a fiber to be considered for computation (default: 10mm)",false,10.0,"minimum length",cmd);
     TCLAP::ValueArg<double> maxLengthArg("","max-length","Maximum length of a tract (default: 150mm)",false,150.0,"maximum length",cmd);
 
+    TCLAP::SwitchArg streamArg("","stream","Write fibers to disk while tracking, memory does not grow with the number of fibers (vtk or fibb output only, no local colors)",cmd,false);
+    TCLAP::SwitchArg mortonSeedsArg("","morton-seeds","Process seeds along a Morton curve instead of raster order, for cache locality",cmd,false);
+
     TCLAP::ValueArg<unsigned int> nbThreadsArg("T","nb-threads","Number of threads to run on (default: all available)",false,itk::MultiThreader::GetGlobalDefaultNumberOfThreads(),"number of threads",cmd);
 
     try
@@ -92,11 +96,21 @@ int main(int argc,  char*  argv[])
 
     bool computeColors = (fibersArg.getValue().find(".fds") != std::string::npos);
     dtiTracker->SetComputeLocalColors(computeColors);
+    dtiTracker->SetMortonSeedOrdering(mortonSeedsArg.getValue());
 
     itk::CStyleCommand::Pointer callback = itk::CStyleCommand::New();
     callback->SetCallback(eventCallback);
     dtiTracker->AddObserver(itk::ProgressEvent(), callback);
 
+    anima::StreamingFibersWriter streamingWriter;
+    if (streamArg.isSet())
+    {
+        dtiTracker->SetComputeLocalColors(false);
+        streamingWriter.SetFileName(fibersArg.getValue());
+        streamingWriter.Open();
+        dtiTracker->SetStreamingWriter(&streamingWriter);
+    }
+
     itk::TimeProbe tmpTime;
     tmpTime.Start();
 
@@ -106,6 +120,22 @@ int main(int argc,  char*  argv[])
     tmpTime.Stop();
     std::cout << "Tracking time: " << tmpTime.GetTotal() << "s" << std::endl;
 
+    if (streamArg.isSet())
+    {
+        try
+        {
+            streamingWriter.Close();
+        }
+        catch (itk::ExceptionObject &e)
+        {
+            std::cerr << e << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::cout << "Kept " << streamingWriter.GetNumberOfFibers() << " fibers after filtering" << std::endl;
+        return EXIT_SUCCESS;
+    }
+
     anima::ShapesWriter writer;
     writer.SetInputData(dtiTracker->GetOutput());
     writer.SetFileName(fibersArg.getValue());
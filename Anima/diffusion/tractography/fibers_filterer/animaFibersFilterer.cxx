@@ -4,96 +4,250 @@
 #include <animaShapesWriter.h>
 
 #include <animaShapesReader.h>
+#include <animaFibersBinaryFileFormat.h>
 #include <vtkSmartPointer.h>
 #include <vtkPoints.h>
 #include <vtkPointData.h>
+#include <vtkCellData.h>
+#include <vtkCellArray.h>
+#include <vtkIdList.h>
 #include <vtkPolyData.h>
 #include <vtkCleanPolyData.h>
-#include <vtkGenericCell.h>
 
-#include <itkNearestNeighborInterpolateImageFunction.h>
+#include <itkImageRegionConstIteratorWithIndex.h>
 #include <itkMultiThreader.h>
+#include <itksys/SystemTools.hxx>
 
-void FilterTracks(vtkPolyData *tracks, unsigned int startIndex, unsigned int endIndex,
-                  itk::NearestNeighborInterpolateImageFunction < itk::Image <unsigned short, 3> > * interpolator,
-                  const std::vector <unsigned int> &touchLabels, const std::vector <unsigned int> &forbiddenLabels)
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+typedef itk::Image <unsigned short, 3> ROIImageType;
+
+//! Fibers selection: output file and labels that have to be / must not be touched
+struct FibersSelection
 {
-    std::vector <unsigned int> seenLabels;
-    double pointPositionVTK[3];
-    itk::ContinuousIndex<double, 3> currentIndex;
-    typedef itk::Image <unsigned short, 3>::PointType PointType;
-    PointType pointPosition;
-
-    vtkSmartPointer <vtkGenericCell> cell = vtkGenericCell::New();
-    for (unsigned int i = startIndex;i < endIndex;++i)
+    std::string outputName;
+    std::vector <unsigned int> touchLabels;
+    std::vector <unsigned int> forbiddenLabels;
+};
+
+/**
+ * Reads selections from a text file, one per line: output file name followed by -t and -f label options as on the
+ * command line (e.g. "cst_left.fibb -t 3 -t 12 -f 40"). Empty lines and lines starting with # are ignored.
+ */
+void ReadSelectionsFile(const std::string &fileName, std::vector <FibersSelection> &selections)
+{
+    std::ifstream selectionsFile(fileName.c_str());
+    if (!selectionsFile.is_open())
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Could not open selections file " + fileName,ITK_LOCATION);
+
+    std::string line;
+    while (std::getline(selectionsFile,line))
     {
-        // Inspect i-th cell
-        tracks->GetCell(i,cell);
-        vtkPoints *cellPts = cell->GetPoints();
-        vtkIdType numCellPts = cellPts->GetNumberOfPoints();
-        seenLabels.clear();
-        bool lineOk = true;
-
-        for (unsigned int j = 0;j < numCellPts;++j)
+        std::istringstream lineStream(line);
+        FibersSelection selection;
+        if (!(lineStream >> selection.outputName) || (selection.outputName[0] == '#'))
+            continue;
+
+        std::string option;
+        while (lineStream >> option)
         {
-            cellPts->GetPoint(j, pointPositionVTK);
-            for (unsigned int k = 0; k < 3; ++k)
-                pointPosition[k] = pointPositionVTK[k];
+            unsigned int label;
+            if (!(lineStream >> label) || ((option != "-t") && (option != "-f")))
+                throw itk::ExceptionObject(__FILE__, __LINE__,"Invalid selection line: " + line,ITK_LOCATION);
+
+            if (option == "-t")
+                selection.touchLabels.push_back(label);
+            else
+                selection.forbiddenLabels.push_back(label);
+        }
 
-            interpolator->GetInputImage()->TransformPhysicalPointToContinuousIndex(pointPosition,currentIndex);
+        selections.push_back(selection);
+    }
+}
 
-            if (!interpolator->IsInsideBuffer(currentIndex))
-                continue;
+/**
+ * Compact nearest neighbour lookup of ROI labels. The label image is cropped to the bounding box of voxels holding
+ * labels used by at least one selection, and those labels are replaced by class indices (starting at 1, 0 elsewhere)
+ */
+class ROILabelLookup
+{
+public:
+    void Initialize(ROIImageType *roiImage, const std::vector <unsigned int> &usedLabels)
+    {
+        m_PointToIndexMatrix = roiImage->GetPhysicalPointToIndexMatrix();
+        m_Origin = roiImage->GetOrigin();
+
+        std::vector <unsigned short> labelClasses(itk::NumericTraits <unsigned short>::max() + 1,0);
+        for (unsigned int i = 0;i < usedLabels.size();++i)
+        {
+            if (usedLabels[i] < labelClasses.size())
+                labelClasses[usedLabels[i]] = i + 1;
+        }
 
-            unsigned int value = interpolator->EvaluateAtContinuousIndex(currentIndex);
+        typedef itk::ImageRegionConstIteratorWithIndex <ROIImageType> IteratorType;
+        ROIImageType::IndexType minIndex, maxIndex;
+        bool emptyLookup = true;
 
-            for (unsigned int k = 0;k < forbiddenLabels.size();++k)
+        IteratorType roiItr(roiImage,roiImage->GetLargestPossibleRegion());
+        while (!roiItr.IsAtEnd())
+        {
+            if (labelClasses[roiItr.Get()] != 0)
             {
-                if (value == forbiddenLabels[k])
+                ROIImageType::IndexType currentIndex = roiItr.GetIndex();
+                for (unsigned int k = 0;k < 3;++k)
                 {
-                    lineOk = false;
-                    break;
+                    minIndex[k] = emptyLookup ? currentIndex[k] : std::min(minIndex[k],currentIndex[k]);
+                    maxIndex[k] = emptyLookup ? currentIndex[k] : std::max(maxIndex[k],currentIndex[k]);
                 }
+
+                emptyLookup = false;
             }
 
-            if (!lineOk)
-                break;
+            ++roiItr;
+        }
 
-            for (unsigned int k = 0;k < touchLabels.size();++k)
+        for (unsigned int k = 0;k < 3;++k)
+        {
+            m_Start[k] = emptyLookup ? 0 : minIndex[k];
+            m_Size[k] = emptyLookup ? 0 : maxIndex[k] - minIndex[k] + 1;
+        }
+
+        m_Classes.clear();
+        if (emptyLookup)
+            return;
+
+        ROIImageType::RegionType croppedRegion;
+        for (unsigned int k = 0;k < 3;++k)
+        {
+            croppedRegion.SetIndex(k,m_Start[k]);
+            croppedRegion.SetSize(k,m_Size[k]);
+        }
+
+        // Region iterators go along x first, as the lookup buffer
+        m_Classes.resize(m_Size[0] * m_Size[1] * m_Size[2]);
+        IteratorType croppedItr(roiImage,croppedRegion);
+        for (unsigned int i = 0;i < m_Classes.size();++i,++croppedItr)
+            m_Classes[i] = labelClasses[croppedItr.Get()];
+    }
+
+    //! Class of the voxel containing a physical point, 0 if it has no used label or is outside of the image
+    unsigned short GetClass(const double *point) const
+    {
+        unsigned int offset = 0;
+        unsigned int stride = 1;
+        for (unsigned int k = 0;k < 3;++k)
+        {
+            double continuousIndex = 0;
+            for (unsigned int l = 0;l < 3;++l)
+                continuousIndex += m_PointToIndexMatrix(k,l) * (point[l] - m_Origin[l]);
+
+            long index = (long)std::floor(continuousIndex + 0.5) - m_Start[k];
+            if ((index < 0)||(index >= (long)m_Size[k]))
+                return 0;
+
+            offset += index * stride;
+            stride *= m_Size[k];
+        }
+
+        return m_Classes[offset];
+    }
+
+private:
+    std::vector <unsigned short> m_Classes;
+    ROIImageType::DirectionType m_PointToIndexMatrix;
+    ROIImageType::PointType m_Origin;
+    long m_Start[3];
+    unsigned int m_Size[3];
+};
+
+/**
+ * Tracks as flat arrays: fiber i spans positions fiberOffsets[i] to fiberOffsets[i + 1]. For a mapped binary file,
+ * positions are point indices in pointRecords. For polydata, positions index pointIds, gathered once from the lines.
+ */
+struct TracksArrays
+{
+    itk::uint64_t numFibers;
+    const itk::uint64_t *fiberOffsets;
+
+    vtkPoints *points;
+    const vtkIdType *pointIds;
+
+    const float *pointRecords;
+    unsigned int recordLength;
+};
+
+typedef struct
+{
+    TracksArrays tracks;
+    const ROILabelLookup *lookup;
+
+    // For each label class: selections requiring it (with their bit in the touched mask), selections forbidding it
+    std::vector < std::vector < std::pair <unsigned int, itk::uint64_t> > > classTouches;
+    std::vector < std::vector <unsigned int> > classForbids;
+    std::vector <itk::uint64_t> fullTouchMasks;
+
+    // Kept fibers indices, per thread and per selection
+    std::vector < std::vector < std::vector <unsigned int> > > keptFibers;
+} ThreaderArguments;
+
+void FilterTracks(ThreaderArguments *args, unsigned int threadId, itk::uint64_t startIndex, itk::uint64_t endIndex)
+{
+    const TracksArrays &tracks = args->tracks;
+    unsigned int numSelections = args->fullTouchMasks.size();
+    std::vector <itk::uint64_t> touchedMasks(numSelections);
+    std::vector <bool> rejected(numSelections);
+    std::vector < std::vector <unsigned int> > &keptFibers = args->keptFibers[threadId];
+
+    double pointPosition[3];
+    for (itk::uint64_t i = startIndex;i < endIndex;++i)
+    {
+        std::fill(touchedMasks.begin(),touchedMasks.end(),0);
+        std::fill(rejected.begin(),rejected.end(),false);
+        unsigned int numRemaining = numSelections;
+        unsigned short previousClass = 0;
+
+        for (itk::uint64_t j = tracks.fiberOffsets[i];(j < tracks.fiberOffsets[i + 1])&&(numRemaining != 0);++j)
+        {
+            if (tracks.pointRecords)
             {
-                if (value == touchLabels[k])
+                const float *pointRecord = tracks.pointRecords + j * tracks.recordLength;
+                for (unsigned int k = 0;k < 3;++k)
+                    pointPosition[k] = pointRecord[k];
+            }
+            else
+                tracks.points->GetPoint(tracks.pointIds[j],pointPosition);
+
+            // Consecutive points mostly lie in the same region, nothing new to learn from them
+            unsigned short currentClass = args->lookup->GetClass(pointPosition);
+            if ((currentClass == 0)||(currentClass == previousClass))
+                continue;
+
+            previousClass = currentClass;
+            const std::vector <unsigned int> &forbids = args->classForbids[currentClass];
+            for (unsigned int k = 0;k < forbids.size();++k)
+            {
+                if (!rejected[forbids[k]])
                 {
-                    bool alreadyIn = false;
-                    for (unsigned int l = 0;l < seenLabels.size();++l)
-                    {
-                        if (seenLabels[l] == value)
-                        {
-                            alreadyIn = true;
-                            break;
-                        }
-                    }
-
-                    if (!alreadyIn)
-                        seenLabels.push_back(value);
-
-                    break;
+                    rejected[forbids[k]] = true;
+                    --numRemaining;
                 }
             }
+
+            const std::vector < std::pair <unsigned int, itk::uint64_t> > &touches = args->classTouches[currentClass];
+            for (unsigned int k = 0;k < touches.size();++k)
+                touchedMasks[touches[k].first] |= touches[k].second;
         }
 
-        if (!lineOk || (seenLabels.size() != touchLabels.size()))
-            tracks->DeleteCell(i);
+        for (unsigned int s = 0;s < numSelections;++s)
+        {
+            if (!rejected[s] && (touchedMasks[s] == args->fullTouchMasks[s]))
+                keptFibers[s].push_back(i);
+        }
     }
 }
 
-typedef struct
-{
-    vtkPolyData *tracks;
-    itk::NearestNeighborInterpolateImageFunction < itk::Image <unsigned short, 3> > *interpolator;
-    std::vector <unsigned int> touchLabels;
-    std::vector <unsigned int> forbiddenLabels;
-} ThreaderArguments;
-
 ITK_THREAD_RETURN_TYPE ThreadFilterer(void *arg)
 {
     itk::MultiThreader::ThreadInfoStruct *threadArgs = (itk::MultiThreader::ThreadInfoStruct *)arg;
@@ -101,27 +255,84 @@ ITK_THREAD_RETURN_TYPE ThreadFilterer(void *arg)
     unsigned int numTotalThread = threadArgs->NumberOfThreads;
 
     ThreaderArguments *tmpArg = (ThreaderArguments *)threadArgs->UserData;
-    unsigned int nbTotalCells = tmpArg->tracks->GetNumberOfCells();
+    itk::uint64_t nbTotalCells = tmpArg->tracks.numFibers;
 
-    unsigned int step = nbTotalCells / numTotalThread;
-    unsigned int startIndex = nbThread * step;
-    unsigned int endIndex = (nbThread + 1) * step;
+    itk::uint64_t step = nbTotalCells / numTotalThread;
+    itk::uint64_t startIndex = nbThread * step;
+    itk::uint64_t endIndex = (nbThread + 1) * step;
 
     if (nbThread == numTotalThread - 1)
         endIndex = nbTotalCells;
 
-    FilterTracks(tmpArg->tracks, startIndex, endIndex, tmpArg->interpolator, tmpArg->touchLabels, tmpArg->forbiddenLabels);
+    FilterTracks(tmpArg, nbThread, startIndex, endIndex);
 
     return NULL;
 }
 
+//! Builds the class tables of the threader arguments and the ROI lookup from the selections
+void PrepareSelections(const std::vector <FibersSelection> &selections, ROIImageType *roiImage,
+                       ROILabelLookup &lookup, ThreaderArguments &args)
+{
+    std::vector <unsigned int> usedLabels;
+    for (unsigned int s = 0;s < selections.size();++s)
+    {
+        usedLabels.insert(usedLabels.end(),selections[s].touchLabels.begin(),selections[s].touchLabels.end());
+        usedLabels.insert(usedLabels.end(),selections[s].forbiddenLabels.begin(),selections[s].forbiddenLabels.end());
+    }
+
+    std::sort(usedLabels.begin(),usedLabels.end());
+    usedLabels.erase(std::unique(usedLabels.begin(),usedLabels.end()),usedLabels.end());
+
+    lookup.Initialize(roiImage,usedLabels);
+    args.lookup = &lookup;
+
+    args.classTouches.assign(usedLabels.size() + 1,std::vector < std::pair <unsigned int, itk::uint64_t> > ());
+    args.classForbids.assign(usedLabels.size() + 1,std::vector <unsigned int> ());
+    args.fullTouchMasks.assign(selections.size(),0);
+
+    for (unsigned int s = 0;s < selections.size();++s)
+    {
+        std::vector <unsigned int> touchLabels = selections[s].touchLabels;
+        std::sort(touchLabels.begin(),touchLabels.end());
+        touchLabels.erase(std::unique(touchLabels.begin(),touchLabels.end()),touchLabels.end());
+
+        if (touchLabels.size() > 64)
+            throw itk::ExceptionObject(__FILE__, __LINE__,"At most 64 labels to touch are supported per selection",ITK_LOCATION);
+
+        for (unsigned int k = 0;k < touchLabels.size();++k)
+        {
+            unsigned int classIndex = std::lower_bound(usedLabels.begin(),usedLabels.end(),touchLabels[k]) - usedLabels.begin() + 1;
+            itk::uint64_t touchBit = (itk::uint64_t)1 << k;
+            args.classTouches[classIndex].push_back(std::make_pair(s,touchBit));
+            args.fullTouchMasks[s] |= touchBit;
+        }
+
+        for (unsigned int k = 0;k < selections[s].forbiddenLabels.size();++k)
+        {
+            unsigned int classIndex = std::lower_bound(usedLabels.begin(),usedLabels.end(),selections[s].forbiddenLabels[k]) - usedLabels.begin() + 1;
+            std::vector <unsigned int> &forbids = args.classForbids[classIndex];
+            if (std::find(forbids.begin(),forbids.end(),s) == forbids.end())
+                forbids.push_back(s);
+        }
+    }
+}
+
+//! Gathers kept fibers of a selection from all threads, in increasing order since threads work on consecutive ranges
+void GatherKeptFibers(const ThreaderArguments &args, unsigned int selection, std::vector <unsigned int> &keptFibers)
+{
+    keptFibers.clear();
+    for (unsigned int i = 0;i < args.keptFibers.size();++i)
+        keptFibers.insert(keptFibers.end(),args.keptFibers[i][selection].begin(),args.keptFibers[i][selection].end());
+}
+
 int main(int argc, char **argv)
 {
-    TCLAP::CmdLine cmd("Filters fibers from a vtp file using a label image and specifying with several -t and -f which labels should be touched or are forbidden for each fiber. INRIA / IRISA - VisAGeS Team", ' ',ANIMA_VERSION);
+    TCLAP::CmdLine cmd("Filters fibers from a tracks file using a label image and specifying with several -t and -f which labels should be touched or are forbidden for each fiber. Several selections may be extracted in a single pass from a selections file. INRIA / IRISA - VisAGeS Team", ' ',ANIMA_VERSION);
 
     TCLAP::ValueArg<std::string> inArg("i","input","input tracks file",true,"","input tracks",cmd);
     TCLAP::ValueArg<std::string> roiArg("r","roi","input ROI label image",true,"","ROI image",cmd);
-    TCLAP::ValueArg<std::string> outArg("o","output","output tracks name",true,"","output tracks",cmd);
+    TCLAP::ValueArg<std::string> outArg("o","output","output tracks name",false,"","output tracks",cmd);
+    TCLAP::ValueArg<std::string> selectionsArg("s","selections","Selections file: one selection per line, output name followed by -t and -f labels options",false,"","selections file",cmd);
 
     TCLAP::MultiArg<unsigned int> touchArg("t", "touch", "Labels that have to be touched",false,"touched labels",cmd);
     TCLAP::MultiArg<unsigned int> forbiddenArg("f", "forbid", "Labels that must not to be touched",false,"forbidden labels",cmd);
@@ -137,12 +348,88 @@ int main(int argc, char **argv)
         return EXIT_FAILURE;
     }
 
-    typedef itk::Image <unsigned short, 3> ROIImageType;
+    std::vector <FibersSelection> selections;
+    if (outArg.getValue() != "")
+    {
+        FibersSelection selection;
+        selection.outputName = outArg.getValue();
+        selection.touchLabels = touchArg.getValue();
+        selection.forbiddenLabels = forbiddenArg.getValue();
+        selections.push_back(selection);
+    }
+
+    if (selectionsArg.getValue() != "")
+        ReadSelectionsFile(selectionsArg.getValue(),selections);
+
+    if (selections.empty())
+    {
+        std::cerr << "Error: an output file or a selections file is required" << std::endl;
+        return EXIT_FAILURE;
+    }
+
     ROIImageType::Pointer roiImage = anima::readImage <ROIImageType> (roiArg.getValue());
 
-    typedef itk::NearestNeighborInterpolateImageFunction <ROIImageType> InterpolatorType;
-    InterpolatorType::Pointer interpolator = InterpolatorType::New();
-    interpolator->SetInputImage(roiImage);
+    ROILabelLookup lookup;
+    ThreaderArguments tmpStr;
+    PrepareSelections(selections,roiImage,lookup,tmpStr);
+
+    itk::MultiThreader::Pointer mThreader = itk::MultiThreader::New();
+    mThreader->SetNumberOfThreads(nbThreadsArg.getValue());
+    mThreader->SetSingleMethod(ThreadFilterer,&tmpStr);
+    tmpStr.keptFibers.assign(mThreader->GetNumberOfThreads(),std::vector < std::vector <unsigned int> > (selections.size()));
+
+    bool binaryOutputs = anima::IsFibersBinaryFileName(inArg.getValue());
+    for (unsigned int s = 0;s < selections.size();++s)
+        binaryOutputs = binaryOutputs && anima::IsFibersBinaryFileName(selections[s].outputName);
+
+    std::vector <unsigned int> keptFibers;
+
+    // Binary fibers files are filtered in place and kept fibers appended to the outputs, no polydata involved
+    if (binaryOutputs)
+    {
+        // Writing an output would truncate the mapped input
+        for (unsigned int s = 0;s < selections.size();++s)
+        {
+            if (itksys::SystemTools::SameFile(inArg.getValue(),selections[s].outputName))
+            {
+                std::cerr << "Error: binary fibers outputs have to be different from the input" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+
+        anima::MappedFibersBinaryFile binaryTracks;
+        binaryTracks.Open(inArg.getValue());
+
+        tmpStr.tracks.numFibers = binaryTracks.GetNumberOfFibers();
+        tmpStr.tracks.fiberOffsets = binaryTracks.GetFiberOffsets();
+        tmpStr.tracks.points = 0;
+        tmpStr.tracks.pointIds = 0;
+        tmpStr.tracks.pointRecords = binaryTracks.GetPointRecords();
+        tmpStr.tracks.recordLength = binaryTracks.GetHeader().GetPointRecordLength();
+        mThreader->SingleMethodExecute();
+
+        unsigned int fiberRecordLength = binaryTracks.GetHeader().GetFiberRecordLength();
+        for (unsigned int s = 0;s < selections.size();++s)
+        {
+            GatherKeptFibers(tmpStr,s,keptFibers);
+
+            std::cout << "Writing tracks: " << selections[s].outputName << std::endl;
+            anima::FibersBinaryFileWriter binaryWriter;
+            binaryWriter.Open(selections[s].outputName,binaryTracks.GetHeader());
+
+            for (unsigned int i = 0;i < keptFibers.size();++i)
+            {
+                unsigned int fiberIndex = keptFibers[i];
+                const float *fiberRecord = (fiberRecordLength != 0) ? binaryTracks.GetFiberRecords() + fiberIndex * fiberRecordLength : 0;
+                binaryWriter.AppendFiber(binaryTracks.GetFiberPointRecords(fiberIndex),binaryTracks.GetFiberNumberOfPoints(fiberIndex),fiberRecord);
+            }
+
+            binaryWriter.Close();
+            std::cout << "Kept " << keptFibers.size() << " after filtering" << std::endl;
+        }
+
+        return EXIT_SUCCESS;
+    }
 
     anima::ShapesReader trackReader;
     trackReader.SetFileName(inArg.getValue());
@@ -150,40 +437,64 @@ int main(int argc, char **argv)
 
     vtkSmartPointer <vtkPolyData> tracks = trackReader.GetOutput();
 
-    // Get dummy cell so that it's thread safe
-    vtkSmartPointer <vtkGenericCell> dummyCell = vtkGenericCell::New();
-    tracks->GetCell(0,dummyCell);
-
-    std::vector <unsigned int> touchLabels = touchArg.getValue();
-    std::vector <unsigned int> forbiddenLabels = forbiddenArg.getValue();
+    // Lines are gathered once into flat arrays, traversal of vtk cell arrays is not thread safe
+    std::vector <itk::uint64_t> fiberOffsets(1,0);
+    std::vector <vtkIdType> pointIds;
+    vtkCellArray *lines = tracks->GetLines();
+    vtkSmartPointer <vtkIdList> idList = vtkSmartPointer <vtkIdList>::New();
+    lines->InitTraversal();
+    for (vtkIdType i = 0;i < tracks->GetNumberOfLines();++i)
+    {
+        lines->GetNextCell(idList);
+        for (vtkIdType j = 0;j < idList->GetNumberOfIds();++j)
+            pointIds.push_back(idList->GetId(j));
 
-    ThreaderArguments tmpStr;
-    tmpStr.interpolator = interpolator;
-    tmpStr.tracks = tracks;
-    tmpStr.touchLabels = touchLabels;
-    tmpStr.forbiddenLabels = forbiddenLabels;
+        fiberOffsets.push_back(pointIds.size());
+    }
 
-    itk::MultiThreader::Pointer mThreader = itk::MultiThreader::New();
-    mThreader->SetNumberOfThreads(nbThreadsArg.getValue());
-    mThreader->SetSingleMethod(ThreadFilterer,&tmpStr);
+    tmpStr.tracks.numFibers = fiberOffsets.size() - 1;
+    tmpStr.tracks.fiberOffsets = &fiberOffsets[0];
+    tmpStr.tracks.points = tracks->GetPoints();
+    tmpStr.tracks.pointIds = pointIds.data();
+    tmpStr.tracks.pointRecords = 0;
+    tmpStr.tracks.recordLength = 3;
     mThreader->SingleMethodExecute();
 
-    // Final pruning of removed cells
-    tracks->RemoveDeletedCells();
+    // Lines come after vertices in polydata cell numbering
+    vtkIdType firstLineId = tracks->GetNumberOfVerts();
+    for (unsigned int s = 0;s < selections.size();++s)
+    {
+        GatherKeptFibers(tmpStr,s,keptFibers);
+
+        vtkSmartPointer <vtkPolyData> outputTracks = vtkSmartPointer <vtkPolyData>::New();
+        outputTracks->SetPoints(tracks->GetPoints());
+        outputTracks->GetPointData()->ShallowCopy(tracks->GetPointData());
+        outputTracks->GetCellData()->CopyAllocate(tracks->GetCellData(),keptFibers.size());
+
+        vtkSmartPointer <vtkCellArray> outputLines = vtkSmartPointer <vtkCellArray>::New();
+        for (unsigned int i = 0;i < keptFibers.size();++i)
+        {
+            unsigned int fiberIndex = keptFibers[i];
+            outputLines->InsertNextCell(fiberOffsets[fiberIndex + 1] - fiberOffsets[fiberIndex],&pointIds[fiberOffsets[fiberIndex]]);
+            outputTracks->GetCellData()->CopyData(tracks->GetCellData(),firstLineId + fiberIndex,i);
+        }
 
-    // Out of security, but apparently does not do much
-    vtkSmartPointer <vtkCleanPolyData> vtkCleaner = vtkSmartPointer <vtkCleanPolyData>::New();
-    vtkCleaner->SetInputData(tracks);
-    vtkCleaner->Update();
-    tracks->ShallowCopy(vtkCleaner->GetOutput());
+        outputTracks->SetLines(outputLines);
 
-    std::cout << "Kept " << tracks->GetNumberOfCells() << " after filtering" << std::endl;
+        // Removes points of discarded fibers
+        vtkSmartPointer <vtkCleanPolyData> vtkCleaner = vtkSmartPointer <vtkCleanPolyData>::New();
+        vtkCleaner->SetInputData(outputTracks);
+        vtkCleaner->Update();
+        outputTracks = vtkCleaner->GetOutput();
 
-    anima::ShapesWriter writer;
-    writer.SetInputData(tracks);
-    writer.SetFileName(outArg.getValue());
-    std::cout << "Writing tracks: " << outArg.getValue() << std::endl;
-    writer.Update();
+        std::cout << "Kept " << outputTracks->GetNumberOfCells() << " after filtering" << std::endl;
+
+        anima::ShapesWriter writer;
+        writer.SetInputData(outputTracks);
+        writer.SetFileName(selections[s].outputName);
+        std::cout << "Writing tracks: " << selections[s].outputName << std::endl;
+        writer.Update();
+    }
 
     return EXIT_SUCCESS;
 }
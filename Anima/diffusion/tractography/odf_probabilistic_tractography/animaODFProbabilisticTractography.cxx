@@ -10,6 +10,7 @@
 #include <itkCommand.h>
 
 #include <animaShapesWriter.h>
+#include <animaStreamingFibersWriter.h>
 
 //Update progression of the process
 void eventCallback (itk::Object* caller, const itk::EventObject& event, void* clientData)
@@ -65,6 +66,17 @@ int main(int argc,  char*  argv[])
 
     TCLAP::SwitchArg averageClustersArg("M","average-clusters","Output only cluster mean",cmd,false);
 
+    TCLAP::SwitchArg peaksArg("","peaks","Extract ODF peaks of all voxels before tracking instead of searching them at each step",cmd,false);
+    TCLAP::ValueArg<double> peakDistThrArg("","peak-dist-thr","Maximal relative distance between interpolated and voxel ODFs to use voxel peaks (default: 0.1)",false,0.1,"peak distance threshold",cmd);
+
+    TCLAP::SwitchArg streamArg("","stream","Write fibers to disk while tracking, memory does not grow with the number of fibers (vtk or fibb output only, no local colors)",cmd,false);
+    TCLAP::SwitchArg mortonSeedsArg("","morton-seeds","Process seeds along a Morton curve instead of raster order, for cache locality",cmd,false);
+
+    TCLAP::ValueArg<unsigned int> randomSeedArg("","random-seed","Key of the per seed random streams, fixing it makes runs reproducible (default: current time)",false,0,"random seed",cmd);
+    TCLAP::ValueArg<unsigned int> firstSeedArg("","first-seed","Index of the first seed to track, to split a run across processes (default: 0)",false,0,"first seed index",cmd);
+    TCLAP::ValueArg<unsigned int> nbSeedsArg("","nb-seeds","Number of seeds to track from the first one (default: 0, all remaining)",false,0,"number of seeds",cmd);
+    TCLAP::ValueArg<unsigned int> threadsPerSeedArg("","threads-per-seed","Number of threads sharing the particles of a seed (default: 0, automatic when there are less seeds than threads)",false,0,"threads per seed",cmd);
+
     TCLAP::ValueArg<unsigned int> nbThreadsArg("T","nb-threads","Number of threads to run on (default: all available)",false,itk::MultiThreader::GetGlobalDefaultNumberOfThreads(),"number of threads",cmd);
 
     try
@@ -127,14 +139,32 @@ int main(int argc,  char*  argv[])
     odfTracker->SetKappaSplitThreshold(kappaThrArg.getValue());
     odfTracker->SetClusterDistance(clusterDistArg.getValue());
     odfTracker->SetCurvatureScale(curvScaleArg.getValue());
+    odfTracker->SetUsePrecomputedPeaks(peaksArg.isSet());
+    odfTracker->SetPeakODFDistanceThreshold(peakDistThrArg.getValue());
     
     odfTracker->SetComputeLocalColors(fibersArg.getValue().find(".fds") != std::string::npos);
+    odfTracker->SetMortonSeedOrdering(mortonSeedsArg.getValue());
+    if (randomSeedArg.isSet())
+        odfTracker->SetRandomSeed(randomSeedArg.getValue());
+    odfTracker->SetFirstSeedIndex(firstSeedArg.getValue());
+    odfTracker->SetNumberOfSeedsToProcess(nbSeedsArg.getValue());
+    odfTracker->SetNumberOfThreadsPerSeed(threadsPerSeedArg.getValue());
     odfTracker->SetMAPMergeFibers(averageClustersArg.getValue());
     
     itk::CStyleCommand::Pointer callback = itk::CStyleCommand::New();
     callback->SetCallback(eventCallback);
     odfTracker->AddObserver(itk::ProgressEvent(), callback);
 
+    anima::StreamingFibersWriter streamingWriter;
+    if (streamArg.isSet())
+    {
+        odfTracker->SetComputeLocalColors(false);
+        streamingWriter.SetFileName(fibersArg.getValue());
+        streamingWriter.SetWriteWeights(true);
+        streamingWriter.Open();
+        odfTracker->SetStreamingWriter(&streamingWriter);
+    }
+
     itk::TimeProbe tmpTime;
     tmpTime.Start();
     
@@ -144,6 +174,22 @@ int main(int argc,  char*  argv[])
     tmpTime.Stop();
     std::cout << "Tracking time: " << tmpTime.GetTotal() << "s" << std::endl;
     
+    if (streamArg.isSet())
+    {
+        try
+        {
+            streamingWriter.Close();
+        }
+        catch (itk::ExceptionObject &e)
+        {
+            std::cerr << e << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::cout << "Kept " << streamingWriter.GetNumberOfFibers() << " fibers after filtering" << std::endl;
+        return EXIT_SUCCESS;
+    }
+
     anima::ShapesWriter writer;
     writer.SetInputData(odfTracker->GetOutput());
     writer.SetFileName(fibersArg.getValue());
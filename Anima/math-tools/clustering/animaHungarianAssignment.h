@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+
+namespace anima
+{
+
+/** \class HungarianAssignment
+ * \brief Optimal assignment of rows to columns of a cost matrix (Hungarian / Kuhn-Munkres algorithm with potentials,
+ * in O(n^2 m) for n rows and m columns). Work buffers are kept between calls so that solving many small problems of
+ * bounded size does not allocate memory.
+ */
+template <class ScalarType>
+class HungarianAssignment
+{
+public:
+    HungarianAssignment() {}
+    virtual ~HungarianAssignment() {}
+
+    /**
+     * Solves the assignment minimizing the sum of costs. costs is a row-major numRows x numColumns array. If there are
+     * more rows than columns, only numColumns rows get a column
+     */
+    void Solve(const ScalarType *costs, unsigned int numRows, unsigned int numColumns);
+
+    //! Column assigned to a row, -1 if the row was left out
+    int GetAssignedColumn(unsigned int row) const {return m_RowAssignments[row];}
+
+private:
+    void SolveWithRowsNotLargerThanColumns(const ScalarType *costs, unsigned int numRows, unsigned int numColumns,
+                                           bool transposed);
+
+    std::vector <ScalarType> m_RowPotentials, m_ColumnPotentials, m_MinimalSlacks;
+    std::vector <unsigned int> m_ColumnMatches, m_PreviousColumns;
+    std::vector <bool> m_UsedColumns;
+    std::vector <int> m_RowAssignments;
+};
+
+} // end namespace anima
+
+#include "animaHungarianAssignment.hxx"
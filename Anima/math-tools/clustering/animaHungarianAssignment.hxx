@@ -0,0 +1,118 @@
+#pragma once
+#include "animaHungarianAssignment.h"
+
+#include <limits>
+
+namespace anima
+{
+
+template <class ScalarType>
+void
+HungarianAssignment <ScalarType>
+::Solve(const ScalarType *costs, unsigned int numRows, unsigned int numColumns)
+{
+    m_RowAssignments.resize(numRows);
+    std::fill(m_RowAssignments.begin(),m_RowAssignments.end(),-1);
+
+    if ((numRows == 0)||(numColumns == 0))
+        return;
+
+    // Columns are assigned to rows on the transposed problem when there are more rows
+    if (numRows <= numColumns)
+        this->SolveWithRowsNotLargerThanColumns(costs,numRows,numColumns,false);
+    else
+        this->SolveWithRowsNotLargerThanColumns(costs,numColumns,numRows,true);
+}
+
+template <class ScalarType>
+void
+HungarianAssignment <ScalarType>
+::SolveWithRowsNotLargerThanColumns(const ScalarType *costs, unsigned int numRows, unsigned int numColumns,
+                                    bool transposed)
+{
+    // Indexes start at 1, 0 being a virtual column to which the row being added is first matched
+    m_RowPotentials.resize(numRows + 1);
+    m_ColumnPotentials.resize(numColumns + 1);
+    m_MinimalSlacks.resize(numColumns + 1);
+    m_ColumnMatches.resize(numColumns + 1);
+    m_PreviousColumns.resize(numColumns + 1);
+    m_UsedColumns.resize(numColumns + 1);
+
+    std::fill(m_RowPotentials.begin(),m_RowPotentials.end(),0);
+    std::fill(m_ColumnPotentials.begin(),m_ColumnPotentials.end(),0);
+    std::fill(m_ColumnMatches.begin(),m_ColumnMatches.end(),0);
+    std::fill(m_PreviousColumns.begin(),m_PreviousColumns.end(),0);
+
+    for (unsigned int i = 1;i <= numRows;++i)
+    {
+        m_ColumnMatches[0] = i;
+        unsigned int currentColumn = 0;
+        std::fill(m_MinimalSlacks.begin(),m_MinimalSlacks.end(),std::numeric_limits <ScalarType>::max());
+        std::fill(m_UsedColumns.begin(),m_UsedColumns.end(),false);
+
+        // Grows an alternating tree until a free column is reached
+        do
+        {
+            m_UsedColumns[currentColumn] = true;
+            unsigned int currentRow = m_ColumnMatches[currentColumn];
+            ScalarType delta = std::numeric_limits <ScalarType>::max();
+            unsigned int nextColumn = 0;
+
+            for (unsigned int j = 1;j <= numColumns;++j)
+            {
+                if (m_UsedColumns[j])
+                    continue;
+
+                ScalarType cost = transposed ? costs[(j - 1) * numRows + currentRow - 1] : costs[(currentRow - 1) * numColumns + j - 1];
+                ScalarType slack = cost - m_RowPotentials[currentRow] - m_ColumnPotentials[j];
+                if (slack < m_MinimalSlacks[j])
+                {
+                    m_MinimalSlacks[j] = slack;
+                    m_PreviousColumns[j] = currentColumn;
+                }
+
+                if (m_MinimalSlacks[j] < delta)
+                {
+                    delta = m_MinimalSlacks[j];
+                    nextColumn = j;
+                }
+            }
+
+            for (unsigned int j = 0;j <= numColumns;++j)
+            {
+                if (m_UsedColumns[j])
+                {
+                    m_RowPotentials[m_ColumnMatches[j]] += delta;
+                    m_ColumnPotentials[j] -= delta;
+                }
+                else
+                    m_MinimalSlacks[j] -= delta;
+            }
+
+            currentColumn = nextColumn;
+        }
+        while (m_ColumnMatches[currentColumn] != 0);
+
+        // Augmenting path
+        do
+        {
+            unsigned int previousColumn = m_PreviousColumns[currentColumn];
+            m_ColumnMatches[currentColumn] = m_ColumnMatches[previousColumn];
+            currentColumn = previousColumn;
+        }
+        while (currentColumn != 0);
+    }
+
+    for (unsigned int j = 1;j <= numColumns;++j)
+    {
+        if (m_ColumnMatches[j] == 0)
+            continue;
+
+        if (transposed)
+            m_RowAssignments[j - 1] = m_ColumnMatches[j] - 1;
+        else
+            m_RowAssignments[m_ColumnMatches[j] - 1] = j - 1;
+    }
+}
+
+} // end namespace anima
@@ -7,6 +7,8 @@
 #include <itkFastMutexLock.h>
 #include <itkProgressReporter.h>
 
+#include <string>
+
 namespace anima
 {
 
@@ -46,6 +48,29 @@ public:
     itkGetMacro(ComputationRegion, MaskRegionType)
 
     itkSetMacro(VerboseProgression, bool)
+    itkGetMacro(VerboseProgression, bool)
+
+    //! Number of slices (along the last image dimension) per slab in slab streaming mode, 0 to process the image at once
+    itkSetMacro(SlabSize, unsigned int)
+    itkGetMacro(SlabSize, unsigned int)
+
+    //! Prefix of slab results and progress files, required for slab streaming
+    itkSetMacro(SlabFilesPrefix, std::string)
+    itkGetMacro(SlabFilesPrefix, std::string)
+
+    //! Description of the run inputs (e.g. file names) written to the progress file, a run to resume must have the same one
+    itkSetMacro(SlabRunDescription, std::string)
+    itkGetMacro(SlabRunDescription, std::string)
+
+    /**
+     * Slab streaming update: the output largest region is processed slab by slab, inputs only need to provide the
+     * current slab (requested regions are propagated upstream). Each finished slab is written to disk and recorded in
+     * a progress file so that an interrupted run resumes after the last completed slab. The progress file header
+     * (slab size, output region, inputs, mask and run description) has to match for a run to be resumed. Outputs are
+     * assembled from slab files at the end, slab and progress files are then removed. Equivalent to Update() if slab
+     * size is 0.
+     */
+    void UpdateBySlabs();
 
 protected:
     MaskedImageToImageFilter()
@@ -56,6 +81,9 @@ protected:
         m_ProcessedDimension = 0;
         m_VerboseProgression = true;
         m_ProgressReport = 0;
+        m_SlabSize = 0;
+        m_SlabFilesPrefix = "";
+        m_SlabRunDescription = "";
     }
 
     virtual ~MaskedImageToImageFilter()
@@ -73,11 +101,36 @@ protected:
     virtual void InitializeSplitParameters();
     virtual void DeleteProgressReporter();
 
+    //! Creates progress reporter (if verbose) for a given number of work units, e.g. slices
+    void InitializeProgressReporter(unsigned int numberOfWorkUnits);
+
+    //! Thread safe progress update after completion of one work unit
+    void ReportCompletedWorkUnit();
+
     static ITK_THREAD_RETURN_TYPE ThreaderMultiSplitCallback(void *arg);
     virtual void ThreadProcessSlices(itk::ThreadIdType threadId);
 
     virtual void BeforeThreadedGenerateData() ITK_OVERRIDE;
 
+    //! Writes results of the slab just computed, outputs then only hold that slab
+    virtual void WriteSlab(const std::string &slabPrefix, const OutputImageRegionType &slabRegion);
+
+    //! Allocates full size results before slab files are read back
+    virtual void AllocateSlabAssembly();
+
+    //! Reads back results of a slab written by WriteSlab into full size results
+    virtual void ReadSlab(const std::string &slabPrefix, const OutputImageRegionType &slabRegion);
+
+    //! Removes files of a slab written by WriteSlab, once full size results are assembled
+    virtual void RemoveSlab(const std::string &slabPrefix);
+
+    //! Progress file header identifying a slab streaming run, one item per line
+    std::string GetSlabProgressHeader();
+
+    //! Copies an image holding a single slab (as read from a slab file) into the slab region of a full size image
+    template <class ImageType>
+    void PasteSlabImage(ImageType *slabImage, ImageType *image, const typename ImageType::RegionType &slabRegion);
+
     //! Utility function to initialize output images pixel to zero for vector images
     template <typename ScalarRealType>
     void
@@ -100,12 +153,17 @@ private:
     ITK_DISALLOW_COPY_AND_ASSIGN(MaskedImageToImageFilter);
 
     itk::SimpleFastMutexLock m_LockHighestProcessedSlice;
+    itk::SimpleFastMutexLock m_LockProgressReport;
     int m_HighestProcessedSlice;
     unsigned int m_ProcessedDimension;
 
     itk::ProgressReporter *m_ProgressReport;
     bool m_VerboseProgression;
 
+    unsigned int m_SlabSize;
+    std::string m_SlabFilesPrefix;
+    std::string m_SlabRunDescription;
+
     MaskImagePointer m_ComputationMask;
     // Optimization of multithread code, compute only on region defined from mask... Uninitialized in constructor.
     MaskRegionType m_ComputationRegion;
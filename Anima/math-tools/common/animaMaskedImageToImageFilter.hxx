@@ -2,6 +2,13 @@
 #include "animaMaskedImageToImageFilter.h"
 
 #include <itkImageRegionConstIterator.h>
+#include <itkImageRegionIterator.h>
+#include <animaReadWriteFunctions.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
 
 namespace anima
 {
@@ -39,6 +46,7 @@ MaskedImageToImageFilter < TInputImage, TOutputImage >
     maskItr.GoToBegin();
 
     MaskIndexType minPos, maxPos;
+    bool emptyMask = true;
 
     for (unsigned int i = 0;i < m_ComputationMask->GetImageDimension();++i)
     {
@@ -50,6 +58,7 @@ MaskedImageToImageFilter < TInputImage, TOutputImage >
     {
         if (maskItr.Get() != 0)
         {
+            emptyMask = false;
             MaskIndexType tmpInd = maskItr.GetIndex();
 
             for (unsigned int i = 0;i < m_ComputationMask->GetImageDimension();++i)
@@ -65,9 +74,17 @@ MaskedImageToImageFilter < TInputImage, TOutputImage >
         ++maskItr;
     }
 
+    MaskSizeType tmpSize;
+    if (emptyMask)
+    {
+        m_ComputationRegion.SetIndex(m_ComputationMask->GetLargestPossibleRegion().GetIndex());
+        tmpSize.Fill(0);
+        m_ComputationRegion.SetSize(tmpSize);
+        return;
+    }
+
     m_ComputationRegion.SetIndex(minPos);
 
-    MaskSizeType tmpSize;
     for (unsigned int i = 0;i < m_ComputationMask->GetImageDimension();++i)
         tmpSize[i] = maxPos[i] - minPos[i] + 1;
 
@@ -82,6 +99,14 @@ MaskedImageToImageFilter < TInputImage, TOutputImage >
     if (m_ComputationRegion.GetSize(0) == 0)
         this->InitializeComputationRegionFromMask();
 
+    // Only compute inside the requested output region (current slab in slab streaming mode)
+    if ((m_ComputationRegion.GetNumberOfPixels() != 0) && (!m_ComputationRegion.Crop(this->GetOutput()->GetRequestedRegion())))
+    {
+        MaskSizeType emptySize;
+        emptySize.Fill(0);
+        m_ComputationRegion.SetSize(emptySize);
+    }
+
     unsigned int maxNumSlices = m_ComputationRegion.GetSize()[0];
     m_ProcessedDimension = 0;
     for (unsigned int i = 1;i < InputImageRegionType::ImageDimension;++i)
@@ -133,12 +158,33 @@ MaskedImageToImageFilter < TInputImage, TOutputImage >
 ::InitializeSplitParameters()
 {
     m_HighestProcessedSlice = 0;
+    this->InitializeProgressReporter(m_ComputationRegion.GetSize()[m_ProcessedDimension]);
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+MaskedImageToImageFilter < TInputImage, TOutputImage >
+::InitializeProgressReporter(unsigned int numberOfWorkUnits)
+{
     if (m_VerboseProgression)
     {
         if (m_ProgressReport)
             delete m_ProgressReport;
 
-        m_ProgressReport = new itk::ProgressReporter(this,0,m_ComputationRegion.GetSize()[m_ProcessedDimension]);
+        m_ProgressReport = new itk::ProgressReporter(this,0,numberOfWorkUnits);
+    }
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+MaskedImageToImageFilter < TInputImage, TOutputImage >
+::ReportCompletedWorkUnit()
+{
+    if (m_VerboseProgression && m_ProgressReport)
+    {
+        m_LockProgressReport.Lock();
+        m_ProgressReport->CompletedPixel();
+        m_LockProgressReport.Unlock();
     }
 }
 
@@ -176,6 +222,9 @@ void
 MaskedImageToImageFilter < TInputImage, TOutputImage >
 ::ThreadProcessSlices(itk::ThreadIdType threadId)
 {
+    if (m_ComputationRegion.GetNumberOfPixels() == 0)
+        return;
+
     InputImageRegionType processedRegion = m_ComputationRegion;
     processedRegion.SetSize(m_ProcessedDimension,1);
     unsigned int highestToleratedSliceValue = m_ComputationRegion.GetSize()[m_ProcessedDimension] - 1;
@@ -198,13 +247,271 @@ MaskedImageToImageFilter < TInputImage, TOutputImage >
         m_LockHighestProcessedSlice.Unlock();
 
         this->ThreadedGenerateData(processedRegion,threadId);
+        this->ReportCompletedWorkUnit();
+    }
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+MaskedImageToImageFilter < TInputImage, TOutputImage >
+::UpdateBySlabs()
+{
+    if (m_SlabSize == 0)
+    {
+        this->Update();
+        return;
+    }
+
+    if (m_SlabFilesPrefix == "")
+        itkExceptionMacro("Slab files prefix required for slab streaming");
+
+    this->UpdateOutputInformation();
+
+    // Slabs are taken along the last dimension
+    OutputImageRegionType largestRegion = this->GetOutput()->GetLargestPossibleRegion();
+    unsigned int slabDimension = OutputImageRegionType::ImageDimension - 1;
+    unsigned int numSlices = largestRegion.GetSize()[slabDimension];
+    unsigned int numSlabs = (numSlices + m_SlabSize - 1) / m_SlabSize;
+
+    std::vector <OutputImageRegionType> slabRegions(numSlabs,largestRegion);
+    std::vector <std::string> slabPrefixes(numSlabs);
+    for (unsigned int i = 0;i < numSlabs;++i)
+    {
+        unsigned int slabStart = i * m_SlabSize;
+        slabRegions[i].SetIndex(slabDimension,largestRegion.GetIndex()[slabDimension] + slabStart);
+        slabRegions[i].SetSize(slabDimension,std::min(m_SlabSize,numSlices - slabStart));
+
+        std::ostringstream slabPrefix;
+        slabPrefix << m_SlabFilesPrefix << "_slab" << i;
+        slabPrefixes[i] = slabPrefix.str();
+    }
+
+    // Progress file: header identifying the run, then one line per completed slab
+    std::string progressHeader = this->GetSlabProgressHeader();
+    std::vector <bool> completedSlabs(numSlabs,false);
+    std::string progressFileName = m_SlabFilesPrefix + "_progress.txt";
+    std::ifstream progressInput(progressFileName.c_str());
+    bool resumingRun = progressInput.is_open();
+
+    if (resumingRun)
+    {
+        std::istringstream expectedHeader(progressHeader);
+        std::string expectedLine, previousLine;
+        while (std::getline(expectedHeader,expectedLine))
+        {
+            if (!std::getline(progressInput,previousLine) || (previousLine != expectedLine))
+                itkExceptionMacro("Run to resume from " << progressFileName << " does not match the current one (expected \""
+                                  << expectedLine << "\", read \"" << previousLine << "\")");
+        }
+
+        unsigned int slabIndex;
+        while (progressInput >> slabIndex)
+        {
+            if (slabIndex < numSlabs)
+                completedSlabs[slabIndex] = true;
+        }
+
+        progressInput.close();
+    }
+
+    std::ofstream progressOutput(progressFileName.c_str(),std::ios::app);
+    if (!progressOutput.is_open())
+        itkExceptionMacro("Unable to write slab progress file " << progressFileName);
+
+    if (!resumingRun)
+        progressOutput << progressHeader << std::flush;
+
+    // Mask and computation region are derived for each slab from the user provided ones
+    MaskImagePointer userComputationMask = m_ComputationMask;
+    MaskRegionType userComputationRegion = m_ComputationRegion;
+
+    for (unsigned int i = 0;i < numSlabs;++i)
+    {
+        if (completedSlabs[i])
+        {
+            if (m_VerboseProgression)
+                std::cout << "Slab " << i + 1 << "/" << numSlabs << " already computed, skipping" << std::endl;
+            continue;
+        }
 
         if (m_VerboseProgression)
+            std::cout << "Processing slab " << i + 1 << "/" << numSlabs << std::endl;
+
+        m_ComputationMask = userComputationMask;
+        m_ComputationRegion = userComputationRegion;
+        for (unsigned int j = 0;j < this->GetNumberOfOutputs();++j)
+            this->GetOutput(j)->SetRequestedRegion(slabRegions[i]);
+
+        this->Modified();
+        this->Update();
+
+        // Slab is recorded only once all its results are on disk
+        this->WriteSlab(slabPrefixes[i],slabRegions[i]);
+        progressOutput << i << std::endl;
+
+        if (!progressOutput)
+            itkExceptionMacro("Unable to write slab progress file " << progressFileName);
+    }
+
+    progressOutput.close();
+
+    m_ComputationMask = userComputationMask;
+    m_ComputationRegion = userComputationRegion;
+
+    this->AllocateSlabAssembly();
+    for (unsigned int i = 0;i < numSlabs;++i)
+        this->ReadSlab(slabPrefixes[i],slabRegions[i]);
+
+    // Results are assembled, slab files are not needed anymore
+    for (unsigned int i = 0;i < numSlabs;++i)
+        this->RemoveSlab(slabPrefixes[i]);
+
+    std::remove(progressFileName.c_str());
+}
+
+template< typename TInputImage, typename TOutputImage >
+std::string
+MaskedImageToImageFilter < TInputImage, TOutputImage >
+::GetSlabProgressHeader()
+{
+    OutputImageRegionType largestRegion = this->GetOutput()->GetLargestPossibleRegion();
+    std::ostringstream header;
+
+    header << "slab size: " << m_SlabSize << std::endl;
+
+    header << "output region:";
+    for (unsigned int i = 0;i < OutputImageRegionType::ImageDimension;++i)
+        header << " " << largestRegion.GetIndex()[i];
+    for (unsigned int i = 0;i < OutputImageRegionType::ImageDimension;++i)
+        header << " " << largestRegion.GetSize()[i];
+    header << std::endl;
+
+    header << "inputs: " << this->GetNumberOfIndexedInputs() << std::endl;
+
+    header << "computation region:";
+    for (unsigned int i = 0;i < MaskRegionType::ImageDimension;++i)
+        header << " " << m_ComputationRegion.GetIndex()[i];
+    for (unsigned int i = 0;i < MaskRegionType::ImageDimension;++i)
+        header << " " << m_ComputationRegion.GetSize()[i];
+    header << std::endl;
+
+    // Mask is summarized by its region and number of voxels inside
+    header << "mask:";
+    if (m_ComputationMask)
+    {
+        MaskRegionType maskRegion = m_ComputationMask->GetLargestPossibleRegion();
+        for (unsigned int i = 0;i < MaskRegionType::ImageDimension;++i)
+            header << " " << maskRegion.GetIndex()[i];
+        for (unsigned int i = 0;i < MaskRegionType::ImageDimension;++i)
+            header << " " << maskRegion.GetSize()[i];
+
+        unsigned int numMaskVoxels = 0;
+        itk::ImageRegionConstIterator <MaskImageType> maskItr(m_ComputationMask,maskRegion);
+        while (!maskItr.IsAtEnd())
         {
-            m_LockHighestProcessedSlice.Lock();
-            m_ProgressReport->CompletedPixel();
-            m_LockHighestProcessedSlice.Unlock();
+            if (maskItr.Get() != 0)
+                ++numMaskVoxels;
+            ++maskItr;
         }
+
+        header << " " << numMaskVoxels;
+    }
+    else
+        header << " none";
+    header << std::endl;
+
+    header << "run: " << m_SlabRunDescription << std::endl;
+
+    return header.str();
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+MaskedImageToImageFilter < TInputImage, TOutputImage >
+::WriteSlab(const std::string &slabPrefix, const OutputImageRegionType &slabRegion)
+{
+    for (unsigned int i = 0;i < this->GetNumberOfOutputs();++i)
+    {
+        // Image sharing the output buffer, whose extent is the slab only
+        typename TOutputImage::Pointer slabImage = TOutputImage::New();
+        slabImage->Graft(this->GetOutput(i));
+        slabImage->SetLargestPossibleRegion(slabRegion);
+
+        std::ostringstream fileName;
+        fileName << slabPrefix << "_" << i << ".nrrd";
+        anima::writeImage <TOutputImage> (fileName.str(),slabImage);
+    }
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+MaskedImageToImageFilter < TInputImage, TOutputImage >
+::AllocateSlabAssembly()
+{
+    typedef typename TOutputImage::PixelType OutputPixelType;
+
+    for (unsigned int i = 0;i < this->GetNumberOfOutputs();++i)
+    {
+        TOutputImage *output = this->GetOutput(i);
+        output->SetRequestedRegion(output->GetLargestPossibleRegion());
+        output->SetBufferedRegion(output->GetLargestPossibleRegion());
+        output->Allocate();
+
+        OutputPixelType zeroPixel;
+        this->InitializeZeroPixel(output,zeroPixel);
+        output->FillBuffer(zeroPixel);
+    }
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+MaskedImageToImageFilter < TInputImage, TOutputImage >
+::ReadSlab(const std::string &slabPrefix, const OutputImageRegionType &slabRegion)
+{
+    for (unsigned int i = 0;i < this->GetNumberOfOutputs();++i)
+    {
+        std::ostringstream fileName;
+        fileName << slabPrefix << "_" << i << ".nrrd";
+
+        typename TOutputImage::Pointer slabImage = anima::readImage <TOutputImage> (fileName.str());
+        this->PasteSlabImage(slabImage.GetPointer(),this->GetOutput(i),slabRegion);
+    }
+}
+
+template< typename TInputImage, typename TOutputImage >
+void
+MaskedImageToImageFilter < TInputImage, TOutputImage >
+::RemoveSlab(const std::string &slabPrefix)
+{
+    for (unsigned int i = 0;i < this->GetNumberOfOutputs();++i)
+    {
+        std::ostringstream fileName;
+        fileName << slabPrefix << "_" << i << ".nrrd";
+        std::remove(fileName.str().c_str());
+    }
+}
+
+template< typename TInputImage, typename TOutputImage >
+template <class ImageType>
+void
+MaskedImageToImageFilter < TInputImage, TOutputImage >
+::PasteSlabImage(ImageType *slabImage, ImageType *image, const typename ImageType::RegionType &slabRegion)
+{
+    if (slabImage->GetLargestPossibleRegion().GetSize() != slabRegion.GetSize())
+        itkExceptionMacro("Slab image size does not match slab region");
+
+    typedef itk::ImageRegionConstIterator <ImageType> SlabIteratorType;
+    typedef itk::ImageRegionIterator <ImageType> ImageIteratorType;
+
+    SlabIteratorType slabItr(slabImage,slabImage->GetLargestPossibleRegion());
+    ImageIteratorType imageItr(image,slabRegion);
+
+    while (!slabItr.IsAtEnd())
+    {
+        imageItr.Set(slabItr.Get());
+
+        ++slabItr;
+        ++imageItr;
     }
 }
 
@@ -0,0 +1,95 @@
+#include <animaMemoryMappedFile.h>
+#include <itkMacro.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace anima
+{
+
+MemoryMappedFile::MemoryMappedFile()
+{
+    m_Data = 0;
+    m_Size = 0;
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+    this->Close();
+}
+
+void MemoryMappedFile::Open(const std::string &fileName)
+{
+    this->Close();
+    std::string error("Unable to map file in memory: ");
+    error += fileName;
+
+#ifdef _WIN32
+    HANDLE fileHandle = CreateFileA(fileName.c_str(),GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        throw itk::ExceptionObject(__FILE__, __LINE__,error,ITK_LOCATION);
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle,&fileSize) || (fileSize.QuadPart == 0))
+    {
+        CloseHandle(fileHandle);
+        throw itk::ExceptionObject(__FILE__, __LINE__,error,ITK_LOCATION);
+    }
+
+    HANDLE mappingHandle = CreateFileMappingA(fileHandle,NULL,PAGE_WRITECOPY,0,0,NULL);
+    CloseHandle(fileHandle);
+    if (!mappingHandle)
+        throw itk::ExceptionObject(__FILE__, __LINE__,error,ITK_LOCATION);
+
+    // The view keeps the mapping alive, handles can be released right away
+    void *data = MapViewOfFile(mappingHandle,FILE_MAP_COPY,0,0,0);
+    CloseHandle(mappingHandle);
+    if (!data)
+        throw itk::ExceptionObject(__FILE__, __LINE__,error,ITK_LOCATION);
+
+    m_Size = fileSize.QuadPart;
+#else
+    int fileDescriptor = open(fileName.c_str(),O_RDONLY);
+    if (fileDescriptor < 0)
+        throw itk::ExceptionObject(__FILE__, __LINE__,error,ITK_LOCATION);
+
+    struct stat fileStats;
+    if ((fstat(fileDescriptor,&fileStats) != 0) || (fileStats.st_size == 0))
+    {
+        close(fileDescriptor);
+        throw itk::ExceptionObject(__FILE__, __LINE__,error,ITK_LOCATION);
+    }
+
+    void *data = mmap(NULL,fileStats.st_size,PROT_READ | PROT_WRITE,MAP_PRIVATE,fileDescriptor,0);
+    close(fileDescriptor);
+    if (data == MAP_FAILED)
+        throw itk::ExceptionObject(__FILE__, __LINE__,error,ITK_LOCATION);
+
+    m_Size = fileStats.st_size;
+#endif
+
+    m_Data = static_cast <char *> (data);
+}
+
+void MemoryMappedFile::Close()
+{
+    if (!m_Data)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_Data);
+#else
+    munmap(m_Data,m_Size);
+#endif
+
+    m_Data = 0;
+    m_Size = 0;
+}
+
+} // end namespace anima
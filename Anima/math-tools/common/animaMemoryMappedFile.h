@@ -0,0 +1,48 @@
+#pragma once
+
+#include <itkLightObject.h>
+#include <itkObjectFactory.h>
+
+#include <string>
+
+#include <AnimaCommonExport.h>
+
+namespace anima
+{
+
+/**
+ * @brief Read-only file mapped in memory. Mapping is private: pages written to are copied and never reach the file.
+ * The mapping is released when the object is destroyed.
+ */
+class ANIMACOMMON_EXPORT MemoryMappedFile : public itk::LightObject
+{
+public:
+    typedef MemoryMappedFile Self;
+    typedef itk::LightObject Superclass;
+    typedef itk::SmartPointer<Self> Pointer;
+    typedef itk::SmartPointer<const Self> ConstPointer;
+
+    /** Run-time type information (and related methods) */
+    itkTypeMacro(MemoryMappedFile, itk::LightObject)
+
+    itkNewMacro(Self)
+
+    //! Maps the whole file in memory, throws an itk::ExceptionObject on failure
+    void Open(const std::string &fileName);
+    void Close();
+
+    char *GetData() {return m_Data;}
+    std::size_t GetSize() const {return m_Size;}
+
+protected:
+    MemoryMappedFile();
+    virtual ~MemoryMappedFile();
+
+private:
+    ITK_DISALLOW_COPY_AND_ASSIGN(MemoryMappedFile);
+
+    char *m_Data;
+    std::size_t m_Size;
+};
+
+} // end namespace anima
@@ -73,11 +73,59 @@ getImagesFromHigherDimensionImage(InputImageType *inputImage)
     return outputData;
 }
 
-//! Set inputs of an image to image filter from a file name containing either a list of files or a higher dimensional image
+/**
+ * Get a vector of pipeline outputs, one per volume of a higher dimensional image, without reading any data yet.
+ * Extraction filters are added to streamingSources, they have to be kept alive as long as outputs are updated
+ */
+template <class InputImageType, class OutputImageType>
+std::vector < itk::SmartPointer <OutputImageType> >
+getStreamedImagesFromHigherDimensionImage(InputImageType *inputImage,
+                                          std::vector <itk::ProcessObject::Pointer> &streamingSources)
+{
+    unsigned int highDimImage = InputImageType::ImageDimension;
+    unsigned int lowerDimImage = OutputImageType::ImageDimension;
+
+    if (highDimImage != lowerDimImage + 1)
+        throw itk::ExceptionObject(__FILE__, __LINE__, "Trying to divide an image that doesn't have one more dimension",ITK_LOCATION);
+
+    inputImage->UpdateOutputInformation();
+    unsigned int ndim = inputImage->GetLargestPossibleRegion().GetSize()[lowerDimImage];
+
+    typename InputImageType::RegionType largeRegion = inputImage->GetLargestPossibleRegion();
+    typename InputImageType::RegionType smallRegion = largeRegion;
+    typedef itk::ExtractImageFilter <InputImageType, OutputImageType> ExtractFilterType;
+
+    std::vector < itk::SmartPointer <OutputImageType> > outputData;
+    smallRegion.SetSize(lowerDimImage,0);
+    for (unsigned int i = 0;i < ndim;++i)
+    {
+        smallRegion.SetIndex(lowerDimImage,i + largeRegion.GetIndex(lowerDimImage));
+
+        typename ExtractFilterType::Pointer extractor = ExtractFilterType::New();
+        extractor->SetInput(inputImage);
+        extractor->SetExtractionRegion(smallRegion);
+        extractor->SetDirectionCollapseToGuess();
+
+        // Output stays connected, only the requested region is read when the pipeline is updated
+        outputData.push_back(extractor->GetOutput());
+        streamingSources.push_back(extractor.GetPointer());
+    }
+
+    return outputData;
+}
+
+/**
+ * Set inputs of an image to image filter from a file name containing either a list of files or a higher dimensional image.
+ * If streamingSources is provided, images are not read but connected to the filter through readers, so that only the
+ * region requested by the filter is read (e.g. in slab streaming mode). Readers are then added to streamingSources, which
+ * has to be kept alive until the filter is updated. Images whose format does not support streamed reading are read once
+ * as a whole instead, as each update of a partial region would read the whole file again
+ */
 template <class InputImageType, class ImageFilterType>
 unsigned int
 setMultipleImageFilterInputsFromFileName(std::string &fileName,
-                                         ImageFilterType *filter)
+                                         ImageFilterType *filter,
+                                         std::vector <itk::ProcessObject::Pointer> *streamingSources = 0)
 {
     typedef itk::Image <typename InputImageType::PixelType, InputImageType::ImageDimension + 1> HigherDimImageType;
     typedef itk::ImageFileReader <HigherDimImageType> HigherDimImageReaderType;
@@ -111,7 +159,23 @@ setMultipleImageFilterInputsFromFileName(std::string &fileName,
             std::cout << "Loading image " << nbPats << " " << tmpStr << "..." << std::endl;
             imageReader = ImageReaderType::New();
             imageReader->SetFileName(tmpStr);
-            imageReader->Update();
+
+            bool streamedReading = false;
+            if (streamingSources)
+            {
+                itk::ImageIOBase::Pointer fileIO = itk::ImageIOFactory::CreateImageIO(tmpStr, itk::ImageIOFactory::ReadMode);
+                if (fileIO)
+                {
+                    fileIO->SetFileName(tmpStr);
+                    fileIO->ReadImageInformation();
+                    streamedReading = fileIO->CanStreamRead();
+                }
+            }
+
+            if (streamedReading)
+                streamingSources->push_back(imageReader.GetPointer());
+            else
+                imageReader->Update();
 
             filter->SetInput(nbPats,imageReader->GetOutput());
 
@@ -128,10 +192,23 @@ setMultipleImageFilterInputsFromFileName(std::string &fileName,
 
         // Do we have a (N+1)D image ? If not, exiting, otherwise considering the last dimension as each input
         unsigned int ndim = imageIO->GetNumberOfDimensions();
+        bool streamedReading = streamingSources && imageIO->CanStreamRead();
+
+        if (streamingSources && !streamedReading)
+            std::cout << "Image format of " << fileName << " does not support streamed reading, reading it at once" << std::endl;
 
         if (ndim == InputImageType::ImageDimension)
         {
-            filter->SetInput(anima::readImage <InputImageType> (fileName));
+            if (streamedReading)
+            {
+                typename ImageReaderType::Pointer imageReader = ImageReaderType::New();
+                imageReader->SetFileName(fileName);
+                filter->SetInput(imageReader->GetOutput());
+                streamingSources->push_back(imageReader.GetPointer());
+            }
+            else
+                filter->SetInput(anima::readImage <InputImageType> (fileName));
+
             return 1;
         }
 
@@ -146,10 +223,18 @@ setMultipleImageFilterInputsFromFileName(std::string &fileName,
         typename HigherDimImageReaderType::Pointer imageReader = HigherDimImageReaderType::New();
         imageReader->SetImageIO(imageIO);
         imageReader->SetFileName(fileName);
-        imageReader->Update();
 
         std::vector <typename InputImageType::Pointer> inputData;
-        inputData = anima::getImagesFromHigherDimensionImage<HigherDimImageType,InputImageType>(imageReader->GetOutput());
+        if (streamedReading)
+        {
+            streamingSources->push_back(imageReader.GetPointer());
+            inputData = anima::getStreamedImagesFromHigherDimensionImage<HigherDimImageType,InputImageType>(imageReader->GetOutput(),*streamingSources);
+        }
+        else
+        {
+            imageReader->Update();
+            inputData = anima::getImagesFromHigherDimensionImage<HigherDimImageType,InputImageType>(imageReader->GetOutput());
+        }
 
         for (unsigned int i = 0;i < inputData.size();++i)
             filter->SetInput(i,inputData[i]);
@@ -0,0 +1,324 @@
+#include <animaFibersBinaryFileFormat.h>
+#include <itkMacro.h>
+
+#include <cstring>
+#include <sstream>
+
+namespace anima
+{
+
+namespace
+{
+
+const char FibersBinaryMagic[8] = {'A','N','I','M','A','F','I','B'};
+const itk::uint32_t FibersBinaryVersion = 1;
+const itk::uint32_t FibersBinaryByteOrderMark = 0x01020304;
+
+//! Sections alignment in bytes
+const itk::uint64_t FibersBinarySectionAlignment = 64;
+
+//! Positions of the values patched when closing a file: fibers and points numbers, fibers section offset
+const std::streamoff FibersBinaryCountsPosition = 16;
+
+template <class T> void WriteValue(std::ostream &stream, T value)
+{
+    stream.write(reinterpret_cast <const char *> (&value),sizeof(T));
+}
+
+template <class T> T ReadValue(std::istream &stream)
+{
+    T value;
+    stream.read(reinterpret_cast <char *> (&value),sizeof(T));
+
+    if (!stream)
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Truncated binary fibers header",ITK_LOCATION);
+
+    return value;
+}
+
+itk::uint64_t AlignOffset(itk::uint64_t offset)
+{
+    return FibersBinarySectionAlignment * ((offset + FibersBinarySectionAlignment - 1) / FibersBinarySectionAlignment);
+}
+
+} // end anonymous namespace
+
+FibersBinaryFileHeader::FibersBinaryFileHeader()
+{
+    NumberOfFibers = 0;
+    NumberOfPoints = 0;
+    PointsOffset = 0;
+    FibersOffset = 0;
+}
+
+unsigned int FibersBinaryFileHeader::GetPointRecordLength() const
+{
+    unsigned int recordLength = 3;
+    for (unsigned int i = 0;i < PointArrayComponents.size();++i)
+        recordLength += PointArrayComponents[i];
+
+    return recordLength;
+}
+
+unsigned int FibersBinaryFileHeader::GetFiberRecordLength() const
+{
+    unsigned int recordLength = 0;
+    for (unsigned int i = 0;i < FiberArrayComponents.size();++i)
+        recordLength += FiberArrayComponents[i];
+
+    return recordLength;
+}
+
+bool IsFibersBinaryFileName(const std::string &fileName)
+{
+    std::size_t dotPos = fileName.find_last_of('.');
+    if (dotPos == std::string::npos)
+        return false;
+
+    return (fileName.substr(dotPos) == ".fibb");
+}
+
+void WriteFibersBinaryHeader(std::ostream &stream, FibersBinaryFileHeader &header)
+{
+    if ((header.PointArrayNames.size() != header.PointArrayComponents.size()) ||
+            (header.FiberArrayNames.size() != header.FiberArrayComponents.size()))
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Inconsistent arrays in binary fibers header",ITK_LOCATION);
+
+    // Header is built in memory first to know where point records start
+    std::ostringstream headerStream(std::ios::binary);
+    headerStream.write(FibersBinaryMagic,sizeof(FibersBinaryMagic));
+    WriteValue <itk::uint32_t> (headerStream,FibersBinaryVersion);
+    WriteValue <itk::uint32_t> (headerStream,FibersBinaryByteOrderMark);
+    WriteValue <itk::uint64_t> (headerStream,header.NumberOfFibers);
+    WriteValue <itk::uint64_t> (headerStream,header.NumberOfPoints);
+    WriteValue <itk::uint64_t> (headerStream,header.FibersOffset);
+    WriteValue <itk::uint32_t> (headerStream,header.PointArrayNames.size());
+    WriteValue <itk::uint32_t> (headerStream,header.FiberArrayNames.size());
+
+    for (unsigned int i = 0;i < header.PointArrayNames.size();++i)
+    {
+        WriteValue <itk::uint32_t> (headerStream,header.PointArrayNames[i].size());
+        headerStream.write(header.PointArrayNames[i].c_str(),header.PointArrayNames[i].size());
+        WriteValue <itk::uint32_t> (headerStream,header.PointArrayComponents[i]);
+    }
+
+    for (unsigned int i = 0;i < header.FiberArrayNames.size();++i)
+    {
+        WriteValue <itk::uint32_t> (headerStream,header.FiberArrayNames[i].size());
+        headerStream.write(header.FiberArrayNames[i].c_str(),header.FiberArrayNames[i].size());
+        WriteValue <itk::uint32_t> (headerStream,header.FiberArrayComponents[i]);
+    }
+
+    header.PointsOffset = AlignOffset(headerStream.str().size() + sizeof(itk::uint64_t));
+    WriteValue <itk::uint64_t> (headerStream,header.PointsOffset);
+
+    std::string headerString = headerStream.str();
+    headerString.resize(header.PointsOffset,'\0');
+    stream.write(headerString.c_str(),headerString.size());
+}
+
+void ReadFibersBinaryHeader(std::istream &stream, FibersBinaryFileHeader &header)
+{
+    char magic[sizeof(FibersBinaryMagic)];
+    stream.read(magic,sizeof(FibersBinaryMagic));
+    if (!stream || (std::memcmp(magic,FibersBinaryMagic,sizeof(FibersBinaryMagic)) != 0))
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Not a binary fibers file",ITK_LOCATION);
+
+    if (ReadValue <itk::uint32_t> (stream) != FibersBinaryVersion)
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Unsupported binary fibers file version",ITK_LOCATION);
+
+    if (ReadValue <itk::uint32_t> (stream) != FibersBinaryByteOrderMark)
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Binary fibers file was written with a different byte order",ITK_LOCATION);
+
+    header.NumberOfFibers = ReadValue <itk::uint64_t> (stream);
+    header.NumberOfPoints = ReadValue <itk::uint64_t> (stream);
+    header.FibersOffset = ReadValue <itk::uint64_t> (stream);
+    unsigned int numPointArrays = ReadValue <itk::uint32_t> (stream);
+    unsigned int numFiberArrays = ReadValue <itk::uint32_t> (stream);
+
+    header.PointArrayNames.resize(numPointArrays);
+    header.PointArrayComponents.resize(numPointArrays);
+    for (unsigned int i = 0;i < numPointArrays;++i)
+    {
+        unsigned int nameLength = ReadValue <itk::uint32_t> (stream);
+        header.PointArrayNames[i].resize(nameLength);
+        if (nameLength > 0)
+            stream.read(&header.PointArrayNames[i][0],nameLength);
+        header.PointArrayComponents[i] = ReadValue <itk::uint32_t> (stream);
+    }
+
+    header.FiberArrayNames.resize(numFiberArrays);
+    header.FiberArrayComponents.resize(numFiberArrays);
+    for (unsigned int i = 0;i < numFiberArrays;++i)
+    {
+        unsigned int nameLength = ReadValue <itk::uint32_t> (stream);
+        header.FiberArrayNames[i].resize(nameLength);
+        if (nameLength > 0)
+            stream.read(&header.FiberArrayNames[i][0],nameLength);
+        header.FiberArrayComponents[i] = ReadValue <itk::uint32_t> (stream);
+    }
+
+    header.PointsOffset = ReadValue <itk::uint64_t> (stream);
+
+    if (header.FibersOffset == 0)
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Binary fibers file was not closed properly",ITK_LOCATION);
+}
+
+FibersBinaryFileWriter::FibersBinaryFileWriter()
+{
+    m_Opened = false;
+}
+
+FibersBinaryFileWriter::~FibersBinaryFileWriter()
+{
+    // Destructors must not throw: errors are only reported by an explicit call to Close
+    try
+    {
+        if (m_Opened)
+            this->Close();
+    }
+    catch (...)
+    {
+    }
+}
+
+void FibersBinaryFileWriter::Open(const std::string &fileName, const FibersBinaryFileHeader &header)
+{
+    m_OutputFile.open(fileName.c_str(), std::ios::out | std::ios::binary);
+    if (!m_OutputFile.is_open())
+        throw itk::ExceptionObject(__FILE__, __LINE__,"The output file could not be opened",ITK_LOCATION);
+
+    m_Header = header;
+    m_Header.NumberOfFibers = 0;
+    m_Header.NumberOfPoints = 0;
+    m_Header.FibersOffset = 0;
+    WriteFibersBinaryHeader(m_OutputFile,m_Header);
+
+    m_FiberOffsets.assign(1,0);
+    m_FiberRecords.clear();
+    m_Opened = true;
+}
+
+void FibersBinaryFileWriter::AppendFiber(const float *pointRecords, unsigned int numPoints, const float *fiberRecord)
+{
+    m_OutputFile.write(reinterpret_cast <const char *> (pointRecords),numPoints * m_Header.GetPointRecordLength() * sizeof(float));
+
+    m_Header.NumberOfPoints += numPoints;
+    ++m_Header.NumberOfFibers;
+    m_FiberOffsets.push_back(m_Header.NumberOfPoints);
+
+    unsigned int fiberRecordLength = m_Header.GetFiberRecordLength();
+    if (fiberRecordLength == 0)
+        return;
+
+    if (fiberRecord)
+        m_FiberRecords.insert(m_FiberRecords.end(),fiberRecord,fiberRecord + fiberRecordLength);
+    else
+        m_FiberRecords.resize(m_FiberRecords.size() + fiberRecordLength,0.0);
+}
+
+void FibersBinaryFileWriter::Close()
+{
+    if (!m_Opened)
+        return;
+
+    itk::uint64_t pointsEnd = m_Header.PointsOffset + m_Header.NumberOfPoints * m_Header.GetPointRecordLength() * sizeof(float);
+    m_Header.FibersOffset = AlignOffset(pointsEnd);
+
+    std::vector <char> padding(m_Header.FibersOffset - pointsEnd,0);
+    if (padding.size() > 0)
+        m_OutputFile.write(&padding[0],padding.size());
+
+    m_OutputFile.write(reinterpret_cast <const char *> (&m_FiberOffsets[0]),m_FiberOffsets.size() * sizeof(itk::uint64_t));
+    if (m_FiberRecords.size() > 0)
+        m_OutputFile.write(reinterpret_cast <const char *> (&m_FiberRecords[0]),m_FiberRecords.size() * sizeof(float));
+
+    m_OutputFile.seekp(FibersBinaryCountsPosition);
+    WriteValue <itk::uint64_t> (m_OutputFile,m_Header.NumberOfFibers);
+    WriteValue <itk::uint64_t> (m_OutputFile,m_Header.NumberOfPoints);
+    WriteValue <itk::uint64_t> (m_OutputFile,m_Header.FibersOffset);
+
+    if (!m_OutputFile)
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Error writing binary fibers file",ITK_LOCATION);
+
+    m_OutputFile.close();
+    m_Opened = false;
+
+    std::vector <itk::uint64_t> emptyOffsets;
+    m_FiberOffsets.swap(emptyOffsets);
+    std::vector <float> emptyRecords;
+    m_FiberRecords.swap(emptyRecords);
+}
+
+MappedFibersBinaryFile::MappedFibersBinaryFile()
+{
+    m_FiberOffsets = 0;
+    m_PointRecords = 0;
+    m_FiberRecords = 0;
+}
+
+void MappedFibersBinaryFile::Open(const std::string &fileName)
+{
+    std::ifstream headerFile(fileName.c_str(), std::ios::in | std::ios::binary);
+    if (!headerFile.is_open())
+        throw itk::ExceptionObject(__FILE__, __LINE__,"The input file could not be opened",ITK_LOCATION);
+
+    ReadFibersBinaryHeader(headerFile,m_Header);
+    headerFile.close();
+
+    m_MappedFile = anima::MemoryMappedFile::New();
+    m_MappedFile->Open(fileName);
+
+    // Sections are used in place: offsets must be aligned for their types, and sizes are checked by dividing the
+    // available space so that corrupt counts cannot overflow
+    itk::uint64_t fileSize = m_MappedFile->GetSize();
+    itk::uint64_t pointRecordSize = m_Header.GetPointRecordLength() * sizeof(float);
+    itk::uint64_t fiberRecordSize = m_Header.GetFiberRecordLength() * sizeof(float);
+
+    bool validLayout = (m_Header.PointsOffset % sizeof(float) == 0) && (m_Header.FibersOffset % sizeof(itk::uint64_t) == 0) &&
+            (m_Header.PointsOffset <= m_Header.FibersOffset) && (m_Header.FibersOffset <= fileSize);
+
+    if (validLayout)
+        validLayout = (m_Header.NumberOfPoints <= (m_Header.FibersOffset - m_Header.PointsOffset) / pointRecordSize);
+
+    if (validLayout)
+        validLayout = (m_Header.NumberOfFibers < (fileSize - m_Header.FibersOffset) / sizeof(itk::uint64_t));
+
+    if (validLayout && (fiberRecordSize > 0))
+    {
+        itk::uint64_t fiberRecordsSize = fileSize - m_Header.FibersOffset - (m_Header.NumberOfFibers + 1) * sizeof(itk::uint64_t);
+        validLayout = (m_Header.NumberOfFibers <= fiberRecordsSize / fiberRecordSize);
+    }
+
+    if (!validLayout)
+    {
+        this->Close();
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Truncated or corrupt binary fibers file",ITK_LOCATION);
+    }
+
+    char *data = m_MappedFile->GetData();
+    m_PointRecords = reinterpret_cast <float *> (data + m_Header.PointsOffset);
+    m_FiberOffsets = reinterpret_cast <itk::uint64_t *> (data + m_Header.FibersOffset);
+    m_FiberRecords = reinterpret_cast <float *> (data + m_Header.FibersOffset + (m_Header.NumberOfFibers + 1) * sizeof(itk::uint64_t));
+
+    // Fiber offsets index point records: they must start at 0, not decrease and end at the number of points
+    bool validOffsets = (m_FiberOffsets[0] == 0) && (m_FiberOffsets[m_Header.NumberOfFibers] == m_Header.NumberOfPoints);
+    for (itk::uint64_t i = 0;(i < m_Header.NumberOfFibers) && validOffsets;++i)
+        validOffsets = (m_FiberOffsets[i] <= m_FiberOffsets[i + 1]);
+
+    if (!validOffsets)
+    {
+        this->Close();
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Invalid fiber offsets in binary fibers file",ITK_LOCATION);
+    }
+}
+
+void MappedFibersBinaryFile::Close()
+{
+    m_MappedFile = NULL;
+    m_FiberOffsets = 0;
+    m_PointRecords = 0;
+    m_FiberRecords = 0;
+}
+
+} // end namespace anima
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <animaMemoryMappedFile.h>
+#include <itkIntTypes.h>
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "AnimaDataIOExport.h"
+
+namespace anima
+{
+
+/**
+ * @brief Header of the binary fibers format (.fibb). The file is made of:
+ * - a binary header: magic string, version, byte order mark, numbers of fibers and points, section offsets and
+ * the list of point and fiber arrays (name and number of components)
+ * - point records starting at PointsOffset: for each point, float32 x, y, z followed by its point array values
+ * - starting at FibersOffset: NumberOfFibers + 1 uint64 offsets (index of the first point of each fiber, the last one
+ * being NumberOfPoints), then one float32 record of fiber array values per fiber
+ * Sections are aligned so that a mapped file is used in place. Counts and FibersOffset are at fixed positions so
+ * that the header is written first and patched once all fibers are appended.
+ */
+struct ANIMADATAIO_EXPORT FibersBinaryFileHeader
+{
+    itk::uint64_t NumberOfFibers;
+    itk::uint64_t NumberOfPoints;
+    itk::uint64_t PointsOffset;
+    itk::uint64_t FibersOffset;
+
+    std::vector <std::string> PointArrayNames;
+    std::vector <unsigned int> PointArrayComponents;
+    std::vector <std::string> FiberArrayNames;
+    std::vector <unsigned int> FiberArrayComponents;
+
+    FibersBinaryFileHeader();
+
+    //! Number of floats per point record (coordinates and point arrays)
+    unsigned int GetPointRecordLength() const;
+    //! Number of floats per fiber record
+    unsigned int GetFiberRecordLength() const;
+};
+
+//! Checks from its extension if a file name refers to the binary fibers format
+ANIMADATAIO_EXPORT bool IsFibersBinaryFileName(const std::string &fileName);
+
+//! Writes header to stream, PointsOffset is computed and stream is padded up to it
+ANIMADATAIO_EXPORT void WriteFibersBinaryHeader(std::ostream &stream, FibersBinaryFileHeader &header);
+
+//! Reads header from stream, throws an itk::ExceptionObject if it is not a valid binary fibers header
+ANIMADATAIO_EXPORT void ReadFibersBinaryHeader(std::istream &stream, FibersBinaryFileHeader &header);
+
+/**
+ * @brief Append-only writer of binary fibers files. Point records go to disk as fibers are appended, only fiber
+ * offsets and fiber records are kept in memory until Close() writes them and patches the header.
+ */
+class ANIMADATAIO_EXPORT FibersBinaryFileWriter
+{
+public:
+    FibersBinaryFileWriter();
+    ~FibersBinaryFileWriter();
+
+    //! Creates the file, arrays have to be declared in the header given (counts and offsets are ignored)
+    void Open(const std::string &fileName, const FibersBinaryFileHeader &header);
+
+    /**
+     * Appends a fiber: numPoints point records of GetPointRecordLength() floats each, and a fiber record of
+     * GetFiberRecordLength() floats (may be null if there are no fiber arrays)
+     */
+    void AppendFiber(const float *pointRecords, unsigned int numPoints, const float *fiberRecord = 0);
+
+    void Close();
+
+    const FibersBinaryFileHeader &GetHeader() const {return m_Header;}
+
+private:
+    std::ofstream m_OutputFile;
+    FibersBinaryFileHeader m_Header;
+    std::vector <itk::uint64_t> m_FiberOffsets;
+    std::vector <float> m_FiberRecords;
+    bool m_Opened;
+};
+
+/**
+ * @brief Binary fibers file mapped in memory, points and fiber data are accessed in place without any copy.
+ * Mapping is private: values may be modified in memory (e.g. transformed) without changing the file.
+ */
+class ANIMADATAIO_EXPORT MappedFibersBinaryFile
+{
+public:
+    MappedFibersBinaryFile();
+    ~MappedFibersBinaryFile() {}
+
+    //! Maps the file and checks its layout, throws an itk::ExceptionObject on failure
+    void Open(const std::string &fileName);
+    void Close();
+
+    const FibersBinaryFileHeader &GetHeader() const {return m_Header;}
+    itk::uint64_t GetNumberOfFibers() const {return m_Header.NumberOfFibers;}
+    itk::uint64_t GetNumberOfPoints() const {return m_Header.NumberOfPoints;}
+
+    //! Index of the first point of each fiber, NumberOfFibers + 1 values
+    const itk::uint64_t *GetFiberOffsets() const {return m_FiberOffsets;}
+    itk::uint64_t GetFiberNumberOfPoints(itk::uint64_t fiberIndex) const {return m_FiberOffsets[fiberIndex + 1] - m_FiberOffsets[fiberIndex];}
+
+    //! Point records, each of GetPointRecordLength() floats starting with x, y, z
+    float *GetPointRecords() {return m_PointRecords;}
+    float *GetFiberPointRecords(itk::uint64_t fiberIndex) {return m_PointRecords + m_FiberOffsets[fiberIndex] * m_Header.GetPointRecordLength();}
+
+    //! Fiber records, each of GetFiberRecordLength() floats
+    float *GetFiberRecords() {return m_FiberRecords;}
+
+private:
+    anima::MemoryMappedFile::Pointer m_MappedFile;
+    FibersBinaryFileHeader m_Header;
+
+    itk::uint64_t *m_FiberOffsets;
+    float *m_PointRecords;
+    float *m_FiberRecords;
+};
+
+} // end namespace anima
@@ -1,4 +1,5 @@
 #include <animaShapesReader.h>
+#include <animaFibersBinaryFileFormat.h>
 #include <itkMacro.h>
 
 #include <vtkPolyDataReader.h>
@@ -7,7 +8,9 @@
 #include <tinyxml2.h>
 
 #include <vtkDoubleArray.h>
+#include <vtkFloatArray.h>
 #include <vtkPointData.h>
+#include <vtkCellData.h>
 
 #include <fstream>
 #include <algorithm>
@@ -31,6 +34,8 @@ void ShapesReader::Update()
         this->ReadFileAsMedinriaFibers();
     else if (extensionName == "csv")
         this->ReadFileAsCSV();
+    else if (extensionName == "fibb")
+        this->ReadFileAsFibersBinary();
     else
         throw itk::ExceptionObject(__FILE__, __LINE__,"Unsupported shapes extension.",ITK_LOCATION);
 }
@@ -273,4 +278,88 @@ void ShapesReader::ReadFileAsCSV()
     }
 }
 
+void ShapesReader::ReadFileAsFibersBinary()
+{
+    // Conversion to polydata for tools working on VTK data, MappedFibersBinaryFile gives direct access otherwise
+    anima::MappedFibersBinaryFile fibersFile;
+    fibersFile.Open(m_FileName);
+
+    const anima::FibersBinaryFileHeader &header = fibersFile.GetHeader();
+    vtkIdType numberOfPoints = fibersFile.GetNumberOfPoints();
+    vtkIdType numberOfFibers = fibersFile.GetNumberOfFibers();
+    unsigned int pointRecordLength = header.GetPointRecordLength();
+    unsigned int fiberRecordLength = header.GetFiberRecordLength();
+    const float *pointRecords = fibersFile.GetPointRecords();
+    const float *fiberRecords = fibersFile.GetFiberRecords();
+
+    m_OutputData = vtkSmartPointer <vtkPolyData>::New();
+    m_OutputData->Initialize();
+    m_OutputData->Allocate(numberOfFibers);
+
+    vtkSmartPointer <vtkPoints> points = vtkSmartPointer <vtkPoints>::New();
+    points->SetDataTypeToFloat();
+    points->SetNumberOfPoints(numberOfPoints);
+    float *pointsBuffer = vtkFloatArray::SafeDownCast(points->GetData())->GetPointer(0);
+
+    for (vtkIdType i = 0;i < numberOfPoints;++i)
+    {
+        for (unsigned int j = 0;j < 3;++j)
+            pointsBuffer[3 * i + j] = pointRecords[i * pointRecordLength + j];
+    }
+
+    m_OutputData->SetPoints(points);
+
+    const itk::uint64_t *fiberOffsets = fibersFile.GetFiberOffsets();
+    std::vector <vtkIdType> ids;
+    for (vtkIdType i = 0;i < numberOfFibers;++i)
+    {
+        vtkIdType npts = fiberOffsets[i + 1] - fiberOffsets[i];
+        ids.resize(npts);
+        for (vtkIdType j = 0;j < npts;++j)
+            ids[j] = fiberOffsets[i] + j;
+
+        m_OutputData->InsertNextCell(VTK_POLY_LINE, npts, ids.data());
+    }
+
+    unsigned int pos = 3;
+    for (unsigned int k = 0;k < header.PointArrayNames.size();++k)
+    {
+        unsigned int nbComponents = header.PointArrayComponents[k];
+        vtkSmartPointer <vtkFloatArray> arrayData = vtkSmartPointer <vtkFloatArray>::New();
+        arrayData->SetName(header.PointArrayNames[k].c_str());
+        arrayData->SetNumberOfComponents(nbComponents);
+        arrayData->SetNumberOfTuples(numberOfPoints);
+
+        float *arrayBuffer = arrayData->GetPointer(0);
+        for (vtkIdType i = 0;i < numberOfPoints;++i)
+        {
+            for (unsigned int j = 0;j < nbComponents;++j)
+                arrayBuffer[i * nbComponents + j] = pointRecords[i * pointRecordLength + pos + j];
+        }
+
+        m_OutputData->GetPointData()->AddArray(arrayData);
+        pos += nbComponents;
+    }
+
+    pos = 0;
+    for (unsigned int k = 0;k < header.FiberArrayNames.size();++k)
+    {
+        unsigned int nbComponents = header.FiberArrayComponents[k];
+        vtkSmartPointer <vtkFloatArray> arrayData = vtkSmartPointer <vtkFloatArray>::New();
+        arrayData->SetName(header.FiberArrayNames[k].c_str());
+        arrayData->SetNumberOfComponents(nbComponents);
+        arrayData->SetNumberOfTuples(numberOfFibers);
+
+        float *arrayBuffer = arrayData->GetPointer(0);
+        for (vtkIdType i = 0;i < numberOfFibers;++i)
+        {
+            for (unsigned int j = 0;j < nbComponents;++j)
+                arrayBuffer[i * nbComponents + j] = fiberRecords[i * fiberRecordLength + pos + j];
+        }
+
+        m_OutputData->GetCellData()->AddArray(arrayData);
+        pos += nbComponents;
+    }
+}
+
 } // end namespace anima
@@ -29,6 +29,7 @@ protected:
     void ReadFileAsVTKXML();
     void ReadFileAsMedinriaFibers();
     void ReadFileAsCSV();
+    void ReadFileAsFibersBinary();
 
 private:
     vtkSmartPointer <vtkPolyData> m_OutputData;
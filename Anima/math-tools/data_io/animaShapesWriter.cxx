@@ -1,4 +1,5 @@
 #include <animaShapesWriter.h>
+#include <animaFibersBinaryFileFormat.h>
 #include <itkMacro.h>
 
 #include <vtkPolyDataWriter.h>
@@ -6,6 +7,7 @@
 #include <vtksys/SystemTools.hxx>
 
 #include <vtkPointData.h>
+#include <vtkCellData.h>
 
 #include <fstream>
 #include <algorithm>
@@ -27,6 +29,8 @@ void ShapesWriter::Update()
         this->WriteFileAsMedinriaFibers();
     else if (extensionName == "csv")
         this->WriteFileAsCSV();
+    else if (extensionName == "fibb")
+        this->WriteFileAsFibersBinary();
     else
         throw itk::ExceptionObject(__FILE__, __LINE__,"Unsupported shapes extension.",ITK_LOCATION);
 }
@@ -190,4 +194,78 @@ void ShapesWriter::WriteFileAsCSV()
     outputFile.close();
 }
 
+void ShapesWriter::WriteFileAsFibersBinary()
+{
+    vtkPointData *pointData = m_InputData->GetPointData();
+    vtkCellData *cellData = m_InputData->GetCellData();
+
+    // All arrays are stored as float, unnamed ones get a default name
+    anima::FibersBinaryFileHeader header;
+    for (int i = 0;i < pointData->GetNumberOfArrays();++i)
+    {
+        std::string arrayName = (pointData->GetArrayName(i)) ? pointData->GetArrayName(i) : "PointArray" + std::to_string(i);
+        header.PointArrayNames.push_back(arrayName);
+        header.PointArrayComponents.push_back(pointData->GetArray(i)->GetNumberOfComponents());
+    }
+
+    for (int i = 0;i < cellData->GetNumberOfArrays();++i)
+    {
+        std::string arrayName = (cellData->GetArrayName(i)) ? cellData->GetArrayName(i) : "FiberArray" + std::to_string(i);
+        header.FiberArrayNames.push_back(arrayName);
+        header.FiberArrayComponents.push_back(cellData->GetArray(i)->GetNumberOfComponents());
+    }
+
+    anima::FibersBinaryFileWriter fibersWriter;
+    fibersWriter.Open(m_FileName,header);
+
+    unsigned int pointRecordLength = header.GetPointRecordLength();
+    std::vector <float> pointRecords, fiberRecord(header.GetFiberRecordLength());
+    vtkSmartPointer <vtkIdList> idList = vtkSmartPointer <vtkIdList>::New();
+    double point[3];
+
+    // Lines come after vertices in polydata cell numbering
+    vtkIdType firstLineId = m_InputData->GetNumberOfVerts();
+    vtkIdType numberOfLines = m_InputData->GetNumberOfLines();
+    vtkCellArray *lines = m_InputData->GetLines();
+    lines->InitTraversal();
+
+    for (vtkIdType i = 0;i < numberOfLines;++i)
+    {
+        lines->GetNextCell(idList);
+        unsigned int numPoints = idList->GetNumberOfIds();
+        pointRecords.resize(numPoints * pointRecordLength);
+
+        for (unsigned int j = 0;j < numPoints;++j)
+        {
+            vtkIdType pointId = idList->GetId(j);
+            float *pointRecord = &pointRecords[j * pointRecordLength];
+
+            m_InputData->GetPoint(pointId,point);
+            for (unsigned int k = 0;k < 3;++k)
+                pointRecord[k] = point[k];
+
+            unsigned int pos = 3;
+            for (int k = 0;k < pointData->GetNumberOfArrays();++k)
+            {
+                vtkDataArray *dataArray = pointData->GetArray(k);
+                for (int l = 0;l < dataArray->GetNumberOfComponents();++l)
+                    pointRecord[pos++] = dataArray->GetComponent(pointId,l);
+            }
+        }
+
+        unsigned int pos = 0;
+        for (int k = 0;k < cellData->GetNumberOfArrays();++k)
+        {
+            vtkDataArray *dataArray = cellData->GetArray(k);
+            for (int l = 0;l < dataArray->GetNumberOfComponents();++l)
+                fiberRecord[pos++] = dataArray->GetComponent(firstLineId + i,l);
+        }
+
+        if (numPoints > 0)
+            fibersWriter.AppendFiber(&pointRecords[0],numPoints,fiberRecord.empty() ? 0 : &fiberRecord[0]);
+    }
+
+    fibersWriter.Close();
+}
+
 } // end namespace anima
@@ -29,6 +29,7 @@ protected:
     void WriteFileAsVTKXML();
     void WriteFileAsMedinriaFibers();
     void WriteFileAsCSV();
+    void WriteFileAsFibersBinary();
 
 private:
     vtkSmartPointer <vtkPolyData> m_InputData;
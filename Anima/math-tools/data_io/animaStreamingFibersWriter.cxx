@@ -0,0 +1,335 @@
+#include <animaStreamingFibersWriter.h>
+#include <itkMacro.h>
+#include <itkByteSwapper.h>
+
+#include <cstdio>
+#include <iomanip>
+#include <limits>
+
+namespace anima {
+
+StreamingFibersWriter::StreamingFibersWriter()
+{
+    m_FileName = "";
+    m_WriteWeights = false;
+    m_MaximalNumberOfQueuedPoints = 1000000;
+    m_BinaryFormat = false;
+
+    m_Threader = itk::MultiThreader::New();
+    m_WriterThreadId = 0;
+    m_Opened = false;
+    m_Closing = false;
+
+    m_QueueNotEmpty = itk::ConditionVariable::New();
+    m_QueueNotFull = itk::ConditionVariable::New();
+    m_NumberOfQueuedPoints = 0;
+
+    m_NumberOfFibers = 0;
+    m_NumberOfPoints = 0;
+}
+
+StreamingFibersWriter::~StreamingFibersWriter()
+{
+    // Errors can only be reported by an explicit call to Close()
+    try
+    {
+        if (m_Opened)
+            this->Close();
+    }
+    catch (...)
+    {
+    }
+}
+
+void StreamingFibersWriter::Open()
+{
+    std::string extensionName = m_FileName.substr(m_FileName.find_last_of('.') + 1);
+    m_BinaryFormat = anima::IsFibersBinaryFileName(m_FileName);
+    if ((extensionName != "vtk") && !m_BinaryFormat)
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Streamed fibers can only be written as legacy vtk or binary fibers files.",ITK_LOCATION);
+
+    if (m_BinaryFormat)
+    {
+        anima::FibersBinaryFileHeader header;
+        if (m_WriteWeights)
+        {
+            header.PointArrayNames.push_back("Fiber weights");
+            header.PointArrayComponents.push_back(1);
+        }
+
+        m_BinaryWriter.Open(m_FileName,header);
+    }
+    else
+        this->OpenVTKFile();
+
+    m_NumberOfFibers = 0;
+    m_NumberOfPoints = 0;
+    m_NumberOfQueuedPoints = 0;
+    m_WriteError = "";
+    m_Closing = false;
+    m_Opened = true;
+
+    m_WriterThreadId = m_Threader->SpawnThread(WriterThreadCallback,this);
+}
+
+void StreamingFibersWriter::OpenVTKFile()
+{
+    m_OutputFile.open(m_FileName.c_str(), std::ios::out | std::ios::binary);
+    m_LinesFileName = m_FileName + ".lines.tmp";
+    m_LinesFile.open(m_LinesFileName.c_str(), std::ios::out | std::ios::binary);
+
+    if (!m_OutputFile.is_open() || !m_LinesFile.is_open())
+        throw itk::ExceptionObject(__FILE__, __LINE__,"The output file could not be opened",ITK_LOCATION);
+
+    if (m_WriteWeights)
+    {
+        m_WeightsFileName = m_FileName + ".weights.tmp";
+        m_WeightsFile.open(m_WeightsFileName.c_str(), std::ios::out | std::ios::binary);
+
+        if (!m_WeightsFile.is_open())
+            throw itk::ExceptionObject(__FILE__, __LINE__,"The output file could not be opened",ITK_LOCATION);
+    }
+
+    m_OutputFile << "# vtk DataFile Version 3.0" << std::endl;
+    m_OutputFile << "vtk output" << std::endl;
+    m_OutputFile << "BINARY" << std::endl;
+    m_OutputFile << "DATASET POLYDATA" << std::endl;
+
+    // Number of points is unknown until the end, leave room to patch it
+    m_OutputFile << "POINTS ";
+    m_PointsHeaderPosition = m_OutputFile.tellp();
+    m_OutputFile << std::setw(12) << std::left << 0 << " float" << std::endl;
+}
+
+void StreamingFibersWriter::AddFiberCoordinates(std::vector <float> &fiberCoordinates, double weight)
+{
+    unsigned int numPoints = fiberCoordinates.size() / 3;
+    if (numPoints == 0)
+        return;
+
+    m_QueueLock.Lock();
+
+    // A fiber larger than the queue is still accepted when the queue is empty
+    while ((m_NumberOfQueuedPoints != 0)&&(m_NumberOfQueuedPoints + numPoints > m_MaximalNumberOfQueuedPoints))
+        m_QueueNotFull->Wait(&m_QueueLock);
+
+    m_FiberQueue.push_back(std::vector <float> ());
+    m_FiberQueue.back().swap(fiberCoordinates);
+    m_WeightQueue.push_back(weight);
+    m_NumberOfQueuedPoints += numPoints;
+
+    m_QueueNotEmpty->Signal();
+    m_QueueLock.Unlock();
+}
+
+ITK_THREAD_RETURN_TYPE StreamingFibersWriter::WriterThreadCallback(void *arg)
+{
+    itk::MultiThreader::ThreadInfoStruct *threadArgs = (itk::MultiThreader::ThreadInfoStruct *)arg;
+    StreamingFibersWriter *writer = (StreamingFibersWriter *)threadArgs->UserData;
+
+    writer->WriteQueuedFibers();
+
+    return NULL;
+}
+
+void StreamingFibersWriter::WriteQueuedFibers()
+{
+    std::vector <float> fiberCoordinates;
+
+    m_QueueLock.Lock();
+    while (true)
+    {
+        while (m_FiberQueue.empty() && !m_Closing)
+            m_QueueNotEmpty->Wait(&m_QueueLock);
+
+        if (m_FiberQueue.empty())
+            break;
+
+        fiberCoordinates.swap(m_FiberQueue.front());
+        double weight = m_WeightQueue.front();
+        m_FiberQueue.pop_front();
+        m_WeightQueue.pop_front();
+        m_NumberOfQueuedPoints -= fiberCoordinates.size() / 3;
+
+        m_QueueNotFull->Broadcast();
+        m_QueueLock.Unlock();
+
+        // Disk writes are done outside of the lock so that tracking threads keep on pushing fibers. After an error,
+        // the queue is still emptied so that they are not blocked
+        if (m_WriteError == "")
+        {
+            try
+            {
+                this->WriteFiber(fiberCoordinates,weight);
+            }
+            catch (itk::ExceptionObject &e)
+            {
+                m_WriteError = e.GetDescription();
+            }
+            catch (std::exception &e)
+            {
+                m_WriteError = e.what();
+            }
+            catch (...)
+            {
+                m_WriteError = "Unknown error writing streamed fibers to " + m_FileName;
+            }
+        }
+
+        m_QueueLock.Lock();
+    }
+
+    m_QueueLock.Unlock();
+}
+
+void StreamingFibersWriter::WriteFiber(std::vector <float> &fiberCoordinates, double weight)
+{
+    unsigned int numPoints = fiberCoordinates.size() / 3;
+
+    if (m_BinaryFormat)
+    {
+        float *pointRecords = &fiberCoordinates[0];
+        if (m_WriteWeights)
+        {
+            m_BinaryPointRecords.resize(4 * numPoints);
+            for (unsigned int i = 0;i < numPoints;++i)
+            {
+                for (unsigned int j = 0;j < 3;++j)
+                    m_BinaryPointRecords[4 * i + j] = fiberCoordinates[3 * i + j];
+                m_BinaryPointRecords[4 * i + 3] = weight;
+            }
+
+            pointRecords = &m_BinaryPointRecords[0];
+        }
+
+        m_BinaryWriter.AppendFiber(pointRecords,numPoints);
+        m_NumberOfPoints += numPoints;
+        ++m_NumberOfFibers;
+        return;
+    }
+
+    // Legacy vtk readers store point ids and the lines section size as int
+    if (m_NumberOfFibers + m_NumberOfPoints + numPoints + 1 > (itk::uint64_t)std::numeric_limits <int>::max())
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Too many points for a legacy vtk file, use a binary fibers file (.fibb) for " + m_FileName,ITK_LOCATION);
+
+    // Legacy vtk binary files are big endian
+    itk::ByteSwapper <float>::SwapRangeFromSystemToBigEndian(&fiberCoordinates[0],fiberCoordinates.size());
+    m_OutputFile.write((char *)&fiberCoordinates[0],fiberCoordinates.size() * sizeof(float));
+
+    std::vector <int> cellIds(numPoints + 1);
+    cellIds[0] = numPoints;
+    for (unsigned int i = 0;i < numPoints;++i)
+        cellIds[i + 1] = (int)(m_NumberOfPoints + i);
+
+    itk::ByteSwapper <int>::SwapRangeFromSystemToBigEndian(&cellIds[0],cellIds.size());
+    m_LinesFile.write((char *)&cellIds[0],cellIds.size() * sizeof(int));
+
+    if (m_WriteWeights)
+    {
+        itk::ByteSwapper <double>::SwapFromSystemToBigEndian(&weight);
+        std::vector <double> pointWeights(numPoints,weight);
+        m_WeightsFile.write((char *)&pointWeights[0],numPoints * sizeof(double));
+    }
+
+    if (!m_OutputFile || !m_LinesFile || (m_WriteWeights && !m_WeightsFile))
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Error writing streamed fibers to " + m_FileName,ITK_LOCATION);
+
+    m_NumberOfPoints += numPoints;
+    ++m_NumberOfFibers;
+}
+
+void StreamingFibersWriter::Close()
+{
+    if (!m_Opened)
+        return;
+
+    m_QueueLock.Lock();
+    m_Closing = true;
+    m_QueueNotEmpty->Broadcast();
+    m_QueueLock.Unlock();
+
+    // Waits for the writer thread to empty the queue
+    m_Threader->TerminateThread(m_WriterThreadId);
+    m_Opened = false;
+
+    if (m_WriteError != "")
+    {
+        // The first error is the one reported, closing the stream may fail as well
+        if (m_BinaryFormat)
+        {
+            try
+            {
+                m_BinaryWriter.Close();
+            }
+            catch (itk::ExceptionObject &)
+            {
+            }
+        }
+        else
+        {
+            m_OutputFile.close();
+            m_LinesFile.close();
+            std::remove(m_LinesFileName.c_str());
+            if (m_WriteWeights)
+            {
+                m_WeightsFile.close();
+                std::remove(m_WeightsFileName.c_str());
+            }
+        }
+
+        throw itk::ExceptionObject(__FILE__, __LINE__,m_WriteError,ITK_LOCATION);
+    }
+
+    if (m_BinaryFormat)
+        m_BinaryWriter.Close();
+    else
+        this->CloseVTKFile();
+}
+
+void StreamingFibersWriter::CloseVTKFile()
+{
+    // Temporary files are flushed when closed
+    m_LinesFile.close();
+    if (m_WriteWeights)
+        m_WeightsFile.close();
+
+    if (!m_LinesFile || (m_WriteWeights && !m_WeightsFile))
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Error writing streamed fibers temporary files",ITK_LOCATION);
+
+    m_OutputFile << std::endl;
+    m_OutputFile << "LINES " << m_NumberOfFibers << " " << m_NumberOfFibers + m_NumberOfPoints << std::endl;
+    this->AppendFileContent(m_LinesFileName);
+    m_OutputFile << std::endl;
+
+    if (m_WriteWeights)
+    {
+        m_OutputFile << "POINT_DATA " << m_NumberOfPoints << std::endl;
+        m_OutputFile << "FIELD FieldData 1" << std::endl;
+        m_OutputFile << "Fiber%20weights 1 " << m_NumberOfPoints << " double" << std::endl;
+        this->AppendFileContent(m_WeightsFileName);
+        m_OutputFile << std::endl;
+    }
+
+    m_OutputFile.seekp(m_PointsHeaderPosition);
+    m_OutputFile << std::setw(12) << std::left << m_NumberOfPoints;
+    m_OutputFile.close();
+
+    if (!m_OutputFile)
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Error writing streamed fibers to " + m_FileName,ITK_LOCATION);
+}
+
+void StreamingFibersWriter::AppendFileContent(const std::string &fileName)
+{
+    std::ifstream inputFile(fileName.c_str(), std::ios::in | std::ios::binary);
+    if (!inputFile.is_open())
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Temporary fibers file could not be read",ITK_LOCATION);
+
+    // Empty files would set the fail bit of the output stream
+    if (inputFile.peek() != std::ifstream::traits_type::eof())
+        m_OutputFile << inputFile.rdbuf();
+
+    inputFile.close();
+    std::remove(fileName.c_str());
+}
+
+} // end namespace anima
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <itkMultiThreader.h>
+#include <itkMutexLock.h>
+#include <itkConditionVariable.h>
+#include <itkIntTypes.h>
+
+#include <animaFibersBinaryFileFormat.h>
+
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "AnimaDataIOExport.h"
+
+namespace anima {
+
+/**
+ * @brief Writes fibers to a binary legacy VTK polydata file or a binary fibers file (.fibb) while they are computed.
+ * Tracking threads push accepted fibers with AddFiber, a writer thread empties a bounded queue to disk so that memory
+ * does not grow with the number of fibers. For VTK files, point coordinates go directly to the output file,
+ * connectivity and weights to temporary files appended at Close(), header counts being patched at that time.
+ */
+class ANIMADATAIO_EXPORT StreamingFibersWriter
+{
+public:
+    StreamingFibersWriter();
+    ~StreamingFibersWriter();
+
+    //! Output file name, has to be a legacy vtk file or a binary fibers file
+    void SetFileName(const std::string &name) {m_FileName = name;}
+
+    //! Adds a "Fiber weights" point array holding the weight given for each fiber
+    void SetWriteWeights(bool flag) {m_WriteWeights = flag;}
+
+    //! Maximal number of points waiting to be written, producers are blocked beyond it
+    void SetMaximalNumberOfQueuedPoints(unsigned int num) {m_MaximalNumberOfQueuedPoints = num;}
+
+    //! Opens output files and starts the writer thread
+    void Open();
+
+    //! Thread-safe: queues a fiber (any container of 3D points) for writing, blocks while the queue is full
+    template <class FiberType> void AddFiber(const FiberType &fiber, double weight = 1.0)
+    {
+        std::vector <float> fiberCoordinates(3 * fiber.size());
+        for (unsigned int i = 0;i < fiber.size();++i)
+        {
+            for (unsigned int j = 0;j < 3;++j)
+                fiberCoordinates[3 * i + j] = fiber[i][j];
+        }
+
+        this->AddFiberCoordinates(fiberCoordinates,weight);
+    }
+
+    //! Thread-safe: queues a fiber given as interleaved x,y,z coordinates, swapped with the caller's vector
+    void AddFiberCoordinates(std::vector <float> &fiberCoordinates, double weight);
+
+    //! Writes remaining fibers, stops the writer thread and finalizes the output file. Throws if any write failed
+    void Close();
+
+    //! Numbers of written fibers and points, only valid once Close() returned
+    itk::uint64_t GetNumberOfFibers() {return m_NumberOfFibers;}
+    itk::uint64_t GetNumberOfPoints() {return m_NumberOfPoints;}
+
+protected:
+    static ITK_THREAD_RETURN_TYPE WriterThreadCallback(void *arg);
+    void WriteQueuedFibers();
+
+    //! Writes a fiber to the output and temporary files, called from the writer thread only, throws on write errors
+    void WriteFiber(std::vector <float> &fiberCoordinates, double weight);
+
+    void AppendFileContent(const std::string &fileName);
+
+    void OpenVTKFile();
+    void CloseVTKFile();
+
+private:
+    std::string m_FileName;
+    bool m_WriteWeights;
+    unsigned int m_MaximalNumberOfQueuedPoints;
+
+    std::ofstream m_OutputFile, m_LinesFile, m_WeightsFile;
+    std::string m_LinesFileName, m_WeightsFileName;
+    std::streampos m_PointsHeaderPosition;
+
+    bool m_BinaryFormat;
+    anima::FibersBinaryFileWriter m_BinaryWriter;
+    std::vector <float> m_BinaryPointRecords;
+
+    itk::MultiThreader::Pointer m_Threader;
+    itk::ThreadIdType m_WriterThreadId;
+    bool m_Opened, m_Closing;
+
+    //! First write error of the writer thread, reported by Close()
+    std::string m_WriteError;
+
+    itk::SimpleMutexLock m_QueueLock;
+    itk::ConditionVariable::Pointer m_QueueNotEmpty, m_QueueNotFull;
+    std::deque < std::vector <float> > m_FiberQueue;
+    std::deque <double> m_WeightQueue;
+    unsigned int m_NumberOfQueuedPoints;
+
+    itk::uint64_t m_NumberOfFibers, m_NumberOfPoints;
+};
+
+} // end namespace anima
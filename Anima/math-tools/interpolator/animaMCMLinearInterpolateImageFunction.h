@@ -49,6 +49,7 @@ public:
 
     typedef anima::MCMWeightedAverager AveragerType;
     typedef AveragerType::Pointer AveragerPointer;
+    typedef AveragerType::CompartmentGroupingType CompartmentGroupingType;
 
     /** Evaluate the function at a ContinuousIndex position
      *
@@ -66,6 +67,16 @@ public:
 
     std::vector <AveragerPointer> &GetAveragers() const {return m_MCMAveragers;}
 
+    //! Method used by averagers to group compartments of neighboring voxels (default: spectral clustering)
+    void SetCompartmentGrouping(CompartmentGroupingType val);
+
+    /** Reuse compartment memberships computed at the previous evaluation when falling in the same voxel cell with the
+     * same neighbors, so that repeated lookups inside one cell (e.g. along a fiber) avoid clustering. Memberships depend
+     * on the position of the first lookup in the cell and caches are kept per work index, so that results then depend on
+     * thread scheduling. Default: false */
+    itkSetMacro(CacheCellMemberships, bool)
+    itkGetConstMacro(CacheCellMemberships, bool)
+
 protected:
     MCMLinearInterpolateImageFunction();
     virtual ~MCMLinearInterpolateImageFunction() {}
@@ -117,6 +128,14 @@ private:
     mutable std::vector < std::vector <MCModelPointer> > m_ReferenceInputModels;
     mutable std::vector < std::vector <double> > m_ReferenceInputWeights;
     mutable std::vector <AveragerPointer> m_MCMAveragers;
+
+    bool m_CacheCellMemberships;
+    CompartmentGroupingType m_CompartmentGrouping;
+
+    // Last voxel cell (base index and used neighbors bits) and its memberships, per work index
+    mutable std::vector <IndexType> m_CachedCellIndexes;
+    mutable std::vector <unsigned int> m_CachedCellNeighbors;
+    mutable std::vector < std::vector < std::vector <double> > > m_CachedCellMemberships;
 };
 
 } // end namespace anima
@@ -19,6 +19,8 @@ template<class TInputImage, class TCoordRep>
 MCMLinearInterpolateImageFunction< TInputImage, TCoordRep >
 ::MCMLinearInterpolateImageFunction()
 {
+    m_CacheCellMemberships = false;
+    m_CompartmentGrouping = AveragerType::SpectralClustering;
 }
 
 template<class TInputImage, class TCoordRep>
@@ -40,6 +42,11 @@ MCMLinearInterpolateImageFunction< TInputImage, TCoordRep >
     unsigned int numThreads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
     m_ReferenceInputModels.resize(numThreads);
     m_ReferenceInputWeights.resize(numThreads);
+
+    // No used neighbor means no cached cell
+    m_CachedCellIndexes.resize(numThreads);
+    m_CachedCellNeighbors.assign(numThreads,0);
+    m_CachedCellMemberships.resize(numThreads);
     for (unsigned int i = 0;i < numThreads;++i)
     {
         m_ReferenceInputModels[i].resize(m_Neighbors);
@@ -73,9 +80,23 @@ MCMLinearInterpolateImageFunction< TInputImage, TCoordRep >
     {
         m_MCMAveragers[i] = AveragerType::New();
         m_MCMAveragers[i]->SetOutputModel(model);
+        m_MCMAveragers[i]->SetCompartmentGrouping(m_CompartmentGrouping);
     }
 }
 
+template<class TInputImage, class TCoordRep>
+void
+MCMLinearInterpolateImageFunction< TInputImage, TCoordRep >
+::SetCompartmentGrouping(CompartmentGroupingType val)
+{
+    m_CompartmentGrouping = val;
+    for (unsigned int i = 0;i < m_MCMAveragers.size();++i)
+        m_MCMAveragers[i]->SetCompartmentGrouping(val);
+
+    // Cached memberships were obtained with the previous method
+    std::fill(m_CachedCellNeighbors.begin(),m_CachedCellNeighbors.end(),0);
+}
+
 template<class TInputImage, class TCoordRep>
 bool
 MCMLinearInterpolateImageFunction< TInputImage, TCoordRep >
@@ -234,6 +255,7 @@ MCMLinearInterpolateImageFunction< TInputImage, TCoordRep >
 
     unsigned int numIsoCompartments = m_ReferenceInputModels[threadIndex][0]->GetNumberOfIsotropicCompartments();
     unsigned int numberOfTotalInputCompartments = m_ReferenceInputModels[threadIndex][0]->GetNumberOfCompartments();
+    unsigned int usedNeighbors = 0;
 
     for (unsigned int counterInput = 0;counterInput < m_Neighbors;++counterInput)
     {
@@ -297,6 +319,7 @@ MCMLinearInterpolateImageFunction< TInputImage, TCoordRep >
                 maxNumCompartments = numEffectiveAnisotropicCompartments;
 
             totalOverlap += overlap;
+            usedNeighbors |= (1 << counterInput);
             ++posMCM;
         }
     }
@@ -312,8 +335,21 @@ MCMLinearInterpolateImageFunction< TInputImage, TCoordRep >
     m_MCMAveragers[threadIndex]->SetInputModels(m_ReferenceInputModels[threadIndex]);
     m_MCMAveragers[threadIndex]->SetInputWeights(m_ReferenceInputWeights[threadIndex]);
 
+    bool cachedCell = m_CacheCellMemberships && (m_CachedCellNeighbors[threadIndex] == usedNeighbors) &&
+            (m_CachedCellIndexes[threadIndex] == baseIndex);
+
+    if (cachedCell)
+        m_MCMAveragers[threadIndex]->SetInputMemberships(m_CachedCellMemberships[threadIndex]);
+
     m_MCMAveragers[threadIndex]->Update();
 
+    if (m_CacheCellMemberships && !cachedCell)
+    {
+        m_CachedCellIndexes[threadIndex] = baseIndex;
+        m_CachedCellNeighbors[threadIndex] = usedNeighbors;
+        m_CachedCellMemberships[threadIndex] = m_MCMAveragers[threadIndex]->GetCompartmentMemberships();
+    }
+
     voxelOutputValue = m_MCMAveragers[threadIndex]->GetOutputModel()->GetModelVector();
 
     this->UnlockWorkIndex(threadIndex);
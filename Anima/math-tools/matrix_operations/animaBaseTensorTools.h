@@ -10,6 +10,7 @@
 namespace anima
 {
 
+//! Tensor logarithm, eigenvalues below 1e-16 are clamped to 1e-16 so that degenerate tensors get a finite logarithm
 template <class T> void GetTensorLogarithm(const vnl_matrix <T> &tensor, vnl_matrix <T> &log_tensor);
 template <class T> void GetTensorExponential(const vnl_matrix <T> &log_tensor, vnl_matrix <T> &tensor);
 template <class T> void GetTensorPower(const vnl_matrix <T> &tensor, vnl_matrix <T> &outputTensor, double powerValue);
@@ -21,6 +22,28 @@ template <class T1, class T2> void GetTensorFromVectorRepresentation(const itk::
                                                                      vnl_matrix <T2> &tensor, unsigned int tensDim = 0,
                                                                      bool scale = false);
 
+/**
+ * Closed form eigen decomposition of a 3x3 symmetric matrix: trigonometric eigenvalues and eigenvectors from cross
+ * products, robust to repeated eigenvalues. Same conventions as itk::SymmetricEigenAnalysis (ascending eigenvalues,
+ * eigenvectors stored as rows), works with vnl or itk matrices and vectors
+ */
+template <class MatrixType, class EigenValuesType, class EigenVectorsType>
+void ComputeSymmetric3x3EigenSystem(const MatrixType &tensor, EigenValuesType &eigenValues, EigenVectorsType &eigenVectors);
+
+//! Closed form eigenvalues (ascending) of a 3x3 symmetric matrix
+template <class MatrixType, class EigenValuesType>
+void ComputeSymmetric3x3EigenValues(const MatrixType &tensor, EigenValuesType &eigenValues);
+
+/**
+ * Closed form eigenvalues of a batch of 3x3 symmetric matrices stored as a structure of arrays: component k (vector
+ * representation order) of tensor i is tensorComponents[k * numTensors + i], ascending eigenvalue k of tensor i is
+ * written to eigenValues[k * numTensors + i]. The loop is branch free and uses no math library call other than sqrt
+ * (acos and cos are replaced by polynomials): it is vectorized across tensors by GCC at -O3 as long as sqrt does not
+ * have to set errno (-fno-math-errno, set on the targets using it)
+ */
+template <class T>
+void ComputeSymmetric3x3EigenValues(unsigned int numTensors, const T *tensorComponents, T *eigenValues);
+
 template <class T> void ProjectOnTensorSpace(const vnl_matrix <T> &matrix, vnl_matrix <T> &tensor);
 
 template <typename RealType>
@@ -3,6 +3,8 @@
 #include "animaBaseTensorTools.h"
 #include <itkSymmetricEigenAnalysis.h>
 
+#include <algorithm>
+
 #include <animaVectorOperations.h>
 #include <animaMatrixOperations.h>
 
@@ -15,11 +17,16 @@ GetTensorLogarithm(const vnl_matrix <T> &tensor, vnl_matrix <T> &log_tensor)
     typedef itk::SymmetricEigenAnalysis < vnl_matrix <T>, vnl_diag_matrix<T>, vnl_matrix <T> > EigenAnalysisType;
     unsigned int tensDim = tensor.rows();
 
-    EigenAnalysisType eigen(tensDim);
     vnl_matrix <T> eigVecs(tensDim,tensDim);
     vnl_diag_matrix <T> eigVals(tensDim);
 
-    eigen.ComputeEigenValuesAndVectors(tensor,eigVals,eigVecs);
+    if (tensDim == 3)
+        anima::ComputeSymmetric3x3EigenSystem(tensor,eigVals,eigVecs);
+    else
+    {
+        EigenAnalysisType eigen(tensDim);
+        eigen.ComputeEigenValuesAndVectors(tensor,eigVals,eigVecs);
+    }
 
     for (unsigned int i = 0;i < tensDim;++i)
     {
@@ -39,11 +46,16 @@ GetTensorPower(const vnl_matrix <T> &tensor, vnl_matrix <T> &outputTensor, doubl
     typedef itk::SymmetricEigenAnalysis < vnl_matrix <T>, vnl_diag_matrix<T>, vnl_matrix <T> > EigenAnalysisType;
     unsigned int tensDim = tensor.rows();
 
-    EigenAnalysisType eigen(tensDim);
     vnl_matrix <T> eigVecs(tensDim,tensDim);
     vnl_diag_matrix <T> eigVals(tensDim);
 
-    eigen.ComputeEigenValuesAndVectors(tensor,eigVals,eigVecs);
+    if (tensDim == 3)
+        anima::ComputeSymmetric3x3EigenSystem(tensor,eigVals,eigVecs);
+    else
+    {
+        EigenAnalysisType eigen(tensDim);
+        eigen.ComputeEigenValuesAndVectors(tensor,eigVals,eigVecs);
+    }
 
     for (unsigned int i = 0;i < tensDim;++i)
     {
@@ -63,11 +75,16 @@ GetTensorExponential(const vnl_matrix <T> &log_tensor, vnl_matrix <T> &tensor)
     typedef itk::SymmetricEigenAnalysis < vnl_matrix <T>, vnl_diag_matrix<T>, vnl_matrix <T> > EigenAnalysisType;
     unsigned int tensDim = log_tensor.rows();
 
-    EigenAnalysisType eigen(tensDim);
     vnl_matrix <T> eigVecs(tensDim,tensDim);
     vnl_diag_matrix <T> eigVals(tensDim);
 
-    eigen.ComputeEigenValuesAndVectors(log_tensor,eigVals,eigVecs);
+    if (tensDim == 3)
+        anima::ComputeSymmetric3x3EigenSystem(log_tensor,eigVals,eigVecs);
+    else
+    {
+        EigenAnalysisType eigen(tensDim);
+        eigen.ComputeEigenValuesAndVectors(log_tensor,eigVals,eigVecs);
+    }
 
     for (unsigned int i = 0;i < tensDim;++i)
         eigVals[i] = std::exp(eigVals[i]);
@@ -129,16 +146,404 @@ GetTensorFromVectorRepresentation(const itk::VariableLengthVector <T1> &vector,
         }
 }
 
+/**
+ * Cosine and sine of acos(x) / 3 for x in [-1, 1] (clamped outside), from polynomials and selections written as
+ * products only: loops calling it can be vectorized by the compiler, unlike calls to acos and cos.
+ * Absolute error is a few 1e-16
+ */
+template <class T>
+inline void
+ComputeThirdOfArcCosine(T x, T &cosValue, T &sinValue)
+{
+    const T tanPiOver16 = 0.198912367379658006;
+    const T tanPiOver8 = 0.414213562373095049;
+    const T tan3PiOver16 = 0.668178637919298919;
+    const T piOver8 = 0.392699081698724155;
+    const T piOver4 = 0.785398163397448310;
+    const T piOver2 = 1.57079632679489662;
+
+    // acos(x) = 2 atan(a / b) with a = sqrt(1 - x), b = sqrt(1 + x), the ratio being folded in [0,1]
+    T a = std::sqrt(std::max((T)0.0,(T)1.0 - x));
+    T b = std::sqrt(std::max((T)0.0,(T)1.0 + x));
+    T swapRatio = (a > b);
+    T y = std::min(a,b) / std::max(a,b);
+
+    // atan(y) = c + atan((y - t) / (1 + t y)) with t = tan(c) the closest of tan(0), tan(pi/8), tan(pi/4)
+    T upperCenter = (y > tan3PiOver16);
+    T middleCenter = (y > tanPiOver16) - upperCenter;
+    T center = upperCenter + middleCenter * tanPiOver8;
+    T centerAngle = upperCenter * piOver4 + middleCenter * piOver8;
+    T z = (y - center) / ((T)1.0 + center * y);
+    T z2 = z * z;
+
+    // Taylor series of atan on |z| <= tan(pi/16), truncated below 1e-17
+    T atanValue = 0.0;
+    for (int n = 12;n >= 0;--n)
+        atanValue = 1.0 / (2.0 * n + 1.0) - z2 * atanValue;
+
+    atanValue = centerAngle + z * atanValue;
+    atanValue += swapRatio * (piOver2 - 2.0 * atanValue);
+
+    T angle = atanValue * 2.0 / 3.0;
+    T angle2 = angle * angle;
+
+    // Taylor series of cos and sin on [0, pi/3], truncated below 1e-17
+    T cosSeries = 1.0;
+    T sinSeries = 1.0;
+    for (unsigned int n = 10;n > 0;--n)
+    {
+        cosSeries = 1.0 - angle2 * cosSeries * (1.0 / ((2.0 * n - 1.0) * (2.0 * n)));
+        sinSeries = 1.0 - angle2 * sinSeries * (1.0 / ((2.0 * n) * (2.0 * n + 1.0)));
+    }
+
+    cosValue = cosSeries;
+    sinValue = angle * sinSeries;
+}
+
+/**
+ * Invariants of a symmetric 3x3 matrix A scaled so that its largest absolute component is one (or zero): its eigenvalues
+ * are q + 2 p cos(acos(halfDeterminant) / 3 + 2 k pi / 3), halfDeterminant being det((A - q I) / p) / 2 (not clamped)
+ */
+template <class T>
+inline void
+ComputeScaledSymmetric3x3Invariants(T a00, T a01, T a02, T a11, T a12, T a22, T &q, T &p, T &halfDeterminant)
+{
+    T offDiagonalNorm = a01 * a01 + a02 * a02 + a12 * a12;
+    q = (a00 + a11 + a22) / 3.0;
+    T b00 = a00 - q;
+    T b11 = a11 - q;
+    T b22 = a22 - q;
+    p = std::sqrt((b00 * b00 + b11 * b11 + b22 * b22 + 2.0 * offDiagonalNorm) / 6.0);
+
+    T c00 = b11 * b22 - a12 * a12;
+    T c01 = a01 * b22 - a12 * a02;
+    T c02 = a01 * a12 - b11 * a02;
+
+    // Multiple of the identity: all eigenvalues are q (p is then replaced by one to keep the division branch free)
+    T pCube = p * p * p;
+    pCube += (pCube > 0) ? 0.0 : 1.0;
+    halfDeterminant = (b00 * c00 - a01 * c01 + a02 * c02) / (2.0 * pCube);
+}
+
+//! Eigenvalues of a symmetric 3x3 matrix scaled so that its largest absolute component is one (or zero), ascending
+template <class T>
+inline void
+ComputeScaledSymmetric3x3EigenValues(T a00, T a01, T a02, T a11, T a12, T a22, T &eigenValue0,
+                                     T &eigenValue1, T &eigenValue2, T &halfDeterminant)
+{
+    const T twoThirdsPi = 2.09439510239319549;
+
+    T q, p;
+    anima::ComputeScaledSymmetric3x3Invariants(a00,a01,a02,a11,a12,a22,q,p,halfDeterminant);
+    halfDeterminant = std::min((T)1.0, std::max((T)-1.0, halfDeterminant));
+
+    T angle = std::acos(halfDeterminant) / 3.0;
+    T beta2 = 2.0 * std::cos(angle);
+    T beta0 = 2.0 * std::cos(angle + twoThirdsPi);
+    T beta1 = - (beta0 + beta2);
+
+    eigenValue0 = q + p * beta0;
+    eigenValue1 = q + p * beta1;
+    eigenValue2 = q + p * beta2;
+}
+
+//! Unit eigenvector for a simple eigenvalue: largest cross product of two rows of the matrix minus eigenvalue
+template <class T>
+inline void
+ComputeSymmetric3x3SimpleEigenVector(T a00, T a01, T a02, T a11, T a12, T a22, T eigenValue, T eigenVector[3])
+{
+    T rows[3][3] = {{a00 - eigenValue, a01, a02}, {a01, a11 - eigenValue, a12}, {a02, a12, a22 - eigenValue}};
+    T crossProducts[3][3];
+    T squaredNorms[3];
+
+    const unsigned int firstRows[3] = {0, 0, 1};
+    const unsigned int secondRows[3] = {1, 2, 2};
+    for (unsigned int i = 0;i < 3;++i)
+    {
+        const T *u = rows[firstRows[i]];
+        const T *v = rows[secondRows[i]];
+        crossProducts[i][0] = u[1] * v[2] - u[2] * v[1];
+        crossProducts[i][1] = u[2] * v[0] - u[0] * v[2];
+        crossProducts[i][2] = u[0] * v[1] - u[1] * v[0];
+        squaredNorms[i] = crossProducts[i][0] * crossProducts[i][0] + crossProducts[i][1] * crossProducts[i][1] +
+                crossProducts[i][2] * crossProducts[i][2];
+    }
+
+    unsigned int maxIndex = 0;
+    for (unsigned int i = 1;i < 3;++i)
+    {
+        if (squaredNorms[i] > squaredNorms[maxIndex])
+            maxIndex = i;
+    }
+
+    if (squaredNorms[maxIndex] <= 0)
+    {
+        eigenVector[0] = 1.0;
+        eigenVector[1] = 0.0;
+        eigenVector[2] = 0.0;
+        return;
+    }
+
+    T invNorm = 1.0 / std::sqrt(squaredNorms[maxIndex]);
+    for (unsigned int i = 0;i < 3;++i)
+        eigenVector[i] = crossProducts[maxIndex][i] * invNorm;
+}
+
+/**
+ * Eigen decomposition of the restriction of a symmetric 3x3 matrix to the plane orthogonal to a unit eigenvector.
+ * The 2x2 problem is solved by a single Jacobi rotation so that close or repeated eigenvalues stay accurate.
+ * Eigenvalues are returned in ascending order with matching unit eigenvectors
+ */
+template <class T>
+inline void
+ComputeSymmetric3x3ComplementEigenSystem(T a00, T a01, T a02, T a11, T a12, T a22, const T firstEigenVector[3],
+                                         T eigenValues[2], T eigenVectors[2][3])
+{
+    T u[3], v[3];
+    if (std::abs(firstEigenVector[0]) > std::abs(firstEigenVector[1]))
+    {
+        T invLength = 1.0 / std::sqrt(firstEigenVector[0] * firstEigenVector[0] + firstEigenVector[2] * firstEigenVector[2]);
+        u[0] = - firstEigenVector[2] * invLength;
+        u[1] = 0.0;
+        u[2] = firstEigenVector[0] * invLength;
+    }
+    else
+    {
+        T invLength = 1.0 / std::sqrt(firstEigenVector[1] * firstEigenVector[1] + firstEigenVector[2] * firstEigenVector[2]);
+        u[0] = 0.0;
+        u[1] = firstEigenVector[2] * invLength;
+        u[2] = - firstEigenVector[1] * invLength;
+    }
+
+    v[0] = firstEigenVector[1] * u[2] - firstEigenVector[2] * u[1];
+    v[1] = firstEigenVector[2] * u[0] - firstEigenVector[0] * u[2];
+    v[2] = firstEigenVector[0] * u[1] - firstEigenVector[1] * u[0];
+
+    T av[3] = {a00 * v[0] + a01 * v[1] + a02 * v[2], a01 * v[0] + a11 * v[1] + a12 * v[2], a02 * v[0] + a12 * v[1] + a22 * v[2]};
+    T au[3] = {a00 * u[0] + a01 * u[1] + a02 * u[2], a01 * u[0] + a11 * u[1] + a12 * u[2], a02 * u[0] + a12 * u[1] + a22 * u[2]};
+
+    T s00 = u[0] * au[0] + u[1] * au[1] + u[2] * au[2];
+    T s01 = u[0] * av[0] + u[1] * av[1] + u[2] * av[2];
+    T s11 = v[0] * av[0] + v[1] * av[1] + v[2] * av[2];
+
+    // Jacobi rotation (c,s) diagonalizing [s00 s01; s01 s11], t is the tangent of the smallest rotation angle
+    T t = 0.0;
+    if (s01 != 0)
+    {
+        T theta = (s11 - s00) / (2.0 * s01);
+        t = 1.0 / (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+        if (theta < 0)
+            t = - t;
+    }
+
+    T c = 1.0 / std::sqrt(t * t + 1.0);
+    T sn = t * c;
+
+    T firstValue = s00 - t * s01;
+    T secondValue = s11 + t * s01;
+
+    T firstVector[3], secondVector[3];
+    for (unsigned int i = 0;i < 3;++i)
+    {
+        firstVector[i] = c * u[i] - sn * v[i];
+        secondVector[i] = sn * u[i] + c * v[i];
+    }
+
+    bool swapValues = (secondValue < firstValue);
+    eigenValues[0] = swapValues ? secondValue : firstValue;
+    eigenValues[1] = swapValues ? firstValue : secondValue;
+    for (unsigned int i = 0;i < 3;++i)
+    {
+        eigenVectors[0][i] = swapValues ? secondVector[i] : firstVector[i];
+        eigenVectors[1][i] = swapValues ? firstVector[i] : secondVector[i];
+    }
+}
+
+template <class MatrixType, class EigenValuesType>
+void
+ComputeSymmetric3x3EigenValues(const MatrixType &tensor, EigenValuesType &eigenValues)
+{
+    double components[6] = {tensor(0,0), tensor(0,1), tensor(1,1), tensor(0,2), tensor(1,2), tensor(2,2)};
+
+    double maxAbsComponent = 0;
+    for (unsigned int i = 0;i < 6;++i)
+        maxAbsComponent = std::max(maxAbsComponent,std::abs(components[i]));
+
+    double invMax = (maxAbsComponent > 0) ? 1.0 / maxAbsComponent : 0.0;
+    for (unsigned int i = 0;i < 6;++i)
+        components[i] *= invMax;
+
+    double values[3], halfDeterminant;
+    anima::ComputeScaledSymmetric3x3EigenValues(components[0],components[1],components[3],components[2],components[4],
+                                                components[5],values[0],values[1],values[2],halfDeterminant);
+
+    for (unsigned int i = 0;i < 3;++i)
+        eigenValues[i] = values[i] * maxAbsComponent;
+}
+
+template <class T>
+void
+ComputeSymmetric3x3EigenValues(unsigned int numTensors, const T *tensorComponents, T *eigenValues)
+{
+    const T *a00 = tensorComponents;
+    const T *a01 = tensorComponents + numTensors;
+    const T *a11 = tensorComponents + 2 * numTensors;
+    const T *a02 = tensorComponents + 3 * numTensors;
+    const T *a12 = tensorComponents + 4 * numTensors;
+    const T *a22 = tensorComponents + 5 * numTensors;
+
+    const T sqrt3 = 1.73205080756887729;
+
+    // Results go to local buffers first: direct writes to eigenValues would need more run-time aliasing checks against
+    // the six input arrays than the compiler accepts before vectorizing
+    const unsigned int chunkSize = 64;
+    T chunkEigenValues[3][chunkSize];
+
+    for (unsigned int chunkStart = 0;chunkStart < numTensors;chunkStart += chunkSize)
+    {
+        unsigned int chunkEnd = std::min(chunkStart + chunkSize,numTensors);
+        for (unsigned int i = chunkStart;i < chunkEnd;++i)
+        {
+            // Scaling by the largest component avoids under and overflows on small diffusivities
+            T maxAbsComponent = std::max(std::max(std::max(std::abs(a00[i]),std::abs(a01[i])),std::max(std::abs(a02[i]),std::abs(a11[i]))),
+                                         std::max(std::abs(a12[i]),std::abs(a22[i])));
+            T invMax = 1.0 / (maxAbsComponent + ((maxAbsComponent > 0) ? 0.0 : 1.0));
+
+            T q, p, halfDeterminant;
+            anima::ComputeScaledSymmetric3x3Invariants(a00[i] * invMax,a01[i] * invMax,a02[i] * invMax,a11[i] * invMax,
+                                                       a12[i] * invMax,a22[i] * invMax,q,p,halfDeterminant);
+
+            // Same as ComputeScaledSymmetric3x3EigenValues with polynomial angles, cos(angle + 2 pi / 3) being expanded
+            T cosValue, sinValue;
+            anima::ComputeThirdOfArcCosine(halfDeterminant,cosValue,sinValue);
+            T beta2 = 2.0 * cosValue;
+            T beta0 = - cosValue - sqrt3 * sinValue;
+            T beta1 = - (beta0 + beta2);
+
+            chunkEigenValues[0][i - chunkStart] = (q + p * beta0) * maxAbsComponent;
+            chunkEigenValues[1][i - chunkStart] = (q + p * beta1) * maxAbsComponent;
+            chunkEigenValues[2][i - chunkStart] = (q + p * beta2) * maxAbsComponent;
+        }
+
+        for (unsigned int k = 0;k < 3;++k)
+            std::copy(chunkEigenValues[k],chunkEigenValues[k] + chunkEnd - chunkStart,eigenValues + k * numTensors + chunkStart);
+    }
+}
+
+template <class MatrixType, class EigenValuesType, class EigenVectorsType>
+void
+ComputeSymmetric3x3EigenSystem(const MatrixType &tensor, EigenValuesType &eigenValues, EigenVectorsType &eigenVectors)
+{
+    double maxAbsComponent = 0;
+    for (unsigned int i = 0;i < 3;++i)
+    {
+        for (unsigned int j = i;j < 3;++j)
+            maxAbsComponent = std::max(maxAbsComponent,(double)std::abs(tensor(i,j)));
+    }
+
+    double values[3];
+    double vectors[3][3] = {{1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0}};
+
+    if (maxAbsComponent == 0)
+    {
+        for (unsigned int i = 0;i < 3;++i)
+            values[i] = 0;
+    }
+    else
+    {
+        double invMax = 1.0 / maxAbsComponent;
+        double a00 = tensor(0,0) * invMax;
+        double a01 = tensor(0,1) * invMax;
+        double a02 = tensor(0,2) * invMax;
+        double a11 = tensor(1,1) * invMax;
+        double a12 = tensor(1,2) * invMax;
+        double a22 = tensor(2,2) * invMax;
+
+        if (a01 * a01 + a02 * a02 + a12 * a12 > 0)
+        {
+            double halfDeterminant;
+            anima::ComputeScaledSymmetric3x3EigenValues(a00,a01,a02,a11,a12,a22,values[0],values[1],values[2],halfDeterminant);
+
+            // Start from the eigenvalue farthest from the two others: it is simple and accurate
+            unsigned int firstIndex = (halfDeterminant >= 0) ? 2 : 0;
+            unsigned int otherIndex = (firstIndex == 2) ? 0 : 1;
+
+            anima::ComputeSymmetric3x3SimpleEigenVector(a00,a01,a02,a11,a12,a22,values[firstIndex],vectors[firstIndex]);
+
+            // Rayleigh quotient of the simple eigenvector is more accurate than the trigonometric value
+            const double *w = vectors[firstIndex];
+            values[firstIndex] = a00 * w[0] * w[0] + a11 * w[1] * w[1] + a22 * w[2] * w[2] +
+                    2.0 * (a01 * w[0] * w[1] + a02 * w[0] * w[2] + a12 * w[1] * w[2]);
+
+            double complementValues[2];
+            double complementVectors[2][3];
+            anima::ComputeSymmetric3x3ComplementEigenSystem(a00,a01,a02,a11,a12,a22,vectors[firstIndex],
+                                                            complementValues,complementVectors);
+
+            for (unsigned int i = 0;i < 2;++i)
+            {
+                values[otherIndex + i] = complementValues[i];
+                for (unsigned int j = 0;j < 3;++j)
+                    vectors[otherIndex + i][j] = complementVectors[i][j];
+            }
+
+            // Right handed basis
+            double determinant = vectors[0][0] * (vectors[1][1] * vectors[2][2] - vectors[1][2] * vectors[2][1]) -
+                    vectors[0][1] * (vectors[1][0] * vectors[2][2] - vectors[1][2] * vectors[2][0]) +
+                    vectors[0][2] * (vectors[1][0] * vectors[2][1] - vectors[1][1] * vectors[2][0]);
+
+            if (determinant < 0)
+            {
+                for (unsigned int j = 0;j < 3;++j)
+                    vectors[2][j] *= -1.0;
+            }
+        }
+        else
+        {
+            // Diagonal matrix: sort diagonal values with matching canonical vectors
+            double diagonal[3] = {a00, a11, a22};
+            unsigned int order[3] = {0, 1, 2};
+            for (unsigned int i = 0;i < 2;++i)
+            {
+                for (unsigned int j = i + 1;j < 3;++j)
+                {
+                    if (diagonal[order[j]] < diagonal[order[i]])
+                        std::swap(order[i],order[j]);
+                }
+            }
+
+            for (unsigned int i = 0;i < 3;++i)
+            {
+                values[i] = diagonal[order[i]];
+                for (unsigned int j = 0;j < 3;++j)
+                    vectors[i][j] = (j == order[i]) ? 1.0 : 0.0;
+            }
+        }
+    }
+
+    for (unsigned int i = 0;i < 3;++i)
+    {
+        eigenValues[i] = values[i] * maxAbsComponent;
+        for (unsigned int j = 0;j < 3;++j)
+            eigenVectors(i,j) = vectors[i][j];
+    }
+}
+
 template <class T> void ProjectOnTensorSpace(const vnl_matrix <T> &matrix, vnl_matrix <T> &tensor)
 {
     typedef itk::SymmetricEigenAnalysis < vnl_matrix <T>, vnl_diag_matrix<T>, vnl_matrix <T> > EigenAnalysisType;
     unsigned int tensDim = matrix.rows();
 
-    EigenAnalysisType eigen(tensDim);
     vnl_matrix <T> eigVecs(tensDim,tensDim);
     vnl_diag_matrix <T> eigVals(tensDim);
 
-    eigen.ComputeEigenValuesAndVectors(matrix,eigVals,eigVecs);
+    if (tensDim == 3)
+        anima::ComputeSymmetric3x3EigenSystem(matrix,eigVals,eigVecs);
+    else
+    {
+        EigenAnalysisType eigen(tensDim);
+        eigen.ComputeEigenValuesAndVectors(matrix,eigVals,eigVecs);
+    }
 
     for (unsigned int i = 0;i < tensDim;++i)
     {
@@ -168,11 +573,10 @@ ExtractRotationFromJacobianMatrix(vnl_matrix <RealType> &jacobianMatrix, vnl_mat
                 tmpMat(m,l) = tmpMat(l,m);
         }
 
-    itk::SymmetricEigenAnalysis < vnl_matrix <RealType>, vnl_diag_matrix<RealType>, vnl_matrix <RealType> > eigenComputer(tensorDimension);
     vnl_matrix <RealType> eVec(tensorDimension,tensorDimension);
     vnl_diag_matrix <RealType> eVals(tensorDimension);
 
-    eigenComputer.ComputeEigenValuesAndVectors(tmpMat, eVals, eVec);
+    anima::ComputeSymmetric3x3EigenSystem(tmpMat, eVals, eVec);
 
     for (unsigned int i = 0;i < tensorDimension;++i)
         eVals[i] = pow(eVals[i], -0.5);
@@ -10,6 +10,15 @@ template <class ScalarType> itk::Matrix <double,3,3> GetRotationMatrixFromVector
 template <class ScalarType, unsigned int NDimension> itk::Matrix <double,3,3> GetRotationMatrixFromVectors(const itk::Vector<ScalarType,NDimension> &first_direction, const itk::Vector<ScalarType,NDimension> &second_direction);
 template <class ScalarType, unsigned int NDimension> itk::Matrix <double,3,3> GetRotationMatrixFromVectors(const vnl_vector_fixed<ScalarType,NDimension> &first_direction, const vnl_vector_fixed<ScalarType,NDimension> &second_direction);
 
+/**
+ * Cache blocked matrix product result = leftMatrix * rightMatrix^T on contiguous row-major arrays: leftMatrix is
+ * numRows x innerDimension, rightMatrix is numColumns x innerDimension and result is numRows x numColumns. Typically
+ * used to apply one reconstruction matrix to a block of voxels at once instead of one matrix-vector product per voxel
+ */
+template <class ScalarType> void ComputeBlockedMatrixTransposeProduct(unsigned int numRows, unsigned int innerDimension,
+                                                                      unsigned int numColumns, const ScalarType *leftMatrix,
+                                                                      const ScalarType *rightMatrix, ScalarType *result);
+
 } // end of namespace anima
 
 #include "animaMatrixOperations.hxx"
@@ -5,6 +5,9 @@
 #include <animaLinearTransformEstimationTools.h>
 #include <itkSymmetricEigenAnalysis.h>
 
+#include <algorithm>
+#include <vector>
+
 namespace anima
 {
 
@@ -71,4 +74,53 @@ GetRotationMatrixFromVectors(const vnl_vector_fixed<ScalarType,NDimension> &firs
     return GetRotationMatrixFromVectors(first_direction, second_direction, NDimension);
 }
 
+template <class ScalarType>
+void
+ComputeBlockedMatrixTransposeProduct(unsigned int numRows, unsigned int innerDimension, unsigned int numColumns,
+                                     const ScalarType *leftMatrix, const ScalarType *rightMatrix, ScalarType *result)
+{
+    // Tile sizes chosen so that a packed tile of the right matrix stays in L1 cache
+    const unsigned int innerTileSize = 64;
+    const unsigned int columnTileSize = 32;
+    const unsigned int rowTileSize = 64;
+
+    std::fill(result,result + numRows * numColumns,ScalarType(0));
+    std::vector <ScalarType> packedTile(innerTileSize * columnTileSize);
+
+    for (unsigned int kStart = 0;kStart < innerDimension;kStart += innerTileSize)
+    {
+        unsigned int kEnd = std::min(kStart + innerTileSize,innerDimension);
+        for (unsigned int jStart = 0;jStart < numColumns;jStart += columnTileSize)
+        {
+            unsigned int jEnd = std::min(jStart + columnTileSize,numColumns);
+            unsigned int tileWidth = jEnd - jStart;
+
+            // Pack the right matrix tile so that the innermost loop is contiguous and vectorizable
+            for (unsigned int k = kStart;k < kEnd;++k)
+            {
+                for (unsigned int j = jStart;j < jEnd;++j)
+                    packedTile[(k - kStart) * tileWidth + j - jStart] = rightMatrix[j * innerDimension + k];
+            }
+
+            for (unsigned int iStart = 0;iStart < numRows;iStart += rowTileSize)
+            {
+                unsigned int iEnd = std::min(iStart + rowTileSize,numRows);
+                for (unsigned int i = iStart;i < iEnd;++i)
+                {
+                    const ScalarType *leftRow = leftMatrix + i * innerDimension;
+                    ScalarType *resultRow = result + i * numColumns + jStart;
+
+                    for (unsigned int k = kStart;k < kEnd;++k)
+                    {
+                        ScalarType leftValue = leftRow[k];
+                        const ScalarType *packedRow = &packedTile[(k - kStart) * tileWidth];
+                        for (unsigned int j = 0;j < tileWidth;++j)
+                            resultRow[j] += leftValue * packedRow[j];
+                    }
+                }
+            }
+        }
+    }
+}
+
 } // end of namespace anima
@@ -0,0 +1,254 @@
+#include <animaBaseTensorTools.h>
+#include <tclap/CmdLine.h>
+
+#include <itkSymmetricEigenAnalysis.h>
+#include <itkTimeProbe.h>
+
+#include <iostream>
+#include <cmath>
+#include <random>
+#include <algorithm>
+
+//! Random tensor, with close or repeated eigenvalues depending on tensor type
+void GenerateTensor(std::mt19937 &generator, unsigned int tensorType, vnl_matrix <double> &tensor)
+{
+    std::normal_distribution <double> normalDistribution(0.0,1.0);
+    std::uniform_real_distribution <double> uniformDistribution(0.0,1.0);
+
+    // Random rotation by Gram-Schmidt orthonormalization
+    vnl_matrix <double> rotation(3,3);
+    for (unsigned int i = 0;i < 3;++i)
+    {
+        for (unsigned int j = 0;j < 3;++j)
+            rotation(i,j) = normalDistribution(generator);
+
+        for (unsigned int k = 0;k < i;++k)
+        {
+            double dotProduct = 0;
+            for (unsigned int j = 0;j < 3;++j)
+                dotProduct += rotation(i,j) * rotation(k,j);
+
+            for (unsigned int j = 0;j < 3;++j)
+                rotation(i,j) -= dotProduct * rotation(k,j);
+        }
+
+        double norm = 0;
+        for (unsigned int j = 0;j < 3;++j)
+            norm += rotation(i,j) * rotation(i,j);
+
+        for (unsigned int j = 0;j < 3;++j)
+            rotation(i,j) /= std::sqrt(norm);
+    }
+
+    double baseValue = 3.0e-3 * uniformDistribution(generator);
+    double relativeGap = std::pow(10.0, - 1.0 - 15.0 * uniformDistribution(generator));
+
+    vnl_diag_matrix <double> eigenValues(3);
+    switch (tensorType)
+    {
+        case 0:
+            // Generic tensor
+            for (unsigned int i = 0;i < 3;++i)
+                eigenValues[i] = 3.0e-3 * uniformDistribution(generator);
+            break;
+
+        case 1:
+            // Nearly prolate
+            eigenValues[0] = baseValue;
+            eigenValues[1] = baseValue * (1.0 + relativeGap);
+            eigenValues[2] = 4.0 * baseValue;
+            break;
+
+        case 2:
+            // Nearly oblate
+            eigenValues[0] = 0.2 * baseValue;
+            eigenValues[1] = baseValue;
+            eigenValues[2] = baseValue * (1.0 + relativeGap);
+            break;
+
+        case 3:
+            // Nearly isotropic
+            eigenValues[0] = baseValue;
+            eigenValues[1] = baseValue * (1.0 + relativeGap);
+            eigenValues[2] = baseValue * (1.0 + 2.0 * relativeGap);
+            break;
+
+        case 4:
+            // Rank one
+            eigenValues[0] = 0;
+            eigenValues[1] = 0;
+            eigenValues[2] = baseValue;
+            break;
+
+        case 5:
+        default:
+            // Exactly isotropic
+            eigenValues.fill(baseValue);
+            rotation.set_identity();
+            break;
+    }
+
+    anima::RecomposeTensor(eigenValues,rotation,tensor);
+}
+
+int main(int argc,  char **argv)
+{
+    TCLAP::CmdLine cmd("INRIA / IRISA - VisAGeS Team", ' ',ANIMA_VERSION);
+
+    TCLAP::ValueArg<unsigned int> numTensorsArg("n","nb-tensors","Number of random tensors per tensor type (default: 100000)",false,100000,"number of tensors",cmd);
+    TCLAP::ValueArg<double> toleranceArg("t","tolerance","Maximal error allowed, relative to the largest eigenvalue (default: 1.0e-10)",false,1.0e-10,"tolerance",cmd);
+
+    try
+    {
+        cmd.parse(argc,argv);
+    }
+    catch (TCLAP::ArgException& e)
+    {
+        std::cerr << "Error: " << e.error() << "for argument " << e.argId() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const unsigned int numTensorTypes = 6;
+    const char *tensorTypeNames[numTensorTypes] = {"generic", "nearly prolate", "nearly oblate", "nearly isotropic",
+                                                   "rank one", "isotropic"};
+
+    unsigned int numTensors = numTensorsArg.getValue();
+    std::mt19937 generator(0);
+
+    typedef itk::SymmetricEigenAnalysis < vnl_matrix <double>, vnl_diag_matrix<double>, vnl_matrix <double> > EigenAnalysisType;
+    EigenAnalysisType eigenAnalysis(3);
+
+    vnl_matrix <double> tensor(3,3), eigenVectors(3,3), refEigenVectors(3,3);
+    vnl_diag_matrix <double> eigenValues(3), refEigenValues(3);
+    std::vector <double> tensorComponents(6 * numTensors), batchEigenValues(3 * numTensors);
+    std::vector <double> eigenValueErrors(numTensorTypes,0.0), residualErrors(numTensorTypes,0.0);
+    std::vector <double> orthogonalityErrors(numTensorTypes,0.0), batchErrors(numTensorTypes,0.0);
+
+    bool testPassed = true;
+    for (unsigned int type = 0;type < numTensorTypes;++type)
+    {
+        for (unsigned int i = 0;i < numTensors;++i)
+        {
+            GenerateTensor(generator,type,tensor);
+
+            unsigned int pos = 0;
+            for (unsigned int j = 0;j < 3;++j)
+            {
+                for (unsigned int k = 0;k <= j;++k)
+                {
+                    tensorComponents[pos * numTensors + i] = tensor(j,k);
+                    ++pos;
+                }
+            }
+
+            anima::ComputeSymmetric3x3EigenSystem(tensor,eigenValues,eigenVectors);
+            eigenAnalysis.ComputeEigenValuesAndVectors(tensor,refEigenValues,refEigenVectors);
+
+            double scale = std::max(std::abs(refEigenValues[0]),std::abs(refEigenValues[2]));
+            if (scale == 0)
+                scale = 1.0;
+
+            for (unsigned int j = 0;j < 3;++j)
+            {
+                eigenValueErrors[type] = std::max(eigenValueErrors[type],std::abs(eigenValues[j] - refEigenValues[j]) / scale);
+
+                // Eigenvectors of repeated eigenvalues are not unique: check A v = lambda v and orthonormality
+                double residual = 0;
+                for (unsigned int k = 0;k < 3;++k)
+                {
+                    double residualComponent = - eigenValues[j] * eigenVectors(j,k);
+                    for (unsigned int l = 0;l < 3;++l)
+                        residualComponent += tensor(k,l) * eigenVectors(j,l);
+
+                    residual += residualComponent * residualComponent;
+                }
+
+                residualErrors[type] = std::max(residualErrors[type],std::sqrt(residual) / scale);
+
+                for (unsigned int k = 0;k < 3;++k)
+                {
+                    double dotProduct = 0;
+                    for (unsigned int l = 0;l < 3;++l)
+                        dotProduct += eigenVectors(j,l) * eigenVectors(k,l);
+
+                    orthogonalityErrors[type] = std::max(orthogonalityErrors[type],std::abs(dotProduct - (j == k)));
+                }
+            }
+        }
+
+        anima::ComputeSymmetric3x3EigenValues(numTensors,tensorComponents.data(),batchEigenValues.data());
+        for (unsigned int i = 0;i < numTensors;++i)
+        {
+            for (unsigned int j = 0;j < 3;++j)
+            {
+                for (unsigned int k = 0;k < 3;++k)
+                {
+                    unsigned int row = std::max(j,k);
+                    unsigned int pos = row * (row + 1) / 2 + std::min(j,k);
+                    tensor(j,k) = tensorComponents[pos * numTensors + i];
+                }
+            }
+
+            eigenAnalysis.ComputeEigenValues(tensor,refEigenValues);
+            double scale = std::max(std::abs(refEigenValues[0]),std::abs(refEigenValues[2]));
+            if (scale == 0)
+                scale = 1.0;
+
+            for (unsigned int j = 0;j < 3;++j)
+                batchErrors[type] = std::max(batchErrors[type],std::abs(batchEigenValues[j * numTensors + i] - refEigenValues[j]) / scale);
+        }
+
+        std::cout << "Tensor type " << tensorTypeNames[type] << ": max eigenvalue error " << eigenValueErrors[type]
+                  << ", max residual " << residualErrors[type] << ", max orthogonality error " << orthogonalityErrors[type]
+                  << ", max batched eigenvalue error " << batchErrors[type] << std::endl;
+
+        if ((eigenValueErrors[type] > toleranceArg.getValue()) || (residualErrors[type] > toleranceArg.getValue()) ||
+                (orthogonalityErrors[type] > toleranceArg.getValue()))
+            testPassed = false;
+
+        // Trigonometric eigenvalues lose accuracy on close eigenvalues, eigen systems refine them
+        if (batchErrors[type] > std::sqrt(toleranceArg.getValue()))
+            testPassed = false;
+    }
+
+    // Benchmark on generic tensors
+    std::vector < vnl_matrix <double> > tensors(numTensors);
+    for (unsigned int i = 0;i < numTensors;++i)
+        GenerateTensor(generator,0,tensors[i]);
+
+    double checkSum = 0;
+    itk::TimeProbe tmpTime;
+    tmpTime.Start();
+    for (unsigned int i = 0;i < numTensors;++i)
+    {
+        eigenAnalysis.ComputeEigenValuesAndVectors(tensors[i],refEigenValues,refEigenVectors);
+        checkSum += refEigenValues[0] + refEigenVectors(0,0);
+    }
+    tmpTime.Stop();
+    std::cout << "SymmetricEigenAnalysis time per tensor: " << tmpTime.GetTotal() / numTensors << "s" << std::endl;
+
+    tmpTime.Reset();
+    tmpTime.Start();
+    for (unsigned int i = 0;i < numTensors;++i)
+    {
+        anima::ComputeSymmetric3x3EigenSystem(tensors[i],eigenValues,eigenVectors);
+        checkSum += eigenValues[0] + eigenVectors(0,0);
+    }
+    tmpTime.Stop();
+    std::cout << "Closed form time per tensor: " << tmpTime.GetTotal() / numTensors << "s" << std::endl;
+
+    tmpTime.Reset();
+    tmpTime.Start();
+    anima::ComputeSymmetric3x3EigenValues(numTensors,tensorComponents.data(),batchEigenValues.data());
+    tmpTime.Stop();
+    std::cout << "Batched closed form eigenvalues time per tensor: " << tmpTime.GetTotal() / numTensors << "s (checksum "
+              << checkSum + batchEigenValues[0] << ")" << std::endl;
+
+    if (!testPassed)
+    {
+        std::cerr << "Closed form eigen decomposition is not accurate enough" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
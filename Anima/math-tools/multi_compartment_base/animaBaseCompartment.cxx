@@ -13,6 +13,100 @@ double BaseCompartment::GetPredictedSignal(double smallDelta, double bigDelta, d
     return std::abs(ftDiffusionProfile);
 }
 
+void BaseCompartment::GetFourierTransformedDiffusionProfiles(const MCMGradientTable &gradientTable, ListType &attenuations)
+{
+    unsigned int nbValues = gradientTable.GetNumberOfGradients();
+    attenuations.resize(nbValues);
+
+    const ListType &gradientStrengths = gradientTable.GetGradientStrengths();
+    const std::vector <Vector3DType> &gradients = gradientTable.GetGradients();
+
+    for (unsigned int i = 0;i < nbValues;++i)
+        attenuations[i] = this->GetFourierTransformedDiffusionProfile(gradientTable.GetSmallDelta(), gradientTable.GetBigDelta(),
+                                                                      gradientStrengths[i], gradients[i]);
+}
+
+void BaseCompartment::GetSignalAttenuationJacobians(const MCMGradientTable &gradientTable, ListType &jacobians)
+{
+    unsigned int nbValues = gradientTable.GetNumberOfGradients();
+    unsigned int nbParams = this->GetNumberOfParameters();
+    jacobians.resize(nbValues * nbParams);
+
+    const ListType &gradientStrengths = gradientTable.GetGradientStrengths();
+    const std::vector <Vector3DType> &gradients = gradientTable.GetGradients();
+
+    for (unsigned int i = 0;i < nbValues;++i)
+    {
+        ListType &jacobianValue = this->GetSignalAttenuationJacobian(gradientTable.GetSmallDelta(), gradientTable.GetBigDelta(),
+                                                                     gradientStrengths[i], gradients[i]);
+
+        for (unsigned int k = 0;k < nbParams;++k)
+            jacobians[k * nbValues + i] = jacobianValue[k];
+    }
+}
+
+void BaseCompartment::ComputeCylindricallySymmetricAttenuations(const MCMGradientTable &gradientTable, double radialDiffusivity,
+                                                                 double diffusivityDifference, ListType &attenuations)
+{
+    unsigned int nbValues = gradientTable.GetNumberOfGradients();
+    attenuations.resize(nbValues);
+
+    Vector3DType compartmentOrientation(0.0);
+    anima::TransformSphericalToCartesianCoordinates(this->GetOrientationTheta(),this->GetOrientationPhi(),1.0,compartmentOrientation);
+
+    const double *bValues = gradientTable.GetBValues();
+    const double *gradientX = gradientTable.GetGradientComponents(0);
+    const double *gradientY = gradientTable.GetGradientComponents(1);
+    const double *gradientZ = gradientTable.GetGradientComponents(2);
+
+    for (unsigned int i = 0;i < nbValues;++i)
+    {
+        double innerProd = gradientX[i] * compartmentOrientation[0] + gradientY[i] * compartmentOrientation[1]
+                + gradientZ[i] * compartmentOrientation[2];
+
+        attenuations[i] = std::exp(- bValues[i] * (radialDiffusivity + diffusivityDifference * innerProd * innerProd));
+    }
+}
+
+void BaseCompartment::ComputeCylindricallySymmetricJacobians(const MCMGradientTable &gradientTable, double radialDiffusivity,
+                                                             double diffusivityDifference, unsigned int numDiffusivityDerivatives,
+                                                             ListType &jacobians)
+{
+    unsigned int nbValues = gradientTable.GetNumberOfGradients();
+    jacobians.resize(nbValues * this->GetNumberOfParameters());
+
+    double sinTheta = std::sin(this->GetOrientationTheta());
+    double cosTheta = std::cos(this->GetOrientationTheta());
+    double sinPhi = std::sin(this->GetOrientationPhi());
+    double cosPhi = std::cos(this->GetOrientationPhi());
+
+    const double *bValues = gradientTable.GetBValues();
+    const double *gradientX = gradientTable.GetGradientComponents(0);
+    const double *gradientY = gradientTable.GetGradientComponents(1);
+    const double *gradientZ = gradientTable.GetGradientComponents(2);
+
+    for (unsigned int i = 0;i < nbValues;++i)
+    {
+        double innerProd = sinTheta * (gradientX[i] * cosPhi + gradientY[i] * sinPhi) + gradientZ[i] * cosTheta;
+        double signalAttenuation = std::exp(- bValues[i] * (radialDiffusivity + diffusivityDifference * innerProd * innerProd));
+        double baseDerivative = -2.0 * bValues[i] * diffusivityDifference * innerProd * signalAttenuation;
+
+        // Derivative w.r.t. theta
+        jacobians[i] = baseDerivative * (cosTheta * (gradientX[i] * cosPhi + gradientY[i] * sinPhi) - gradientZ[i] * sinTheta);
+
+        // Derivative w.r.t. phi
+        jacobians[nbValues + i] = baseDerivative * sinTheta * (gradientY[i] * cosPhi - gradientX[i] * sinPhi);
+
+        // Derivative w.r.t. axial minus radial diffusivity
+        if (numDiffusivityDerivatives > 0)
+            jacobians[2 * nbValues + i] = - bValues[i] * innerProd * innerProd * signalAttenuation;
+
+        // Derivative w.r.t. radial diffusivity
+        if (numDiffusivityDerivatives > 1)
+            jacobians[3 * nbValues + i] = - bValues[i] * signalAttenuation;
+    }
+}
+
 bool BaseCompartment::IsEqual(Self *rhs, double tolerance, double absoluteTolerance)
 {
     if (this->GetTensorCompatible() && rhs->GetTensorCompatible())
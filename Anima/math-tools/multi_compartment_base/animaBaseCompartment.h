@@ -9,6 +9,7 @@
 
 #include <AnimaMCMBaseExport.h>
 #include <animaMCMConstants.h>
+#include <animaMCMGradientTable.h>
 
 namespace anima
 {
@@ -51,6 +52,18 @@ public:
     virtual ListType &GetSignalAttenuationJacobian(double smallDelta, double bigDelta, double gradientStrength, const Vector3DType &gradient) = 0;
     virtual double GetLogDiffusionProfile(const Vector3DType &sample) = 0;
 
+    /**
+     * Batched version of GetFourierTransformedDiffusionProfile: computes signal attenuations for a whole gradient table
+     * in a contiguous array. Default implementation loops over single gradient calls, re-implemented for speed in subclasses
+     */
+    virtual void GetFourierTransformedDiffusionProfiles(const MCMGradientTable &gradientTable, ListType &attenuations);
+
+    /**
+     * Batched version of GetSignalAttenuationJacobian. Output is stored parameter-wise:
+     * jacobians[k * nbGradients + i] is the derivative of the i-th attenuation w.r.t. the k-th parameter
+     */
+    virtual void GetSignalAttenuationJacobians(const MCMGradientTable &gradientTable, ListType &jacobians);
+
     //! Various methods for optimization parameters setting and getting
     virtual void SetParametersFromVector(const ListType &params) = 0;
     virtual ListType &GetParametersAsVector() = 0;
@@ -125,6 +138,22 @@ protected:
 
     virtual ~BaseCompartment() {}
 
+    /**
+     * Batched attenuations exp(-b (radialDiffusivity + diffusivityDifference (g.u)^2)) of a cylindrically symmetric
+     * Gaussian compartment oriented along u (orientation angles). Shared by stick and zeppelin compartments
+     */
+    void ComputeCylindricallySymmetricAttenuations(const MCMGradientTable &gradientTable, double radialDiffusivity,
+                                                   double diffusivityDifference, ListType &attenuations);
+
+    /**
+     * Batched jacobians of the same attenuations w.r.t. theta and phi, followed when numDiffusivityDerivatives > 0 by
+     * the derivative w.r.t. the axial minus radial diffusivity, and when it is 2 by the derivative w.r.t. the radial
+     * diffusivity (the difference being kept fixed). Stored parameter-wise as GetSignalAttenuationJacobians
+     */
+    void ComputeCylindricallySymmetricJacobians(const MCMGradientTable &gradientTable, double radialDiffusivity,
+                                                double diffusivityDifference, unsigned int numDiffusivityDerivatives,
+                                                ListType &jacobians);
+
     static const unsigned int m_SpaceDimension = 3;
 
     //! Matrix to hold working value of diffusion tensor approximation to the model
@@ -26,6 +26,33 @@ BaseCompartment::ListType &BaseIsotropicCompartment::GetSignalAttenuationJacobia
     return m_JacobianVector;
 }
     
+void BaseIsotropicCompartment::GetFourierTransformedDiffusionProfiles(const MCMGradientTable &gradientTable, ListType &attenuations)
+{
+    unsigned int nbValues = gradientTable.GetNumberOfGradients();
+    attenuations.resize(nbValues);
+
+    const double *bValues = gradientTable.GetBValues();
+    double diffusivity = this->GetAxialDiffusivity();
+
+    for (unsigned int i = 0;i < nbValues;++i)
+        attenuations[i] = std::exp(- bValues[i] * diffusivity);
+}
+
+void BaseIsotropicCompartment::GetSignalAttenuationJacobians(const MCMGradientTable &gradientTable, ListType &jacobians)
+{
+    unsigned int nbValues = gradientTable.GetNumberOfGradients();
+    jacobians.resize(nbValues * this->GetNumberOfParameters());
+
+    if (jacobians.size() == 0)
+        return;
+
+    const double *bValues = gradientTable.GetBValues();
+    double diffusivity = this->GetAxialDiffusivity();
+
+    for (unsigned int i = 0;i < nbValues;++i)
+        jacobians[i] = - bValues[i] * std::exp(- bValues[i] * diffusivity);
+}
+
 double BaseIsotropicCompartment::GetLogDiffusionProfile(const Vector3DType &sample)
 {
     double resVal = - 1.5 * std::log(2.0 * M_PI * this->GetAxialDiffusivity());
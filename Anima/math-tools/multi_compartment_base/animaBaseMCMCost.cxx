@@ -10,6 +10,19 @@ BaseMCMCost::BaseMCMCost()
 
     m_SmallDelta = anima::DiffusionSmallDelta;
     m_BigDelta = anima::DiffusionBigDelta;
+
+    m_ModifiedGradientTable = true;
+}
+
+const MCMGradientTable &BaseMCMCost::GetGradientTable()
+{
+    if (m_ModifiedGradientTable)
+    {
+        m_GradientTable.Initialize(m_SmallDelta,m_BigDelta,m_GradientStrengths,m_Gradients);
+        m_ModifiedGradientTable = false;
+    }
+
+    return m_GradientTable;
 }
 
 } // end namespace anima
@@ -5,6 +5,7 @@
 #include <itkOptimizerParameters.h>
 
 #include <animaMultiCompartmentModel.h>
+#include <animaMCMGradientTable.h>
 #include <AnimaMCMBaseExport.h>
 
 namespace anima
@@ -36,8 +37,8 @@ public:
     typedef MCMType::ListType ListType;
 
     void SetObservedSignals(ListType &value) {m_ObservedSignals = value;}
-    void SetGradients(std::vector<Vector3DType> &value) {m_Gradients = value;}
-    void SetGradientStrengths(ListType &value) {m_GradientStrengths = value;}
+    void SetGradients(std::vector<Vector3DType> &value) {m_Gradients = value; m_ModifiedGradientTable = true;}
+    void SetGradientStrengths(ListType &value) {m_GradientStrengths = value; m_ModifiedGradientTable = true;}
 
     void SetMCMStructure(MCMType *model) {m_MCMStructure = model;}
     MCMPointer &GetMCMStructure() {return m_MCMStructure;}
@@ -70,8 +71,11 @@ public:
 
     virtual double GetSigmaSquare() {return m_SigmaSquare;}
 
-    void SetSmallDelta(double val) {m_SmallDelta = val;}
-    void SetBigDelta(double val) {m_BigDelta = val;}
+    void SetSmallDelta(double val) {m_SmallDelta = val; m_ModifiedGradientTable = true;}
+    void SetBigDelta(double val) {m_BigDelta = val; m_ModifiedGradientTable = true;}
+
+    //! Pre-computed acquisition table used for batched signal evaluations, updated from acquisition parameters if needed
+    const MCMGradientTable &GetGradientTable();
 
 protected:
     BaseMCMCost();
@@ -89,6 +93,9 @@ protected:
     double m_BigDelta;
     ListType m_GradientStrengths;
 
+    MCMGradientTable m_GradientTable;
+    bool m_ModifiedGradientTable;
+
     MCMPointer m_MCMStructure;
 
 private:
@@ -0,0 +1,221 @@
+#include <animaMCMBinaryFileFormat.h>
+#include <itkMacro.h>
+
+#include <cstring>
+#include <sstream>
+
+namespace anima
+{
+
+namespace
+{
+
+const char MCMBinaryMagic[8] = {'A','N','I','M','A','M','C','M'};
+const itk::uint32_t MCMBinaryVersion = 1;
+const itk::uint32_t MCMBinaryByteOrderMark = 0x01020304;
+
+//! Payload alignment in bytes, enough for vectorized access to the mapped buffer
+const itk::uint64_t MCMBinaryPayloadAlignment = 64;
+
+//! Bounds on header values read before allocating anything from them
+const itk::uint32_t MCMBinaryMaximalDimension = 4;
+const itk::uint32_t MCMBinaryMaximalNumberOfCompartments = 1024;
+const itk::uint32_t MCMBinaryMaximalNameLength = 256;
+
+template <class T> void WriteValue(std::ostream &stream, T value)
+{
+    stream.write(reinterpret_cast <const char *> (&value),sizeof(T));
+}
+
+template <class T> T ReadValue(std::istream &stream)
+{
+    T value;
+    stream.read(reinterpret_cast <char *> (&value),sizeof(T));
+
+    if (!stream)
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Truncated binary MCM header",ITK_LOCATION);
+
+    return value;
+}
+
+} // end anonymous namespace
+
+itk::SizeValueType MCMBinaryFileHeader::GetNumberOfPixels() const
+{
+    itk::SizeValueType numPixels = 1;
+    for (unsigned int i = 0;i < Size.size();++i)
+        numPixels *= Size[i];
+
+    return numPixels;
+}
+
+bool MCMBinaryFileHeader::IsPayloadInFile(itk::uint64_t fileSize) const
+{
+    if ((PayloadOffset > fileSize) || (PayloadOffset % GetComponentSize() != 0))
+        return false;
+
+    // Number of values that fit after the header, pixels are accumulated against it to avoid overflows
+    itk::uint64_t availableValues = (fileSize - PayloadOffset) / GetComponentSize();
+    if (VectorLength == 0)
+        return true;
+
+    itk::uint64_t availablePixels = availableValues / VectorLength;
+    itk::uint64_t numPixels = 1;
+    for (unsigned int i = 0;i < Size.size();++i)
+    {
+        if (Size[i] == 0)
+            return true;
+
+        if (Size[i] > availablePixels / numPixels)
+            return false;
+
+        numPixels *= Size[i];
+    }
+
+    return true;
+}
+
+bool IsMCMBinaryFileName(const std::string &fileName)
+{
+    std::size_t dotPos = fileName.find_last_of('.');
+    if (dotPos == std::string::npos)
+        return false;
+
+    return (fileName.substr(dotPos) == ".mcmb");
+}
+
+std::string GetCompartmentTypeName(anima::DiffusionModelCompartmentType compartmentType)
+{
+    switch(compartmentType)
+    {
+        case Stick:
+            return "Stick";
+
+        case Zeppelin:
+            return "Zeppelin";
+
+        case Tensor:
+            return "Tensor";
+
+        case NODDI:
+            return "NODDI";
+
+        case DDI:
+            return "DDI";
+
+        case FreeWater:
+            return "FreeWater";
+
+        case StationaryWater:
+            return "StationaryWater";
+
+        case Stanisz:
+            return "Stanisz";
+
+        case IsotropicRestrictedWater:
+        default:
+            return "IRWater";
+    }
+}
+
+void WriteMCMBinaryHeader(std::ostream &stream, MCMBinaryFileHeader &header)
+{
+    unsigned int dimension = header.ImageDimension;
+    if ((header.Size.size() != dimension) || (header.Spacing.size() != dimension) ||
+            (header.Origin.size() != dimension) || (header.Direction.size() != dimension * dimension))
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Inconsistent geometry in binary MCM header",ITK_LOCATION);
+
+    // Header is built in memory first to know where the payload starts
+    std::ostringstream headerStream(std::ios::binary);
+    headerStream.write(MCMBinaryMagic,sizeof(MCMBinaryMagic));
+    WriteValue <itk::uint32_t> (headerStream,MCMBinaryVersion);
+    WriteValue <itk::uint32_t> (headerStream,MCMBinaryByteOrderMark);
+    WriteValue <itk::uint32_t> (headerStream,header.Component);
+    WriteValue <itk::uint32_t> (headerStream,dimension);
+    WriteValue <itk::uint32_t> (headerStream,header.VectorLength);
+    WriteValue <itk::uint32_t> (headerStream,header.CompartmentTypes.size());
+
+    for (unsigned int i = 0;i < dimension;++i)
+        WriteValue <itk::uint64_t> (headerStream,header.Size[i]);
+    for (unsigned int i = 0;i < dimension;++i)
+        WriteValue <double> (headerStream,header.Spacing[i]);
+    for (unsigned int i = 0;i < dimension;++i)
+        WriteValue <double> (headerStream,header.Origin[i]);
+    for (unsigned int i = 0;i < dimension * dimension;++i)
+        WriteValue <double> (headerStream,header.Direction[i]);
+
+    for (unsigned int i = 0;i < header.CompartmentTypes.size();++i)
+    {
+        WriteValue <itk::uint32_t> (headerStream,header.CompartmentTypes[i].size());
+        headerStream.write(header.CompartmentTypes[i].c_str(),header.CompartmentTypes[i].size());
+    }
+
+    itk::uint64_t headerSize = headerStream.str().size() + sizeof(itk::uint64_t);
+    header.PayloadOffset = MCMBinaryPayloadAlignment * ((headerSize + MCMBinaryPayloadAlignment - 1) / MCMBinaryPayloadAlignment);
+    WriteValue <itk::uint64_t> (headerStream,header.PayloadOffset);
+
+    std::string headerString = headerStream.str();
+    headerString.resize(header.PayloadOffset,'\0');
+    stream.write(headerString.c_str(),headerString.size());
+}
+
+void ReadMCMBinaryHeader(std::istream &stream, MCMBinaryFileHeader &header)
+{
+    char magic[sizeof(MCMBinaryMagic)];
+    stream.read(magic,sizeof(MCMBinaryMagic));
+    if (!stream || (std::memcmp(magic,MCMBinaryMagic,sizeof(MCMBinaryMagic)) != 0))
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Not a binary MCM file",ITK_LOCATION);
+
+    if (ReadValue <itk::uint32_t> (stream) != MCMBinaryVersion)
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Unsupported binary MCM file version",ITK_LOCATION);
+
+    if (ReadValue <itk::uint32_t> (stream) != MCMBinaryByteOrderMark)
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Binary MCM file was written with a different byte order",ITK_LOCATION);
+
+    itk::uint32_t componentType = ReadValue <itk::uint32_t> (stream);
+    if ((componentType != MCMBinaryFileHeader::FloatComponent) && (componentType != MCMBinaryFileHeader::DoubleComponent))
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Unsupported component type in binary MCM file",ITK_LOCATION);
+
+    header.Component = static_cast <MCMBinaryFileHeader::ComponentType> (componentType);
+    header.ImageDimension = ReadValue <itk::uint32_t> (stream);
+    header.VectorLength = ReadValue <itk::uint32_t> (stream);
+    unsigned int numCompartments = ReadValue <itk::uint32_t> (stream);
+
+    if ((header.ImageDimension == 0) || (header.ImageDimension > MCMBinaryMaximalDimension))
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Not a valid binary MCM header: unsupported image dimension",ITK_LOCATION);
+
+    if ((numCompartments == 0) || (numCompartments > MCMBinaryMaximalNumberOfCompartments))
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Not a valid binary MCM header: invalid number of compartments",ITK_LOCATION);
+
+    unsigned int dimension = header.ImageDimension;
+    header.Size.resize(dimension);
+    header.Spacing.resize(dimension);
+    header.Origin.resize(dimension);
+    header.Direction.resize(dimension * dimension);
+
+    for (unsigned int i = 0;i < dimension;++i)
+        header.Size[i] = ReadValue <itk::uint64_t> (stream);
+    for (unsigned int i = 0;i < dimension;++i)
+        header.Spacing[i] = ReadValue <double> (stream);
+    for (unsigned int i = 0;i < dimension;++i)
+        header.Origin[i] = ReadValue <double> (stream);
+    for (unsigned int i = 0;i < dimension * dimension;++i)
+        header.Direction[i] = ReadValue <double> (stream);
+
+    header.CompartmentTypes.resize(numCompartments);
+    for (unsigned int i = 0;i < numCompartments;++i)
+    {
+        unsigned int nameLength = ReadValue <itk::uint32_t> (stream);
+        if ((nameLength == 0) || (nameLength > MCMBinaryMaximalNameLength))
+            throw itk::ExceptionObject(__FILE__, __LINE__,"Not a valid binary MCM header: invalid compartment name",ITK_LOCATION);
+
+        header.CompartmentTypes[i].resize(nameLength);
+        stream.read(&header.CompartmentTypes[i][0],nameLength);
+        if (!stream)
+            throw itk::ExceptionObject(__FILE__, __LINE__,"Truncated binary MCM header",ITK_LOCATION);
+    }
+
+    header.PayloadOffset = ReadValue <itk::uint64_t> (stream);
+}
+
+} // end namespace anima
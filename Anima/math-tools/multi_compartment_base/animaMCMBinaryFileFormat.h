@@ -0,0 +1,62 @@
+#pragma once
+
+#include <animaBaseCompartment.h>
+#include <animaMemoryMappedFile.h>
+#include <itkIntTypes.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <AnimaMCMBaseExport.h>
+
+namespace anima
+{
+
+/**
+ * @brief Header of the single file binary MCM format (.mcmb). The file is made of:
+ * - a binary header: magic string, version, byte order mark, component type, image geometry and the list of
+ * compartment types (same names as in the XML format)
+ * - a voxel-interleaved payload starting at PayloadOffset (aligned for direct use as an image buffer). It holds, for
+ * each voxel in x-fastest order, the full model vector (weights then compartment parameters) as in MCMImage
+ */
+struct ANIMAMCMBASE_EXPORT MCMBinaryFileHeader
+{
+    //! Component types supported in the payload
+    enum ComponentType
+    {
+        FloatComponent = 1,
+        DoubleComponent = 2
+    };
+
+    unsigned int ImageDimension;
+    ComponentType Component;
+    unsigned int VectorLength;
+    std::vector <itk::SizeValueType> Size;
+    std::vector <double> Spacing;
+    std::vector <double> Origin;
+    //! Direction matrix, stored row by row
+    std::vector <double> Direction;
+    std::vector <std::string> CompartmentTypes;
+    itk::uint64_t PayloadOffset;
+
+    unsigned int GetComponentSize() const {return (Component == FloatComponent) ? sizeof(float) : sizeof(double);}
+    itk::SizeValueType GetNumberOfPixels() const;
+
+    //! Checks that the payload is aligned and fits in a file of the given size, without overflowing on corrupt sizes
+    bool IsPayloadInFile(itk::uint64_t fileSize) const;
+};
+
+//! Checks from its extension if a file name refers to the binary MCM format
+ANIMAMCMBASE_EXPORT bool IsMCMBinaryFileName(const std::string &fileName);
+
+//! Compartment type name as used in MCM headers (XML or binary)
+ANIMAMCMBASE_EXPORT std::string GetCompartmentTypeName(anima::DiffusionModelCompartmentType compartmentType);
+
+//! Writes header to stream, PayloadOffset is computed and stream is padded up to it
+ANIMAMCMBASE_EXPORT void WriteMCMBinaryHeader(std::ostream &stream, MCMBinaryFileHeader &header);
+
+//! Reads header from stream, throws an itk::ExceptionObject if it is not a valid binary MCM header
+ANIMAMCMBASE_EXPORT void ReadMCMBinaryHeader(std::istream &stream, MCMBinaryFileHeader &header);
+
+} // end namespace anima
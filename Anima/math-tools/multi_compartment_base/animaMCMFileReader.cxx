@@ -1,12 +1,35 @@
 #include <animaMCMFileReader.h>
 #include <tinyxml2.h>
 #include <itkObjectFactoryBase.h>
+#include <animaMCMBinaryFileFormat.h>
+
+#include <fstream>
 
 namespace anima
 {
 
 itk::ImageIOBase::IOComponentType ANIMAMCM_EXPORT GetMCMComponentType(std::string fileName)
 {
+    if (anima::IsMCMBinaryFileName(fileName))
+    {
+        std::ifstream inputFile(fileName.c_str(),std::ios::binary);
+        anima::MCMBinaryFileHeader header;
+
+        try
+        {
+            anima::ReadMCMBinaryHeader(inputFile,header);
+        }
+        catch(itk::ExceptionObject &e)
+        {
+            return itk::ImageIOBase::UNKNOWNCOMPONENTTYPE;
+        }
+
+        if (header.Component == anima::MCMBinaryFileHeader::FloatComponent)
+            return itk::ImageIOBase::FLOAT;
+
+        return itk::ImageIOBase::DOUBLE;
+    }
+
     tinyxml2::XMLDocument doc;
     tinyxml2::XMLError loadOk = doc.LoadFile(fileName.c_str());
 
@@ -32,12 +32,20 @@ public:
     OutputImagePointer &GetModelVectorImage() {return m_OutputImage;}
     void SetFileName(std::string fileName) {m_FileName = fileName;}
 
+    //! For binary MCM files (.mcmb), use the memory mapped file directly as image buffer when possible (default: true)
+    void SetUseMemoryMapping(bool val) {m_UseMemoryMapping = val;}
+
     void Update();
     virtual anima::BaseCompartment::Pointer CreateCompartmentForType(std::string &compartmentType);
 
+protected:
+    //! Reads single file binary MCM format, zero-copy if pixel type matches the file component type
+    void ReadBinaryFile();
+
 private:
     OutputImagePointer m_OutputImage;
     std::string m_FileName;
+    bool m_UseMemoryMapping;
 };
 
 } // end namespace anima
@@ -2,6 +2,8 @@
 #include "animaMCMFileReader.h"
 
 #include <animaReadWriteFunctions.h>
+#include <animaMCMBinaryFileFormat.h>
+#include <animaMemoryMappedImageContainer.h>
 
 #include <animaFreeWaterCompartment.h>
 #include <animaIsotropicRestrictedWaterCompartment.h>
@@ -15,6 +17,9 @@
 #include <itkImageRegionIterator.h>
 #include <tinyxml2.h>
 
+#include <fstream>
+#include <type_traits>
+
 namespace anima
 {
 
@@ -23,6 +28,7 @@ MCMFileReader <PixelType, ImageDimension>
 ::MCMFileReader()
 {
     m_FileName = "";
+    m_UseMemoryMapping = true;
 }
 
 template <class PixelType, unsigned int ImageDimension>
@@ -36,6 +42,12 @@ void
 MCMFileReader <PixelType, ImageDimension>
 ::Update()
 {
+    if (anima::IsMCMBinaryFileName(m_FileName))
+    {
+        this->ReadBinaryFile();
+        return;
+    }
+
     tinyxml2::XMLDocument doc;
     tinyxml2::XMLError loadOk = doc.LoadFile(m_FileName.c_str());
 
@@ -158,6 +170,109 @@ MCMFileReader <PixelType, ImageDimension>
     }
 }
 
+template <class PixelType, unsigned int ImageDimension>
+void
+MCMFileReader <PixelType, ImageDimension>
+::ReadBinaryFile()
+{
+    std::ifstream inputFile(m_FileName.c_str(),std::ios::binary);
+    if (!inputFile.is_open())
+    {
+        std::string error("Unable to read input binary MCM file: ");
+        error += m_FileName;
+        throw itk::ExceptionObject(__FILE__, __LINE__,error,ITK_LOCATION);
+    }
+
+    anima::MCMBinaryFileHeader header;
+    anima::ReadMCMBinaryHeader(inputFile,header);
+    inputFile.close();
+
+    if (header.ImageDimension != ImageDimension)
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Binary MCM file dimension does not match reader dimension",ITK_LOCATION);
+
+    unsigned int numCompartments = header.CompartmentTypes.size();
+    ModelPointer referenceModel = ModelType::New();
+    for (unsigned int i = 0;i < numCompartments;++i)
+    {
+        anima::BaseCompartment::Pointer additionalCompartment = this->CreateCompartmentForType(header.CompartmentTypes[i]);
+        referenceModel->AddCompartment(1.0 / numCompartments,additionalCompartment);
+    }
+
+    if (referenceModel->GetSize() != header.VectorLength)
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Binary MCM file vector length does not match its compartments",ITK_LOCATION);
+
+    typename OutputImageType::RegionType largestRegion;
+    typename OutputImageType::SpacingType spacing;
+    typename OutputImageType::PointType origin;
+    typename OutputImageType::DirectionType direction;
+
+    for (unsigned int i = 0;i < ImageDimension;++i)
+    {
+        largestRegion.SetIndex(i,0);
+        largestRegion.SetSize(i,header.Size[i]);
+        spacing[i] = header.Spacing[i];
+        origin[i] = header.Origin[i];
+
+        for (unsigned int j = 0;j < ImageDimension;++j)
+            direction(i,j) = header.Direction[i * ImageDimension + j];
+    }
+
+    m_OutputImage = OutputImageType::New();
+    m_OutputImage->Initialize();
+    m_OutputImage->SetRegions(largestRegion);
+    m_OutputImage->SetSpacing(spacing);
+    m_OutputImage->SetOrigin(origin);
+    m_OutputImage->SetDirection(direction);
+    m_OutputImage->SetNumberOfComponentsPerPixel(header.VectorLength);
+
+    itk::SizeValueType numValues = header.GetNumberOfPixels() * header.VectorLength;
+
+    anima::MemoryMappedFile::Pointer mappedFile = anima::MemoryMappedFile::New();
+    mappedFile->Open(m_FileName);
+
+    if (!header.IsPayloadInFile(mappedFile->GetSize()))
+    {
+        std::string error("Truncated or corrupt binary MCM file: ");
+        error += m_FileName;
+        throw itk::ExceptionObject(__FILE__, __LINE__,error,ITK_LOCATION);
+    }
+
+    bool floatPixel = std::is_same <PixelType, float>::value;
+    bool doublePixel = std::is_same <PixelType, double>::value;
+    bool matchingComponent = (floatPixel && (header.Component == anima::MCMBinaryFileHeader::FloatComponent)) ||
+            (doublePixel && (header.Component == anima::MCMBinaryFileHeader::DoubleComponent));
+
+    if (m_UseMemoryMapping && matchingComponent)
+    {
+        typedef anima::MemoryMappedImageContainer <PixelType> MappedContainerType;
+        typename MappedContainerType::Pointer mappedContainer = MappedContainerType::New();
+        mappedContainer->SetMappedFile(mappedFile,header.PayloadOffset,numValues);
+        m_OutputImage->SetPixelContainer(mappedContainer);
+    }
+    else
+    {
+        // Conversion or explicit copy requested, mapping is released once values are copied
+        m_OutputImage->Allocate();
+        PixelType *outputBuffer = m_OutputImage->GetBufferPointer();
+        const char *payload = mappedFile->GetData() + header.PayloadOffset;
+
+        if (header.Component == anima::MCMBinaryFileHeader::FloatComponent)
+        {
+            const float *inputBuffer = reinterpret_cast <const float *> (payload);
+            for (itk::SizeValueType i = 0;i < numValues;++i)
+                outputBuffer[i] = static_cast <PixelType> (inputBuffer[i]);
+        }
+        else
+        {
+            const double *inputBuffer = reinterpret_cast <const double *> (payload);
+            for (itk::SizeValueType i = 0;i < numValues;++i)
+                outputBuffer[i] = static_cast <PixelType> (inputBuffer[i]);
+        }
+    }
+
+    m_OutputImage->SetDescriptionModel(referenceModel);
+}
+
 template <class PixelType, unsigned int ImageDimension>
 anima::BaseCompartment::Pointer
 MCMFileReader <PixelType, ImageDimension>
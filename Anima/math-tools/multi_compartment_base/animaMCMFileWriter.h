@@ -22,13 +22,20 @@ public:
     ~MCMFileWriter();
 
     void SetInputImage(InputImageType *input) {m_InputImage = input;}
+
+    //! Sets output file name, a .mcmb extension selects the single file binary format, XML header and images otherwise
     void SetFileName(std::string fileName);
 
     void Update();
 
+protected:
+    //! Writes header and voxel-interleaved image buffer to a single binary file (through a temporary file renamed onto it)
+    void WriteBinaryFile();
+
 private:
     InputImagePointer m_InputImage;
     std::string m_FileName;
+    bool m_BinaryFormat;
 };
 
 } // end namespace anima
@@ -4,6 +4,11 @@
 #include <itkImageRegionIterator.h>
 #include <itkFileTools.h>
 #include <animaReadWriteFunctions.h>
+#include <animaMCMBinaryFileFormat.h>
+
+#include <cstdio>
+#include <fstream>
+#include <type_traits>
 
 namespace anima
 {
@@ -13,6 +18,7 @@ MCMFileWriter <PixelType, ImageDimension>
 ::MCMFileWriter()
 {
     m_FileName = "";
+    m_BinaryFormat = false;
 }
 
 template <class PixelType, unsigned int ImageDimension>
@@ -26,6 +32,13 @@ void
 MCMFileWriter <PixelType, ImageDimension>
 ::SetFileName(std::string fileName)
 {
+    m_BinaryFormat = anima::IsMCMBinaryFileName(fileName);
+    if (m_BinaryFormat)
+    {
+        m_FileName = fileName;
+        return;
+    }
+
     if (fileName.find('.') != std::string::npos)
         fileName.erase(fileName.find_first_of('.'));
     m_FileName = fileName;
@@ -45,6 +58,12 @@ MCMFileWriter <PixelType, ImageDimension>
     if (!m_InputImage->GetDescriptionModel())
         throw itk::ExceptionObject(__FILE__, __LINE__,"No reference model provided for writing MCM file",ITK_LOCATION);
 
+    if (m_BinaryFormat)
+    {
+        this->WriteBinaryFile();
+        return;
+    }
+
     std::replace(m_FileName.begin(),m_FileName.end(),'\\','/');
     std::string noPathName = m_FileName;
     std::size_t lastSlashPos = m_FileName.find_last_of("/");
@@ -112,45 +131,7 @@ MCMFileWriter <PixelType, ImageDimension>
     for (unsigned int i = 0;i < descriptionModel->GetNumberOfCompartments();++i)
     {
         outputHeaderFile << "<Compartment>" << std::endl;
-        switch(descriptionModel->GetCompartment(i)->GetCompartmentType())
-        {
-            case Stick:
-                outputHeaderFile << "<Type>Stick</Type>" << std::endl;
-                break;
-
-            case Zeppelin:
-                outputHeaderFile << "<Type>Zeppelin</Type>" << std::endl;
-                break;
-
-            case Tensor:
-                outputHeaderFile << "<Type>Tensor</Type>" << std::endl;
-                break;
-                
-            case NODDI:
-                outputHeaderFile << "<Type>NODDI</Type>" << std::endl;
-                break;
-
-            case DDI:
-                outputHeaderFile << "<Type>DDI</Type>" << std::endl;
-                break;
-
-            case FreeWater:
-                outputHeaderFile << "<Type>FreeWater</Type>" << std::endl;
-                break;
-
-            case StationaryWater:
-                outputHeaderFile << "<Type>StationaryWater</Type>" << std::endl;
-                break;
-
-            case Stanisz:
-                outputHeaderFile << "<Type>Stanisz</Type>" << std::endl;
-                break;
-
-            case IsotropicRestrictedWater:
-            default:
-                outputHeaderFile << "<Type>IRWater</Type>" << std::endl;
-                break;
-        }
+        outputHeaderFile << "<Type>" << anima::GetCompartmentTypeName(descriptionModel->GetCompartment(i)->GetCompartmentType()) << "</Type>" << std::endl;
 
         // Output compartment image
         unsigned int compartmentSize = descriptionModel->GetCompartment(i)->GetCompartmentSize();
@@ -206,4 +187,83 @@ MCMFileWriter <PixelType, ImageDimension>
     outputHeaderFile.close();
 }
 
+template <class PixelType, unsigned int ImageDimension>
+void
+MCMFileWriter <PixelType, ImageDimension>
+::WriteBinaryFile()
+{
+    if (m_InputImage->GetBufferedRegion() != m_InputImage->GetLargestPossibleRegion())
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Binary MCM writing requires a fully buffered input image",ITK_LOCATION);
+
+    anima::MCMBinaryFileHeader header;
+    if (std::is_same <PixelType, float>::value)
+        header.Component = anima::MCMBinaryFileHeader::FloatComponent;
+    else if (std::is_same <PixelType, double>::value)
+        header.Component = anima::MCMBinaryFileHeader::DoubleComponent;
+    else
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Binary MCM format only supports float or double pixel types",ITK_LOCATION);
+
+    ModelPointer descriptionModel = m_InputImage->GetDescriptionModel();
+    header.ImageDimension = ImageDimension;
+    header.VectorLength = m_InputImage->GetNumberOfComponentsPerPixel();
+
+    if (header.VectorLength != descriptionModel->GetSize())
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Input image vector length does not match its description model",ITK_LOCATION);
+
+    for (unsigned int i = 0;i < ImageDimension;++i)
+    {
+        header.Size.push_back(m_InputImage->GetLargestPossibleRegion().GetSize()[i]);
+        header.Spacing.push_back(m_InputImage->GetSpacing()[i]);
+        header.Origin.push_back(m_InputImage->GetOrigin()[i]);
+    }
+
+    for (unsigned int i = 0;i < ImageDimension;++i)
+    {
+        for (unsigned int j = 0;j < ImageDimension;++j)
+            header.Direction.push_back(m_InputImage->GetDirection()(i,j));
+    }
+
+    for (unsigned int i = 0;i < descriptionModel->GetNumberOfCompartments();++i)
+        header.CompartmentTypes.push_back(anima::GetCompartmentTypeName(descriptionModel->GetCompartment(i)->GetCompartmentType()));
+
+    // Written next to the target then renamed onto it: the input may be a mapping of the target file itself,
+    // truncating it in place would invalidate that buffer while it is written
+    std::string temporaryFileName = m_FileName + ".tmp";
+    std::ofstream outputFile(temporaryFileName.c_str(),std::ios::binary);
+    if (!outputFile.is_open())
+    {
+        std::string error("Unable to write binary MCM file: ");
+        error += temporaryFileName;
+        throw itk::ExceptionObject(__FILE__, __LINE__,error,ITK_LOCATION);
+    }
+
+    anima::WriteMCMBinaryHeader(outputFile,header);
+
+    // Vector image buffer is already voxel-interleaved, written as is
+    std::size_t payloadSize = header.GetNumberOfPixels() * header.VectorLength * sizeof(PixelType);
+    outputFile.write(reinterpret_cast <const char *> (m_InputImage->GetBufferPointer()),payloadSize);
+    outputFile.close();
+
+    if (!outputFile)
+    {
+        std::remove(temporaryFileName.c_str());
+        std::string error("Error while writing binary MCM file: ");
+        error += m_FileName;
+        throw itk::ExceptionObject(__FILE__, __LINE__,error,ITK_LOCATION);
+    }
+
+#ifdef _WIN32
+    // Rename does not replace existing files on Windows (and fails anyway if the target is still mapped)
+    std::remove(m_FileName.c_str());
+#endif
+
+    if (std::rename(temporaryFileName.c_str(),m_FileName.c_str()) != 0)
+    {
+        std::remove(temporaryFileName.c_str());
+        std::string error("Unable to replace binary MCM file: ");
+        error += m_FileName;
+        throw itk::ExceptionObject(__FILE__, __LINE__,error,ITK_LOCATION);
+    }
+}
+
 } // end namespace anima
@@ -0,0 +1,49 @@
+#include <animaMCMGradientTable.h>
+#include <animaMCMConstants.h>
+
+#include <algorithm>
+
+namespace anima
+{
+
+MCMGradientTable::MCMGradientTable()
+{
+    m_SmallDelta = anima::DiffusionSmallDelta;
+    m_BigDelta = anima::DiffusionBigDelta;
+}
+
+void MCMGradientTable::Initialize(double smallDelta, double bigDelta, const ListType &gradientStrengths,
+                                  const std::vector <Vector3DType> &gradients)
+{
+    m_SmallDelta = smallDelta;
+    m_BigDelta = bigDelta;
+    m_GradientStrengths = gradientStrengths;
+    m_Gradients = gradients;
+
+    unsigned int nbValues = std::min(gradientStrengths.size(),gradients.size());
+
+    m_BValues.resize(nbValues);
+    for (unsigned int i = 0;i < 3;++i)
+        m_GradientComponents[i].resize(nbValues);
+
+    for (unsigned int i = 0;i < 6;++i)
+        m_BValueOuterProducts[i].resize(nbValues);
+
+    for (unsigned int i = 0;i < nbValues;++i)
+    {
+        double bValue = anima::GetBValueFromAcquisitionParameters(smallDelta, bigDelta, gradientStrengths[i]);
+        m_BValues[i] = bValue;
+
+        for (unsigned int j = 0;j < 3;++j)
+            m_GradientComponents[j][i] = gradients[i][j];
+
+        m_BValueOuterProducts[0][i] = bValue * gradients[i][0] * gradients[i][0];
+        m_BValueOuterProducts[1][i] = bValue * gradients[i][1] * gradients[i][1];
+        m_BValueOuterProducts[2][i] = bValue * gradients[i][2] * gradients[i][2];
+        m_BValueOuterProducts[3][i] = 2.0 * bValue * gradients[i][0] * gradients[i][1];
+        m_BValueOuterProducts[4][i] = 2.0 * bValue * gradients[i][0] * gradients[i][2];
+        m_BValueOuterProducts[5][i] = 2.0 * bValue * gradients[i][1] * gradients[i][2];
+    }
+}
+
+} // end namespace anima
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+#include <vnl/vnl_vector_fixed.h>
+
+#include <AnimaMCMBaseExport.h>
+
+namespace anima
+{
+
+/**
+ * @brief Pre-computed acquisition table used by batched compartment signal evaluations.
+ * Gradient directions, b-values and b-value weighted gradient outer products are stored as
+ * contiguous arrays (one array per component), so that compartments may compute their
+ * signal attenuations on the whole table with simple vectorizable loops.
+ * Outer products are stored in the order xx, yy, zz, xy, xz, yz, off-diagonal terms being
+ * multiplied by two so that quadratic forms become plain dot products.
+ */
+class ANIMAMCMBASE_EXPORT MCMGradientTable
+{
+public:
+    typedef vnl_vector_fixed <double,3> Vector3DType;
+    typedef std::vector <double> ListType;
+
+    MCMGradientTable();
+    virtual ~MCMGradientTable() {}
+
+    //! Compute all tables from acquisition parameters (gradient strengths in T/mm, deltas in s)
+    void Initialize(double smallDelta, double bigDelta, const ListType &gradientStrengths,
+                    const std::vector <Vector3DType> &gradients);
+
+    unsigned int GetNumberOfGradients() const {return m_BValues.size();}
+
+    double GetSmallDelta() const {return m_SmallDelta;}
+    double GetBigDelta() const {return m_BigDelta;}
+    const ListType &GetGradientStrengths() const {return m_GradientStrengths;}
+    const std::vector <Vector3DType> &GetGradients() const {return m_Gradients;}
+
+    //! Contiguous array of b-values
+    const double *GetBValues() const {return m_BValues.data();}
+
+    //! Contiguous array of the i-th gradient direction component
+    const double *GetGradientComponents(unsigned int i) const {return m_GradientComponents[i].data();}
+
+    //! Contiguous array of the i-th b-value weighted outer product component (xx, yy, zz, xy, xz, yz)
+    const double *GetBValueOuterProducts(unsigned int i) const {return m_BValueOuterProducts[i].data();}
+
+private:
+    double m_SmallDelta, m_BigDelta;
+    ListType m_GradientStrengths;
+    std::vector <Vector3DType> m_Gradients;
+
+    ListType m_BValues;
+    ListType m_GradientComponents[3];
+    ListType m_BValueOuterProducts[6];
+};
+
+} // end namespace anima
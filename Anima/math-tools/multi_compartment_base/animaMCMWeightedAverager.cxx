@@ -2,6 +2,8 @@
 #include <animaSpectralClusteringFilter.h>
 #include <animaBaseTensorTools.h>
 
+#include <algorithm>
+
 namespace anima
 {
 
@@ -9,6 +11,7 @@ MCMWeightedAverager::MCMWeightedAverager()
 {
     m_UpToDate = false;
     m_NumberOfOutputDirectionalCompartments = 3;
+    m_CompartmentGrouping = SpectralClustering;
 }
 
 void MCMWeightedAverager::SetOutputModel(MCMType *model)
@@ -106,6 +109,8 @@ void MCMWeightedAverager::Update()
 
     m_WorkCompartmentsVector.clear();
     m_WorkCompartmentWeights.clear();
+    m_WorkCompartmentInputIndexes.clear();
+    m_InternalSpectralMemberships.clear();
 
     for (unsigned int i = 0;i < numInputs;++i)
     {
@@ -120,6 +125,7 @@ void MCMWeightedAverager::Update()
 
             m_WorkCompartmentsVector.push_back(m_InputModels[i]->GetCompartment(j));
             m_WorkCompartmentWeights.push_back(m_InputWeights[i] * tmpWeight);
+            m_WorkCompartmentInputIndexes.push_back(i);
         }
     }
 
@@ -134,6 +140,7 @@ void MCMWeightedAverager::Update()
         }
 
         m_OutputModel->SetCompartmentWeights(m_InternalOutputWeights);
+        m_InputMemberships.clear();
 
         m_UpToDate = true;
         return;
@@ -145,21 +152,42 @@ void MCMWeightedAverager::Update()
     else
         this->ComputeNonTensorDistanceMatrix();
 
-    typedef anima::SpectralClusteringFilter<double> SpectralClusterType;
-    SpectralClusterType spectralCluster;
-    spectralCluster.SetNbClass(numOutputCompartments);
-    spectralCluster.SetMaxIterations(200);
-    spectralCluster.SetInputData(m_InternalDistanceMatrix);
-    spectralCluster.SetDataWeights(m_WorkCompartmentWeights);
-    spectralCluster.SetVerbose(false);
-    spectralCluster.InitializeSigmaFromDistances();
-    spectralCluster.SetCMeansAverageType(SpectralClusterType::CMeansFilterType::Euclidean);
+    // Memberships given from outside (e.g. computed for the same compartments) or obvious ones avoid clustering
+    bool membershipsOk = (m_InputMemberships.size() == numInputCompartments);
+    for (unsigned int i = 0;(i < m_InputMemberships.size())&&membershipsOk;++i)
+        membershipsOk = (m_InputMemberships[i].size() == numOutputCompartments);
+
+    if (membershipsOk)
+        m_InternalSpectralMemberships = m_InputMemberships;
+    else
+        membershipsOk = this->ComputeTrivialMemberships(numOutputCompartments);
+
+    m_InputMemberships.clear();
 
-    spectralCluster.Update();
+    if ((!membershipsOk)&&(m_CompartmentGrouping == GreedyHungarianPairing))
+    {
+        this->ComputePairingMemberships(numOutputCompartments);
+        membershipsOk = true;
+    }
 
-    m_InternalSpectralMemberships.resize(numInputCompartments);
-    for (unsigned int i = 0;i < numInputCompartments;++i)
-        m_InternalSpectralMemberships[i] = spectralCluster.GetClassesMembership(i);
+    if (!membershipsOk)
+    {
+        typedef anima::SpectralClusteringFilter<double> SpectralClusterType;
+        SpectralClusterType spectralCluster;
+        spectralCluster.SetNbClass(numOutputCompartments);
+        spectralCluster.SetMaxIterations(200);
+        spectralCluster.SetInputData(m_InternalDistanceMatrix);
+        spectralCluster.SetDataWeights(m_WorkCompartmentWeights);
+        spectralCluster.SetVerbose(false);
+        spectralCluster.InitializeSigmaFromDistances();
+        spectralCluster.SetCMeansAverageType(SpectralClusterType::CMeansFilterType::Euclidean);
+
+        spectralCluster.Update();
+
+        m_InternalSpectralMemberships.resize(numInputCompartments);
+        for (unsigned int i = 0;i < numInputCompartments;++i)
+            m_InternalSpectralMemberships[i] = spectralCluster.GetClassesMembership(i);
+    }
 
     if (tensorCompatibility)
         this->ComputeOutputTensorModel();
@@ -171,6 +199,273 @@ void MCMWeightedAverager::Update()
     m_UpToDate = true;
 }
 
+bool MCMWeightedAverager::ComputeTrivialMemberships(unsigned int numOutputCompartments)
+{
+    unsigned int numCompartments = m_WorkCompartmentsVector.size();
+    m_InternalSpectralMemberships.resize(numCompartments);
+
+    if (numOutputCompartments == 1)
+    {
+        for (unsigned int i = 0;i < numCompartments;++i)
+            m_InternalSpectralMemberships[i].assign(1,1.0);
+
+        return true;
+    }
+
+    this->ComputeWorkInputStartIndexes();
+    unsigned int numContributingInputs = m_WorkInputStartIndexes.size() - 1;
+
+    unsigned int referenceStart = 0;
+    double referenceWeight = 0;
+    for (unsigned int i = 0;i < numContributingInputs;++i)
+    {
+        unsigned int inputStart = m_WorkInputStartIndexes[i];
+        if (m_WorkInputStartIndexes[i + 1] - inputStart != numOutputCompartments)
+            return false;
+
+        double inputWeight = m_InputWeights[m_WorkCompartmentInputIndexes[inputStart]];
+        if (inputWeight > referenceWeight)
+        {
+            referenceWeight = inputWeight;
+            referenceStart = inputStart;
+        }
+    }
+
+    for (unsigned int i = 0;i < numContributingInputs;++i)
+    {
+        unsigned int inputStart = m_WorkInputStartIndexes[i];
+        for (unsigned int j = 0;j < numOutputCompartments;++j)
+        {
+            unsigned int closestIndex = 0;
+            for (unsigned int k = 1;k < numOutputCompartments;++k)
+            {
+                if (m_InternalDistanceMatrix(inputStart + j,referenceStart + k) < m_InternalDistanceMatrix(inputStart + j,referenceStart + closestIndex))
+                    closestIndex = k;
+            }
+
+            if (closestIndex != j)
+                return false;
+
+            m_InternalSpectralMemberships[inputStart + j].assign(numOutputCompartments,0.0);
+            m_InternalSpectralMemberships[inputStart + j][j] = 1.0;
+        }
+    }
+
+    return true;
+}
+
+void MCMWeightedAverager::ComputeWorkInputStartIndexes()
+{
+    // Work compartments are stored input by input
+    unsigned int numCompartments = m_WorkCompartmentsVector.size();
+    m_WorkInputStartIndexes.clear();
+    for (unsigned int i = 0;i < numCompartments;++i)
+    {
+        if ((i == 0)||(m_WorkCompartmentInputIndexes[i] != m_WorkCompartmentInputIndexes[i - 1]))
+            m_WorkInputStartIndexes.push_back(i);
+    }
+
+    m_WorkInputStartIndexes.push_back(numCompartments);
+}
+
+void MCMWeightedAverager::ComputePairingMemberships(unsigned int numOutputCompartments)
+{
+    unsigned int numCompartments = m_WorkCompartmentsVector.size();
+    this->ComputeWorkInputStartIndexes();
+    unsigned int numContributingInputs = m_WorkInputStartIndexes.size() - 1;
+
+    unsigned int referenceInput = 0;
+    double referenceWeight = 0;
+    for (unsigned int i = 0;i < numContributingInputs;++i)
+    {
+        double inputWeight = 0;
+        for (unsigned int j = m_WorkInputStartIndexes[i];j < m_WorkInputStartIndexes[i + 1];++j)
+            inputWeight += m_WorkCompartmentWeights[j];
+
+        if (inputWeight > referenceWeight)
+        {
+            referenceWeight = inputWeight;
+            referenceInput = i;
+        }
+    }
+
+    unsigned int referenceStart = m_WorkInputStartIndexes[referenceInput];
+    unsigned int referenceEnd = m_WorkInputStartIndexes[referenceInput + 1];
+
+    m_WorkAssignments.assign(numCompartments,-1);
+    m_WorkClusterSeeds.clear();
+
+    // Seeds: heaviest compartments of the reference input, then compartments far from existing seeds
+    while (m_WorkClusterSeeds.size() < numOutputCompartments)
+    {
+        int bestIndex = -1;
+        double bestScore = -1;
+        for (unsigned int i = 0;i < numCompartments;++i)
+        {
+            if (m_WorkAssignments[i] >= 0)
+                continue;
+
+            double score = m_WorkCompartmentWeights[i];
+            bool isReference = (i >= referenceStart)&&(i < referenceEnd);
+            if ((!isReference)&&(m_WorkClusterSeeds.size() != 0))
+            {
+                double minDistance = m_InternalDistanceMatrix(i,m_WorkClusterSeeds[0]);
+                for (unsigned int j = 1;j < m_WorkClusterSeeds.size();++j)
+                    minDistance = std::min(minDistance,m_InternalDistanceMatrix(i,m_WorkClusterSeeds[j]));
+
+                score *= minDistance;
+            }
+
+            // Reference compartments always come first
+            bool bestIsReference = (bestIndex >= (int)referenceStart)&&(bestIndex < (int)referenceEnd);
+            if ((bestIndex < 0)||(isReference && !bestIsReference)||((isReference == bestIsReference)&&(score > bestScore)))
+            {
+                bestIndex = i;
+                bestScore = score;
+            }
+        }
+
+        if (bestIndex < 0)
+            break;
+
+        m_WorkAssignments[bestIndex] = m_WorkClusterSeeds.size();
+        m_WorkClusterSeeds.push_back(bestIndex);
+    }
+
+    unsigned int numClusters = m_WorkClusterSeeds.size();
+    m_WorkUsedClusters.resize(numClusters);
+
+    // Greedy matching of each input to seeds: closest free (compartment, seed) pairs first
+    for (unsigned int i = 0;i < numContributingInputs;++i)
+    {
+        unsigned int inputStart = m_WorkInputStartIndexes[i];
+        unsigned int inputEnd = m_WorkInputStartIndexes[i + 1];
+
+        std::fill(m_WorkUsedClusters.begin(),m_WorkUsedClusters.end(),false);
+        for (unsigned int j = inputStart;j < inputEnd;++j)
+        {
+            if (m_WorkAssignments[j] >= 0)
+                m_WorkUsedClusters[m_WorkAssignments[j]] = true;
+        }
+
+        while (true)
+        {
+            int bestCompartment = -1;
+            unsigned int bestCluster = 0;
+            for (unsigned int j = inputStart;j < inputEnd;++j)
+            {
+                if (m_WorkAssignments[j] >= 0)
+                    continue;
+
+                for (unsigned int k = 0;k < numClusters;++k)
+                {
+                    if (m_WorkUsedClusters[k])
+                        continue;
+
+                    if ((bestCompartment < 0)||(m_InternalDistanceMatrix(j,m_WorkClusterSeeds[k]) < m_InternalDistanceMatrix(bestCompartment,m_WorkClusterSeeds[bestCluster])))
+                    {
+                        bestCompartment = j;
+                        bestCluster = k;
+                    }
+                }
+            }
+
+            if (bestCompartment < 0)
+                break;
+
+            m_WorkAssignments[bestCompartment] = bestCluster;
+            m_WorkUsedClusters[bestCluster] = true;
+        }
+
+        // Inputs with more compartments than output ones: remaining ones go to their closest seed
+        for (unsigned int j = inputStart;j < inputEnd;++j)
+        {
+            if (m_WorkAssignments[j] >= 0)
+                continue;
+
+            unsigned int closestCluster = 0;
+            for (unsigned int k = 1;k < numClusters;++k)
+            {
+                if (m_InternalDistanceMatrix(j,m_WorkClusterSeeds[k]) < m_InternalDistanceMatrix(j,m_WorkClusterSeeds[closestCluster]))
+                    closestCluster = k;
+            }
+
+            m_WorkAssignments[j] = closestCluster;
+        }
+    }
+
+    // Refinement: optimal re-assignment of each input given the groups formed by the other ones
+    const unsigned int maxRefinementIterations = 10;
+    m_WorkClusterDistances.resize(numClusters);
+    m_WorkClusterWeights.resize(numClusters);
+    for (unsigned int iter = 0;iter < maxRefinementIterations;++iter)
+    {
+        bool assignmentsChanged = false;
+        for (unsigned int i = 0;i < numContributingInputs;++i)
+        {
+            unsigned int inputStart = m_WorkInputStartIndexes[i];
+            unsigned int inputSize = m_WorkInputStartIndexes[i + 1] - inputStart;
+            m_WorkPairingCosts.resize(inputSize * numClusters);
+
+            for (unsigned int j = 0;j < inputSize;++j)
+            {
+                std::fill(m_WorkClusterDistances.begin(),m_WorkClusterDistances.end(),0.0);
+                std::fill(m_WorkClusterWeights.begin(),m_WorkClusterWeights.end(),0.0);
+
+                for (unsigned int k = 0;k < numCompartments;++k)
+                {
+                    if ((k >= inputStart)&&(k < inputStart + inputSize))
+                        continue;
+
+                    m_WorkClusterDistances[m_WorkAssignments[k]] += m_WorkCompartmentWeights[k] * m_InternalDistanceMatrix(inputStart + j,k);
+                    m_WorkClusterWeights[m_WorkAssignments[k]] += m_WorkCompartmentWeights[k];
+                }
+
+                for (unsigned int k = 0;k < numClusters;++k)
+                {
+                    double cost = m_InternalDistanceMatrix(inputStart + j,m_WorkClusterSeeds[k]);
+                    if (m_WorkClusterWeights[k] > 0)
+                        cost = m_WorkClusterDistances[k] / m_WorkClusterWeights[k];
+
+                    m_WorkPairingCosts[j * numClusters + k] = cost;
+                }
+            }
+
+            m_HungarianSolver.Solve(&m_WorkPairingCosts[0],inputSize,numClusters);
+
+            for (unsigned int j = 0;j < inputSize;++j)
+            {
+                int cluster = m_HungarianSolver.GetAssignedColumn(j);
+                if (cluster < 0)
+                {
+                    cluster = 0;
+                    for (unsigned int k = 1;k < numClusters;++k)
+                    {
+                        if (m_WorkPairingCosts[j * numClusters + k] < m_WorkPairingCosts[j * numClusters + cluster])
+                            cluster = k;
+                    }
+                }
+
+                if (cluster != m_WorkAssignments[inputStart + j])
+                {
+                    m_WorkAssignments[inputStart + j] = cluster;
+                    assignmentsChanged = true;
+                }
+            }
+        }
+
+        if (!assignmentsChanged)
+            break;
+    }
+
+    m_InternalSpectralMemberships.resize(numCompartments);
+    for (unsigned int i = 0;i < numCompartments;++i)
+    {
+        m_InternalSpectralMemberships[i].assign(numOutputCompartments,0.0);
+        m_InternalSpectralMemberships[i][m_WorkAssignments[i]] = 1.0;
+    }
+}
+
 void MCMWeightedAverager::ComputeTensorDistanceMatrix()
 {
     unsigned int numCompartments = m_WorkCompartmentsVector.size();
@@ -227,6 +522,13 @@ void MCMWeightedAverager::ComputeOutputTensorModel()
             outputVector += m_InternalLogTensors[j] * weight;
         }
 
+        // Groups may end up empty with hard memberships
+        if (totalWeights <= 0)
+        {
+            m_InternalOutputWeights[i+numIsoCompartments] = 0;
+            continue;
+        }
+
         outputVector /= totalWeights;
 
         m_InternalOutputWeights[i+numIsoCompartments] = totalWeights;
@@ -2,6 +2,7 @@
 #include <animaMultiCompartmentModel.h>
 #include <itkLightObject.h>
 #include <itkVariableLengthVector.h>
+#include <animaHungarianAssignment.h>
 
 #include <vnl/vnl_math.h>
 
@@ -32,12 +33,22 @@ public:
     typedef MCMType::BaseCompartmentPointer MCMCompartmentPointer;
     typedef MCMType::Pointer MCMPointer;
 
+    enum CompartmentGroupingType
+    {
+        SpectralClustering = 0,
+        GreedyHungarianPairing
+    };
+
     void SetInputModels(std::vector <MCMPointer> &models) {m_InputModels = models; m_UpToDate = false;}
     void SetInputWeights(std::vector <double> &weights) {m_InputWeights = weights; m_UpToDate = false;}
 
     void SetNumberOfOutputDirectionalCompartments(unsigned int val);
     void ResetNumberOfOutputDirectionalCompartments();
 
+    //! Method used to group input compartments into output ones when there are too many of them (default: spectral clustering)
+    void SetCompartmentGrouping(CompartmentGroupingType val) {m_CompartmentGrouping = val; m_UpToDate = false;}
+    CompartmentGroupingType GetCompartmentGrouping() {return m_CompartmentGrouping;}
+
     void SetOutputModel(MCMType *model);
     MCMPointer &GetOutputModel();
     MCMPointer &GetUntouchedOutputModel();
@@ -46,6 +57,15 @@ public:
 
     void SetUpToDate(bool val) {m_UpToDate = val;}
 
+    /**
+     * Compartment memberships to output compartments to use instead of clustering at next Update (one vector per input
+     * compartment of positive weight, in input models order). Ignored if they do not match the inputs, cleared by Update
+     */
+    void SetInputMemberships(const std::vector < std::vector <double> > &memberships) {m_InputMemberships = memberships; m_UpToDate = false;}
+
+    //! Memberships used at last Update, empty if no grouping of compartments was needed
+    const std::vector < std::vector <double> > &GetCompartmentMemberships() {return m_InternalSpectralMemberships;}
+
     void Update();
 
 protected:
@@ -58,11 +78,30 @@ protected:
     void ComputeOutputTensorModel();
     virtual void ComputeOutputNonTensorModel();
 
+    /**
+     * Fills memberships without clustering when there is a single output compartment, or when all inputs have as many
+     * compartments as the output and the i-th compartment of each input is closest to the i-th one of the heaviest input.
+     * Returns false if none of these cases applies
+     */
+    bool ComputeTrivialMemberships(unsigned int numOutputCompartments);
+
+    /**
+     * Hard memberships by pairing: compartments of the heaviest input (completed by heavy compartments far from them)
+     * seed the output compartments, other inputs are greedily matched to these seeds. Each input is then re-assigned
+     * by Hungarian assignment on the mean distance to the compartments of other inputs in each group, until stable
+     */
+    void ComputePairingMemberships(unsigned int numOutputCompartments);
+
+    //! Fills m_WorkInputStartIndexes: first work compartment of each contributing input, then the number of compartments
+    void ComputeWorkInputStartIndexes();
+
 private:
     std::vector <MCMPointer> m_InputModels;
     std::vector <double> m_InputWeights;
+    std::vector < std::vector <double> > m_InputMemberships;
 
     unsigned int m_NumberOfOutputDirectionalCompartments;
+    CompartmentGroupingType m_CompartmentGrouping;
 
     MCMPointer m_OutputModel;
     bool m_UpToDate;
@@ -74,6 +113,14 @@ protected:
     std::vector <double> m_InternalOutputWeights;
     std::vector <MCMCompartmentPointer> m_WorkCompartmentsVector;
     std::vector <double> m_WorkCompartmentWeights;
+    std::vector <unsigned int> m_WorkCompartmentInputIndexes;
+    std::vector <unsigned int> m_WorkInputStartIndexes;
+    std::vector <unsigned int> m_WorkClusterSeeds;
+    std::vector <int> m_WorkAssignments;
+    std::vector <bool> m_WorkUsedClusters;
+    std::vector <double> m_WorkPairingCosts;
+    std::vector <double> m_WorkClusterDistances, m_WorkClusterWeights;
+    anima::HungarianAssignment <double> m_HungarianSolver;
     vnl_matrix <double> m_InternalDistanceMatrix;
     std::vector < std::vector <double> > m_InternalSpectralMemberships;
 };
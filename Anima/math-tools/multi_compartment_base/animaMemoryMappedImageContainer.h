@@ -0,0 +1,42 @@
+#pragma once
+
+#include <itkImportImageContainer.h>
+#include <animaMemoryMappedFile.h>
+
+namespace anima
+{
+
+/**
+ * @brief Image pixel container pointing directly into a memory mapped file. The container keeps the mapping alive
+ * as long as an image uses it, memory is never allocated nor freed by the container itself.
+ */
+template <class TElement>
+class MemoryMappedImageContainer : public itk::ImportImageContainer <itk::SizeValueType, TElement>
+{
+public:
+    typedef MemoryMappedImageContainer Self;
+    typedef itk::ImportImageContainer <itk::SizeValueType, TElement> Superclass;
+    typedef itk::SmartPointer<Self> Pointer;
+    typedef itk::SmartPointer<const Self> ConstPointer;
+
+    itkNewMacro(Self)
+    itkTypeMacro(MemoryMappedImageContainer, ImportImageContainer)
+
+    //! Uses numberOfElements values stored offset bytes after the start of the mapped file as buffer, without copy
+    void SetMappedFile(anima::MemoryMappedFile *mappedFile, std::size_t offset, itk::SizeValueType numberOfElements)
+    {
+        m_MappedFile = mappedFile;
+        this->SetImportPointer(reinterpret_cast <TElement *> (mappedFile->GetData() + offset),numberOfElements,false);
+    }
+
+protected:
+    MemoryMappedImageContainer() {}
+    virtual ~MemoryMappedImageContainer() {}
+
+private:
+    ITK_DISALLOW_COPY_AND_ASSIGN(MemoryMappedImageContainer);
+
+    anima::MemoryMappedFile::Pointer m_MappedFile;
+};
+
+} // end namespace anima
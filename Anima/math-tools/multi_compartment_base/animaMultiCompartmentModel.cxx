@@ -275,6 +275,63 @@ MultiCompartmentModel::ListType &MultiCompartmentModel::GetSignalJacobian(double
     return m_JacobianVector;
 }
 
+void MultiCompartmentModel::GetPredictedSignals(const MCMGradientTable &gradientTable, ListType &signals)
+{
+    unsigned int nbValues = gradientTable.GetNumberOfGradients();
+    signals.resize(nbValues);
+    std::fill(signals.begin(),signals.end(),0.0);
+
+    for (unsigned int i = 0;i < m_Compartments.size();++i)
+    {
+        if (m_CompartmentWeights[i] == 0.0)
+            continue;
+
+        m_Compartments[i]->GetFourierTransformedDiffusionProfiles(gradientTable,m_WorkAttenuations);
+
+        double weight = m_CompartmentWeights[i];
+        for (unsigned int j = 0;j < nbValues;++j)
+            signals[j] += weight * m_WorkAttenuations[j];
+    }
+}
+
+void MultiCompartmentModel::GetSignalJacobians(const MCMGradientTable &gradientTable, ListType &jacobians)
+{
+    unsigned int nbValues = gradientTable.GetNumberOfGradients();
+    unsigned int jacobianSize = this->GetNumberOfParameters();
+
+    jacobians.resize(jacobianSize * nbValues);
+    std::fill(jacobians.begin(), jacobians.end(), 0.0);
+
+    unsigned int numWeightsToOptimize = this->GetNumberOfOptimizedWeights();
+
+    // Not accounting for optimize weights with common compartment weights, and no free water
+    // In that case, weights are not optimized
+    for (unsigned int i = 0;i < numWeightsToOptimize;++i)
+    {
+        m_Compartments[i]->GetFourierTransformedDiffusionProfiles(gradientTable,m_WorkAttenuations);
+
+        for (unsigned int j = 0;j < nbValues;++j)
+            jacobians[i * nbValues + j] = - m_WorkAttenuations[j];
+    }
+
+    unsigned int pos = numWeightsToOptimize;
+
+    for (unsigned int i = 0;i < m_Compartments.size();++i)
+    {
+        unsigned int compartmentSize = m_Compartments[i]->GetNumberOfParameters();
+        m_Compartments[i]->GetSignalAttenuationJacobians(gradientTable,m_WorkJacobians);
+
+        double weight = m_CompartmentWeights[i];
+        for (unsigned int k = 0;k < compartmentSize;++k)
+        {
+            for (unsigned int j = 0;j < nbValues;++j)
+                jacobians[(pos + k) * nbValues + j] -= weight * m_WorkJacobians[k * nbValues + j];
+        }
+
+        pos += compartmentSize;
+    }
+}
+
 double MultiCompartmentModel::GetDiffusionProfile(Vector3DType &sample)
 {
     double resVal = 0;
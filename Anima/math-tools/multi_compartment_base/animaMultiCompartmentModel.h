@@ -63,6 +63,13 @@ public:
 
     double GetPredictedSignal(double smallDelta, double bigDelta, double gradientStrength, const Vector3DType &gradient);
     ListType &GetSignalJacobian(double smallDelta, double bigDelta, double gradientStrength, const Vector3DType &gradient);
+
+    //! Batched version of GetPredictedSignal, computes predicted signals for a whole gradient table
+    void GetPredictedSignals(const MCMGradientTable &gradientTable, ListType &signals);
+
+    //! Batched version of GetSignalJacobian, stored parameter-wise: jacobians[k * nbGradients + i]
+    void GetSignalJacobians(const MCMGradientTable &gradientTable, ListType &jacobians);
+
     double GetDiffusionProfile(Vector3DType &sample);
 
     ListType &GetParameterLowerBounds();
@@ -122,6 +129,9 @@ private:
     //! Vector holding working value vector
     ListType m_WorkVector;
 
+    //! Vectors holding batched compartment attenuations and jacobians
+    ListType m_WorkAttenuations, m_WorkJacobians;
+
     //! Vector holding current parameters lower bounds
     ListType m_ParametersLowerBoundsVector;
 
@@ -1,5 +1,6 @@
 #include <animaNNLSOptimizer.h>
 #include <vnl_qr.h>
+#include <algorithm>
 
 namespace anima
 {
@@ -8,8 +9,8 @@ const double NNLSOptimizer::m_EpsilonValue = 1.0e-12;
 
 void NNLSOptimizer::StartOptimization()
 {
-    unsigned int parametersSize = m_DataMatrix.cols();
-    unsigned int numEquations = m_DataMatrix.rows();
+    unsigned int parametersSize = m_DataMatrixPointer->cols();
+    unsigned int numEquations = m_DataMatrixPointer->rows();
 
     if ((numEquations != m_Points.size())||(numEquations == 0)||(parametersSize == 0))
         itkExceptionMacro("Wrongly sized inputs to NNLS, aborting");
@@ -21,7 +22,12 @@ void NNLSOptimizer::StartOptimization()
     m_ProcessedIndexes.clear();
     m_WVector.resize(parametersSize);
 
-    unsigned int numProcessedIndexes = 0;
+    if (m_WarmStart && (m_InitialPosition.GetSize() == parametersSize))
+        this->InitializeFromWarmStart();
+
+    unsigned int numProcessedIndexes = m_ProcessedIndexes.size();
+    if (numProcessedIndexes == parametersSize)
+        return;
 
     this->ComputeWVector();
 
@@ -131,24 +137,60 @@ void NNLSOptimizer::StartOptimization()
     }
 }
 
+void NNLSOptimizer::InitializeFromWarmStart()
+{
+    unsigned int parametersSize = m_DataMatrixPointer->cols();
+
+    for (unsigned int i = 0;i < parametersSize;++i)
+        m_TreatedIndexes[i] = (m_InitialPosition[i] > 0.0);
+
+    unsigned int numProcessedIndexes = this->UpdateProcessedIndexes();
+
+    // Main loop requires a positive least squares solution on the passive set, drop non positive entries until reached
+    bool feasibleSolution = false;
+    while ((numProcessedIndexes > 0)&&(!feasibleSolution))
+    {
+        this->ComputeSPVector();
+
+        feasibleSolution = true;
+        for (unsigned int i = 0;i < numProcessedIndexes;++i)
+        {
+            if (m_SPVector[i] <= m_EpsilonValue)
+            {
+                m_TreatedIndexes[m_ProcessedIndexes[i]] = 0;
+                feasibleSolution = false;
+            }
+        }
+
+        if (!feasibleSolution)
+            numProcessedIndexes = this->UpdateProcessedIndexes();
+    }
+
+    for (unsigned int i = 0;i < numProcessedIndexes;++i)
+        m_CurrentPosition[m_ProcessedIndexes[i]] = m_SPVector[i];
+}
+
 void NNLSOptimizer::ComputeWVector()
 {
-    unsigned int parametersSize = m_DataMatrix.cols();
-    unsigned int numEquations = m_DataMatrix.rows();
+    const MatrixType &dataMatrix = *m_DataMatrixPointer;
+    unsigned int parametersSize = dataMatrix.cols();
+    unsigned int numEquations = dataMatrix.rows();
+    unsigned int numProcessedIndexes = m_ProcessedIndexes.size();
 
     m_WVector.resize(parametersSize);
 
+    // Current position is null outside of the passive set, only its columns are used
     std::fill(m_WVector.begin(),m_WVector.end(),0.0);
     if (!m_SquaredProblem)
     {
         for (unsigned int i = 0;i < numEquations;++i)
         {
             double tmpValue = m_Points[i];
-            for (unsigned int j = 0;j < parametersSize;++j)
-                tmpValue -= m_DataMatrix(i,j) * m_CurrentPosition[j];
+            for (unsigned int j = 0;j < numProcessedIndexes;++j)
+                tmpValue -= dataMatrix(i,m_ProcessedIndexes[j]) * m_CurrentPosition[m_ProcessedIndexes[j]];
 
             for (unsigned int j = 0;j < parametersSize;++j)
-                m_WVector[j] += m_DataMatrix(i,j) * tmpValue;
+                m_WVector[j] += dataMatrix(i,j) * tmpValue;
         }
     }
     else
@@ -156,8 +198,8 @@ void NNLSOptimizer::ComputeWVector()
         for (unsigned int i = 0;i < numEquations;++i)
         {
             m_WVector[i] = m_Points[i];
-            for (unsigned int j = 0;j < parametersSize;++j)
-                m_WVector[i] -= m_DataMatrix(i,j) * m_CurrentPosition[j];
+            for (unsigned int j = 0;j < numProcessedIndexes;++j)
+                m_WVector[i] -= dataMatrix(i,m_ProcessedIndexes[j]) * m_CurrentPosition[m_ProcessedIndexes[j]];
         }
     }
 }
@@ -165,7 +207,7 @@ void NNLSOptimizer::ComputeWVector()
 unsigned int NNLSOptimizer::UpdateProcessedIndexes()
 {
     unsigned int numProcessedIndexes = 0;
-    unsigned int parametersSize = m_DataMatrix.cols();
+    unsigned int parametersSize = m_DataMatrixPointer->cols();
 
     for (unsigned int i = 0;i < parametersSize;++i)
         numProcessedIndexes += m_TreatedIndexes[i];
@@ -186,7 +228,8 @@ unsigned int NNLSOptimizer::UpdateProcessedIndexes()
 
 void NNLSOptimizer::ComputeSPVector()
 {
-    unsigned int numEquations = m_DataMatrix.rows();
+    const MatrixType &dataMatrix = *m_DataMatrixPointer;
+    unsigned int numEquations = dataMatrix.rows();
     unsigned int numProcessedIndexes = m_ProcessedIndexes.size();
 
     if (!m_SquaredProblem)
@@ -199,7 +242,7 @@ void NNLSOptimizer::ComputeSPVector()
         for (unsigned int i = 0;i < numEquations;++i)
         {
             for (unsigned int j = 0;j < numProcessedIndexes;++j)
-                m_DataMatrixP(i,j) = m_DataMatrix(i,m_ProcessedIndexes[j]);
+                m_DataMatrixP(i,j) = dataMatrix(i,m_ProcessedIndexes[j]);
         }
 
         m_SPVector = vnl_qr <double> (m_DataMatrixP).solve(m_Points);
@@ -218,7 +261,7 @@ void NNLSOptimizer::ComputeSPVector()
             for (unsigned int j = i;j < numProcessedIndexes;++j)
             {
                 unsigned int jIndex = m_ProcessedIndexes[j];
-                m_DataMatrixP(i,j) = m_DataMatrix(iIndex,jIndex);
+                m_DataMatrixP(i,j) = dataMatrix(iIndex,jIndex);
 
                 if (i != j)
                     m_DataMatrixP(j,i) = m_DataMatrixP(i,j);
@@ -233,13 +276,36 @@ void NNLSOptimizer::ComputeSPVector()
 
 double NNLSOptimizer::GetCurrentResidual()
 {
+    const MatrixType &dataMatrix = *m_DataMatrixPointer;
     double residualValue = 0;
 
-    for (unsigned int i = 0;i < m_DataMatrix.rows();++i)
+    if (m_SquaredProblem)
+    {
+        if (!m_PointsSquaredNormSet)
+            itkExceptionMacro("Residual of a squared NNLS problem requires PointsSquaredNorm (BtB) to be set");
+
+        // |Ax - b|^2 = xt AtA x - 2 xt Atb + btb
+        residualValue = m_PointsSquaredNorm;
+        for (unsigned int i = 0;i < dataMatrix.rows();++i)
+        {
+            if (m_CurrentPosition[i] == 0.0)
+                continue;
+
+            double tmpVal = 0;
+            for (unsigned int j = 0;j < dataMatrix.cols();++j)
+                tmpVal += dataMatrix(i,j) * m_CurrentPosition[j];
+
+            residualValue += m_CurrentPosition[i] * (tmpVal - 2.0 * m_Points[i]);
+        }
+
+        return std::max(residualValue,0.0);
+    }
+
+    for (unsigned int i = 0;i < dataMatrix.rows();++i)
     {
         double tmpVal = 0;
-        for (unsigned int j = 0;j < m_DataMatrix.cols();++j)
-            tmpVal += m_DataMatrix(i,j) * m_CurrentPosition[j];
+        for (unsigned int j = 0;j < dataMatrix.cols();++j)
+            tmpVal += dataMatrix(i,j) * m_CurrentPosition[j];
 
         residualValue += (tmpVal - m_Points[i]) * (tmpVal - m_Points[i]);
     }
@@ -13,6 +13,9 @@ namespace anima
 /** \class NNLSOptimizer
  * \brief Non negative least squares optimizer. Implements Lawson et al method,
  * of squared problem is activated, assumes we pass AtA et AtB and uses Bro and de Jong method
+ * The data matrix may be shared (not copied) between several optimizers, e.g. a Gram matrix computed once
+ * and used read-only by all threads. If warm start is activated, the active set is initialized from the
+ * non null entries of the initial position (e.g. a neighboring voxel solution).
  *
  * \ingroup Numerics Optimizers
  */
@@ -40,17 +43,34 @@ public:
     /** Start optimization. */
     void StartOptimization() ITK_OVERRIDE;
 
-    void SetDataMatrix(MatrixType &data) {m_DataMatrix = data;}
-    void SetPoints(ParametersType &data) {m_Points = data;}
+    void SetDataMatrix(MatrixType &data) {m_DataMatrix = data; m_DataMatrixPointer = &m_DataMatrix;}
 
+    //! Use an external data matrix without copying it, it has to be kept alive and unchanged during optimization
+    void SetSharedDataMatrix(const MatrixType *data) {m_DataMatrixPointer = data;}
+    const MatrixType &GetDataMatrix() {return *m_DataMatrixPointer;}
+
+    //! Sets B (or AtB for squared problems), PointsSquaredNorm has to be set again afterwards for squared problems residuals
+    void SetPoints(ParametersType &data) {m_Points = data; m_PointsSquaredNormSet = false;}
+
+    //! Residual sum of squares. Throws for squared problems if PointsSquaredNorm (BtB) was not provided after SetPoints
     double GetCurrentResidual();
 
     itkSetMacro(SquaredProblem, bool)
 
+    //! BtB value for squared problems, only used in residual computation
+    void SetPointsSquaredNorm(double value) {m_PointsSquaredNorm = value; m_PointsSquaredNormSet = true;}
+
+    //! Initialize active set from the non null entries of the initial position
+    itkSetMacro(WarmStart, bool)
+
 protected:
     NNLSOptimizer()
     {
         m_SquaredProblem = false;
+        m_PointsSquaredNorm = 0.0;
+        m_PointsSquaredNormSet = false;
+        m_WarmStart = false;
+        m_DataMatrixPointer = &m_DataMatrix;
     }
 
     virtual ~NNLSOptimizer() ITK_OVERRIDE {}
@@ -62,13 +82,20 @@ private:
     void ComputeSPVector();
     void ComputeWVector();
 
+    //! Sets up passive set from initial position, shrinking it until its least squares solution is positive
+    void InitializeFromWarmStart();
+
     MatrixType m_DataMatrix;
+    const MatrixType *m_DataMatrixPointer;
     ParametersType m_Points;
 
     static const double m_EpsilonValue;
 
     //! Flag to indicate if the inputs are already AtA and AtB
     bool m_SquaredProblem;
+    double m_PointsSquaredNorm;
+    bool m_PointsSquaredNormSet;
+    bool m_WarmStart;
 
     // Working values
     std::vector <unsigned short> m_TreatedIndexes;
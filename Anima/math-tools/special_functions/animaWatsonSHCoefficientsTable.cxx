@@ -0,0 +1,206 @@
+#include <animaWatsonSHCoefficientsTable.h>
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+namespace anima
+{
+
+namespace
+{
+
+//! Kummer series M(a,b,k), all terms are positive for k >= 0 and a, b > 0 so summation stops once they are negligible
+double KummerPositiveSeries(double k, double a, double b)
+{
+    double resVal = 1.0;
+    double tVal = 1.0;
+
+    for (unsigned int n = 0;n < 10000;++n)
+    {
+        tVal *= (a + n) * k / ((b + n) * (n + 1.0));
+        resVal += tVal;
+
+        if (tVal <= std::numeric_limits <double>::epsilon() * resVal)
+            break;
+    }
+
+    return resVal;
+}
+
+} // end anonymous namespace
+
+const double WatsonSHCoefficientsTable::m_KappaUpperBound = 128.0;
+
+const WatsonSHCoefficientsTable &WatsonSHCoefficientsTable::GetInstance()
+{
+    // Function local static, initialization is thread safe
+    static const WatsonSHCoefficientsTable table;
+    return table;
+}
+
+WatsonSHCoefficientsTable::WatsonSHCoefficientsTable()
+{
+    unsigned int nbNodes = m_ChebyshevDegree + 1;
+    unsigned int segmentSize = m_NumberOfCoefficients * nbNodes;
+    double segmentWidth = m_KappaUpperBound / m_NumberOfSegments;
+
+    m_ValueExpansions.resize(m_NumberOfSegments * segmentSize);
+    m_DerivativeExpansions.resize(m_NumberOfSegments * segmentSize);
+
+    std::vector < std::vector <double> > nodeValues(nbNodes), nodeDerivatives(nbNodes);
+
+    for (unsigned int s = 0;s < m_NumberOfSegments;++s)
+    {
+        double segmentCenter = (s + 0.5) * segmentWidth;
+
+        // Sample reduced coefficients on Chebyshev nodes of the segment
+        for (unsigned int j = 0;j < nbNodes;++j)
+        {
+            double nodeValue = std::cos(M_PI * (j + 0.5) / nbNodes);
+            ComputeReducedCoefficients(segmentCenter + 0.5 * segmentWidth * nodeValue,nodeValues[j],nodeDerivatives[j]);
+        }
+
+        for (unsigned int i = 0;i < m_NumberOfCoefficients;++i)
+        {
+            for (unsigned int m = 0;m < nbNodes;++m)
+            {
+                double valueSum = 0.0;
+                double derivativeSum = 0.0;
+                for (unsigned int j = 0;j < nbNodes;++j)
+                {
+                    double cosValue = std::cos(M_PI * m * (j + 0.5) / nbNodes);
+                    valueSum += nodeValues[j][i] * cosValue;
+                    derivativeSum += nodeDerivatives[j][i] * cosValue;
+                }
+
+                double factor = (m == 0) ? 1.0 / nbNodes : 2.0 / nbNodes;
+                unsigned int index = s * segmentSize + i * nbNodes + m;
+                m_ValueExpansions[index] = factor * valueSum;
+                m_DerivativeExpansions[index] = factor * derivativeSum;
+            }
+        }
+    }
+}
+
+void WatsonSHCoefficientsTable::Evaluate(double k, unsigned int i, double &coefficient, double &derivative) const
+{
+    unsigned int nbNodes = m_ChebyshevDegree + 1;
+    double segmentWidth = m_KappaUpperBound / m_NumberOfSegments;
+
+    unsigned int segment = 0;
+    if (k > 0.0)
+        segment = std::min((unsigned int)std::floor(k / segmentWidth),m_NumberOfSegments - 1);
+
+    double t = 2.0 * (k - segment * segmentWidth) / segmentWidth - 1.0;
+    const double *valueExpansion = &m_ValueExpansions[(segment * m_NumberOfCoefficients + i) * nbNodes];
+    const double *derivativeExpansion = &m_DerivativeExpansions[(segment * m_NumberOfCoefficients + i) * nbNodes];
+
+    // Clenshaw recurrences for both expansions
+    double valueB1 = 0.0, valueB2 = 0.0;
+    double derivativeB1 = 0.0, derivativeB2 = 0.0;
+    for (unsigned int m = m_ChebyshevDegree;m > 0;--m)
+    {
+        double tmpValue = 2.0 * t * valueB1 - valueB2 + valueExpansion[m];
+        valueB2 = valueB1;
+        valueB1 = tmpValue;
+
+        tmpValue = 2.0 * t * derivativeB1 - derivativeB2 + derivativeExpansion[m];
+        derivativeB2 = derivativeB1;
+        derivativeB1 = tmpValue;
+    }
+
+    double reducedValue = t * valueB1 - valueB2 + valueExpansion[0];
+    double reducedDerivative = t * derivativeB1 - derivativeB2 + derivativeExpansion[0];
+
+    // Back to c_i(k) = k^i g_i(k)
+    double kPower = 1.0;
+    double kPowerDerivative = 0.0;
+    for (unsigned int j = 0;j < i;++j)
+    {
+        kPowerDerivative = kPowerDerivative * k + kPower;
+        kPower *= k;
+    }
+
+    coefficient = kPower * reducedValue;
+    derivative = kPowerDerivative * reducedValue + kPower * reducedDerivative;
+}
+
+void WatsonSHCoefficientsTable::ComputeReferenceCoefficients(double k, std::vector <double> &coefficients, std::vector <double> &derivatives)
+{
+    ComputeReducedCoefficients(k,coefficients,derivatives);
+
+    for (unsigned int i = 1;i < m_NumberOfCoefficients;++i)
+    {
+        double kPower = std::pow(k,(double)i);
+        derivatives[i] = i * std::pow(k,i - 1.0) * coefficients[i] + kPower * derivatives[i];
+        coefficients[i] *= kPower;
+    }
+}
+
+void WatsonSHCoefficientsTable::ComputeAsymptoticCoefficients(double k, std::vector <double> &coefficients, std::vector <double> &derivatives)
+{
+    // M(a,b,k) ~ Gamma(b) / Gamma(a) e^k k^(a-b) sum_n (b-a)_n (1-a)_n / (n! k^n), exponentially small terms dropped
+    coefficients.resize(m_NumberOfCoefficients);
+    derivatives.resize(m_NumberOfCoefficients);
+
+    std::vector <double> seriesValues(m_NumberOfCoefficients), seriesDerivatives(m_NumberOfCoefficients);
+    for (unsigned int i = 0;i < m_NumberOfCoefficients;++i)
+    {
+        double term = 1.0;
+        double seriesValue = 1.0;
+        double seriesDerivative = 0.0;
+
+        // Asymptotic series: stop at machine precision or once terms start growing again
+        for (unsigned int n = 0;n < m_MaximalAsymptoticTerms;++n)
+        {
+            double nextTerm = term * (i + 1.0 + n) * (0.5 - i + n) / ((n + 1.0) * k);
+            if ((n > i) && (std::abs(nextTerm) >= std::abs(term)))
+                break;
+
+            term = nextTerm;
+            seriesValue += term;
+            seriesDerivative -= (n + 1.0) * term / k;
+
+            if (std::abs(term) <= std::numeric_limits <double>::epsilon() * std::abs(seriesValue))
+                break;
+        }
+
+        seriesValues[i] = seriesValue;
+        seriesDerivatives[i] = seriesDerivative;
+    }
+
+    for (unsigned int i = 0;i < m_NumberOfCoefficients;++i)
+    {
+        double factor = 2.0 * std::sqrt(M_PI * (4.0 * i + 1.0));
+        coefficients[i] = factor * seriesValues[i] / seriesValues[0];
+        derivatives[i] = factor * (seriesDerivatives[i] * seriesValues[0] - seriesValues[i] * seriesDerivatives[0]) /
+                (seriesValues[0] * seriesValues[0]);
+    }
+}
+
+void WatsonSHCoefficientsTable::ComputeReducedCoefficients(double k, std::vector <double> &coefficients, std::vector <double> &derivatives)
+{
+    // c_l(k) = sqrt(pi (4l+1)) k^l Gamma(l+1/2) / Gamma(2l+3/2) M(l+1/2, 2l+3/2, k) / M(1/2, 3/2, k)
+    // using dM(a,b,k)/dk = a / b M(a+1, b+1, k)
+    coefficients.resize(m_NumberOfCoefficients);
+    derivatives.resize(m_NumberOfCoefficients);
+
+    double baseKummer = KummerPositiveSeries(k,0.5,1.5);
+    double baseKummerDerivative = KummerPositiveSeries(k,1.5,2.5) / 3.0;
+
+    for (unsigned int i = 0;i < m_NumberOfCoefficients;++i)
+    {
+        double aValue = i + 0.5;
+        double bValue = 2.0 * i + 1.5;
+        double factor = std::sqrt(M_PI * (4.0 * i + 1.0)) * std::exp(std::lgamma(aValue) - std::lgamma(bValue));
+
+        double kummerValue = (i == 0) ? baseKummer : KummerPositiveSeries(k,aValue,bValue);
+        double kummerDerivative = aValue / bValue * KummerPositiveSeries(k,aValue + 1.0,bValue + 1.0);
+
+        coefficients[i] = factor * kummerValue / baseKummer;
+        derivatives[i] = factor * (kummerDerivative - kummerValue * baseKummerDerivative / baseKummer) / baseKummer;
+    }
+}
+
+} // end namespace anima
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "AnimaSpecialFunctionsExport.h"
+#include <vector>
+
+namespace anima
+{
+
+/**
+ * @brief Tabulated spherical harmonics coefficients (multiplied by 4 M_PI) of the standard Watson PDF and their
+ * derivatives w.r.t. the concentration parameter kappa.
+ * Coefficients are written c_l(k) = k^l g_l(k) where g_l is a smooth ratio of Kummer functions. Each g_l and its
+ * derivative are approximated by piecewise Chebyshev expansions over [0, GetKappaUpperBound()], built once from
+ * the Kummer series. This avoids the cancellation of the closed form Dawson based expressions for small kappa while
+ * being cheap to evaluate. Above the table range, the large kappa asymptotic expansion of the Kummer functions ratio
+ * is used. Relative differences to the Kummer series measured by animaWatsonSHCoefficientsTableTest are below 1e-12
+ * on coefficients and 1e-10 on derivatives, the series derivative itself losing digits to cancellation.
+ */
+class ANIMASPECIALFUNCTIONS_EXPORT WatsonSHCoefficientsTable
+{
+public:
+    //! Shared table, built on first use
+    static const WatsonSHCoefficientsTable &GetInstance();
+
+    WatsonSHCoefficientsTable();
+    virtual ~WatsonSHCoefficientsTable() {}
+
+    //! Number of non-zero coefficients handled (orders 0, 2, ..., 12)
+    static unsigned int GetNumberOfCoefficients() {return m_NumberOfCoefficients;}
+
+    //! Upper bound on kappa for the table, above it coefficients are given by ComputeAsymptoticCoefficients
+    static double GetKappaUpperBound() {return m_KappaUpperBound;}
+
+    //! Evaluate coefficient of index i (SH order 2i) and its derivative at k, k in [0, GetKappaUpperBound()]
+    void Evaluate(double k, unsigned int i, double &coefficient, double &derivative) const;
+
+    /**
+     * Large kappa expansion of all coefficients and derivatives: c_l(k) = 2 sqrt(pi (4l+1)) S_l(k) / S_0(k) with
+     * S_l(k) = sum_n (l+1)_n (1/2-l)_n / (n! k^n), summed up to its smallest term. Over [GetKappaUpperBound(),
+     * 2 GetKappaUpperBound()], relative differences to the Kummer series are below 1e-13 on coefficients and 1e-9 on
+     * derivatives
+     */
+    static void ComputeAsymptoticCoefficients(double k, std::vector <double> &coefficients, std::vector <double> &derivatives);
+
+    //! Reference computation of all coefficients and derivatives from Kummer function series, slow. Derivatives lose digits to cancellation as k grows
+    static void ComputeReferenceCoefficients(double k, std::vector <double> &coefficients, std::vector <double> &derivatives);
+
+private:
+    //! Computes g_l(k) = c_l(k) / k^l and its derivative from Kummer function series
+    static void ComputeReducedCoefficients(double k, std::vector <double> &coefficients, std::vector <double> &derivatives);
+
+    static const unsigned int m_NumberOfCoefficients = 7;
+    static const unsigned int m_NumberOfSegments = 32;
+    static const unsigned int m_ChebyshevDegree = 16;
+    static const unsigned int m_MaximalAsymptoticTerms = 1000;
+    static const double m_KappaUpperBound;
+
+    //! Chebyshev expansions stored as [segment][coefficient index][degree]
+    std::vector <double> m_ValueExpansions, m_DerivativeExpansions;
+};
+
+} // end namespace anima
@@ -0,0 +1,128 @@
+#include <animaWatsonSHCoefficientsTable.h>
+#include <tclap/CmdLine.h>
+
+#include <itkTimeProbe.h>
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+int main(int argc,  char **argv)
+{
+    TCLAP::CmdLine cmd("INRIA / IRISA - VisAGeS Team", ' ',ANIMA_VERSION);
+
+    TCLAP::ValueArg<unsigned int> numSamplesArg("n","nb-samples","Number of kappa samples in the table range (default: 100000)",false,100000,"number of samples",cmd);
+    TCLAP::ValueArg<double> toleranceArg("t","tolerance","Maximal relative error allowed (default: 1.0e-8)",false,1.0e-8,"tolerance",cmd);
+
+    try
+    {
+        cmd.parse(argc,argv);
+    }
+    catch (TCLAP::ArgException& e)
+    {
+        std::cerr << "Error: " << e.error() << "for argument " << e.argId() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    typedef anima::WatsonSHCoefficientsTable TableType;
+    unsigned int nbSamples = std::max(numSamplesArg.getValue(),(unsigned int)2);
+    unsigned int nbCoefs = TableType::GetNumberOfCoefficients();
+
+    itk::TimeProbe tmpTime;
+    tmpTime.Start();
+    const TableType &shTable = TableType::GetInstance();
+    tmpTime.Stop();
+
+    std::cout << "Table building time: " << tmpTime.GetTotal() << "s" << std::endl;
+
+    // Accuracy against Kummer series
+    std::vector <double> kappaValues(nbSamples);
+    for (unsigned int i = 0;i < nbSamples;++i)
+        kappaValues[i] = TableType::GetKappaUpperBound() * std::pow(i / (nbSamples - 1.0), 2.0);
+
+    std::vector <double> refCoefficients, refDerivatives;
+    std::vector <double> maxCoefficientErrors(nbCoefs,0.0), maxDerivativeErrors(nbCoefs,0.0);
+
+    for (unsigned int i = 0;i < nbSamples;++i)
+    {
+        TableType::ComputeReferenceCoefficients(kappaValues[i],refCoefficients,refDerivatives);
+
+        for (unsigned int j = 0;j < nbCoefs;++j)
+        {
+            double coefficient, derivative;
+            shTable.Evaluate(kappaValues[i],j,coefficient,derivative);
+
+            if (refCoefficients[j] != 0.0)
+                maxCoefficientErrors[j] = std::max(maxCoefficientErrors[j],std::abs(coefficient - refCoefficients[j]) / std::abs(refCoefficients[j]));
+
+            // Derivative of order 0 coefficient is null
+            if (j > 0 && refDerivatives[j] != 0.0)
+                maxDerivativeErrors[j] = std::max(maxDerivativeErrors[j],std::abs(derivative - refDerivatives[j]) / std::abs(refDerivatives[j]));
+        }
+    }
+
+    bool testPassed = true;
+    for (unsigned int j = 0;j < nbCoefs;++j)
+    {
+        std::cout << "Order " << 2 * j << ": max relative error on coefficient " << maxCoefficientErrors[j]
+                  << ", on derivative " << maxDerivativeErrors[j] << std::endl;
+
+        if (maxCoefficientErrors[j] > toleranceArg.getValue() || maxDerivativeErrors[j] > toleranceArg.getValue())
+            testPassed = false;
+    }
+
+    // Asymptotic expansion used above the table, checked against Kummer series up to twice the bound
+    std::vector <double> asymptoticCoefficients, asymptoticDerivatives;
+    double maxAsymptoticCoefficientError = 0.0;
+    double maxAsymptoticDerivativeError = 0.0;
+    for (unsigned int i = 0;i < nbSamples;++i)
+    {
+        double kappaValue = TableType::GetKappaUpperBound() * (1.0 + i / (nbSamples - 1.0));
+        TableType::ComputeReferenceCoefficients(kappaValue,refCoefficients,refDerivatives);
+        TableType::ComputeAsymptoticCoefficients(kappaValue,asymptoticCoefficients,asymptoticDerivatives);
+
+        for (unsigned int j = 0;j < nbCoefs;++j)
+        {
+            maxAsymptoticCoefficientError = std::max(maxAsymptoticCoefficientError,std::abs(asymptoticCoefficients[j] - refCoefficients[j]) / std::abs(refCoefficients[j]));
+            if (j > 0)
+                maxAsymptoticDerivativeError = std::max(maxAsymptoticDerivativeError,std::abs(asymptoticDerivatives[j] - refDerivatives[j]) / std::abs(refDerivatives[j]));
+        }
+    }
+
+    std::cout << "Asymptotic expansion above table: max relative error on coefficients " << maxAsymptoticCoefficientError
+              << ", on derivatives " << maxAsymptoticDerivativeError << std::endl;
+    if (!(maxAsymptoticCoefficientError <= toleranceArg.getValue()) || !(maxAsymptoticDerivativeError <= toleranceArg.getValue()))
+        testPassed = false;
+
+    // Benchmark
+    tmpTime.Reset();
+    tmpTime.Start();
+    for (unsigned int i = 0;i < nbSamples;++i)
+        TableType::ComputeReferenceCoefficients(kappaValues[i],refCoefficients,refDerivatives);
+    tmpTime.Stop();
+
+    std::cout << "Kummer series time per kappa value: " << tmpTime.GetTotal() / nbSamples << "s" << std::endl;
+
+    double checkSum = 0.0;
+    tmpTime.Reset();
+    tmpTime.Start();
+    for (unsigned int i = 0;i < nbSamples;++i)
+    {
+        for (unsigned int j = 0;j < nbCoefs;++j)
+        {
+            double coefficient, derivative;
+            shTable.Evaluate(kappaValues[i],j,coefficient,derivative);
+            checkSum += coefficient + derivative;
+        }
+    }
+    tmpTime.Stop();
+
+    std::cout << "Tabulated time per kappa value: " << tmpTime.GetTotal() / nbSamples << "s (checksum " << checkSum << ")" << std::endl;
+
+    if (!testPassed)
+    {
+        std::cerr << "Tabulated Watson SH coefficients are not accurate enough" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -6,10 +6,21 @@ namespace anima
 
 ODFMaximaCostFunction::MeasureType ODFMaximaCostFunction::GetValue( const ParametersType & parameters ) const
 {
-    anima::ODFSphericalHarmonicBasis shBasis(m_ODFSHOrder);
     double p0 = parameters[0];
     double p1 = parameters[1];
-    return shBasis.getValueAtPosition(m_BasisParameters, p0, p1);
+    return m_SHBasis->getValueAtPosition(m_BasisParameters, p0, p1, m_WorkTables);
+}
+
+void ODFMaximaCostFunction::SetODFSHOrder(unsigned int num)
+{
+    if ((num == m_ODFSHOrder) && (m_SHBasis))
+        return;
+
+    m_ODFSHOrder = num;
+    if (m_SHBasis)
+        delete m_SHBasis;
+
+    m_SHBasis = new anima::ODFSphericalHarmonicBasis(m_ODFSHOrder);
 }
 
 void ODFMaximaCostFunction::GetDerivative( const ParametersType & parameters, DerivativeType & derivative ) const
@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <itkSingleValuedCostFunction.h>
+#include <animaODFSphericalHarmonicBasis.h>
 #include "AnimaSHToolsExport.h"
 
 namespace anima
@@ -30,7 +31,7 @@ public:
     virtual void GetDerivative(const ParametersType & parameters, DerivativeType & derivative) const ITK_OVERRIDE;
 
     void SetBasisParameters(const std::vector <double> &basisPars) {m_BasisParameters = basisPars;}
-    void SetODFSHOrder(unsigned int num) {m_ODFSHOrder = num;}
+    void SetODFSHOrder(unsigned int num);
 
     virtual unsigned int GetNumberOfParameters() const ITK_OVERRIDE
     {
@@ -41,9 +42,14 @@ protected:
     ODFMaximaCostFunction()
     {
         m_ODFSHOrder = 4;
+        m_SHBasis = new anima::ODFSphericalHarmonicBasis(m_ODFSHOrder);
     }
 
-    virtual ~ODFMaximaCostFunction() {}
+    virtual ~ODFMaximaCostFunction()
+    {
+        if (m_SHBasis)
+            delete m_SHBasis;
+    }
 
 private:
     ODFMaximaCostFunction(const Self&); //purposely not implemented
@@ -51,6 +57,12 @@ private:
 
     std::vector <double> m_BasisParameters;
     unsigned int m_ODFSHOrder;
+
+    //! Basis created once per order, not at each evaluation
+    anima::ODFSphericalHarmonicBasis *m_SHBasis;
+
+    //! Basis tables reused by evaluations
+    mutable anima::ODFSphericalHarmonicBasis::WorkTables m_WorkTables;
 };
 
 } // end of namespace anima
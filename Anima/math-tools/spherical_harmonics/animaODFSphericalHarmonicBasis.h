@@ -1,7 +1,8 @@
 #pragma once
 
-#include <animaSphericalHarmonic.h>
+#include <animaRealSphericalHarmonicsEvaluator.h>
 #include <itkVariableLengthVector.h>
+#include <vnl/vnl_matrix.h>
 #include <vector>
 #include <AnimaSHToolsExport.h>
 
@@ -11,37 +12,64 @@ class ANIMASHTOOLS_EXPORT ODFSphericalHarmonicBasis
 {
 public:
     ODFSphericalHarmonicBasis(unsigned int L);
-    virtual ~ODFSphericalHarmonicBasis() {m_SphericalHarmonics.clear();}
+    virtual ~ODFSphericalHarmonicBasis() {}
+
+    /**
+     * Basis tables reused from one evaluation to the next by the getters taking them, so that evaluations do not
+     * allocate. A basis shared by several threads needs one per thread
+     */
+    struct WorkTables
+    {
+        std::vector <double> legendreTables;
+        std::vector <double> basisTables;
+    };
 
     // T has to be a vector type with the [] operator
     template <class T> double getValueAtPosition(const T &coefficients, double theta, double phi);
+    template <class T> double getValueAtPosition(const T &coefficients, double theta, double phi, WorkTables &workTables);
 
-    template <class T> double getThetaFirstDerivativeValueAtPosition(const T &coefficients,
-                                                  double theta, double phi);
+    template <class T> double getThetaFirstDerivativeValueAtPosition(const T &coefficients, double theta, double phi);
+    template <class T> double getThetaFirstDerivativeValueAtPosition(const T &coefficients, double theta, double phi,
+                                                                     WorkTables &workTables);
 
-    template <class T> double getPhiFirstDerivativeValueAtPosition(const T &coefficients,
-                                                double theta, double phi);
+    template <class T> double getPhiFirstDerivativeValueAtPosition(const T &coefficients, double theta, double phi);
+    template <class T> double getPhiFirstDerivativeValueAtPosition(const T &coefficients, double theta, double phi,
+                                                                   WorkTables &workTables);
 
-    template <class T> double getThetaSecondDerivativeValueAtPosition(const T &coefficients,
-                                                   double theta, double phi);
+    template <class T> double getThetaSecondDerivativeValueAtPosition(const T &coefficients, double theta, double phi);
+    template <class T> double getThetaSecondDerivativeValueAtPosition(const T &coefficients, double theta, double phi,
+                                                                      WorkTables &workTables);
 
-    template <class T> double getThetaPhiDerivativeValueAtPosition(const T &coefficients,
-                                                double theta, double phi);
+    template <class T> double getThetaPhiDerivativeValueAtPosition(const T &coefficients, double theta, double phi);
+    template <class T> double getThetaPhiDerivativeValueAtPosition(const T &coefficients, double theta, double phi,
+                                                                   WorkTables &workTables);
 
-    template <class T> double getPhiSecondDerivativeValueAtPosition(const T &coefficients,
-                                                 double theta, double phi);
+    template <class T> double getPhiSecondDerivativeValueAtPosition(const T &coefficients, double theta, double phi);
+    template <class T> double getPhiSecondDerivativeValueAtPosition(const T &coefficients, double theta, double phi,
+                                                                    WorkTables &workTables);
 
-    template <class T> double getCurvatureAtPosition(const T &coefficients,
-                                  double theta, double phi);
+    template <class T> double getCurvatureAtPosition(const T &coefficients, double theta, double phi);
+    template <class T> double getCurvatureAtPosition(const T &coefficients, double theta, double phi, WorkTables &workTables);
 
     double getNthSHValueAtPosition(int k, int m, double theta, double phi);
 
+    //! Basis values at a set of directions (theta,phi), one row per direction, to be computed once for a fixed tesselation
+    void ComputeBasisMatrix(const std::vector < std::vector <double> > &sampleDirections, vnl_matrix <double> &basisMatrix);
+
     template <class T> itk::VariableLengthVector <T>
     GetSampleValues(itk::VariableLengthVector <T> &data,
                     std::vector < std::vector <double> > &m_SampleDirections);
+
+    //! Sample values from a basis matrix computed by ComputeBasisMatrix
+    template <class T> itk::VariableLengthVector <T>
+    GetSampleValues(const itk::VariableLengthVector <T> &data, const vnl_matrix <double> &basisMatrix);
+
 private:
+    //! Sums coefficients weighted by one of the basis tables
+    template <class T> double ComputeWeightedSum(const T &coefficients, const double *basisValues);
+
     unsigned int m_LOrder;
-    std::vector < SphericalHarmonic > m_SphericalHarmonics;
+    anima::RealSphericalHarmonicsEvaluator m_Evaluator;
 };
 
 } // end namespace odf
@@ -1,31 +1,43 @@
 #pragma once
 #include "animaODFSphericalHarmonicBasis.h"
 
+#include <cmath>
+
 namespace anima
 {
 
 template <class T>
 double
 ODFSphericalHarmonicBasis::
-getValueAtPosition(const T &coefficients, double theta, double phi)
+ComputeWeightedSum(const T &coefficients, const double *basisValues)
 {
+    unsigned int numCoefficients = m_Evaluator.GetNumberOfSymmetricCoefficients();
+
     double resVal = 0;
-    std::complex <double> tmpVal;
+    for (unsigned int i = 0;i < numCoefficients;++i)
+        resVal += coefficients[i] * basisValues[i];
 
-    for (int k = 0;k <= (int)m_LOrder;k += 2)
-        for (int m = -k;m <= k;++m)
-        {
-            tmpVal = m_SphericalHarmonics[k*(k+1)/2 + m].Value(theta,phi);
+    return resVal;
+}
+
+template <class T>
+double
+ODFSphericalHarmonicBasis::
+getValueAtPosition(const T &coefficients, double theta, double phi)
+{
+    WorkTables workTables;
+    return this->getValueAtPosition(coefficients,theta,phi,workTables);
+}
 
-            if (m > 0)
-                resVal += coefficients[k*(k+1)/2 + m]*sqrt(2.0)*imag(tmpVal);
-            else if (m < 0)
-                resVal += coefficients[k*(k+1)/2 + m]*sqrt(2.0)*real(tmpVal);
-            else
-                resVal += coefficients[k*(k+1)/2 + m]*real(tmpVal);
-        }
+template <class T>
+double
+ODFSphericalHarmonicBasis::
+getValueAtPosition(const T &coefficients, double theta, double phi, WorkTables &workTables)
+{
+    workTables.basisTables.resize(m_Evaluator.GetNumberOfSymmetricCoefficients());
+    m_Evaluator.EvaluateSymmetricBasis(theta,phi,&workTables.basisTables[0]);
 
-    return resVal;
+    return this->ComputeWeightedSum(coefficients,&workTables.basisTables[0]);
 }
 
 template <class T>
@@ -34,10 +46,29 @@ ODFSphericalHarmonicBasis::
 GetSampleValues(itk::VariableLengthVector <T> &data,
                 std::vector < std::vector <double> > &m_SampleDirections)
 {
-    itk::VariableLengthVector <T> resVal(m_SampleDirections.size());
+    vnl_matrix <double> basisMatrix;
+    this->ComputeBasisMatrix(m_SampleDirections,basisMatrix);
+
+    return this->GetSampleValues(data,basisMatrix);
+}
+
+template <class T>
+itk::VariableLengthVector <T>
+ODFSphericalHarmonicBasis::
+GetSampleValues(const itk::VariableLengthVector <T> &data, const vnl_matrix <double> &basisMatrix)
+{
+    unsigned int numSamples = basisMatrix.rows();
+    unsigned int numCoefficients = basisMatrix.cols();
+    itk::VariableLengthVector <T> resVal(numSamples);
+
+    for (unsigned int i = 0;i < numSamples;++i)
+    {
+        double sampleValue = 0;
+        for (unsigned int j = 0;j < numCoefficients;++j)
+            sampleValue += basisMatrix(i,j) * data[j];
 
-    for (unsigned int i = 0;i < m_SampleDirections.size();++i)
-        resVal[i] = this->getValueAtPosition(data,m_SampleDirections[i][0],m_SampleDirections[i][1]);
+        resVal[i] = sampleValue;
+    }
 
     return resVal;
 }
@@ -47,23 +78,19 @@ double
 ODFSphericalHarmonicBasis::
 getThetaFirstDerivativeValueAtPosition(const T &coefficients, double theta, double phi)
 {
-    double resVal = 0;
-    std::complex <double> tmpVal;
-
-    for (int k = 0;k <= (int)m_LOrder;k += 2)
-        for (int m = -k;m <= k;++m)
-        {
-            tmpVal = m_SphericalHarmonics[k*(k+1)/2 + m].getThetaFirstDerivative(theta,phi);
+    WorkTables workTables;
+    return this->getThetaFirstDerivativeValueAtPosition(coefficients,theta,phi,workTables);
+}
 
-            if (m > 0)
-                resVal += coefficients[k*(k+1)/2 + m]*sqrt(2.0)*imag(tmpVal);
-            else if (m < 0)
-                resVal += coefficients[k*(k+1)/2 + m]*sqrt(2.0)*real(tmpVal);
-            else
-                resVal += coefficients[k*(k+1)/2 + m]*real(tmpVal);
-        }
+template <class T>
+double
+ODFSphericalHarmonicBasis::
+getThetaFirstDerivativeValueAtPosition(const T &coefficients, double theta, double phi, WorkTables &workTables)
+{
+    workTables.basisTables.resize(m_Evaluator.GetNumberOfSymmetricCoefficients());
+    m_Evaluator.EvaluateSymmetricBasisWithDerivatives(theta,phi,workTables.legendreTables,0,&workTables.basisTables[0],0,0,0,0);
 
-    return resVal;
+    return this->ComputeWeightedSum(coefficients,&workTables.basisTables[0]);
 }
 
 template <class T>
@@ -71,23 +98,19 @@ double
 ODFSphericalHarmonicBasis::
 getPhiFirstDerivativeValueAtPosition(const T &coefficients, double theta, double phi)
 {
-    double resVal = 0;
-    std::complex <double> tmpVal;
-
-    for (int k = 0;k <= (int)m_LOrder;k += 2)
-        for (int m = -k;m <= k;++m)
-        {
-            tmpVal = m_SphericalHarmonics[k*(k+1)/2 + m].getPhiFirstDerivative(theta,phi);
+    WorkTables workTables;
+    return this->getPhiFirstDerivativeValueAtPosition(coefficients,theta,phi,workTables);
+}
 
-            if (m > 0)
-                resVal += coefficients[k*(k+1)/2 + m]*sqrt(2.0)*imag(tmpVal);
-            else if (m < 0)
-                resVal += coefficients[k*(k+1)/2 + m]*sqrt(2.0)*real(tmpVal);
-            else
-                resVal += coefficients[k*(k+1)/2 + m]*real(tmpVal);
-        }
+template <class T>
+double
+ODFSphericalHarmonicBasis::
+getPhiFirstDerivativeValueAtPosition(const T &coefficients, double theta, double phi, WorkTables &workTables)
+{
+    workTables.basisTables.resize(m_Evaluator.GetNumberOfSymmetricCoefficients());
+    m_Evaluator.EvaluateSymmetricBasisWithDerivatives(theta,phi,workTables.legendreTables,0,0,&workTables.basisTables[0],0,0,0);
 
-    return resVal;
+    return this->ComputeWeightedSum(coefficients,&workTables.basisTables[0]);
 }
 
 template <class T>
@@ -95,23 +118,19 @@ double
 ODFSphericalHarmonicBasis::
 getThetaSecondDerivativeValueAtPosition(const T &coefficients, double theta, double phi)
 {
-    double resVal = 0;
-    std::complex <double> tmpVal;
-
-    for (int k = 0;k <= (int)m_LOrder;k += 2)
-        for (int m = -k;m <= k;++m)
-        {
-            tmpVal = m_SphericalHarmonics[k*(k+1)/2 + m].getThetaSecondDerivative(theta,phi);
+    WorkTables workTables;
+    return this->getThetaSecondDerivativeValueAtPosition(coefficients,theta,phi,workTables);
+}
 
-            if (m > 0)
-                resVal += coefficients[k*(k+1)/2 + m]*sqrt(2.0)*imag(tmpVal);
-            else if (m < 0)
-                resVal += coefficients[k*(k+1)/2 + m]*sqrt(2.0)*real(tmpVal);
-            else
-                resVal += coefficients[k*(k+1)/2 + m]*real(tmpVal);
-        }
+template <class T>
+double
+ODFSphericalHarmonicBasis::
+getThetaSecondDerivativeValueAtPosition(const T &coefficients, double theta, double phi, WorkTables &workTables)
+{
+    workTables.basisTables.resize(m_Evaluator.GetNumberOfSymmetricCoefficients());
+    m_Evaluator.EvaluateSymmetricBasisWithDerivatives(theta,phi,workTables.legendreTables,0,0,0,&workTables.basisTables[0],0,0);
 
-    return resVal;
+    return this->ComputeWeightedSum(coefficients,&workTables.basisTables[0]);
 }
 
 template <class T>
@@ -119,23 +138,19 @@ double
 ODFSphericalHarmonicBasis::
 getThetaPhiDerivativeValueAtPosition(const T &coefficients, double theta, double phi)
 {
-    double resVal = 0;
-    std::complex <double> tmpVal;
-
-    for (int k = 0;k <= (int)m_LOrder;k += 2)
-        for (int m = -k;m <= k;++m)
-        {
-            tmpVal = m_SphericalHarmonics[k*(k+1)/2 + m].getThetaPhiDerivative(theta,phi);
+    WorkTables workTables;
+    return this->getThetaPhiDerivativeValueAtPosition(coefficients,theta,phi,workTables);
+}
 
-            if (m > 0)
-                resVal += coefficients[k*(k+1)/2 + m]*sqrt(2.0)*imag(tmpVal);
-            else if (m < 0)
-                resVal += coefficients[k*(k+1)/2 + m]*sqrt(2.0)*real(tmpVal);
-            else
-                resVal += coefficients[k*(k+1)/2 + m]*real(tmpVal);
-        }
+template <class T>
+double
+ODFSphericalHarmonicBasis::
+getThetaPhiDerivativeValueAtPosition(const T &coefficients, double theta, double phi, WorkTables &workTables)
+{
+    workTables.basisTables.resize(m_Evaluator.GetNumberOfSymmetricCoefficients());
+    m_Evaluator.EvaluateSymmetricBasisWithDerivatives(theta,phi,workTables.legendreTables,0,0,0,0,&workTables.basisTables[0],0);
 
-    return resVal;
+    return this->ComputeWeightedSum(coefficients,&workTables.basisTables[0]);
 }
 
 template <class T>
@@ -143,23 +158,19 @@ double
 ODFSphericalHarmonicBasis::
 getPhiSecondDerivativeValueAtPosition(const T &coefficients, double theta, double phi)
 {
-    double resVal = 0;
-    std::complex <double> tmpVal;
-
-    for (int k = 0;k <= (int)m_LOrder;k += 2)
-        for (int m = -k;m <= k;++m)
-        {
-            tmpVal = m_SphericalHarmonics[k*(k+1)/2 + m].getPhiSecondDerivative(theta,phi);
+    WorkTables workTables;
+    return this->getPhiSecondDerivativeValueAtPosition(coefficients,theta,phi,workTables);
+}
 
-            if (m > 0)
-                resVal += coefficients[k*(k+1)/2 + m]*sqrt(2.0)*imag(tmpVal);
-            else if (m < 0)
-                resVal += coefficients[k*(k+1)/2 + m]*sqrt(2.0)*real(tmpVal);
-            else
-                resVal += coefficients[k*(k+1)/2 + m]*real(tmpVal);
-        }
+template <class T>
+double
+ODFSphericalHarmonicBasis::
+getPhiSecondDerivativeValueAtPosition(const T &coefficients, double theta, double phi, WorkTables &workTables)
+{
+    workTables.basisTables.resize(m_Evaluator.GetNumberOfSymmetricCoefficients());
+    m_Evaluator.EvaluateSymmetricBasisWithDerivatives(theta,phi,workTables.legendreTables,0,0,0,0,0,&workTables.basisTables[0]);
 
-    return resVal;
+    return this->ComputeWeightedSum(coefficients,&workTables.basisTables[0]);
 }
 
 template <class T>
@@ -167,8 +178,26 @@ double
 ODFSphericalHarmonicBasis::
 getCurvatureAtPosition(const T &coefficients, double theta, double phi)
 {
+    WorkTables workTables;
+    return this->getCurvatureAtPosition(coefficients,theta,phi,workTables);
+}
+
+template <class T>
+double
+ODFSphericalHarmonicBasis::
+getCurvatureAtPosition(const T &coefficients, double theta, double phi, WorkTables &workTables)
+{
+    // All needed basis tables from a single Legendre evaluation: values, theta and phi second derivatives
+    unsigned int numCoefficients = m_Evaluator.GetNumberOfSymmetricCoefficients();
+    workTables.basisTables.resize(3 * numCoefficients);
+    double *basisValues = &workTables.basisTables[0];
+    double *thetaSecondDerivatives = basisValues + numCoefficients;
+    double *phiSecondDerivatives = basisValues + 2 * numCoefficients;
+    m_Evaluator.EvaluateSymmetricBasisWithDerivatives(theta,phi,workTables.legendreTables,basisValues,0,0,thetaSecondDerivatives,
+                                                      0,phiSecondDerivatives);
+
     // Taken from Bloy and Verma, simplified to the maximum (this supposes we are actually at an extremum of the odf)
-    double odfValue = this->getValueAtPosition(coefficients,theta,phi);
+    double odfValue = this->ComputeWeightedSum(coefficients,basisValues);
     double sqSinTheta = sin(theta) * sin(theta);
     if (sqSinTheta <= 1.0e-16)
         sqSinTheta = 1.0e-16;
@@ -176,8 +205,8 @@ getCurvatureAtPosition(const T &coefficients, double theta, double phi)
     double denom = 2.0 * odfValue * odfValue * sqSinTheta;
 
     double num = 2.0 * odfValue * sqSinTheta;
-    num -= sqSinTheta * this->getThetaSecondDerivativeValueAtPosition(coefficients,theta,phi) +
-    this->getPhiSecondDerivativeValueAtPosition(coefficients,theta,phi);
+    num -= sqSinTheta * this->ComputeWeightedSum(coefficients,thetaSecondDerivatives) +
+    this->ComputeWeightedSum(coefficients,phiSecondDerivatives);
 
     return num / denom;
 }
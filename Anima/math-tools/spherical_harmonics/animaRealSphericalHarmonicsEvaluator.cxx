@@ -0,0 +1,231 @@
+#include "animaRealSphericalHarmonicsEvaluator.h"
+
+#include <cmath>
+
+namespace anima
+{
+
+RealSphericalHarmonicsEvaluator::RealSphericalHarmonicsEvaluator(unsigned int lMax)
+{
+    m_LMax = lMax;
+
+    unsigned int numValues = this->GetNumberOfLegendreValues();
+    m_RecurrenceFactors.resize(numValues);
+    m_PreviousRecurrenceFactors.resize(numValues);
+    m_LowerLadderFactors.resize(numValues);
+    m_UpperLadderFactors.resize(numValues);
+
+    for (unsigned int l = 0;l <= m_LMax;++l)
+    {
+        for (unsigned int m = 0;m <= l;++m)
+        {
+            unsigned int index = GetLegendreIndex(l,m);
+            double lValue = l;
+            double mValue = m;
+
+            m_RecurrenceFactors[index] = 0;
+            m_PreviousRecurrenceFactors[index] = 0;
+            if (l >= m + 2)
+            {
+                m_RecurrenceFactors[index] = std::sqrt((4.0 * lValue * lValue - 1.0) / (lValue * lValue - mValue * mValue));
+                m_PreviousRecurrenceFactors[index] = std::sqrt(((lValue - 1.0) * (lValue - 1.0) - mValue * mValue) /
+                                                               (4.0 * (lValue - 1.0) * (lValue - 1.0) - 1.0));
+            }
+
+            m_LowerLadderFactors[index] = std::sqrt((lValue + mValue) * (lValue - mValue + 1.0));
+            m_UpperLadderFactors[index] = std::sqrt((lValue - mValue) * (lValue + mValue + 1.0));
+        }
+    }
+}
+
+void RealSphericalHarmonicsEvaluator::ComputeNormalizedLegendre(double theta, double *values, double *thetaDerivatives,
+                                                                double *thetaSecondDerivatives) const
+{
+    double cosTheta = std::cos(theta);
+    double sinTheta = std::sin(theta);
+
+    values[0] = 1.0 / std::sqrt(4.0 * M_PI);
+    for (unsigned int m = 0;m <= m_LMax;++m)
+    {
+        unsigned int diagonalIndex = GetLegendreIndex(m,m);
+        if (m > 0)
+            values[diagonalIndex] = - std::sqrt((2.0 * m + 1.0) / (2.0 * m)) * sinTheta * values[GetLegendreIndex(m - 1,m - 1)];
+
+        if (m == m_LMax)
+            break;
+
+        values[GetLegendreIndex(m + 1,m)] = std::sqrt(2.0 * m + 3.0) * cosTheta * values[diagonalIndex];
+
+        for (unsigned int l = m + 2;l <= m_LMax;++l)
+        {
+            unsigned int index = GetLegendreIndex(l,m);
+            values[index] = m_RecurrenceFactors[index] * (cosTheta * values[GetLegendreIndex(l - 1,m)] -
+                                                          m_PreviousRecurrenceFactors[index] * values[GetLegendreIndex(l - 2,m)]);
+        }
+    }
+
+    if (!thetaDerivatives)
+        return;
+
+    // Ladder relations (with Condon-Shortley phase), order -1 functions are the opposite of order 1 ones
+    unsigned int numDerivatives = (thetaSecondDerivatives) ? 2 : 1;
+    for (unsigned int d = 0;d < numDerivatives;++d)
+    {
+        const double *inputTable = (d == 0) ? values : thetaDerivatives;
+        double *outputTable = (d == 0) ? thetaDerivatives : thetaSecondDerivatives;
+
+        outputTable[0] = 0;
+        for (unsigned int l = 1;l <= m_LMax;++l)
+        {
+            for (unsigned int m = 0;m <= l;++m)
+            {
+                unsigned int index = GetLegendreIndex(l,m);
+                double lowerValue = (m == 0) ? - inputTable[index + 1] : inputTable[index - 1];
+                double upperValue = (m < l) ? inputTable[index + 1] : 0.0;
+
+                outputTable[index] = 0.5 * (m_UpperLadderFactors[index] * upperValue - m_LowerLadderFactors[index] * lowerValue);
+            }
+        }
+    }
+}
+
+void RealSphericalHarmonicsEvaluator::EvaluateSymmetricBasis(double theta, double phi, double *values) const
+{
+    double cosTheta = std::cos(theta);
+    double sinTheta = std::sin(theta);
+    double cosPhi = std::cos(phi);
+    double sinPhi = std::sin(phi);
+
+    // Column by column (fixed m) recurrence, no Legendre table needed
+    double diagonalValue = 1.0 / std::sqrt(4.0 * M_PI);
+    double cosMPhi = 1.0;
+    double sinMPhi = 0.0;
+    for (unsigned int m = 0;m <= m_LMax;++m)
+    {
+        if (m > 0)
+        {
+            diagonalValue *= - std::sqrt((2.0 * m + 1.0) / (2.0 * m)) * sinTheta;
+
+            double tmpCos = cosMPhi * cosPhi - sinMPhi * sinPhi;
+            sinMPhi = sinMPhi * cosPhi + cosMPhi * sinPhi;
+            cosMPhi = tmpCos;
+        }
+
+        double cosFactor = M_SQRT2 * cosMPhi;
+        if (m % 2 != 0)
+            cosFactor *= -1.0;
+        double sinFactor = M_SQRT2 * sinMPhi;
+
+        double previousValue = 0;
+        double currentValue = diagonalValue;
+        for (unsigned int l = m;l <= m_LMax;++l)
+        {
+            if (l == m + 1)
+            {
+                previousValue = currentValue;
+                currentValue = std::sqrt(2.0 * m + 3.0) * cosTheta * diagonalValue;
+            }
+            else if (l > m + 1)
+            {
+                unsigned int index = GetLegendreIndex(l,m);
+                double nextValue = m_RecurrenceFactors[index] * (cosTheta * currentValue - m_PreviousRecurrenceFactors[index] * previousValue);
+                previousValue = currentValue;
+                currentValue = nextValue;
+            }
+
+            if (l % 2 != 0)
+                continue;
+
+            unsigned int centerIndex = l * (l + 1) / 2;
+            if (m == 0)
+                values[centerIndex] = currentValue;
+            else
+            {
+                values[centerIndex + m] = sinFactor * currentValue;
+                values[centerIndex - m] = cosFactor * currentValue;
+            }
+        }
+    }
+}
+
+void RealSphericalHarmonicsEvaluator::EvaluateSymmetricBasisWithDerivatives(double theta, double phi, std::vector <double> &legendreWorkTables,
+                                                                            double *values, double *thetaDerivatives, double *phiDerivatives,
+                                                                            double *thetaSecondDerivatives, double *thetaPhiDerivatives,
+                                                                            double *phiSecondDerivatives) const
+{
+    unsigned int numLegendreValues = this->GetNumberOfLegendreValues();
+    if (legendreWorkTables.size() < 3 * numLegendreValues + 2 * (m_LMax + 1))
+        legendreWorkTables.resize(3 * numLegendreValues + 2 * (m_LMax + 1));
+
+    double *legendreValues = &legendreWorkTables[0];
+    double *legendreFirstDerivatives = legendreValues + numLegendreValues;
+    double *legendreSecondDerivatives = legendreFirstDerivatives + numLegendreValues;
+    double *cosMPhi = legendreSecondDerivatives + numLegendreValues;
+    double *sinMPhi = cosMPhi + m_LMax + 1;
+
+    bool needsThetaDerivatives = (thetaDerivatives != 0) || (thetaPhiDerivatives != 0) || (thetaSecondDerivatives != 0);
+    this->ComputeNormalizedLegendre(theta,legendreValues,needsThetaDerivatives ? legendreFirstDerivatives : 0,
+                                    (thetaSecondDerivatives != 0) ? legendreSecondDerivatives : 0);
+
+    double cosPhi = std::cos(phi);
+    double sinPhi = std::sin(phi);
+    cosMPhi[0] = 1.0;
+    sinMPhi[0] = 0.0;
+    for (unsigned int m = 1;m <= m_LMax;++m)
+    {
+        cosMPhi[m] = cosMPhi[m - 1] * cosPhi - sinMPhi[m - 1] * sinPhi;
+        sinMPhi[m] = sinMPhi[m - 1] * cosPhi + cosMPhi[m - 1] * sinPhi;
+    }
+
+    for (unsigned int l = 0;l <= m_LMax;l += 2)
+    {
+        unsigned int centerIndex = l * (l + 1) / 2;
+        for (int m = - (int)l;m <= (int)l;++m)
+        {
+            unsigned int absM = std::abs(m);
+            unsigned int legendreIndex = GetLegendreIndex(l,absM);
+            unsigned int index = centerIndex + m;
+
+            // Basis function is thetaPart(theta) * phiPart(phi)
+            double phiPart = 1.0;
+            double phiPartDerivative = 0.0;
+            if (m > 0)
+            {
+                phiPart = M_SQRT2 * sinMPhi[absM];
+                phiPartDerivative = M_SQRT2 * absM * cosMPhi[absM];
+            }
+            else if (m < 0)
+            {
+                double sign = (absM % 2 != 0) ? -1.0 : 1.0;
+                phiPart = sign * M_SQRT2 * cosMPhi[absM];
+                phiPartDerivative = - sign * M_SQRT2 * absM * sinMPhi[absM];
+            }
+
+            double thetaPart = legendreValues[legendreIndex];
+
+            if (values)
+                values[index] = thetaPart * phiPart;
+            if (thetaDerivatives)
+                thetaDerivatives[index] = legendreFirstDerivatives[legendreIndex] * phiPart;
+            if (phiDerivatives)
+                phiDerivatives[index] = thetaPart * phiPartDerivative;
+            if (thetaSecondDerivatives)
+                thetaSecondDerivatives[index] = legendreSecondDerivatives[legendreIndex] * phiPart;
+            if (thetaPhiDerivatives)
+                thetaPhiDerivatives[index] = legendreFirstDerivatives[legendreIndex] * phiPartDerivative;
+            if (phiSecondDerivatives)
+                phiSecondDerivatives[index] = - (double)(absM * absM) * thetaPart * phiPart;
+        }
+    }
+}
+
+void RealSphericalHarmonicsEvaluator::ComputeSymmetricBasisMatrix(const std::vector < std::vector <double> > &directions,
+                                                                  vnl_matrix <double> &basisMatrix) const
+{
+    basisMatrix.set_size(directions.size(),this->GetNumberOfSymmetricCoefficients());
+
+    for (unsigned int i = 0;i < directions.size();++i)
+        this->EvaluateSymmetricBasis(directions[i][0],directions[i][1],basisMatrix[i]);
+}
+
+} // end namespace anima
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include <vnl/vnl_matrix.h>
+#include "AnimaSHToolsExport.h"
+
+namespace anima
+{
+
+/**
+ * Evaluation of all spherical harmonics up to a maximal order at once, using the three-term recurrence of normalized
+ * associated Legendre functions and the Chebyshev recurrence for cos(m phi) and sin(m phi). Derivatives with respect
+ * to theta are obtained from ladder relations, hence are also well defined at the poles.
+ * Evaluation methods are const and only use the buffers they are given, one evaluator may be shared by several threads.
+ */
+class ANIMASHTOOLS_EXPORT RealSphericalHarmonicsEvaluator
+{
+public:
+    RealSphericalHarmonicsEvaluator(unsigned int lMax);
+    virtual ~RealSphericalHarmonicsEvaluator() {}
+
+    unsigned int GetMaximalOrder() const {return m_LMax;}
+
+    //! Index of (l,m), 0 <= m <= l, in associated Legendre tables
+    static unsigned int GetLegendreIndex(unsigned int l, unsigned int m) {return l * (l + 1) / 2 + m;}
+    unsigned int GetNumberOfLegendreValues() const {return (m_LMax + 1) * (m_LMax + 2) / 2;}
+
+    /**
+     * Normalized associated Legendre functions sqrt((2l+1)/(4 pi) (l-m)!/(l+m)!) P_l^m(cos(theta)), Condon-Shortley
+     * phase included, for all 0 <= m <= l <= lMax. First and second derivatives with respect to theta are computed
+     * if non null (second derivatives require first ones). All tables have GetNumberOfLegendreValues() elements.
+     */
+    void ComputeNormalizedLegendre(double theta, double *values, double *thetaDerivatives = 0,
+                                   double *thetaSecondDerivatives = 0) const;
+
+    //! Number of coefficients of the symmetric real basis (even orders up to lMax) used for ODFs
+    unsigned int GetNumberOfSymmetricCoefficients() const {return (m_LMax / 2 + 1) * (m_LMax + 1);}
+
+    /**
+     * Symmetric real SH basis (Descoteaux et al. MRM 2007) at (theta,phi): basis function (l,m), l even, is stored at
+     * l(l+1)/2 + m and equals sqrt(2) Y_l^m imaginary part if m > 0, sqrt(2) Y_l^m real part if m < 0, Y_l^0 if m = 0.
+     * Tables have GetNumberOfSymmetricCoefficients() elements.
+     */
+    void EvaluateSymmetricBasis(double theta, double phi, double *values) const;
+
+    /**
+     * Same as EvaluateSymmetricBasis with derivatives, each computed only if its table is non null. Legendre work
+     * tables are resized as needed so that they can be reused from one call to the next.
+     */
+    void EvaluateSymmetricBasisWithDerivatives(double theta, double phi, std::vector <double> &legendreWorkTables,
+                                               double *values, double *thetaDerivatives, double *phiDerivatives,
+                                               double *thetaSecondDerivatives, double *thetaPhiDerivatives,
+                                               double *phiSecondDerivatives) const;
+
+    /**
+     * Symmetric basis sampled on a fixed set of directions given in spherical coordinates (theta,phi), one row per
+     * direction. Computed once, it turns sampling an SH function on those directions into a matrix-vector product.
+     */
+    void ComputeSymmetricBasisMatrix(const std::vector < std::vector <double> > &directions,
+                                     vnl_matrix <double> &basisMatrix) const;
+
+private:
+    unsigned int m_LMax;
+
+    //! Recurrence coefficients, indexed as Legendre tables
+    std::vector <double> m_RecurrenceFactors, m_PreviousRecurrenceFactors;
+
+    //! Ladder coefficients sqrt((l+m)(l-m+1)) and sqrt((l-m)(l+m+1)), indexed as Legendre tables
+    std::vector <double> m_LowerLadderFactors, m_UpperLadderFactors;
+};
+
+} // end namespace anima
@@ -2,60 +2,68 @@
 
 #include "animaSphericalHarmonic.h"
 
-#include <boost/math/special_functions/legendre.hpp>
-#include <animaLegendreDerivatives.h>
-
 namespace anima
 {
 
 SphericalHarmonic::SphericalHarmonic()
+    : m_Evaluator(0)
 {
     m_L = 0;
     m_M = 0;
 }
 
 SphericalHarmonic::SphericalHarmonic(int &l, int &m)
+    : m_Evaluator(l)
 {
     m_L = l;
     m_M = m;
 }
 
+void SphericalHarmonic::SetL(int &l)
+{
+    if (l == m_L)
+        return;
+
+    m_L = l;
+    m_Evaluator = anima::RealSphericalHarmonicsEvaluator(m_L);
+}
+
+double SphericalHarmonic::ComputeThetaPart(const double &theta, unsigned int derivativeOrder)
+{
+    // Normalized associated Legendre function of order (l,|m|) or its derivatives, from recurrences
+    unsigned int numValues = m_Evaluator.GetNumberOfLegendreValues();
+    m_LegendreTables.resize(3 * numValues);
+    m_Evaluator.ComputeNormalizedLegendre(theta,&m_LegendreTables[0],(derivativeOrder > 0) ? &m_LegendreTables[numValues] : 0,
+                                          (derivativeOrder > 1) ? &m_LegendreTables[2 * numValues] : 0);
+
+    int absm = std::abs(m_M);
+    double resVal = m_LegendreTables[derivativeOrder * numValues + anima::RealSphericalHarmonicsEvaluator::GetLegendreIndex(m_L,absm)];
+
+    if ((absm % 2 != 0)&&(m_M < 0))
+        resVal *= -1;
+
+    return resVal;
+}
+
 std::complex <double> SphericalHarmonic::Value(const double &theta, const double &phi)
 {
-    int absm = abs(m_M);
+    int absm = std::abs(m_M);
     std::complex <double> resVal(0, absm * phi);
-    resVal = std::exp(resVal);
-
-    double sqrtFactor = sqrt((2*m_L + 1) * std::tgamma(m_L - absm + 1) / (4 * M_PI * std::tgamma(m_L + absm + 1)));
-    resVal *= sqrtFactor * boost::math::legendre_p(m_L,absm,cos(theta));
+    resVal = std::exp(resVal) * this->ComputeThetaPart(theta,0);
 
     if (m_M < 0)
-    {
         resVal = std::conj(resVal);
 
-        if (absm % 2 != 0)
-            resVal *= -1;
-    }
-
     return resVal;
 }
 
 std::complex <double> SphericalHarmonic::getThetaFirstDerivative(const double& theta, const double& phi)
 {
-    if ((m_M == 0)||(m_L < 1))
-        return std::complex<double> (0.0,0.0);
-
     int absm = std::abs(m_M);
     std::complex<double> retval(0.0,(double)(absm*phi));
     retval = std::exp(retval);
 
-    double factor = sqrt(((double)(2*m_L+1) / (4.0*M_PI)) * (std::tgamma(m_L - absm + 1) / std::tgamma(m_L + absm + 1)));
-    if ((absm%2 != 0)&&(m_M < 0))
-        factor *= -1;
-
-    factor *= - sin(theta) * anima::legendre_first_derivative(m_L,absm,cos(theta));
-
-    return factor * retval;
+    return this->ComputeThetaPart(theta,1) * retval;
 }
 
 std::complex <double> SphericalHarmonic::getPhiFirstDerivative(const double& theta, const double& phi)
@@ -65,32 +73,16 @@ std::complex <double> SphericalHarmonic::getPhiFirstDerivative(const double& the
     retval = std::exp(retval);
     retval *= std::complex<double> (0.0,absm);
 
-    double factor = std::sqrt(((double)(2*m_L+1) / (4.0*M_PI)) * (std::tgamma(m_L - absm + 1) / std::tgamma(m_L + absm + 1))) *
-            boost::math::legendre_p (m_L,absm,cos(theta));
-
-    if ((absm%2 != 0)&&(m_M < 0))
-        factor *= -1;
-
-    return factor * retval;
+    return this->ComputeThetaPart(theta,0) * retval;
 }
 
 std::complex <double> SphericalHarmonic::getThetaSecondDerivative(const double& theta, const double& phi)
 {
-    if ((m_M == 0)||(m_L < 2))
-        return std::complex<double> (0.0,0.0);
-
     int absm = std::abs(m_M);
     std::complex<double> retval(0.0,(double)(absm*phi));
     retval = std::exp(retval);
 
-    double factor = std::sqrt(((double)(2*m_L+1) / (4.0*M_PI)) * (std::tgamma(m_L - absm + 1) / std::tgamma(m_L + absm + 1)));
-    if ((absm%2 != 0)&&(m_M < 0))
-        factor *= -1;
-
-    factor *= sin(theta) * sin(theta) * anima::legendre_second_derivative(m_L,absm,cos(theta)) -
-    cos(theta) * anima::legendre_first_derivative(m_L,absm,cos(theta));
-
-    return factor * retval;
+    return this->ComputeThetaPart(theta,2) * retval;
 }
 
 std::complex <double> SphericalHarmonic::getPhiSecondDerivative(const double& theta, const double& phi)
@@ -102,21 +94,12 @@ std::complex <double> SphericalHarmonic::getPhiSecondDerivative(const double& th
 
 std::complex <double> SphericalHarmonic::getThetaPhiDerivative(const double& theta, const double& phi)
 {
-    if ((m_M == 0)||(m_L < 1))
-        return std::complex<double> (0.0,0.0);
-
     int absm = std::abs(m_M);
     std::complex<double> retval(0.0,(double)(absm*phi));
     retval = std::exp(retval);
     retval *= std::complex<double> (0.0,absm);
 
-    double factor = sqrt(((double)(2*m_L+1) / (4.0*M_PI)) * (std::tgamma(m_L - absm + 1) / std::tgamma(m_L + absm + 1)));
-    if ((absm%2 != 0)&&(m_M < 0))
-        factor *= -1;
-
-    factor *= sin(theta) * anima::legendre_first_derivative(m_L,absm,cos(theta));
-
-    return factor * retval;
+    return this->ComputeThetaPart(theta,1) * retval;
 }
 
 } // end of namespace anima
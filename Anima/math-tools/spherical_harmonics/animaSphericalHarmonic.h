@@ -1,6 +1,8 @@
 #pragma once
 
 #include <complex>
+#include <vector>
+#include <animaRealSphericalHarmonicsEvaluator.h>
 #include "AnimaSHToolsExport.h"
 
 namespace anima
@@ -12,7 +14,7 @@ public:
     SphericalHarmonic();
     SphericalHarmonic(int &l, int &m);
 
-    void SetL(int &l) {m_L = l;}
+    void SetL(int &l);
     void SetM(int &m) {m_M = m;}
 
     std::complex <double> Value(const double &theta, const double &phi);
@@ -26,8 +28,15 @@ public:
     std::complex <double> getThetaPhiDerivative(const double& theta, const double& phi);
 
 private:
+    //! Theta dependent part of Y_l^m (before conjugation for negative m) or its derivatives with respect to theta
+    double ComputeThetaPart(const double &theta, unsigned int derivativeOrder);
+
     int m_L;
     int m_M;
+
+    //! Recurrence tables for order m_L, rebuilt only when the order changes, and Legendre tables reused across calls
+    anima::RealSphericalHarmonicsEvaluator m_Evaluator;
+    std::vector <double> m_LegendreTables;
 };
 
 } // end of namespace anima
@@ -7,48 +7,78 @@
 #include <itkPoint.h>
 #include <itkVector.h>
 
+#include <animaWatsonDistribution.h>
+
+#include <vector>
+
 namespace anima
 {
 
-template <class T>
-double SampleFromUniformDistribution(const T &a, const T &b, std::mt19937 &generator);
+template <class T, class RandomGeneratorType>
+double SampleFromUniformDistribution(const T &a, const T &b, RandomGeneratorType &generator);
 
-template <class VectorType>
-void SampleFromUniformDistributionOn2Sphere(std::mt19937 &generator, VectorType &resVec);
+template <class VectorType, class RandomGeneratorType>
+void SampleFromUniformDistributionOn2Sphere(RandomGeneratorType &generator, VectorType &resVec);
 
-template <class T>
-unsigned int SampleFromBernoulliDistribution(const T &p, std::mt19937 &generator);
+template <class T, class RandomGeneratorType>
+unsigned int SampleFromBernoulliDistribution(const T &p, RandomGeneratorType &generator);
 
-template <class T>
-double SampleFromGaussianDistribution(const T &mean, const T &std, std::mt19937 &generator);
+template <class T, class RandomGeneratorType>
+double SampleFromGaussianDistribution(const T &mean, const T &std, RandomGeneratorType &generator);
 
-template <class VectorType, class ScalarType>
+template <class VectorType, class ScalarType, class RandomGeneratorType>
 void SampleFromMultivariateGaussianDistribution(const VectorType &mean, const vnl_matrix <ScalarType> &mat, VectorType &resVec,
-                                                std::mt19937 &generator, bool isMatCovariance = true);
+                                                RandomGeneratorType &generator, bool isMatCovariance = true);
 
 // From Ulrich 1984
-template <class VectorType, class ScalarType>
-void SampleFromVMFDistribution(const ScalarType &kappa, const VectorType &meanDirection, VectorType &resVec, std::mt19937 &generator);
+template <class VectorType, class ScalarType, class RandomGeneratorType>
+void SampleFromVMFDistribution(const ScalarType &kappa, const VectorType &meanDirection, VectorType &resVec, RandomGeneratorType &generator);
 
 // From Wenzel 2012
-template <class VectorType, class ScalarType>
-void SampleFromVMFDistributionNumericallyStable(const ScalarType &kappa, const VectorType &meanDirection, VectorType &resVec, std::mt19937 &generator);
+template <class VectorType, class ScalarType, class RandomGeneratorType>
+void SampleFromVMFDistributionNumericallyStable(const ScalarType &kappa, const VectorType &meanDirection, VectorType &resVec, RandomGeneratorType &generator);
 
-template <class ScalarType, class VectorType>
+template <class ScalarType, class VectorType, class RandomGeneratorType>
 void
-SampleFromWatsonDistribution(const ScalarType &kappa, const VectorType &meanDirection, VectorType &resVec, unsigned int DataDimension, std::mt19937 &generator);
+SampleFromWatsonDistribution(const ScalarType &kappa, const VectorType &meanDirection, VectorType &resVec, unsigned int DataDimension, RandomGeneratorType &generator);
 
-template <class ScalarType, unsigned int DataDimension>
+template <class ScalarType, unsigned int DataDimension, class RandomGeneratorType>
 void
-SampleFromWatsonDistribution(const ScalarType &kappa, const vnl_vector_fixed < ScalarType, DataDimension > &meanDirection, vnl_vector_fixed < ScalarType, DataDimension > &resVec, std::mt19937 &generator);
+SampleFromWatsonDistribution(const ScalarType &kappa, const vnl_vector_fixed < ScalarType, DataDimension > &meanDirection, vnl_vector_fixed < ScalarType, DataDimension > &resVec, RandomGeneratorType &generator);
 
-template <class ScalarType, unsigned int DataDimension>
+template <class ScalarType, unsigned int DataDimension, class RandomGeneratorType>
 void
-SampleFromWatsonDistribution(const ScalarType &kappa, const itk::Point < ScalarType, DataDimension > &meanDirection, itk::Point < ScalarType, DataDimension > &resVec, std::mt19937 &generator);
+SampleFromWatsonDistribution(const ScalarType &kappa, const itk::Point < ScalarType, DataDimension > &meanDirection, itk::Point < ScalarType, DataDimension > &resVec, RandomGeneratorType &generator);
 
-template <class ScalarType, unsigned int DataDimension>
+template <class ScalarType, unsigned int DataDimension, class RandomGeneratorType>
 void
-SampleFromWatsonDistribution(const ScalarType &kappa, const itk::Vector < ScalarType, DataDimension > &meanDirection, itk::Vector < ScalarType, DataDimension > &resVec, std::mt19937 &generator);
+SampleFromWatsonDistribution(const ScalarType &kappa, const itk::Vector < ScalarType, DataDimension > &meanDirection, itk::Vector < ScalarType, DataDimension > &resVec, RandomGeneratorType &generator);
+
+//! Axial coordinate (cosine to the mean axis) of a Watson sample on the 2-sphere, Fisher et al. 1993 p.59
+template <class ScalarType, class RandomGeneratorType>
+double SampleWatsonAxialCoordinate(const ScalarType &kappa, RandomGeneratorType &generator);
+
+/**
+ * Maps samples given around [0,0,1] by their axial coordinate and azimuth to the frames of meanDirections (of norm 1).
+ * Frames are built without trigonometry (Duff et al. 2017), valid for distributions symmetric around their mean axis
+ */
+template <class VectorType>
+void MapSamplesToMeanDirections(const std::vector <double> &axialCoordinates, const std::vector <double> &azimuths,
+                                const std::vector <VectorType> &meanDirections, std::vector <VectorType> &resVecs);
+
+/**
+ * Batched Watson sampling on the 2-sphere: resVecs[i] is drawn around meanDirections[i] with concentration kappas[i]
+ * and logPdfs[i] is its log-density. Normalizers come from the cache, rotations are done once for the whole batch
+ */
+template <class VectorType, class ScalarType, class RandomGeneratorType>
+void SampleFromWatsonDistributions(const std::vector <ScalarType> &kappas, const std::vector <VectorType> &meanDirections,
+                                   std::vector <VectorType> &resVecs, std::vector <double> &logPdfs,
+                                   anima::WatsonLogNormalizerCache &normalizerCache, RandomGeneratorType &generator);
+
+//! Batched von Mises & Fisher sampling on the 2-sphere (Wenzel 2012, no rejection), same conventions as SampleFromWatsonDistributions
+template <class VectorType, class ScalarType, class RandomGeneratorType>
+void SampleFromVMFDistributions(const std::vector <ScalarType> &kappas, const std::vector <VectorType> &meanDirections,
+                                std::vector <VectorType> &resVecs, std::vector <double> &logPdfs, RandomGeneratorType &generator);
 
 } // end of namespace anima
 
@@ -2,6 +2,7 @@
 #include "animaDistributionSampling.h"
 
 #include <cmath>
+#include <algorithm>
 #include <boost/math/distributions/beta.hpp>
 
 #include <animaVectorOperations.h>
@@ -14,16 +15,16 @@
 namespace anima
 {
 
-template <class T>
-double SampleFromUniformDistribution(const T &a, const T &b, std::mt19937 &generator)
+template <class T, class RandomGeneratorType>
+double SampleFromUniformDistribution(const T &a, const T &b, RandomGeneratorType &generator)
 {
     // Define distribution U[a,b) [double values]
     std::uniform_real_distribution<T> uniDbl(a,b);
     return uniDbl(generator);
 }
 
-template <class VectorType>
-void SampleFromUniformDistributionOn2Sphere(std::mt19937 &generator, VectorType &resVec)
+template <class VectorType, class RandomGeneratorType>
+void SampleFromUniformDistributionOn2Sphere(RandomGeneratorType &generator, VectorType &resVec)
 {
     std::uniform_real_distribution<double> uniDbl(-1.0,1.0);
     double sqSum = 2;
@@ -41,23 +42,23 @@ void SampleFromUniformDistributionOn2Sphere(std::mt19937 &generator, VectorType
     resVec[2] = 2.0 * sqSum - 1.0;
 }
 
-template <class T>
-unsigned int SampleFromBernoulliDistribution(const T &p, std::mt19937 &generator)
+template <class T, class RandomGeneratorType>
+unsigned int SampleFromBernoulliDistribution(const T &p, RandomGeneratorType &generator)
 {
     std::bernoulli_distribution bernoulli(p);
     return bernoulli(generator);
 }
 
-template <class T>
-double SampleFromGaussianDistribution(const T &mean, const T &std, std::mt19937 &generator)
+template <class T, class RandomGeneratorType>
+double SampleFromGaussianDistribution(const T &mean, const T &std, RandomGeneratorType &generator)
 {
     std::normal_distribution<T> normalDist(mean,std);
     return normalDist(generator);
 }
 
-template <class VectorType, class ScalarType>
+template <class VectorType, class ScalarType, class RandomGeneratorType>
 void SampleFromMultivariateGaussianDistribution(const VectorType &mean, const vnl_matrix <ScalarType> &mat, VectorType &resVec,
-                                                std::mt19937 &generator, bool isMatCovariance)
+                                                RandomGeneratorType &generator, bool isMatCovariance)
 {
     unsigned int vectorSize = mat.rows();
 
@@ -89,8 +90,8 @@ void SampleFromMultivariateGaussianDistribution(const VectorType &mean, const vn
     }
 }
 
-template <class VectorType, class ScalarType>
-void SampleFromVMFDistribution(const ScalarType &kappa, const VectorType &meanDirection, VectorType &resVec, std::mt19937 &generator)
+template <class VectorType, class ScalarType, class RandomGeneratorType>
+void SampleFromVMFDistribution(const ScalarType &kappa, const VectorType &meanDirection, VectorType &resVec, RandomGeneratorType &generator)
 {
     VectorType tmpVec;
 
@@ -139,8 +140,8 @@ void SampleFromVMFDistribution(const ScalarType &kappa, const VectorType &meanDi
             resVec[i] += rotationMatrix(i,j) * tmpVec[j];
 }
 
-template <class VectorType, class ScalarType>
-void SampleFromVMFDistributionNumericallyStable(const ScalarType &kappa, const VectorType &meanDirection, VectorType &resVec, std::mt19937 &generator)
+template <class VectorType, class ScalarType, class RandomGeneratorType>
+void SampleFromVMFDistributionNumericallyStable(const ScalarType &kappa, const VectorType &meanDirection, VectorType &resVec, RandomGeneratorType &generator)
 {
     VectorType tmpVec;
 
@@ -172,18 +173,69 @@ void SampleFromVMFDistributionNumericallyStable(const ScalarType &kappa, const V
             resVec[i] += rotationMatrix(i,j) * tmpVec[j];
 }
 
-template <class ScalarType, class VectorType>
+template <class ScalarType, class RandomGeneratorType>
+double SampleWatsonAxialCoordinate(const ScalarType &kappa, RandomGeneratorType &generator)
+{
+    double U, V, S;
+    if (kappa > 1.0e-6) // Bipolar distribution
+    {
+        U = SampleFromUniformDistribution(0.0, 1.0, generator);
+        S = 1.0 + std::log(U + (1.0 - U) * std::exp(-kappa)) / kappa;
+
+        V = SampleFromUniformDistribution(0.0, 1.0, generator);
+
+        if (V > 1.0e-6)
+        {
+            while (std::log(V) > kappa * S * (S - 1.0))
+            {
+                U = SampleFromUniformDistribution(0.0, 1.0, generator);
+                S = 1.0 + std::log(U + (1.0 - U) * std::exp(-kappa)) / kappa;
+
+                V = SampleFromUniformDistribution(0.0, 1.0, generator);
+
+                if (V < 1.0e-6)
+                    break;
+            }
+        }
+    }
+    else if (kappa < -1.0e-6) // Gridle distribution
+    {
+        double C1 = std::sqrt(std::abs(kappa));
+        double C2 = std::atan(C1);
+        U = SampleFromUniformDistribution(0.0, 1.0, generator);
+        V = SampleFromUniformDistribution(0.0, 1.0, generator);
+        S = (1.0 / C1) * std::tan(C2 * U);
+
+        double T = kappa * S * S;
+        while (V > (1.0 - T) * std::exp(T))
+        {
+            U = SampleFromUniformDistribution(0.0, 1.0, generator);
+            V = SampleFromUniformDistribution(0.0, 1.0, generator);
+            S = (1.0 / C1) * std::tan(C2 * U);
+            T = kappa * S * S;
+        }
+    }
+    else
+    {
+        // Sampling uniformly on the sphere: the axial coordinate is uniform on [-1,1] (Archimedes), not its angle
+        S = SampleFromUniformDistribution(-1.0, 1.0, generator);
+    }
+
+    return S;
+}
+
+template <class ScalarType, class VectorType, class RandomGeneratorType>
 void
-SampleFromWatsonDistribution(const ScalarType &kappa, const VectorType &meanDirection, VectorType &resVec, unsigned int DataDimension, std::mt19937 &generator)
+SampleFromWatsonDistribution(const ScalarType &kappa, const VectorType &meanDirection, VectorType &resVec, unsigned int DataDimension, RandomGeneratorType &generator)
 {
     /**********************************************************************************************//**
-         * \fn template <class ScalarType, class VectorType>
+         * \fn template <class ScalarType, class VectorType, class RandomGeneratorType>
          * 	   void
          *     SampleFromWatsonDistribution(const ScalarType &kappa,
          * 					const VectorType &meanDirection,
          * 					VectorType &resVec,
          * 					unsigned int DataDimension,
-         * 					std::mt19937 &generator)
+         * 					RandomGeneratorType &generator)
          *
          * \brief	Sample from the Watson distribution using the procedure described in
          * 			Fisher et al., Statistical Analysis of Spherical Data, 1993, p.59.
@@ -221,51 +273,7 @@ SampleFromWatsonDistribution(const ScalarType &kappa, const VectorType &meanDire
     if (std::abs(tmpVec[2] - 1.0) > 1.0e-6)
         throw itk::ExceptionObject(__FILE__, __LINE__,"The Watson distribution is on the 2-sphere.",ITK_LOCATION);
 
-    double U, V, S;
-    if (kappa > 1.0e-6) // Bipolar distribution
-    {
-        U = SampleFromUniformDistribution(0.0, 1.0, generator);
-        S = 1.0 + std::log(U + (1.0 - U) * std::exp(-kappa)) / kappa;
-
-        V = SampleFromUniformDistribution(0.0, 1.0, generator);
-
-        if (V > 1.0e-6)
-        {
-            while (std::log(V) > kappa * S * (S - 1.0))
-            {
-                U = SampleFromUniformDistribution(0.0, 1.0, generator);
-                S = 1.0 + std::log(U + (1.0 - U) * std::exp(-kappa)) / kappa;
-
-                V = SampleFromUniformDistribution(0.0, 1.0, generator);
-
-                if (V < 1.0e-6)
-                    break;
-            }
-        }
-    }
-    else if (kappa < -1.0e-6) // Gridle distribution
-    {
-        double C1 = std::sqrt(std::abs(kappa));
-        double C2 = std::atan(C1);
-        U = SampleFromUniformDistribution(0.0, 1.0, generator);
-        V = SampleFromUniformDistribution(0.0, 1.0, generator);
-        S = (1.0 / C1) * std::tan(C2 * U);
-
-        double T = kappa * S * S;
-        while (V > (1.0 - T) * std::exp(T))
-        {
-            U = SampleFromUniformDistribution(0.0, 1.0, generator);
-            V = SampleFromUniformDistribution(0.0, 1.0, generator);
-            S = (1.0 / C1) * std::tan(C2 * U);
-            T = kappa * S * S;
-        }
-    }
-    else
-    {
-        // Sampling uniformly on the sphere
-        S = std::cos(SampleFromUniformDistribution(0.0, M_PI, generator));
-    }
-
+    double S = SampleWatsonAxialCoordinate(kappa, generator);
     double phi = SampleFromUniformDistribution(0.0, 2.0 * M_PI, generator);
 
     tmpVec[0] = std::sqrt(1.0 - S*S) * std::cos(phi);
@@ -287,17 +295,17 @@ SampleFromWatsonDistribution(const ScalarType &kappa, const VectorType &meanDire
     anima::Normalize(resVec,resVec);
 }
 
-template <class ScalarType, unsigned int DataDimension>
+template <class ScalarType, unsigned int DataDimension, class RandomGeneratorType>
 void
-SampleFromWatsonDistribution(const ScalarType &kappa, const vnl_vector_fixed < ScalarType, DataDimension > &meanDirection, vnl_vector_fixed < ScalarType, DataDimension > &resVec, std::mt19937 &generator)
+SampleFromWatsonDistribution(const ScalarType &kappa, const vnl_vector_fixed < ScalarType, DataDimension > &meanDirection, vnl_vector_fixed < ScalarType, DataDimension > &resVec, RandomGeneratorType &generator)
 {
     /**********************************************************************************************//**
-         * \fn template <class ScalarType, unsigned int DataDimension>
+         * \fn template <class ScalarType, unsigned int DataDimension, class RandomGeneratorType>
          * 	   void
          *     SampleFromWatsonDistribution(const ScalarType &kappa,
          * 					const vnl_vector_fixed < ScalarType, DataDimension > &meanDirection,
          * 					vnl_vector_fixed < ScalarType, DataDimension > &resVec,
-         * 					std::mt19937 &generator)
+         * 					RandomGeneratorType &generator)
          *
          * \brief	Sample from the Watson distribution using the procedure described in
          * 			Fisher et al., Statistical Analysis of Spherical Data, 1993, p.59.
@@ -315,17 +323,17 @@ SampleFromWatsonDistribution(const ScalarType &kappa, const vnl_vector_fixed < S
     SampleFromWatsonDistribution(kappa, meanDirection, resVec, DataDimension, generator);
 }
 
-template <class ScalarType, unsigned int DataDimension>
+template <class ScalarType, unsigned int DataDimension, class RandomGeneratorType>
 void
-SampleFromWatsonDistribution(const ScalarType &kappa, const itk::Point < ScalarType, DataDimension > &meanDirection, itk::Point < ScalarType, DataDimension > &resVec, std::mt19937 &generator)
+SampleFromWatsonDistribution(const ScalarType &kappa, const itk::Point < ScalarType, DataDimension > &meanDirection, itk::Point < ScalarType, DataDimension > &resVec, RandomGeneratorType &generator)
 {
     /**********************************************************************************************//**
-         * \fn template <class ScalarType, unsigned int DataDimension>
+         * \fn template <class ScalarType, unsigned int DataDimension, class RandomGeneratorType>
          * 	   void
          *     SampleFromWatsonDistribution(const ScalarType &kappa,
          * 					const itk::Point < ScalarType, DataDimension > &meanDirection,
          * 					itk::Point < ScalarType, DataDimension > &resVec,
-         * 					std::mt19937 &generator)
+         * 					RandomGeneratorType &generator)
          *
          * \brief	Sample from the Watson distribution using the procedure described in
          * 			Fisher et al., Statistical Analysis of Spherical Data, 1993, p.59.
@@ -343,17 +351,17 @@ SampleFromWatsonDistribution(const ScalarType &kappa, const itk::Point < ScalarT
     SampleFromWatsonDistribution(kappa, meanDirection, resVec, DataDimension, generator);
 }
 
-template <class ScalarType, unsigned int DataDimension>
+template <class ScalarType, unsigned int DataDimension, class RandomGeneratorType>
 void
-SampleFromWatsonDistribution(const ScalarType &kappa, const itk::Vector < ScalarType, DataDimension > &meanDirection, itk::Vector < ScalarType, DataDimension > &resVec, std::mt19937 &generator)
+SampleFromWatsonDistribution(const ScalarType &kappa, const itk::Vector < ScalarType, DataDimension > &meanDirection, itk::Vector < ScalarType, DataDimension > &resVec, RandomGeneratorType &generator)
 {
     /**********************************************************************************************//**
-         * \fn template <class ScalarType, unsigned int DataDimension>
+         * \fn template <class ScalarType, unsigned int DataDimension, class RandomGeneratorType>
          * 	   void
          *     SampleFromWatsonDistribution(const ScalarType &kappa,
          * 					const itk::Vector < ScalarType, DataDimension > &meanDirection,
          * 					itk::Vector < ScalarType, DataDimension > &resVec,
-         * 					std::mt19937 &generator)
+         * 					RandomGeneratorType &generator)
          *
          * \brief	Sample from the Watson distribution using the procedure described in
          * 			Fisher et al., Statistical Analysis of Spherical Data, 1993, p.59.
@@ -371,4 +379,97 @@ SampleFromWatsonDistribution(const ScalarType &kappa, const itk::Vector < Scalar
     SampleFromWatsonDistribution(kappa, meanDirection, resVec, DataDimension, generator);
 }
 
+template <class VectorType>
+void MapSamplesToMeanDirections(const std::vector <double> &axialCoordinates, const std::vector <double> &azimuths,
+                                const std::vector <VectorType> &meanDirections, std::vector <VectorType> &resVecs)
+{
+    unsigned int numSamples = meanDirections.size();
+    resVecs.resize(numSamples);
+
+    for (unsigned int i = 0;i < numSamples;++i)
+    {
+        double S = axialCoordinates[i];
+        double radius = std::sqrt(std::max(0.0, 1.0 - S * S));
+        double x = radius * std::cos(azimuths[i]);
+        double y = radius * std::sin(azimuths[i]);
+
+        double nx = meanDirections[i][0];
+        double ny = meanDirections[i][1];
+        double nz = meanDirections[i][2];
+
+        // Branchless orthonormal basis completing the mean direction
+        double sign = std::copysign(1.0, nz);
+        double a = -1.0 / (sign + nz);
+        double b = nx * ny * a;
+
+        resVecs[i][0] = x * (1.0 + sign * nx * nx * a) + y * b + S * nx;
+        resVecs[i][1] = x * sign * b + y * (sign + ny * ny * a) + S * ny;
+        resVecs[i][2] = - x * sign * nx - y * ny + S * nz;
+    }
+}
+
+template <class VectorType, class ScalarType, class RandomGeneratorType>
+void SampleFromWatsonDistributions(const std::vector <ScalarType> &kappas, const std::vector <VectorType> &meanDirections,
+                                   std::vector <VectorType> &resVecs, std::vector <double> &logPdfs,
+                                   anima::WatsonLogNormalizerCache &normalizerCache, RandomGeneratorType &generator)
+{
+    unsigned int numSamples = meanDirections.size();
+    std::vector <double> axialCoordinates(numSamples), azimuths(numSamples);
+    logPdfs.resize(numSamples);
+
+    // Rejection loops are inherently sequential, only draws are done here
+    for (unsigned int i = 0;i < numSamples;++i)
+    {
+        double squaredNorm = 0;
+        for (unsigned int j = 0;j < 3;++j)
+            squaredNorm += meanDirections[i][j] * meanDirections[i][j];
+
+        if (std::abs(squaredNorm - 1.0) > 1.0e-6)
+            throw itk::ExceptionObject(__FILE__, __LINE__,"The Watson distribution is on the 2-sphere.",ITK_LOCATION);
+
+        axialCoordinates[i] = SampleWatsonAxialCoordinate(kappas[i], generator);
+        azimuths[i] = SampleFromUniformDistribution(0.0, 2.0 * M_PI, generator);
+        logPdfs[i] = anima::EvaluateWatsonLogPDFFromCosine(axialCoordinates[i], kappas[i], normalizerCache.GetLogNormalizer(kappas[i]));
+    }
+
+    anima::MapSamplesToMeanDirections(axialCoordinates, azimuths, meanDirections, resVecs);
+}
+
+template <class VectorType, class ScalarType, class RandomGeneratorType>
+void SampleFromVMFDistributions(const std::vector <ScalarType> &kappas, const std::vector <VectorType> &meanDirections,
+                                std::vector <VectorType> &resVecs, std::vector <double> &logPdfs, RandomGeneratorType &generator)
+{
+    unsigned int numSamples = meanDirections.size();
+    std::vector <double> axialCoordinates(numSamples), azimuths(numSamples);
+    logPdfs.resize(numSamples);
+
+    for (unsigned int i = 0;i < numSamples;++i)
+    {
+        double squaredNorm = 0;
+        for (unsigned int j = 0;j < 3;++j)
+            squaredNorm += meanDirections[i][j] * meanDirections[i][j];
+
+        if (std::abs(squaredNorm - 1.0) > 1.0e-6)
+            throw itk::ExceptionObject(__FILE__, __LINE__,"Von Mises & Fisher sampling requires mean direction of norm 1.",ITK_LOCATION);
+
+        double kappa = kappas[i];
+        double xi = SampleFromUniformDistribution(0.0, 1.0, generator);
+        azimuths[i] = SampleFromUniformDistribution(0.0, 2.0 * M_PI, generator);
+
+        // Same density expressions as ComputeVMFPdf
+        if (kappa < 1.0e-4)
+        {
+            axialCoordinates[i] = 2.0 * xi - 1.0;
+            logPdfs[i] = kappa * axialCoordinates[i] - std::log(4.0 * M_PI);
+        }
+        else
+        {
+            axialCoordinates[i] = 1.0 + std::log(xi + (1.0 - xi) * std::exp(-2.0 * kappa)) / kappa;
+            logPdfs[i] = std::log(kappa / (2.0 * M_PI * (1.0 - std::exp(-2.0 * kappa)))) + kappa * (axialCoordinates[i] - 1.0);
+        }
+    }
+
+    anima::MapSamplesToMeanDirections(axialCoordinates, azimuths, meanDirections, resVecs);
+}
+
 } // end of namespace anima
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <itkIntTypes.h>
+
+namespace anima
+{
+
+/**
+ * @brief Counter-based random number generator (Philox4x32-10, Salmon et al., SC 2011). Each output block is a
+ * bijection of a 128 bits counter under a 64 bits key: a (key, stream) pair fully determines a random sequence,
+ * without any state shared between streams. Keying streams by work item (e.g. tractography seed index) thus gives
+ * the same draws whatever thread or process handles the item. Satisfies the C++11 UniformRandomBitGenerator
+ * requirements, so it can be used with std distributions and anima sampling functions.
+ */
+class PhiloxRandomGenerator
+{
+public:
+    typedef itk::uint32_t result_type;
+
+    static constexpr result_type min() {return 0;}
+    static constexpr result_type max() {return 0xffffffff;}
+
+    PhiloxRandomGenerator(itk::uint64_t key = 0, itk::uint64_t stream = 0, itk::uint32_t substream = 0)
+    {
+        this->SetStream(key,stream,substream);
+    }
+
+    /**
+     * Restarts the generator at the beginning of the sequence identified by key, stream and substream indexes.
+     * Substreams split a stream (e.g. a seed) into independent sequences of 2^34 values for parallel sub-tasks
+     */
+    void SetStream(itk::uint64_t key, itk::uint64_t stream, itk::uint32_t substream = 0)
+    {
+        m_Key[0] = static_cast <itk::uint32_t> (key);
+        m_Key[1] = static_cast <itk::uint32_t> (key >> 32);
+
+        // First counter word indexes blocks within a substream, the others identify stream and substream
+        m_Counter[0] = 0;
+        m_Counter[1] = substream;
+        m_Counter[2] = static_cast <itk::uint32_t> (stream);
+        m_Counter[3] = static_cast <itk::uint32_t> (stream >> 32);
+
+        m_OutputIndex = 4;
+    }
+
+    result_type operator()()
+    {
+        if (m_OutputIndex == 4)
+        {
+            this->GenerateBlock(m_Counter,m_Key,m_Output);
+            this->IncrementCounter();
+            m_OutputIndex = 0;
+        }
+
+        return m_Output[m_OutputIndex++];
+    }
+
+    void discard(unsigned long long n)
+    {
+        for (unsigned long long i = 0;i < n;++i)
+            (*this)();
+    }
+
+    //! Philox4x32 bijection with 10 rounds, output is the encrypted counter
+    static void GenerateBlock(const itk::uint32_t counter[4], const itk::uint32_t key[2], itk::uint32_t output[4])
+    {
+        itk::uint32_t workCounter[4] = {counter[0], counter[1], counter[2], counter[3]};
+        itk::uint32_t workKey[2] = {key[0], key[1]};
+
+        for (unsigned int i = 0;i < 10;++i)
+        {
+            if (i > 0)
+            {
+                workKey[0] += 0x9E3779B9;
+                workKey[1] += 0xBB67AE85;
+            }
+
+            itk::uint64_t firstProduct = static_cast <itk::uint64_t> (0xD2511F53) * workCounter[0];
+            itk::uint64_t secondProduct = static_cast <itk::uint64_t> (0xCD9E8D57) * workCounter[2];
+
+            itk::uint32_t firstHigh = static_cast <itk::uint32_t> (firstProduct >> 32);
+            itk::uint32_t secondHigh = static_cast <itk::uint32_t> (secondProduct >> 32);
+
+            workCounter[0] = secondHigh ^ workCounter[1] ^ workKey[0];
+            workCounter[1] = static_cast <itk::uint32_t> (secondProduct);
+            workCounter[2] = firstHigh ^ workCounter[3] ^ workKey[1];
+            workCounter[3] = static_cast <itk::uint32_t> (firstProduct);
+        }
+
+        for (unsigned int i = 0;i < 4;++i)
+            output[i] = workCounter[i];
+    }
+
+private:
+    void IncrementCounter()
+    {
+        ++m_Counter[0];
+    }
+
+    itk::uint32_t m_Key[2];
+    itk::uint32_t m_Counter[4];
+    itk::uint32_t m_Output[4];
+    unsigned int m_OutputIndex;
+};
+
+} // end namespace anima
@@ -3,6 +3,11 @@
 #include <vnl/vnl_vector_fixed.h>
 #include <itkPoint.h>
 #include <itkVector.h>
+#include <itkIntTypes.h>
+
+#include <cstring>
+#include <limits>
+#include <vector>
 
 namespace anima
 {
@@ -19,6 +24,62 @@ namespace anima
     template <class ScalarType>
     double EvaluateWatsonPDF(const itk::Vector <ScalarType,3> &v, const itk::Vector <ScalarType,3> &meanAxis, const ScalarType &kappa);
     
+    //! Log of the Watson PDF normalization constant, the PDF being C exp(kappa (c^2 - 1)) for positive kappa and C exp(kappa c^2) otherwise (c: cosine to the mean axis)
+    template <class ScalarType>
+    double ComputeWatsonLogNormalizer(const ScalarType &kappa);
+    
+    //! Log of the Watson PDF from the cosine between sample and mean axis and the log-normalizer of kappa
+    template <class ScalarType>
+    double EvaluateWatsonLogPDFFromCosine(const double cosine, const ScalarType &kappa, const double logNormalizer);
+    
+    /**
+     * @brief Small direct mapped cache of Watson log-normalizers. Particle filters evaluate many PDFs with few distinct
+     * concentrations (prior kappa, kappas of the same model maxima), the Dawson function is then evaluated once per kappa.
+     * Colliding kappas are simply recomputed. Not thread-safe, use one cache per thread.
+     */
+    class WatsonLogNormalizerCache
+    {
+    public:
+        WatsonLogNormalizerCache() {this->Clear();}
+        
+        void Clear()
+        {
+            for (unsigned int i = 0;i < CacheSize;++i)
+            {
+                m_Kappas[i] = std::numeric_limits <double>::quiet_NaN();
+                m_LogNormalizers[i] = 0;
+            }
+        }
+        
+        double GetLogNormalizer(const double kappa)
+        {
+            itk::uint64_t kappaBits;
+            std::memcpy(&kappaBits,&kappa,sizeof(double));
+            unsigned int slot = ((kappaBits * 0x9E3779B97F4A7C15ULL) >> 58) & (CacheSize - 1);
+            
+            // Empty slots hold NaN, never equal to any kappa
+            if (m_Kappas[slot] != kappa)
+            {
+                m_Kappas[slot] = kappa;
+                m_LogNormalizers[slot] = anima::ComputeWatsonLogNormalizer(kappa);
+            }
+            
+            return m_LogNormalizers[slot];
+        }
+        
+    private:
+        static const unsigned int CacheSize = 64;
+        double m_Kappas[CacheSize];
+        double m_LogNormalizers[CacheSize];
+    };
+    
+    //! Batched log-PDF evaluation of samples[i] w.r.t. meanAxes[i] and kappas[i], vectors being of norm 1 (not checked)
+    template <class VectorType, class ScalarType>
+    void EvaluateWatsonLogPDFs(const std::vector <VectorType> &samples, const std::vector <VectorType> &meanAxes,
+                               const std::vector <ScalarType> &kappas, std::vector <double> &logPdfs,
+                               WatsonLogNormalizerCache &normalizerCache);
+    
+    //! Computes the first 7 non-zero SH coefficients (multiplied by 4 M_PI) of the standard Watson PDF and their derivatives w.r.t. k, tabulated for k in [0, WatsonSHCoefficientsTable::GetKappaUpperBound()], asymptotic above. Throws for k < 0
     template <class ScalarType>
     void GetStandardWatsonSHCoefficients(const ScalarType k, std::vector<ScalarType> &coefficients, std::vector<ScalarType> &derivatives);
     
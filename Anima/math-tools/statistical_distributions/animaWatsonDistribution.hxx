@@ -4,6 +4,7 @@
 #include "animaWatsonDistribution.h"
 #include <animaVectorOperations.h>
 #include <animaErrorFunctions.h>
+#include <animaWatsonSHCoefficientsTable.h>
 
 #include <itkExceptionObject.h>
 #include <itkObjectFactory.h>
@@ -79,6 +80,50 @@ double EvaluateWatsonPDF(const itk::Vector <ScalarType,3> &v, const itk::Vector
     return EvaluateWatsonPDF<itk::Vector <ScalarType,3>, ScalarType>(v,meanAxis,kappa);
 }
 
+template <class ScalarType>
+double ComputeWatsonLogNormalizer(const ScalarType &kappa)
+{
+    // Same constants as EvaluateWatsonPDF, expressed in log
+    if (std::abs(kappa) < 1.0e-6)
+        return - std::log(4.0 * M_PI);
+    else if (kappa > 0)
+    {
+        double kappaSqrt = std::sqrt(kappa);
+        return std::log(kappaSqrt / (4.0 * M_PI * anima::EvaluateDawsonFunctionNR(kappaSqrt)));
+    }
+
+    return std::log(std::sqrt(-kappa / M_PI) / (2.0 * M_PI * std::erf(std::sqrt(-kappa))));
+}
+
+template <class ScalarType>
+double EvaluateWatsonLogPDFFromCosine(const double cosine, const ScalarType &kappa, const double logNormalizer)
+{
+    if (std::abs(kappa) < 1.0e-6)
+        return logNormalizer;
+    else if (kappa > 0)
+        return logNormalizer + kappa * (cosine * cosine - 1.0);
+
+    return logNormalizer + kappa * cosine * cosine;
+}
+
+template <class VectorType, class ScalarType>
+void EvaluateWatsonLogPDFs(const std::vector <VectorType> &samples, const std::vector <VectorType> &meanAxes,
+                           const std::vector <ScalarType> &kappas, std::vector <double> &logPdfs,
+                           WatsonLogNormalizerCache &normalizerCache)
+{
+    unsigned int numSamples = samples.size();
+    logPdfs.resize(numSamples);
+
+    for (unsigned int i = 0;i < numSamples;++i)
+    {
+        double cosine = 0;
+        for (unsigned int j = 0;j < 3;++j)
+            cosine += samples[i][j] * meanAxes[i][j];
+
+        logPdfs[i] = anima::EvaluateWatsonLogPDFFromCosine(cosine,kappas[i],normalizerCache.GetLogNormalizer(kappas[i]));
+    }
+}
+
 template <class ScalarType>
     void GetStandardWatsonSHCoefficients(const ScalarType k, std::vector<ScalarType> &coefficients, std::vector<ScalarType> &derivatives)
 {
@@ -87,62 +132,31 @@ template <class ScalarType>
     coefficients.resize(nbCoefs);
     derivatives.resize(nbCoefs);
     
-    double sqrtPi = std::sqrt(M_PI);
-    double dawsonValue = anima::EvaluateDawsonIntegral(std::sqrt(k), true);
-    double k2 = k * k;
-    double k3 = k2 * k;
-    double k4 = k3 * k;
-    double k5 = k4 * k;
-    double k6 = k5 * k;
-    double k7 = k6 * k;
-    
-    coefficients[0] = 2.0 * sqrtPi;
-    derivatives[0] = 0.0;
-    
-    if (k < 1.0e-4) // Handles small k values by Taylor series expansion
+    // Tabulated values over the usual range and asymptotic expansion above it, closed form Dawson based expressions
+    // being inaccurate at both ends. Negative (girdle) concentrations are not handled
+    if (k < 0)
+        throw itk::ExceptionObject(__FILE__, __LINE__,"Watson SH coefficients are only supported for non negative concentrations",ITK_LOCATION);
+
+    if (k <= anima::WatsonSHCoefficientsTable::GetKappaUpperBound())
     {
-        coefficients[1] = k / 3.0;
-        coefficients[2] = k2 / 35.0;
-        coefficients[3] = k3 / 693.0;
-        coefficients[4] = k4 / 19305.0;
-        coefficients[5] = k5 / 692835.0;
-        coefficients[6] = k6 / 30421755.0;
-        derivatives[1] = 1.0 / 3.0;
-        derivatives[2] = 2.0 * k / 35.0;
-        derivatives[3] = k2 / 231.0;
-        derivatives[4] = 4.0 * k3 / 19305.0;
-        derivatives[5] = k4 / 138567.0;
-        derivatives[6] = 6.0 * k5 / 30421755.0;
-        
-        for (unsigned int i = 1;i < nbCoefs;++i)
+        const anima::WatsonSHCoefficientsTable &shTable = anima::WatsonSHCoefficientsTable::GetInstance();
+        for (unsigned int i = 0;i < nbCoefs;++i)
         {
-            double tmpVal = std::pow(2.0, i + 1.0) * sqrtPi / std::sqrt(4.0 * i + 1.0);
-            coefficients[i] *= tmpVal;
-            derivatives[i] *= tmpVal;
+            double coefficient, derivative;
+            shTable.Evaluate(k,i,coefficient,derivative);
+            coefficients[i] = coefficient;
+            derivatives[i] = derivative;
         }
         
         return;
     }
     
-    coefficients[1] = (3.0 - (3.0 + 2.0 * k) * dawsonValue) / (2.0 * k);
-    coefficients[2] = (5.0 * (-21.0 + 2.0 * k) + 3.0 * (35.0 + 4.0 * k * (5.0 + k)) * dawsonValue) / (16.0 * k2);
-    coefficients[3] = (21.0 * (165.0 + 4.0 * (-5.0 + k) * k) - 5.0 * (693.0 + 378.0 * k + 84.0 * k2 + 8.0 * k3) * dawsonValue) / (64.0 * k3);
-    coefficients[4] = (3.0 * (-225225.0 + 2.0 * k * (15015.0 + 2.0 * k * (-1925.0 + 62.0 * k))) + 35.0 * (19305.0 + 8.0 * k * (1287.0 + k * (297.0 + 2.0 * k *  (18.0 + k)))) * dawsonValue) / (1024.0 * k4);
-    coefficients[5] = (11.0 * (3968055.0 + 8.0 * k * (-69615.0 + 2.0 * k * (9828.0 + k * (-468.0 + 29.0 * k)))) - 63.0 * (692835.0 + 2.0 * k * (182325.0 + 4.0 * k * (10725.0 + 2.0 * k * (715.0 + k * (55.0 + 2.0 * k))))) * dawsonValue) / (4096.0 * k5);
-    coefficients[6] = (13.0 * (-540571185.0 + 2.0 * k * (39171825.0 + 4.0 * k * (-2909907.0 + 2.0 * k * (82467.0 + k * (-7469.0 + 122.0 * k))))) + 231.0 * (30421755.0 + 4.0 * k * (3968055.0 + k * (944775.0 + 4.0 * k * (33150.0 + k * (2925.0 + 4.0 * k * (39.0 + k)))))) * dawsonValue) / (32768.0 * k6);
-    
-    derivatives[1] = 3.0 * (-1.0 + (-1.0 + 2.0 * k) * dawsonValue + 2.0 * dawsonValue * dawsonValue) / (4.0 * k2);
-    derivatives[2] = 5.0 * ((21.0 - 2.0 * k) + (63.0 + 4.0 * (-11.0 + k) * k) * dawsonValue - 12.0 * (7.0 + 2.0 * k) * dawsonValue * dawsonValue) / (32.0 * k3);
-    derivatives[3] = 21.0 * ((-165.0 - 4.0 * (-5.0 + k) * k) + (-5.0 + 2.0 * k) * (165.0 + 4.0 * (-3.0 + k) * k) * dawsonValue + 10.0 * (99.0 + 4.0 * k * (9.0 + k)) * dawsonValue * dawsonValue) / (128.0 * k4);
-    derivatives[4] = 3.0 * ((225225.0 - 2.0 * k * (15015.0 + 2.0 * k * (-1925.0 + 62.0 * k))) + (1576575.0 + 8.0 * k * (-75075.0 + k * (10395.0 + 2.0 * k * (-978.0 + 31.0 * k)))) * dawsonValue - 840.0 * (2145.0 + 2.0 * k * (429.0 + 66.0 * k + 4.0 * k2)) * dawsonValue * dawsonValue) / (2048.0 * k5);
-    derivatives[5] = 11.0 * ((-3968055.0 - 8.0 * k * (-69615.0 + 2.0 * k * (9828.0 + k * (-468.0 + 29.0 * k)))) + (-35712495.0 + 2.0 * k * (5917275.0 + 8.0 * k * (-118755.0 + k * (21060.0 + k * (-965.0 + 58.0 * k))))) * dawsonValue + 630.0 * (62985.0 + 8.0 * k * (3315.0 + k * (585.0 + 2.0 * k * (26.0 + k)))) * dawsonValue * dawsonValue) / (8192.0 * k6);
-    derivatives[6] = 13.0 * ((540571185.0 - 2.0 * k * (39171825.0 + 4.0 * k * (-2909907.0 + 2.0 * k * (82467.0 + k * (-7469.0 + 122.0 * k))))) + (5946283035.0 + 4.0 * k * (-446558805.0 + k * (79910523.0 + 4.0 * k * (-3322242.0 + k * (187341.0 + 4.0 * k * (-3765.0 + 61.0 * k)))))) * dawsonValue - 2772.0 * (2340135.0 + 2.0 * k * (508725.0 + 4.0 * k * (24225.0 + 2.0 * k * (1275.0 + k * (75.0 + 2.0 * k))))) * dawsonValue * dawsonValue) / (65536.0 * k7);
-    
-    for (unsigned int i = 1;i < nbCoefs;++i)
+    std::vector <double> asymptoticCoefficients, asymptoticDerivatives;
+    anima::WatsonSHCoefficientsTable::ComputeAsymptoticCoefficients(k,asymptoticCoefficients,asymptoticDerivatives);
+    for (unsigned int i = 0;i < nbCoefs;++i)
     {
-        double sqrtVal = std::sqrt(1.0 + 4.0 * i);
-        coefficients[i] *= (sqrtPi * sqrtVal / dawsonValue);
-        derivatives[i] *= (sqrtPi * sqrtVal / (dawsonValue * dawsonValue));
+        coefficients[i] = asymptoticCoefficients[i];
+        derivatives[i] = asymptoticDerivatives[i];
     }
 }
 
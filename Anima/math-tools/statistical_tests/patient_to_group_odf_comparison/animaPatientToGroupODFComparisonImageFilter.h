@@ -48,6 +48,7 @@ private:
     ITK_DISALLOW_COPY_AND_ASSIGN(PatientToGroupODFComparisonImageFilter);
 
     std::vector < std::vector <double> > m_SampleDirections;
+    vnl_matrix <double> m_SampleBasisMatrix;
     unsigned int m_LOrder;
 
     anima::ODFSphericalHarmonicBasis *m_ShData;
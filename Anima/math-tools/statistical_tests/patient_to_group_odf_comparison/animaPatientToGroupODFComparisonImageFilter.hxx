@@ -18,6 +18,10 @@ PatientToGroupODFComparisonImageFilter<PixelScalarType>
         delete m_ShData;
 
     m_ShData = new anima::ODFSphericalHarmonicBasis (m_LOrder);
+
+    // Sample directions are fixed, basis values on them are computed once
+    if (m_SampleDirections.size() != 0)
+        m_ShData->ComputeBasisMatrix(m_SampleDirections,m_SampleBasisMatrix);
 }
 
 template <class PixelScalarType>
@@ -31,9 +35,9 @@ PatientToGroupODFComparisonImageFilter<PixelScalarType>
 
     unsigned int numItems = databaseValues.size();
     for (unsigned int i = 0;i < numItems;++i)
-        databaseValues[i] = m_ShData->GetSampleValues(databaseValues[i],m_SampleDirections);
+        databaseValues[i] = m_ShData->GetSampleValues(databaseValues[i],m_SampleBasisMatrix);
 
-    patientVectorValue = m_ShData->GetSampleValues(patientVectorValue,m_SampleDirections);
+    patientVectorValue = m_ShData->GetSampleValues(patientVectorValue,m_SampleBasisMatrix);
 
     return patientVectorValue.GetSize();
 }
@@ -2,9 +2,8 @@
 #include "animaLocalPatchCovarianceDistanceImageFilter.h"
 
 #include <itkImageRegionIteratorWithIndex.h>
-#include <itkSymmetricEigenAnalysis.h>
-
 #include <animaVectorImagePatchStatistics.h>
+#include <animaBaseTensorTools.h>
 
 namespace anima
 {
@@ -48,10 +47,6 @@ LocalPatchCovarianceDistanceImageFilter<PixelScalarType>
 
     unsigned int numDistances = numSamplesDatabase * (numSamplesDatabase + 1) / 2 - numSamplesDatabase;
 
-    CovarianceType eVec(ndim,ndim);
-    vnl_diag_matrix <double> eVals(ndim);
-    itk::SymmetricEigenAnalysis <vnl_matrix <double>, vnl_diag_matrix <double>, vnl_matrix <double> > EigenAnalysis(ndim);
-
     InputImageIndexType curIndex;
     OutputImageRegionType largestRegionOut = this->GetOutput(0)->GetLargestPossibleRegion();
 
@@ -79,12 +74,9 @@ LocalPatchCovarianceDistanceImageFilter<PixelScalarType>
         for (unsigned int i = 0;i < numSamplesDatabase;++i)
         {
             anima::computePatchMeanAndCovariance(this->GetInput(i),tmpBlockRegion,patchMean,varianceVector[i]);
-            EigenAnalysis.ComputeEigenValuesAndVectors(varianceVector[i], eVals, eVec);
-
-            for (unsigned int j = 0;j < ndim;++j)
-                eVals[j] = log(eVals[j]);
-
-            logVarianceVector[i] = eVec.transpose() * eVals * eVec;
+            // Closed form eigen decomposition for 3x3 covariances. Eigenvalues are clamped to 1e-16 before the log:
+            // degenerate covariances (e.g. constant patches) now give large finite log values instead of NaN or infinity
+            anima::GetTensorLogarithm(varianceVector[i],logVarianceVector[i]);
         }
 
         double meanDist = 0;
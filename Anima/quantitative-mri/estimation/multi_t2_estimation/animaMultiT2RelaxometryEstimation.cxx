@@ -62,6 +62,9 @@ int main(int argc, char **argv)
     TCLAP::ValueArg<unsigned int> patchSSArg("s","patchStepSize","Patch step size for searching -> default: 1",false,1,"Patch search step size",cmd);
     TCLAP::ValueArg<unsigned int> patchNeighArg("","patchNeighborhood","Patch half neighborhood size -> default: 5",false,5,"Patch search neighborhood size",cmd);
 
+    TCLAP::ValueArg<unsigned int> slabSizeArg("","slab-size","Number of slices per slab for streamed, resumable estimation (default: 0, whole image at once)",false,0,"slab size",cmd);
+    TCLAP::ValueArg<std::string> slabPrefixArg("","slab-prefix","Prefix of slab result files, a run with the same prefix resumes after the last completed slab (default: MWF output name)",false,"","slab files prefix",cmd);
+
     TCLAP::ValueArg<unsigned int> nbpArg("T","numberofthreads","Number of threads to run on (default : all cores)",false,itk::MultiThreader::GetGlobalDefaultNumberOfThreads(),"number of threads",cmd);
 	
     try
@@ -74,6 +77,12 @@ int main(int argc, char **argv)
         return EXIT_FAILURE;
     }
     
+    if (nlEstimationArg.isSet() && (slabSizeArg.getValue() != 0))
+    {
+        std::cerr << "Error: NL estimation cannot be run on slabs" << std::endl;
+        return EXIT_FAILURE;
+    }
+
     typedef itk::Image <double,3> InputImageType;
     typedef InputImageType OutputImageType;
     typedef anima::MultiT2RelaxometryEstimationImageFilter <double> FilterType;
@@ -83,7 +92,14 @@ int main(int argc, char **argv)
 
     FilterType::Pointer mainFilter = FilterType::New();
 	
-    unsigned int numInputs = anima::setMultipleImageFilterInputsFromFileName<InputImageType,FilterType>(t2Arg.getValue(),mainFilter);
+
+    // Readers have to be kept alive while slabs are computed
+    std::vector <itk::ProcessObject::Pointer> streamingSources;
+    std::vector <itk::ProcessObject::Pointer> *streamingSourcesPointer = 0;
+    if (slabSizeArg.getValue() != 0)
+        streamingSourcesPointer = &streamingSources;
+
+    unsigned int numInputs = anima::setMultipleImageFilterInputsFromFileName<InputImageType,FilterType>(t2Arg.getValue(),mainFilter,streamingSourcesPointer);
 
     mainFilter->SetEchoSpacing(echoSpacingArg.getValue());
     mainFilter->SetT2FlipAngles(t2FlipAngleArg.getValue() * M_PI / 180.0,numInputs);
@@ -123,6 +139,13 @@ int main(int argc, char **argv)
     mainFilter->SetAverageSignalThreshold(backgroundSignalThresholdArg.getValue());
     mainFilter->SetNumberOfThreads(nbpArg.getValue());
 
+    mainFilter->SetSlabSize(slabSizeArg.getValue());
+    if (slabPrefixArg.getValue() != "")
+        mainFilter->SetSlabFilesPrefix(slabPrefixArg.getValue());
+    else
+        mainFilter->SetSlabFilesPrefix(resMWFArg.getValue());
+    mainFilter->SetSlabRunDescription("t2: " + t2Arg.getValue() + ", mask: " + maskArg.getValue() + ", t1: " + t1MapArg.getValue());
+
     itk::CStyleCommand::Pointer callback = itk::CStyleCommand::New();
     callback->SetCallback(eventCallback);
     mainFilter->AddObserver(itk::ProgressEvent(), callback );
@@ -132,7 +155,7 @@ int main(int argc, char **argv)
     
     try
     {
-        mainFilter->Update();
+        mainFilter->UpdateBySlabs();
     }
     catch (itk::ExceptionObject &e)
     {
@@ -145,13 +145,23 @@ protected:
     void BeforeThreadedGenerateData() ITK_OVERRIDE;
     void ThreadedGenerateData(const OutputImageRegionType &outputRegionForThread, itk::ThreadIdType threadId) ITK_OVERRIDE;
 
+    //! Slab streaming: T2 distribution image is saved and assembled along with the other outputs
+    void WriteSlab(const std::string &slabPrefix, const OutputImageRegionType &slabRegion) ITK_OVERRIDE;
+    void AllocateSlabAssembly() ITK_OVERRIDE;
+    void ReadSlab(const std::string &slabPrefix, const OutputImageRegionType &slabRegion) ITK_OVERRIDE;
+    void RemoveSlab(const std::string &slabPrefix) ITK_OVERRIDE;
+
+    //! Creates the T2 distribution image on region, with the geometry of the first input
+    void CreateT2OutputImage(const OutputImageRegionType &region);
+
     void PrepareNLPatchSearchers();
     void ComputeTikhonovPrior(const IndexType &refIndex, OutputVectorType &refDistribution,
                               PatchSearcherType &nlPatchSearcher, T2VectorType &priorDistribution,
                               std::vector <double> &workDataWeights, std::vector <OutputVectorType> &workDataSamples);
 
-    double ComputeTikhonovRegularizedSolution(anima::NNLSOptimizer *nnlsOpt, DataMatrixType &AMatrix,
-                                              T2VectorType &signalValues, double lambdaSq,
+    //! Tikhonov regularized NNLS from AtA and Aty (signalsSquaredNorm is yty), returns regularized residual
+    double ComputeTikhonovRegularizedSolution(anima::NNLSOptimizer *nnlsOpt, DataMatrixType &AMatrixGram,
+                                              T2VectorType &projectedSignalValues, double signalsSquaredNorm, double lambdaSq,
                                               T2VectorType &priorDistribution, T2VectorType &t2OptimizedWeights);
 
 private:
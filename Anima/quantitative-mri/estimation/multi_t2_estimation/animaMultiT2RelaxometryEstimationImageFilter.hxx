@@ -17,6 +17,9 @@ MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
     if (m_NLEstimation && (!m_InitialT2Map || !m_InitialM0Map))
         itkExceptionMacro("Missing inputs for non-local estimation");
 
+    if (m_NLEstimation && (this->GetSlabSize() != 0))
+        itkExceptionMacro("Non-local estimation requires whole images, it cannot be run in slab streaming mode");
+
     Superclass::BeforeThreadedGenerateData();
 
     m_T2CompartmentValues.resize(m_NumberOfT2Compartments);
@@ -34,18 +37,7 @@ MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
 
     this->GetB1OutputImage()->FillBuffer(1.0);
 
-    m_T2OutputImage = VectorOutputImageType::New();
-    m_T2OutputImage->Initialize();
-    m_T2OutputImage->SetRegions(this->GetInput(0)->GetLargestPossibleRegion());
-    m_T2OutputImage->SetSpacing (this->GetInput(0)->GetSpacing());
-    m_T2OutputImage->SetOrigin (this->GetInput(0)->GetOrigin());
-    m_T2OutputImage->SetDirection (this->GetInput(0)->GetDirection());
-    m_T2OutputImage->SetVectorLength(m_NumberOfT2Compartments);
-    m_T2OutputImage->Allocate();
-
-    OutputVectorType zero(m_NumberOfT2Compartments);
-    zero.Fill(0.0);
-    m_T2OutputImage->FillBuffer(zero);
+    this->CreateT2OutputImage(this->GetOutput(0)->GetRequestedRegion());
 
     if (m_NLEstimation)
     {
@@ -73,6 +65,65 @@ MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
     }
 }
 
+template <class TPixelScalarType>
+void
+MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
+::CreateT2OutputImage(const OutputImageRegionType &region)
+{
+    m_T2OutputImage = VectorOutputImageType::New();
+    m_T2OutputImage->Initialize();
+    m_T2OutputImage->SetRegions(region);
+    m_T2OutputImage->SetSpacing (this->GetInput(0)->GetSpacing());
+    m_T2OutputImage->SetOrigin (this->GetInput(0)->GetOrigin());
+    m_T2OutputImage->SetDirection (this->GetInput(0)->GetDirection());
+    m_T2OutputImage->SetVectorLength(m_NumberOfT2Compartments);
+    m_T2OutputImage->Allocate();
+
+    OutputVectorType zero(m_NumberOfT2Compartments);
+    zero.Fill(0.0);
+    m_T2OutputImage->FillBuffer(zero);
+}
+
+template <class TPixelScalarType>
+void
+MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
+::WriteSlab(const std::string &slabPrefix, const OutputImageRegionType &slabRegion)
+{
+    this->Superclass::WriteSlab(slabPrefix,slabRegion);
+    anima::writeImage <VectorOutputImageType> (slabPrefix + "_t2.nrrd",m_T2OutputImage);
+}
+
+template <class TPixelScalarType>
+void
+MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
+::AllocateSlabAssembly()
+{
+    this->Superclass::AllocateSlabAssembly();
+
+    // T2 image does not exist yet if all slabs were computed by a previous run
+    this->CreateT2OutputImage(this->GetOutput(0)->GetLargestPossibleRegion());
+}
+
+template <class TPixelScalarType>
+void
+MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
+::ReadSlab(const std::string &slabPrefix, const OutputImageRegionType &slabRegion)
+{
+    this->Superclass::ReadSlab(slabPrefix,slabRegion);
+
+    VectorOutputImagePointer slabImage = anima::readImage <VectorOutputImageType> (slabPrefix + "_t2.nrrd");
+    this->PasteSlabImage(slabImage.GetPointer(),m_T2OutputImage.GetPointer(),slabRegion);
+}
+
+template <class TPixelScalarType>
+void
+MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
+::RemoveSlab(const std::string &slabPrefix)
+{
+    this->Superclass::RemoveSlab(slabPrefix);
+    std::remove((slabPrefix + "_t2.nrrd").c_str());
+}
+
 template <class TPixelScalarType>
 void
 MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
@@ -84,19 +135,21 @@ MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
     typedef itk::ImageRegionConstIterator <InputImageType> IteratorType;
     typedef itk::ImageRegionIterator <MaskImageType> MaskIteratorType;
 
+    // Inputs are only available on the requested region (current slab in slab streaming mode)
     std::vector <IteratorType> inItrs(this->GetNumberOfIndexedInputs());
     for (unsigned int i = 0;i < this->GetNumberOfIndexedInputs();++i)
-        inItrs[i] = IteratorType(this->GetInput(i),this->GetOutput(0)->GetLargestPossibleRegion());
+        inItrs[i] = IteratorType(this->GetInput(i),this->GetOutput(0)->GetRequestedRegion());
 
     typename MaskImageType::Pointer maskImage = MaskImageType::New();
     maskImage->Initialize();
-    maskImage->SetRegions(this->GetInput(0)->GetLargestPossibleRegion());
+    maskImage->SetRegions(this->GetOutput(0)->GetLargestPossibleRegion());
     maskImage->SetSpacing (this->GetInput(0)->GetSpacing());
     maskImage->SetOrigin (this->GetInput(0)->GetOrigin());
     maskImage->SetDirection (this->GetInput(0)->GetDirection());
     maskImage->Allocate();
+    maskImage->FillBuffer(0);
 
-    MaskIteratorType maskItr (maskImage,this->GetOutput(0)->GetLargestPossibleRegion());
+    MaskIteratorType maskItr (maskImage,this->GetOutput(0)->GetRequestedRegion());
     while (!maskItr.IsAtEnd())
     {
         double averageVal = 0;
@@ -160,15 +213,17 @@ MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
         t1MapItr = ImageIteratorType(m_T1Map,outputRegionForThread);
 
     T2VectorType signalValues(numInputs);
-    T2VectorType signalValuesExtended(numInputs + m_NumberOfT2Compartments);
+    T2VectorType projectedSignalValues(m_NumberOfT2Compartments);
     T2VectorType t2OptimizedWeights(m_NumberOfT2Compartments);
     T2VectorType priorDistribution(m_NumberOfT2Compartments);
     priorDistribution.fill(0);
+    T2VectorType zeroT2Weights(m_NumberOfT2Compartments);
+    zeroT2Weights.fill(0);
 
     OutputVectorType outputT2Weights(m_NumberOfT2Compartments);
 
     DataMatrixType AMatrix(numInputs,m_NumberOfT2Compartments,0);
-    DataMatrixType AMatrixExtended(numInputs + m_NumberOfT2Compartments,m_NumberOfT2Compartments,0);
+    DataMatrixType AMatrixGram(m_NumberOfT2Compartments,m_NumberOfT2Compartments,0);
 
     anima::EPGSignalSimulator epgSimulator;
     epgSimulator.SetEchoSpacing(m_EchoSpacing);
@@ -179,7 +234,14 @@ MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
 
     anima::EPGSignalSimulator::RealVectorType epgSignalValues(numInputs);
 
+    // NNLS are only warm started within a voxel (previous B1 iteration or unregularized solution), so that results
+    // do not depend on how regions are split between threads
     NNLSOptimizerPointer nnlsOpt = NNLSOptimizerType::New();
+    nnlsOpt->SetWarmStart(true);
+
+    NNLSOptimizerPointer tikhonovNNLSOpt = NNLSOptimizerType::New();
+    tikhonovNNLSOpt->SetSquaredProblem(true);
+    tikhonovNNLSOpt->SetWarmStart(true);
 
     typedef anima::NLOPTOptimizers B1OptimizerType;
     typedef anima::MultiT2EPGRelaxometryCostFunction B1CostFunctionType;
@@ -241,10 +303,11 @@ MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
         double t1Value = 1000;
         double m0Value = 0.0;
 
+        double signalsSquaredNorm = 0.0;
         for (unsigned int i = 0;i < numInputs;++i)
         {
             signalValues[i] = inIterators[i].Get();
-            signalValuesExtended[i] = signalValues[i];
+            signalsSquaredNorm += signalValues[i] * signalValues[i];
         }
 
         if (m_T1Map)
@@ -276,20 +339,20 @@ MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
             previousB1Value = b1Value;
             // T2 weights estimation
             AMatrix.fill(0);
-            AMatrixExtended.fill(0);
             for (unsigned int i = 0;i < m_NumberOfT2Compartments;++i)
             {
                 epgSignalValues = epgSimulator.GetValue(t1Value,m_T2CompartmentValues[i],b1Value,1.0);
                 for (unsigned int j = 0;j < numInputs;++j)
-                {
                     AMatrix(j,i) = epgSignalValues[j];
-                    AMatrixExtended(j,i) = epgSignalValues[j];
-                }
             }
 
-            // Regular NNLS optimization
+            // Regular NNLS optimization, kept on A (not squared) for conditioning
             nnlsOpt->SetDataMatrix(AMatrix);
             nnlsOpt->SetPoints(signalValues);
+            if (numGlobalIterations > 1)
+                nnlsOpt->SetInitialPosition(nnlsOpt->GetCurrentPosition());
+            else
+                nnlsOpt->SetInitialPosition(zeroT2Weights);
 
             nnlsOpt->StartOptimization();
             t2OptimizedWeights = nnlsOpt->GetCurrentPosition();
@@ -302,9 +365,28 @@ MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
 
             if (m_RegularizationIntensity > 1.0)
             {
+                // AtA and Aty, regularized problem is then well conditioned and solved on squared data
+                for (unsigned int i = 0;i < m_NumberOfT2Compartments;++i)
+                {
+                    projectedSignalValues[i] = 0.0;
+                    for (unsigned int j = 0;j < numInputs;++j)
+                        projectedSignalValues[i] += AMatrix(j,i) * signalValues[j];
+
+                    for (unsigned int j = i;j < m_NumberOfT2Compartments;++j)
+                    {
+                        double gramValue = 0.0;
+                        for (unsigned int k = 0;k < numInputs;++k)
+                            gramValue += AMatrix(k,i) * AMatrix(k,j);
+
+                        AMatrixGram(i,j) = gramValue;
+                        AMatrixGram(j,i) = gramValue;
+                    }
+                }
+
                 double lambdaSq = (m_RegularizationIntensity - 1.0) * residual / normT2Weights;
-                residual = this->ComputeTikhonovRegularizedSolution(nnlsOpt,AMatrixExtended,signalValuesExtended,
-                                                                    lambdaSq,priorDistribution,t2OptimizedWeights);
+                residual = this->ComputeTikhonovRegularizedSolution(tikhonovNNLSOpt,AMatrixGram,projectedSignalValues,
+                                                                    signalsSquaredNorm,lambdaSq,priorDistribution,
+                                                                    t2OptimizedWeights);
             }
 
             outCostIterator.Set(residual);
@@ -533,29 +615,30 @@ MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
 template <class TPixelScalarType>
 double
 MultiT2RelaxometryEstimationImageFilter <TPixelScalarType>
-::ComputeTikhonovRegularizedSolution(anima::NNLSOptimizer *nnlsOpt, DataMatrixType &AMatrix,
-                                     T2VectorType &signalValues, double lambdaSq,
+::ComputeTikhonovRegularizedSolution(anima::NNLSOptimizer *nnlsOpt, DataMatrixType &AMatrixGram,
+                                     T2VectorType &projectedSignalValues, double signalsSquaredNorm, double lambdaSq,
                                      T2VectorType &priorDistribution, T2VectorType &t2OptimizedWeights)
 {
-    unsigned int rowSize = AMatrix.rows() - AMatrix.cols();
-    unsigned int colSize = AMatrix.cols();
-
-    double lambda = std::sqrt(lambdaSq);
+    // Squared version of [A; lambda I] x = [y; lambda prior]:
+    // (AtA + lambda^2 I) x = Aty + lambda^2 prior
+    unsigned int colSize = AMatrixGram.cols();
+    DataMatrixType regularizedGram(AMatrixGram);
+    T2VectorType regularizedProjection(colSize);
 
+    double squaredNorm = signalsSquaredNorm;
     for (unsigned int i = 0;i < colSize;++i)
     {
-        signalValues[rowSize + i] = lambda * priorDistribution[i];
-        for (unsigned int j = 0;j < colSize;++j)
-        {
-            if (i != j)
-                AMatrix(rowSize + i,j) = 0;
-            else
-                AMatrix(rowSize + i,j) = lambda;
-        }
+        regularizedGram(i,i) += lambdaSq;
+        regularizedProjection[i] = projectedSignalValues[i] + lambdaSq * priorDistribution[i];
+        squaredNorm += lambdaSq * priorDistribution[i] * priorDistribution[i];
     }
 
-    nnlsOpt->SetDataMatrix(AMatrix);
-    nnlsOpt->SetPoints(signalValues);
+    nnlsOpt->SetDataMatrix(regularizedGram);
+    nnlsOpt->SetPoints(regularizedProjection);
+    nnlsOpt->SetPointsSquaredNorm(squaredNorm);
+
+    // Warm start from the unregularized solution
+    nnlsOpt->SetInitialPosition(t2OptimizedWeights);
 
     nnlsOpt->StartOptimization();
 
@@ -42,11 +42,7 @@ TensorResampleImageFilter<TImageType, TInterpolatorPrecisionType>
         anima::RotateSymmetricMatrix(m_WorkMats[threadId],modelOrientationMatrix,m_TmpTensors[threadId]);
     else
     {
-        typedef itk::Matrix <double,3,3> MatrixType;
-        typedef vnl_vector_fixed <double,3> VectorType;
-        itk::SymmetricEigenAnalysis < MatrixType, VectorType, MatrixType> eigenComputer(3);
-        eigenComputer.ComputeEigenValuesAndVectors(m_WorkMats[threadId],m_WorkEigenValues[threadId],
-                                                   m_WorkEigenVectors[threadId]);
+        anima::ComputeSymmetric3x3EigenSystem(m_WorkMats[threadId],m_WorkEigenValues[threadId],m_WorkEigenVectors[threadId]);
 
         anima::ExtractPPDRotationFromJacobianMatrix(modelOrientationMatrix,m_WorkPPDOrientationMatrices[threadId],m_WorkEigenVectors[threadId]);
         anima::RotateSymmetricMatrix(m_WorkMats[threadId],m_WorkPPDOrientationMatrices[threadId],m_TmpTensors[threadId]);
@@ -2,27 +2,258 @@
 #include <animaTransformSeriesReader.h>
 #include <animaShapesReader.h>
 #include <animaShapesWriter.h>
+#include <animaFibersBinaryFileFormat.h>
+
+#include <itkMatrixOffsetTransformBase.h>
+#include <itkTransformToDisplacementFieldFilter.h>
+#include <rpiDisplacementFieldTransform.h>
+#include <itksys/SystemTools.hxx>
 
 #include <vtkPolyData.h>
+#include <vtkPoints.h>
+
+#include <cmath>
+
+typedef anima::TransformSeriesReader <double, 3> TransformSeriesReaderType;
+typedef TransformSeriesReaderType::OutputTransformType TransformType;
+typedef itk::MatrixOffsetTransformBase <double, 3> LinearTransformType;
+typedef rpi::DisplacementFieldTransform <double, 3> DenseTransformType;
+
+typedef itk::Vector <double, 3> VectorType;
+typedef itk::Image <VectorType, 3> DisplacementFieldType;
+typedef itk::Image <unsigned short, 3>::PointType PointType;
+
+//! Points to transform (either vtk points or point records of a mapped binary fibers file) and transformation to apply
+typedef struct
+{
+    vtkPoints *points;
+    float *pointRecords;
+    unsigned int recordLength;
+    itk::uint64_t numPoints;
+
+    TransformType *transform;
+    LinearTransformType *linearTransform;
+    DisplacementFieldType *displacementField;
+} ThreaderArguments;
+
+void GetTrackPoint(ThreaderArguments *args, itk::uint64_t index, PointType &point)
+{
+    if (args->pointRecords)
+    {
+        const float *pointCoordinates = args->pointRecords + index * args->recordLength;
+        for (unsigned int k = 0;k < 3;++k)
+            point[k] = pointCoordinates[k];
+    }
+    else
+    {
+        double pointPositionVTK[3];
+        args->points->GetPoint(index,pointPositionVTK);
+        for (unsigned int k = 0;k < 3;++k)
+            point[k] = pointPositionVTK[k];
+    }
+}
+
+void SetTrackPoint(ThreaderArguments *args, itk::uint64_t index, const PointType &point)
+{
+    if (args->pointRecords)
+    {
+        float *pointCoordinates = args->pointRecords + index * args->recordLength;
+        for (unsigned int k = 0;k < 3;++k)
+            pointCoordinates[k] = point[k];
+    }
+    else
+    {
+        double pointPositionVTK[3];
+        for (unsigned int k = 0;k < 3;++k)
+            pointPositionVTK[k] = point[k];
+        args->points->SetPoint(index,pointPositionVTK);
+    }
+}
 
-void ApplyTransformToTracks(vtkPoints *dataPoints, anima::TransformSeriesReader <double, 3>::OutputTransformType *transform)
+//! Trilinear interpolation of a displacement field with identity direction, points outside are clamped to its border
+void TransformPointWithField(DisplacementFieldType *field, const PointType &inputPoint, PointType &outputPoint)
 {
-    typedef itk::Image <unsigned short, 3>::PointType PointType;
+    const DisplacementFieldType::PointType &origin = field->GetOrigin();
+    const DisplacementFieldType::SpacingType &spacing = field->GetSpacing();
+    const DisplacementFieldType::SizeType &size = field->GetLargestPossibleRegion().GetSize();
+    const itk::OffsetValueType *offsetTable = field->GetOffsetTable();
+
+    itk::OffsetValueType baseOffset = 0;
+    double weights[3];
+    for (unsigned int k = 0;k < 3;++k)
+    {
+        double continuousIndex = (inputPoint[k] - origin[k]) / spacing[k];
+        continuousIndex = std::max(0.0,std::min(continuousIndex,size[k] - 1.0));
+
+        unsigned int baseIndex = std::min((unsigned int)std::floor(continuousIndex),(unsigned int)(size[k] - 2));
+        weights[k] = continuousIndex - baseIndex;
+        baseOffset += baseIndex * offsetTable[k];
+    }
+
+    const VectorType *buffer = field->GetBufferPointer() + baseOffset;
+    outputPoint = inputPoint;
+    for (unsigned int corner = 0;corner < 8;++corner)
+    {
+        double cornerWeight = 1.0;
+        itk::OffsetValueType cornerOffset = 0;
+        for (unsigned int k = 0;k < 3;++k)
+        {
+            if (corner & (1 << k))
+            {
+                cornerWeight *= weights[k];
+                cornerOffset += offsetTable[k];
+            }
+            else
+                cornerWeight *= 1.0 - weights[k];
+        }
+
+        if (cornerWeight == 0.0)
+            continue;
+
+        const VectorType &displacement = buffer[cornerOffset];
+        for (unsigned int k = 0;k < 3;++k)
+            outputPoint[k] += cornerWeight * displacement[k];
+    }
+}
+
+ITK_THREAD_RETURN_TYPE ThreadTransformer(void *arg)
+{
+    itk::MultiThreader::ThreadInfoStruct *threadArgs = (itk::MultiThreader::ThreadInfoStruct *)arg;
+    unsigned int nbThread = threadArgs->ThreadID;
+    unsigned int numTotalThread = threadArgs->NumberOfThreads;
+
+    ThreaderArguments *tmpArg = (ThreaderArguments *)threadArgs->UserData;
+
+    itk::uint64_t step = tmpArg->numPoints / numTotalThread;
+    itk::uint64_t startIndex = nbThread * step;
+    itk::uint64_t endIndex = (nbThread + 1) * step;
+
+    if (nbThread == numTotalThread - 1)
+        endIndex = tmpArg->numPoints;
+
     PointType pointPositionIn, pointPositionOut;
-    double pointPositionVTK[3];
+    for (itk::uint64_t i = startIndex;i < endIndex;++i)
+    {
+        GetTrackPoint(tmpArg,i,pointPositionIn);
+
+        if (tmpArg->displacementField)
+            TransformPointWithField(tmpArg->displacementField,pointPositionIn,pointPositionOut);
+        else if (tmpArg->linearTransform)
+            pointPositionOut = tmpArg->linearTransform->TransformPoint(pointPositionIn);
+        else
+            pointPositionOut = tmpArg->transform->TransformPoint(pointPositionIn);
+
+        SetTrackPoint(tmpArg,i,pointPositionOut);
+    }
+
+    return NULL;
+}
 
-    for (unsigned int i = 0;i < dataPoints->GetNumberOfPoints();++i)
+/**
+ * Transforms all track points in parallel. Linear series are merged into a single matrix. Otherwise, unless exact
+ * transformation is required, the whole series is evaluated once on a grid covering the tracks bounding box and points
+ * are moved by trilinear interpolation of this displacement field (grid spacing defaults to the finest one among
+ * dense transformations of the series)
+ */
+void ApplyTransformToTracks(ThreaderArguments &args, TransformType *transform, bool exactTransform,
+                            double fieldSpacing, unsigned int numThreads)
+{
+    args.transform = transform;
+    args.linearTransform = 0;
+    args.displacementField = 0;
+
+    LinearTransformType::Pointer linearTrsf;
+    DisplacementFieldType::Pointer displacementField;
+
+    if (transform->IsLinear())
+    {
+        // Composite transforms apply their last transform first
+        linearTrsf = LinearTransformType::New();
+        linearTrsf->SetIdentity();
+        for (unsigned int i = 0;i < transform->GetNumberOfTransforms();++i)
+            linearTrsf->Compose(dynamic_cast <LinearTransformType *> (transform->GetNthTransform(i).GetPointer()),true);
+
+        args.linearTransform = linearTrsf;
+    }
+    else if ((!exactTransform)&&(args.numPoints != 0))
     {
-        for (unsigned int k = 0; k < 3; ++k)
-            pointPositionIn[k] = dataPoints->GetPoint(i)[k];
+        if (fieldSpacing <= 0)
+        {
+            for (unsigned int i = 0;i < transform->GetNumberOfTransforms();++i)
+            {
+                DenseTransformType *denseTrsf = dynamic_cast <DenseTransformType *> (transform->GetNthTransform(i).GetPointer());
+                if ((!denseTrsf)||(!denseTrsf->GetParametersAsVectorField()))
+                    continue;
+
+                const DenseTransformType::VectorFieldType::SpacingType &denseSpacing = denseTrsf->GetParametersAsVectorField()->GetSpacing();
+                for (unsigned int k = 0;k < 3;++k)
+                {
+                    if ((fieldSpacing <= 0)||(denseSpacing[k] < fieldSpacing))
+                        fieldSpacing = denseSpacing[k];
+                }
+            }
+
+            if (fieldSpacing <= 0)
+                fieldSpacing = 1.0;
+        }
 
-        pointPositionOut = transform->TransformPoint(pointPositionIn);
+        PointType minPoint, maxPoint, currentPoint;
+        GetTrackPoint(&args,0,minPoint);
+        maxPoint = minPoint;
+        for (itk::uint64_t i = 1;i < args.numPoints;++i)
+        {
+            GetTrackPoint(&args,i,currentPoint);
+            for (unsigned int k = 0;k < 3;++k)
+            {
+                minPoint[k] = std::min(minPoint[k],currentPoint[k]);
+                maxPoint[k] = std::max(maxPoint[k],currentPoint[k]);
+            }
+        }
 
-        for (unsigned int k = 0; k < 3; ++k)
-            pointPositionVTK[k] = pointPositionOut[k];
+        // One voxel margin on each side so that all points fall strictly inside the grid
+        DisplacementFieldType::PointType fieldOrigin;
+        DisplacementFieldType::SpacingType fieldSpacingVector;
+        DisplacementFieldType::SizeType fieldSize;
+        DisplacementFieldType::IndexType fieldIndex;
+        DisplacementFieldType::DirectionType fieldDirection;
+        fieldDirection.SetIdentity();
 
-        dataPoints->SetPoint(i,pointPositionVTK);
+        for (unsigned int k = 0;k < 3;++k)
+        {
+            fieldOrigin[k] = minPoint[k] - fieldSpacing;
+            fieldSpacingVector[k] = fieldSpacing;
+            fieldSize[k] = (unsigned int)std::ceil((maxPoint[k] - minPoint[k]) / fieldSpacing) + 3;
+            fieldIndex[k] = 0;
+        }
+
+        std::cout << "Computing displacement field of size " << fieldSize << " with spacing " << fieldSpacing << std::endl;
+
+        typedef itk::TransformToDisplacementFieldFilter <DisplacementFieldType, double> DisplacementFieldGeneratorType;
+        DisplacementFieldGeneratorType::Pointer dispFieldGenerator = DisplacementFieldGeneratorType::New();
+        dispFieldGenerator->UseReferenceImageOff();
+        dispFieldGenerator->SetOutputDirection(fieldDirection);
+        dispFieldGenerator->SetOutputOrigin(fieldOrigin);
+        dispFieldGenerator->SetOutputSpacing(fieldSpacingVector);
+        dispFieldGenerator->SetOutputStartIndex(fieldIndex);
+        dispFieldGenerator->SetSize(fieldSize);
+
+        dispFieldGenerator->SetTransform(transform);
+        dispFieldGenerator->SetNumberOfThreads(numThreads);
+        dispFieldGenerator->Update();
+
+        displacementField = dispFieldGenerator->GetOutput();
+        displacementField->DisconnectPipeline();
+
+        args.displacementField = displacementField;
     }
+
+    itk::MultiThreader::Pointer mThreader = itk::MultiThreader::New();
+    mThreader->SetNumberOfThreads(numThreads);
+    mThreader->SetSingleMethod(ThreadTransformer,&args);
+    mThreader->SingleMethodExecute();
+
+    if (args.points)
+        args.points->Modified();
 }
 
 int main(int ac, const char** av)
@@ -35,6 +266,8 @@ int main(int ac, const char** av)
 
     TCLAP::ValueArg<unsigned int> expOrderArg("e","exp-order","Order of field exponentiation approximation (in between 0 and 1, default: 0)",false,0,"exponentiation order",cmd);
     TCLAP::SwitchArg invertArg("I","invert","Invert the transformation series",cmd,false);
+    TCLAP::SwitchArg exactArg("x","exact","Apply the transformation series to each point instead of interpolating a precomputed displacement field",cmd,false);
+    TCLAP::ValueArg<double> spacingArg("s","field-spacing","Spacing of the precomputed displacement field (default: finest spacing of dense transformations in the series)",false,0,"field spacing",cmd);
     TCLAP::ValueArg<unsigned int> nbpArg("p","numberofthreads","Number of threads to run on (default: all cores)",false,itk::MultiThreader::GetGlobalDefaultNumberOfThreads(),"number of threads",cmd);
 
     try
@@ -47,7 +280,6 @@ int main(int ac, const char** av)
         return EXIT_FAILURE;
     }
 
-    typedef anima::TransformSeriesReader <double, 3> TransformSeriesReaderType;
     TransformSeriesReaderType trsfReader;
     trsfReader.SetInput(trArg.getValue());
     trsfReader.SetInvertTransform(!invertArg.isSet());
@@ -55,12 +287,53 @@ int main(int ac, const char** av)
     trsfReader.SetNumberOfThreads(nbpArg.getValue());
     trsfReader.Update();
 
+    ThreaderArguments tmpStr;
+    tmpStr.points = 0;
+    tmpStr.pointRecords = 0;
+    tmpStr.recordLength = 3;
+    tmpStr.numPoints = 0;
+
+    if (anima::IsFibersBinaryFileName(inArg.getValue()) && anima::IsFibersBinaryFileName(outArg.getValue()))
+    {
+        // Writing the output would truncate the mapped input
+        if (itksys::SystemTools::SameFile(inArg.getValue(),outArg.getValue()))
+        {
+            std::cerr << "Error: binary fibers output has to be different from the input" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        // Private mapping: points are transformed in memory, the input file is untouched
+        anima::MappedFibersBinaryFile binaryTracks;
+        binaryTracks.Open(inArg.getValue());
+
+        tmpStr.pointRecords = binaryTracks.GetPointRecords();
+        tmpStr.recordLength = binaryTracks.GetHeader().GetPointRecordLength();
+        tmpStr.numPoints = binaryTracks.GetNumberOfPoints();
+        ApplyTransformToTracks(tmpStr, trsfReader.GetOutputTransform(), exactArg.isSet(), spacingArg.getValue(), nbpArg.getValue());
+
+        std::cout << "Writing tracks: " << outArg.getValue() << std::endl;
+        anima::FibersBinaryFileWriter binaryWriter;
+        binaryWriter.Open(outArg.getValue(),binaryTracks.GetHeader());
+
+        unsigned int fiberRecordLength = binaryTracks.GetHeader().GetFiberRecordLength();
+        for (itk::uint64_t i = 0;i < binaryTracks.GetNumberOfFibers();++i)
+        {
+            const float *fiberRecord = (fiberRecordLength != 0) ? binaryTracks.GetFiberRecords() + i * fiberRecordLength : 0;
+            binaryWriter.AppendFiber(binaryTracks.GetFiberPointRecords(i),binaryTracks.GetFiberNumberOfPoints(i),fiberRecord);
+        }
+
+        binaryWriter.Close();
+        return EXIT_SUCCESS;
+    }
+
     anima::ShapesReader trackReader;
     trackReader.SetFileName(inArg.getValue());
     trackReader.Update();
 
     vtkSmartPointer <vtkPolyData> tracks = trackReader.GetOutput();
-    ApplyTransformToTracks(tracks->GetPoints(), trsfReader.GetOutputTransform());
+    tmpStr.points = tracks->GetPoints();
+    tmpStr.numPoints = tracks->GetNumberOfPoints();
+    ApplyTransformToTracks(tmpStr, trsfReader.GetOutputTransform(), exactArg.isSet(), spacingArg.getValue(), nbpArg.getValue());
 
     anima::ShapesWriter writer;
     writer.SetInputData(tracks);
@@ -40,6 +40,7 @@ int main(int ac, const char** av)
     TCLAP::SwitchArg ppdArg("P","ppd","Use PPD re-orientation scheme (default: no)",cmd,false);
     TCLAP::SwitchArg invertArg("I","invert","Invert the transformation series",cmd,false);
     TCLAP::SwitchArg nearestArg("N","nearest","Use nearest neighbor interpolation",cmd,false);
+    TCLAP::SwitchArg pairingArg("H","hungarian","Group interpolated fascicles by greedy and Hungarian pairing instead of spectral clustering",cmd,false);
     
     TCLAP::ValueArg<unsigned int> nbpArg("p","numberofthreads","Number of threads to run on (default: all cores)",false,itk::MultiThreader::GetGlobalDefaultNumberOfThreads(),"number of threads",cmd);
     
@@ -143,6 +144,8 @@ int main(int ac, const char** av)
     {
         anima::MCMLinearInterpolateImageFunction<ImageType>::Pointer tmpInterpolator = anima::MCMLinearInterpolateImageFunction<ImageType>::New();
         tmpInterpolator->SetReferenceOutputModel(outputReferenceModel);
+        if (pairingArg.isSet())
+            tmpInterpolator->SetCompartmentGrouping(anima::MCMWeightedAverager::GreedyHungarianPairing);
         interpolator = tmpInterpolator;
     }
 
@@ -2,7 +2,6 @@
 #include "animaTensorGeneralizedCorrelationImageToImageMetric.h"
 
 #include <itkImageRegionConstIteratorWithIndex.h>
-#include <itkSymmetricEigenAnalysis.h>
 
 #include <animaBaseTensorTools.h>
 
@@ -62,7 +61,6 @@ TensorGeneralizedCorrelationImageToImageMetric<TFixedImagePixelType,TMovingImage
     vnl_matrix <double> ppdOrientationMatrix(tensorDimension, tensorDimension);
     typedef itk::Matrix <double, 3, 3> EigVecMatrixType;
     typedef vnl_vector_fixed <double,3> EigValVectorType;
-    itk::SymmetricEigenAnalysis < EigVecMatrixType, EigValVectorType, EigVecMatrixType> eigenComputer(3);
     EigVecMatrixType eigVecs;
     EigValVectorType eigVals;
 
@@ -89,7 +87,7 @@ TensorGeneralizedCorrelationImageToImageMetric<TFixedImagePixelType,TMovingImage
                     anima::RotateSymmetricMatrix(tmpMat,this->m_OrientationMatrix,currentTensor);
                 else
                 {
-                    eigenComputer.ComputeEigenValuesAndVectors(tmpMat,eigVals,eigVecs);
+                    anima::ComputeSymmetric3x3EigenSystem(tmpMat,eigVals,eigVecs);
                     anima::ExtractPPDRotationFromJacobianMatrix(this->m_OrientationMatrix,ppdOrientationMatrix,eigVecs);
                     anima::RotateSymmetricMatrix(tmpMat,ppdOrientationMatrix,currentTensor);
                 }
@@ -174,13 +172,11 @@ TensorGeneralizedCorrelationImageToImageMetric<TFixedImagePixelType,TMovingImage
         for (unsigned int i = 0;i < vectorSize;++i)
             movingMean[i] /= this->m_NumberOfPixelsCounted;
 
-        itk::SymmetricEigenAnalysis < vnl_matrix <double>, vnl_diag_matrix<double>, vnl_matrix <double> > eigenComputer(tensorDimension);
-
         anima::GetTensorFromVectorRepresentation(m_FixedMean,tmpMat,tensorDimension,true);
-        eigenComputer.ComputeEigenValuesAndVectors(tmpMat, tmpEigX, tmpXEVecs);
+        anima::ComputeSymmetric3x3EigenSystem(tmpMat, tmpEigX, tmpXEVecs);
 
         anima::GetTensorFromVectorRepresentation(movingMean,tmpMat,tensorDimension,true);
-        eigenComputer.ComputeEigenValuesAndVectors(tmpMat, tmpEigY, tmpYEVecs);
+        anima::ComputeSymmetric3x3EigenSystem(tmpMat, tmpEigY, tmpYEVecs);
 
         for (unsigned int a = 0;a < tensorDimension;++a)
         {
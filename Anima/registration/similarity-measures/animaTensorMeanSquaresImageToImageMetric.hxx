@@ -52,7 +52,6 @@ TensorMeanSquaresImageToImageMetric<TFixedImagePixelType,TMovingImagePixelType,I
     vnl_matrix <double> ppdOrientationMatrix(tensorDimension, tensorDimension);
     typedef itk::Matrix <double, 3, 3> EigVecMatrixType;
     typedef vnl_vector_fixed <double,3> EigValVectorType;
-    itk::SymmetricEigenAnalysis < EigVecMatrixType, EigValVectorType, EigVecMatrixType> eigenComputer(3);
     EigVecMatrixType eigVecs;
     EigValVectorType eigVals;
     PixelType movingValue;
@@ -78,7 +77,7 @@ TensorMeanSquaresImageToImageMetric<TFixedImagePixelType,TMovingImagePixelType,I
                     anima::RotateSymmetricMatrix(tmpMat,this->m_OrientationMatrix,currentTensor);
                 else
                 {
-                    eigenComputer.ComputeEigenValuesAndVectors(tmpMat,eigVals,eigVecs);
+                    anima::ComputeSymmetric3x3EigenSystem(tmpMat,eigVals,eigVecs);
                     anima::ExtractPPDRotationFromJacobianMatrix(this->m_OrientationMatrix,ppdOrientationMatrix,eigVecs);
                     anima::RotateSymmetricMatrix(tmpMat,ppdOrientationMatrix,currentTensor);
                 }